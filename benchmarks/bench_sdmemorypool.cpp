@@ -0,0 +1,207 @@
+// Variable-size allocator benchmark: CSDMTVarMemoryPool against malloc and
+// against a mutex-guarded CSDVarMemoryPool (the documented way to share one).
+//
+// Two rounds per allocator:
+//   local  every thread keeps a ring of live blocks and replaces one per
+//          operation, so allocation and free happen on the same thread;
+//   cross  producer threads allocate message buffers and hand them in
+//          batches to one consumer thread, which frees them, like I/O
+//          threads feeding the logic thread.
+// Sizes are drawn from [min, max].
+//
+// usage: bench_sdmemorypool [-t threads] [-n ops-per-thread] [-s min,max]
+#include "ssengine/sdmemorypool.h"
+
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+using namespace SSCP;
+
+namespace {
+
+struct Options {
+    UINT32 threads = 4;
+    UINT32 ops = 2000000;
+    UINT32 minSize = 16;
+    UINT32 maxSize = 2048;
+};
+
+const UINT32 RING = 1024;
+const UINT32 BATCH = 256;
+
+struct MallocAlloc {
+    const char* name() const { return "malloc"; }
+    void* alloc(UINT32 n) { return std::malloc(n); }
+    void release(void* p) { std::free(p); }
+};
+
+struct MTPoolAlloc {
+    CSDMTVarMemoryPool pool;
+    MTPoolAlloc() { pool.Create(); }
+    const char* name() const { return "mtpool"; }
+    void* alloc(UINT32 n) { return pool.Malloc(n); }
+    void release(void* p) { pool.Free(p); }
+};
+
+struct LockedPoolAlloc {
+    CSDVarMemoryPool pool;
+    std::mutex mtx;
+    LockedPoolAlloc() { pool.Create(); }
+    const char* name() const { return "varpool+lock"; }
+    void* alloc(UINT32 n) {
+        std::lock_guard<std::mutex> lk(mtx);
+        return pool.Malloc(n);
+    }
+    void release(void* p) {
+        std::lock_guard<std::mutex> lk(mtx);
+        pool.Free(p);
+    }
+};
+
+// xorshift, so the size stream costs next to nothing.
+struct Sizes {
+    UINT32 state;
+    UINT32 lo, span;
+    Sizes(UINT32 seed, const Options& o) : state(seed * 2654435761u + 1), lo(o.minSize), span(o.maxSize - o.minSize + 1) {}
+    UINT32 next() {
+        state ^= state << 13;
+        state ^= state >> 17;
+        state ^= state << 5;
+        return lo + state % span;
+    }
+};
+
+double seconds(std::chrono::steady_clock::time_point start) {
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+template <typename A>
+double runLocal(A& a, const Options& o) {
+    std::vector<std::thread> threads;
+    auto start = std::chrono::steady_clock::now();
+    for (UINT32 t = 0; t < o.threads; ++t) {
+        threads.emplace_back([&a, &o, t] {
+            Sizes sizes(t, o);
+            void* ring[RING];
+            for (UINT32 i = 0; i < RING; ++i) ring[i] = a.alloc(sizes.next());
+            for (UINT32 i = 0; i < o.ops; ++i) {
+                void*& slot = ring[i % RING];
+                a.release(slot);
+                UINT32 n = sizes.next();
+                slot = a.alloc(n);
+                static_cast<char*>(slot)[0] = static_cast<char>(n);
+            }
+            for (void* p : ring) a.release(p);
+        });
+    }
+    for (auto& th : threads) th.join();
+    return seconds(start);
+}
+
+template <typename A>
+double runCross(A& a, const Options& o) {
+    std::mutex mtx;
+    std::vector<std::vector<void*>> handed;
+    std::atomic<UINT32> producing{o.threads};
+    auto start = std::chrono::steady_clock::now();
+    std::thread consumer([&] {
+        std::vector<std::vector<void*>> batches;
+        for (;;) {
+            bool last = producing.load(std::memory_order_acquire) == 0;
+            {
+                std::lock_guard<std::mutex> lk(mtx);
+                batches.swap(handed);
+            }
+            for (auto& b : batches) {
+                for (void* p : b) a.release(p);
+            }
+            if (batches.empty()) {
+                if (last) break;
+                std::this_thread::yield();
+            }
+            batches.clear();
+        }
+    });
+    std::vector<std::thread> producers;
+    for (UINT32 t = 0; t < o.threads; ++t) {
+        producers.emplace_back([&, t] {
+            Sizes sizes(t, o);
+            std::vector<void*> batch;
+            batch.reserve(BATCH);
+            for (UINT32 i = 0; i < o.ops; ++i) {
+                UINT32 n = sizes.next();
+                void* p = a.alloc(n);
+                static_cast<char*>(p)[0] = static_cast<char>(n);
+                batch.push_back(p);
+                if (batch.size() == BATCH) {
+                    std::lock_guard<std::mutex> lk(mtx);
+                    handed.push_back(std::move(batch));
+                    batch = std::vector<void*>();
+                    batch.reserve(BATCH);
+                }
+            }
+            std::lock_guard<std::mutex> lk(mtx);
+            handed.push_back(std::move(batch));
+        });
+    }
+    for (auto& th : producers) th.join();
+    producing.store(0, std::memory_order_release);
+    consumer.join();
+    return seconds(start);
+}
+
+template <typename A>
+void bench(const Options& o) {
+    A a;
+    double ops = static_cast<double>(o.ops) * o.threads;
+    double local = runLocal(a, o);
+    double cross = runCross(a, o);
+    std::printf("%-13s local %8.1f Mops/s %6.1f ns/op   cross %8.1f Mops/s %6.1f ns/op\n", a.name(),
+                ops / local / 1e6, local * 1e9 / ops * o.threads, ops / cross / 1e6, cross * 1e9 / ops * o.threads);
+}
+
+bool parseArgs(int argc, char** argv, Options& o) {
+    for (int i = 1; i < argc; ++i) {
+        std::string a = argv[i];
+        const char* v = i + 1 < argc ? argv[i + 1] : nullptr;
+        if (!v) {
+            std::fprintf(stderr, "usage: bench_sdmemorypool [-t threads] [-n ops-per-thread] [-s min,max]\n");
+            return false;
+        }
+        ++i;
+        if (a == "-t") o.threads = static_cast<UINT32>(std::atoi(v));
+        else if (a == "-n") o.ops = static_cast<UINT32>(std::atoi(v));
+        else if (a == "-s" && std::strchr(v, ',')) {
+            o.minSize = static_cast<UINT32>(std::atoi(v));
+            o.maxSize = static_cast<UINT32>(std::atoi(std::strchr(v, ',') + 1));
+        } else {
+            std::fprintf(stderr, "bench_sdmemorypool: bad option %s\n", a.c_str());
+            return false;
+        }
+    }
+    if (o.threads == 0 || o.ops == 0 || o.minSize == 0 || o.maxSize < o.minSize) {
+        std::fprintf(stderr, "bench_sdmemorypool: bad options\n");
+        return false;
+    }
+    return true;
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+    Options opt;
+    if (!parseArgs(argc, argv, opt)) return 1;
+    std::printf("%u threads, %u ops each, sizes %u..%u (ns/op is per thread)\n", opt.threads, opt.ops, opt.minSize,
+                opt.maxSize);
+    bench<MallocAlloc>(opt);
+    bench<MTPoolAlloc>(opt);
+    bench<LockedPoolAlloc>(opt);
+    return 0;
+}
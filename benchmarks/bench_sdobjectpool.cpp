@@ -0,0 +1,189 @@
+// CSDObjectPool contention benchmark: ObjectSlabAllocator (per-thread
+// magazines, lock-free depot) against the default ObjectAllocator with a
+// CSDMutex and against plain new/delete.
+//
+// Two rounds per allocator, repeated for 1, 2, 4 ... up to the thread count:
+//   local  every thread keeps a ring of live objects and replaces one per
+//          operation, so Alloc and Free happen on the same thread;
+//   cross  producer threads allocate objects and hand them in batches to
+//          one consumer thread, which frees them.
+// The slab allocator's local rate should grow with the thread count on a
+// machine with that many cores; the mutex allocator's should not.
+//
+// usage: bench_sdobjectpool [-t max-threads] [-n ops-per-thread]
+#include "ssengine/sdobjectpool.h"
+
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+using namespace SSCP;
+
+namespace {
+
+struct Options {
+    UINT32 threads = 8;
+    UINT32 ops = 2000000;
+};
+
+const UINT32 RING = 256;
+const UINT32 BATCH = 256;
+
+// A typical small message/entity object.
+struct Object {
+    UINT64 id;
+    UINT32 kind;
+    UINT32 flags;
+    char payload[48];
+    explicit Object(UINT64 n) : id(n), kind(static_cast<UINT32>(n)), flags(0) { payload[0] = 0; }
+};
+
+struct NewDelete {
+    const char* name() const { return "new/delete"; }
+    Object* alloc(UINT64 n) { return new Object(n); }
+    void release(Object* p) { delete p; }
+};
+
+struct MutexPool {
+    CSDObjectPool<Object, CSDMutex> pool;
+    MutexPool() : pool(1024, 1024) {}
+    const char* name() const { return "pool+mutex"; }
+    Object* alloc(UINT64 n) { return pool.Alloc(n); }
+    void release(Object* p) { pool.Free(p); }
+};
+
+struct SlabPool {
+    CSDObjectPool<Object, CSDNonMutex, ObjectSlabAllocator<Object> > pool;
+    SlabPool() : pool(1024, 1024) {}
+    const char* name() const { return "pool+slab"; }
+    Object* alloc(UINT64 n) { return pool.Alloc(n); }
+    void release(Object* p) { pool.Free(p); }
+};
+
+double seconds(std::chrono::steady_clock::time_point start) {
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+template <typename A>
+double runLocal(A& a, UINT32 threadCount, const Options& o) {
+    std::vector<std::thread> threads;
+    auto start = std::chrono::steady_clock::now();
+    for (UINT32 t = 0; t < threadCount; ++t) {
+        threads.emplace_back([&a, &o] {
+            Object* ring[RING];
+            for (UINT32 i = 0; i < RING; ++i) ring[i] = a.alloc(i);
+            for (UINT32 i = 0; i < o.ops; ++i) {
+                Object*& slot = ring[i % RING];
+                a.release(slot);
+                slot = a.alloc(i);
+            }
+            for (Object* p : ring) a.release(p);
+        });
+    }
+    for (auto& th : threads) th.join();
+    return seconds(start);
+}
+
+template <typename A>
+double runCross(A& a, UINT32 threadCount, const Options& o) {
+    std::mutex mtx;
+    std::vector<std::vector<Object*>> handed;
+    std::atomic<bool> producing{true};
+    auto start = std::chrono::steady_clock::now();
+    std::thread consumer([&] {
+        std::vector<std::vector<Object*>> batches;
+        for (;;) {
+            bool last = !producing.load(std::memory_order_acquire);
+            {
+                std::lock_guard<std::mutex> lk(mtx);
+                batches.swap(handed);
+            }
+            for (auto& b : batches) {
+                for (Object* p : b) a.release(p);
+            }
+            if (batches.empty()) {
+                if (last) break;
+                std::this_thread::yield();
+            }
+            batches.clear();
+        }
+    });
+    std::vector<std::thread> producers;
+    for (UINT32 t = 0; t < threadCount; ++t) {
+        producers.emplace_back([&] {
+            std::vector<Object*> batch;
+            batch.reserve(BATCH);
+            for (UINT32 i = 0; i < o.ops; ++i) {
+                batch.push_back(a.alloc(i));
+                if (batch.size() == BATCH) {
+                    std::lock_guard<std::mutex> lk(mtx);
+                    handed.push_back(std::move(batch));
+                    batch = std::vector<Object*>();
+                    batch.reserve(BATCH);
+                }
+            }
+            std::lock_guard<std::mutex> lk(mtx);
+            handed.push_back(std::move(batch));
+        });
+    }
+    for (auto& th : producers) th.join();
+    producing.store(false, std::memory_order_release);
+    consumer.join();
+    return seconds(start);
+}
+
+template <typename A>
+void bench(UINT32 threadCount, const Options& o) {
+    A a;
+    double ops = static_cast<double>(o.ops) * threadCount;
+    double local = runLocal(a, threadCount, o);
+    double cross = runCross(a, threadCount, o);
+    std::printf("%2u  %-11s local %8.1f Mops/s %6.1f ns/op   cross %8.1f Mops/s %6.1f ns/op\n", threadCount,
+                a.name(), ops / local / 1e6, local * 1e9 / ops * threadCount, ops / cross / 1e6,
+                cross * 1e9 / ops * threadCount);
+}
+
+bool parseArgs(int argc, char** argv, Options& o) {
+    for (int i = 1; i < argc; ++i) {
+        std::string a = argv[i];
+        const char* v = i + 1 < argc ? argv[i + 1] : nullptr;
+        if (!v) {
+            std::fprintf(stderr, "usage: bench_sdobjectpool [-t max-threads] [-n ops-per-thread]\n");
+            return false;
+        }
+        ++i;
+        if (a == "-t") o.threads = static_cast<UINT32>(std::atoi(v));
+        else if (a == "-n") o.ops = static_cast<UINT32>(std::atoi(v));
+        else {
+            std::fprintf(stderr, "bench_sdobjectpool: bad option %s\n", a.c_str());
+            return false;
+        }
+    }
+    if (o.threads == 0 || o.ops == 0) {
+        std::fprintf(stderr, "bench_sdobjectpool: bad options\n");
+        return false;
+    }
+    return true;
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+    Options opt;
+    if (!parseArgs(argc, argv, opt)) return 1;
+    std::printf("up to %u threads, %u ops each, %u hardware threads (ns/op is per thread)\n", opt.threads, opt.ops,
+                std::thread::hardware_concurrency());
+    for (UINT32 n = 1;; n *= 2) {
+        if (n > opt.threads) n = opt.threads;
+        bench<NewDelete>(n, opt);
+        bench<MutexPool>(n, opt);
+        bench<SlabPool>(n, opt);
+        if (n == opt.threads) break;
+    }
+    return 0;
+}
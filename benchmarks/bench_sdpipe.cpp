@@ -0,0 +1,245 @@
+// sdpipe throughput/latency benchmark.
+//
+// Two ISSPipeModule instances live in one process: module A listens, module B
+// opens K pipes to it. B pushes fixed-size business messages stamped with a
+// send time; A runs on its own thread and records one-way latency. Each
+// configured payload size is one round; "mix" replays a weighted traffic mix.
+//
+// usage: bench_sdpipe [-k pipes] [-n messages] [-w window] [-s size,size,...] [-p port]
+// Latency is measured under load with up to -w messages in flight; -w 1 gives
+// the unloaded one-way latency.
+#include "ssengine/sdpipe.h"
+#include "ssengine/sdnet.h"
+#include "ssengine/sdnet_ver.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <mutex>
+#include <new>
+#include <string>
+#include <thread>
+#include <vector>
+
+using namespace SSCP;
+
+//
+// Allocation accounting: every operator new in the process is counted.
+//
+static std::atomic<UINT64> g_allocs{0};
+
+void* operator new(std::size_t n) {
+    g_allocs.fetch_add(1, std::memory_order_relaxed);
+    if (void* p = std::malloc(n ? n : 1)) return p;
+    throw std::bad_alloc();
+}
+void* operator new[](std::size_t n) { return operator new(n); }
+void operator delete(void* p) noexcept { std::free(p); }
+void operator delete[](void* p) noexcept { std::free(p); }
+void operator delete(void* p, std::size_t) noexcept { std::free(p); }
+void operator delete[](void* p, std::size_t) noexcept { std::free(p); }
+
+namespace {
+
+const UINT16 BENCH_BUSINESSID = 100;
+
+inline UINT64 nowNs() {
+    return static_cast<UINT64>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count());
+}
+
+struct Options {
+    UINT32 pipes = 4;
+    UINT32 messages = 200000;
+    UINT32 window = 4096;
+    UINT16 port = 46100;
+    std::vector<UINT32> sizes{16, 64, 256, 1024, 4096};
+    bool mix = true;
+};
+
+// Traffic mix: (payload size, weight) pairs.
+const std::pair<UINT32, UINT32> kMix[] = {{16, 40}, {64, 30}, {256, 20}, {1024, 8}, {4096, 2}};
+
+struct IdReporter : public ISSPipeReporter {
+    std::mutex mtx;
+    std::vector<UINT32> ids;
+    void SSAPI OnReport(INT32 nErrCode, UINT32 dwID) override {
+        if (nErrCode != PIPE_SUCCESS) return;
+        std::lock_guard<std::mutex> lk(mtx);
+        if (std::find(ids.begin(), ids.end(), dwID) == ids.end()) ids.push_back(dwID);
+    }
+    size_t count() { std::lock_guard<std::mutex> lk(mtx); return ids.size(); }
+};
+
+// Receiving side: stores one-way latency per message into a preallocated array.
+struct LatencySink : public ISSPipeSink {
+    std::vector<UINT32>* lat = nullptr;
+    std::atomic<UINT32>* received = nullptr;
+    void SSAPI OnRecv(UINT16, const char* pData, UINT32 dwLen) override {
+        if (dwLen < sizeof(UINT64)) return;
+        UINT64 sent;
+        std::memcpy(&sent, pData, sizeof(sent));
+        UINT32 idx = received->load(std::memory_order_relaxed);
+        if (idx < lat->size()) (*lat)[idx] = static_cast<UINT32>(std::min<UINT64>(nowNs() - sent, 0xFFFFFFFFu));
+        received->store(idx + 1, std::memory_order_release);
+    }
+    void SSAPI OnReport(UINT16, INT32) override {}
+};
+
+struct Round {
+    std::string name;
+    std::vector<UINT32> sizes;   // per-message payload size, cycled
+};
+
+void printRound(const Round& r, UINT32 n, double secs, UINT64 allocs, UINT64 bytes, std::vector<UINT32>& lat) {
+    std::sort(lat.begin(), lat.end());
+    auto pct = [&](double p) { return lat.empty() ? 0u : lat[std::min<size_t>(lat.size() - 1, static_cast<size_t>(p * lat.size()))]; };
+    std::printf("%-8s %10.0f msg/s %9.1f MB/s  p50 %8.2f us  p99 %8.2f us  max %9.2f us  %6.2f alloc/msg\n",
+                r.name.c_str(), n / secs, bytes / secs / (1024.0 * 1024.0),
+                pct(0.50) / 1000.0, pct(0.99) / 1000.0, (lat.empty() ? 0 : lat.back()) / 1000.0,
+                static_cast<double>(allocs) / n);
+    // log2 latency histogram
+    UINT32 buckets[33] = {0};
+    for (UINT32 v : lat) {
+        UINT32 b = 0;
+        while (b < 32 && (1u << b) <= v) ++b;
+        ++buckets[b];
+    }
+    std::printf("         latency histogram (ns):");
+    for (UINT32 b = 0; b < 33; ++b) {
+        if (!buckets[b]) continue;
+        std::printf(" <%u:%u", b >= 32 ? 0xFFFFFFFFu : (1u << b), buckets[b]);
+    }
+    std::printf("\n");
+}
+
+bool parseArgs(int argc, char** argv, Options& o) {
+    for (int i = 1; i < argc; ++i) {
+        std::string a = argv[i];
+        auto next = [&]() -> const char* { return i + 1 < argc ? argv[++i] : nullptr; };
+        const char* v = nullptr;
+        if (a == "-k" && (v = next())) o.pipes = static_cast<UINT32>(std::atoi(v));
+        else if (a == "-n" && (v = next())) o.messages = static_cast<UINT32>(std::atoi(v));
+        else if (a == "-w" && (v = next())) o.window = static_cast<UINT32>(std::atoi(v));
+        else if (a == "-p" && (v = next())) o.port = static_cast<UINT16>(std::atoi(v));
+        else if (a == "-s" && (v = next())) {
+            o.sizes.clear();
+            o.mix = false;
+            std::string list = v;
+            size_t pos = 0;
+            while (pos <= list.size()) {
+                size_t comma = list.find(',', pos);
+                std::string tok = list.substr(pos, comma == std::string::npos ? std::string::npos : comma - pos);
+                if (tok == "mix") o.mix = true;
+                else if (!tok.empty()) o.sizes.push_back(static_cast<UINT32>(std::atoi(tok.c_str())));
+                if (comma == std::string::npos) break;
+                pos = comma + 1;
+            }
+        } else {
+            std::fprintf(stderr, "usage: %s [-k pipes] [-n messages] [-w window] [-s size,...|mix] [-p port]\n", argv[0]);
+            return false;
+        }
+    }
+    if (o.pipes == 0 || o.messages == 0 || o.window == 0) return false;
+    return true;
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+    Options opt;
+    if (!parseArgs(argc, argv, opt)) return 1;
+
+    ISSNet* netA = SSNetGetModule(&SDNET_MODULE_VERSION);
+    ISSNet* netB = SSNetGetModule(&SDNET_MODULE_VERSION);
+    ISSPipeModule* pipeA = SSPipeGetModule(&SDNET_MODULE_VERSION);
+    ISSPipeModule* pipeB = SSPipeGetModule(&SDNET_MODULE_VERSION);
+    IdReporter repA, repB;
+    if (!netA || !netB || !pipeA || !pipeB || !pipeA->Init(nullptr, nullptr, &repA, netA) ||
+        !pipeB->Init(nullptr, nullptr, &repB, netB) || !pipeA->AddListen("127.0.0.1", opt.port)) {
+        std::fprintf(stderr, "bench_sdpipe: setup failed\n");
+        return 1;
+    }
+    std::vector<ISSPipe*> senders;
+    for (UINT32 i = 0; i < opt.pipes; ++i) {
+        if (!pipeB->AddConn(0x02000000 + i, "127.0.0.1", opt.port)) {
+            std::fprintf(stderr, "bench_sdpipe: AddConn %u failed\n", i);
+            return 1;
+        }
+    }
+    for (int i = 0; i < 500 && (repA.count() < opt.pipes || repB.count() < opt.pipes); ++i) {
+        pipeA->Run(64); pipeB->Run(64);
+        std::this_thread::sleep_for(std::chrono::milliseconds(2));
+    }
+    // Let transport negotiation settle before measuring.
+    for (int i = 0; i < 50; ++i) { pipeA->Run(64); pipeB->Run(64); std::this_thread::sleep_for(std::chrono::milliseconds(2)); }
+    if (repA.count() < opt.pipes) {
+        std::fprintf(stderr, "bench_sdpipe: only %zu of %u pipes connected\n", repA.count(), opt.pipes);
+        return 1;
+    }
+    for (UINT32 i = 0; i < opt.pipes; ++i) senders.push_back(pipeB->GetPipe(0x02000000 + i));
+
+    std::vector<UINT32> lat;
+    std::atomic<UINT32> received{0};
+    LatencySink sink;
+    sink.lat = &lat;
+    sink.received = &received;
+    for (UINT32 id : repA.ids) {
+        if (ISSPipe* p = pipeA->GetPipe(id)) p->SetSink(BENCH_BUSINESSID, &sink);
+    }
+
+    std::vector<Round> rounds;
+    for (UINT32 s : opt.sizes) rounds.push_back(Round{std::to_string(s), {std::max<UINT32>(s, sizeof(UINT64))}});
+    if (opt.mix) {
+        Round r{"mix", {}};
+        for (const auto& m : kMix) r.sizes.insert(r.sizes.end(), m.second, m.first);
+        // Spread sizes so consecutive messages differ.
+        for (size_t i = 0; i < r.sizes.size(); ++i) std::swap(r.sizes[i], r.sizes[(i * 7919) % r.sizes.size()]);
+        rounds.push_back(r);
+    }
+
+    std::printf("sdpipe benchmark: %u pipes, %u messages per round, window %u\n", opt.pipes, opt.messages, opt.window);
+    UINT32 maxSize = 0;
+    for (const Round& r : rounds) for (UINT32 s : r.sizes) maxSize = std::max(maxSize, s);
+    std::vector<char> payload(maxSize, 'x');
+
+    for (const Round& r : rounds) {
+        lat.assign(opt.messages, 0);
+        received.store(0);
+        std::atomic<bool> stop{false};
+        std::thread receiver([&]() { while (!stop.load(std::memory_order_relaxed)) pipeA->Run(256); });
+
+        UINT64 bytes = 0;
+        UINT64 allocs0 = g_allocs.load();
+        UINT64 t0 = nowNs();
+        for (UINT32 i = 0; i < opt.messages; ++i) {
+            while (i - received.load(std::memory_order_acquire) >= opt.window) pipeB->Run(256);
+            UINT32 size = r.sizes[i % r.sizes.size()];
+            UINT64 ts = nowNs();
+            std::memcpy(payload.data(), &ts, sizeof(ts));
+            senders[i % senders.size()]->Send(BENCH_BUSINESSID, payload.data(), size);
+            bytes += size;
+            if ((i & 63) == 0) pipeB->Run(64);
+        }
+        while (received.load(std::memory_order_acquire) < opt.messages) {
+            pipeB->Run(256);
+            if (nowNs() - t0 > 60ull * 1000 * 1000 * 1000) break;
+        }
+        UINT64 t1 = nowNs();
+        UINT64 allocs = g_allocs.load() - allocs0;
+        stop.store(true);
+        receiver.join();
+
+        UINT32 got = std::min(received.load(), opt.messages);
+        if (got < opt.messages) std::printf("%-8s timed out after %u of %u messages\n", r.name.c_str(), got, opt.messages);
+        lat.resize(got);
+        if (got) printRound(r, got, (t1 - t0) / 1e9, allocs, bytes, lat);
+    }
+
+    pipeB->Release(); pipeA->Release();
+    netB->Release(); netA->Release();
+    return 0;
+}
@@ -0,0 +1,160 @@
+// CSDThreadPool scheduling benchmark: the shared-queue mode against the
+// work-stealing mode, at 1, 2, 4 ... up to the thread count.
+//
+// Two rounds per mode:
+//   flat    the main thread schedules every job, like a batch of AI
+//           updates submitted by the logic thread;
+//   nested  one root job splits in two until the leaves, every split
+//           scheduled from inside the pool, like a divide-and-conquer
+//           path-finding batch.
+// Each job spins for a fixed amount of work, so the numbers show
+// scheduling overhead and scaling rather than memory traffic.
+//
+// usage: bench_sdthreadpool [-t max-threads] [-n jobs] [-w work-per-job]
+#include "ssengine/sdthreadpool.h"
+
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <thread>
+#include <vector>
+
+using namespace SSCP;
+
+namespace {
+
+struct Options {
+    UINT32 threads = 8;
+    UINT32 jobs = 200000;
+    UINT32 work = 200;
+};
+
+volatile UINT64 g_sink;
+
+void spin(UINT32 work) {
+    UINT64 x = work;
+    for (UINT32 i = 0; i < work; ++i) x = x * 6364136223846793005ull + 1442695040888963407ull;
+    g_sink = x;
+}
+
+class FlatJob : public ISSRunable {
+public:
+    FlatJob(UINT32 work, std::atomic<UINT32>& done) : _work(work), _done(done) {}
+    void Run() override {
+        spin(_work);
+        _done.fetch_add(1, std::memory_order_relaxed);
+    }
+
+private:
+    UINT32 _work;
+    std::atomic<UINT32>& _done;
+};
+
+class SplitJob : public ISSRunable {
+public:
+    SplitJob(CSDThreadPool& pool, UINT32 leaves, UINT32 work, std::atomic<UINT32>& done)
+        : _pool(pool), _leaves(leaves), _work(work), _done(done) {}
+    void Run() override {
+        if (_leaves > 1) {
+            schedule(new SplitJob(_pool, _leaves / 2, _work, _done));
+            schedule(new SplitJob(_pool, _leaves - _leaves / 2, _work, _done));
+        } else {
+            spin(_work);
+            _done.fetch_add(1, std::memory_order_relaxed);
+        }
+        delete this;
+    }
+
+private:
+    void schedule(SplitJob* job) {
+        while (!_pool.ScheduleJob(job)) std::this_thread::yield();
+    }
+
+    CSDThreadPool& _pool;
+    UINT32 _leaves;
+    UINT32 _work;
+    std::atomic<UINT32>& _done;
+};
+
+double seconds(std::chrono::steady_clock::time_point start) {
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+void waitFor(std::atomic<UINT32>& done, UINT32 n) {
+    while (done.load(std::memory_order_relaxed) < n) std::this_thread::yield();
+}
+
+double runFlat(CSDThreadPool& pool, const Options& o) {
+    std::atomic<UINT32> done{0};
+    std::vector<FlatJob> jobs(o.jobs, FlatJob(o.work, done));
+    auto start = std::chrono::steady_clock::now();
+    for (FlatJob& job : jobs) {
+        while (!pool.ScheduleJob(&job)) std::this_thread::yield();
+    }
+    waitFor(done, o.jobs);
+    return seconds(start);
+}
+
+double runNested(CSDThreadPool& pool, const Options& o) {
+    std::atomic<UINT32> done{0};
+    auto start = std::chrono::steady_clock::now();
+    pool.ScheduleJob(new SplitJob(pool, o.jobs, o.work, done));
+    waitFor(done, o.jobs);
+    return seconds(start);
+}
+
+void bench(UINT32 threads, ESDThreadPoolMode mode, const Options& o) {
+    CSDThreadPool pool;
+    if (!pool.Init(threads, threads, 0, mode)) {
+        std::fprintf(stderr, "bench_sdthreadpool: Init failed\n");
+        std::exit(1);
+    }
+    double flat = runFlat(pool, o);
+    double nested = runNested(pool, o);
+    pool.TerminateWaitJobs();
+    std::printf("%2u  %-8s flat %7.2f Mjobs/s %7.1f ns/job   nested %7.2f Mjobs/s %7.1f ns/job\n", threads,
+                mode == SDTHREADPOOL_WORK_STEALING ? "stealing" : "shared", o.jobs / flat / 1e6,
+                flat * 1e9 / o.jobs, o.jobs / nested / 1e6, nested * 1e9 / o.jobs);
+}
+
+bool parseArgs(int argc, char** argv, Options& o) {
+    for (int i = 1; i < argc; ++i) {
+        std::string a = argv[i];
+        const char* v = i + 1 < argc ? argv[i + 1] : nullptr;
+        if (!v) {
+            std::fprintf(stderr, "usage: bench_sdthreadpool [-t max-threads] [-n jobs] [-w work-per-job]\n");
+            return false;
+        }
+        ++i;
+        if (a == "-t") o.threads = static_cast<UINT32>(std::atoi(v));
+        else if (a == "-n") o.jobs = static_cast<UINT32>(std::atoi(v));
+        else if (a == "-w") o.work = static_cast<UINT32>(std::atoi(v));
+        else {
+            std::fprintf(stderr, "bench_sdthreadpool: bad option %s\n", a.c_str());
+            return false;
+        }
+    }
+    if (o.threads == 0 || o.jobs == 0) {
+        std::fprintf(stderr, "bench_sdthreadpool: bad options\n");
+        return false;
+    }
+    return true;
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+    Options opt;
+    if (!parseArgs(argc, argv, opt)) return 1;
+    std::printf("up to %u threads, %u jobs, work %u, %u hardware threads\n", opt.threads, opt.jobs, opt.work,
+                std::thread::hardware_concurrency());
+    for (UINT32 n = 1;; n *= 2) {
+        if (n > opt.threads) n = opt.threads;
+        bench(n, SDTHREADPOOL_SHARED_QUEUE, opt);
+        bench(n, SDTHREADPOOL_WORK_STEALING, opt);
+        if (n == opt.threads) break;
+    }
+    return 0;
+}
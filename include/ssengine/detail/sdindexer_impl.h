@@ -33,7 +33,7 @@ namespace SSCP
 	template <class T> 
 	struct DefaultValue<T * > 
 	{
-		void operator() (T & data)
+		void operator() (T * & data)
 		{
 			data = NULL;
 		}
@@ -65,7 +65,7 @@ namespace SSCP
 			m_freeCount = maxSize - 1;
 		}
 
-		UINT32 Alloc(T & value)
+		UINT32 Alloc(const T & value)
 		{
 			while (m_freeCount > 0)
 			{
@@ -77,7 +77,7 @@ namespace SSCP
 						m_array[curIdx].data = value;
 						//һ,߳ͬʱ,Ὣ˲0
 						SDAtomicDec32((volatile INT32*)&m_freeCount);
-						SDAtomicSet32((volatile INT32 *)&m_curIndex, (m_curIndex)%(maxSize-2) + 1);
+						SDAtomicSet32((volatile INT32 *)&m_curIndex, curIdx % (maxSize - 1) + 1);
 						return curIdx;
 					}
 				}
@@ -90,7 +90,7 @@ namespace SSCP
 						m_array[curIdx].data = value;
 						//һ,߳ͬʱ,Ὣ˲0
 						SDAtomicDec32((volatile INT32*)&m_freeCount);
-						SDAtomicSet32((volatile INT32 *)&m_curIndex, (m_curIndex)%(maxSize - 2) + 1);
+						SDAtomicSet32((volatile INT32 *)&m_curIndex, curIdx % (maxSize - 1) + 1);
 						return curIdx;
 					}
 				}
@@ -103,7 +103,7 @@ namespace SSCP
 		{
 			for (UINT32 i = 1; i < maxSize; i++)
 			{
-				if (m_equaler(m_array[i].data, data))
+				if (m_array[i].bUsed && m_equaler(m_array[i].data, data))
 				{
 					return i;
 				}
@@ -135,8 +135,11 @@ namespace SSCP
 			static T defValue;
 			if (idx < maxSize && idx > 0)
 			{
-				SDAtomicInc32((volatile INT32 *)&m_freeCount);
-				SDAtomicCas32((volatile INT32*)&(m_array[idx].bUsed), FALSE, TRUE);
+				//ֻñΪδʱŹ黹,ظͷŲ
+				if (SDAtomicCas32((volatile INT32*)&(m_array[idx].bUsed), FALSE, TRUE))
+				{
+					SDAtomicInc32((volatile INT32 *)&m_freeCount);
+				}
 				return m_array[idx].data;
 			}
 			return defValue;
@@ -0,0 +1,476 @@
+#ifndef __OBJECT_SLAB_ALLOCATOR_H__
+#define __OBJECT_SLAB_ALLOCATOR_H__
+
+#include "sdmutex.h"
+#include "sdlock.h"
+#include <atomic>
+#include <new>
+#include <unordered_set>
+#include <vector>
+
+// Slab allocator with per-thread magazines, after Bonwick's magazine layer.
+//
+// Objects are carved from contiguous slabs. Every thread keeps two
+// magazines (small stacks of free objects) per allocator, so allocate and
+// deallocate normally touch nothing shared. A thread whose magazines run
+// dry or fill up trades a whole magazine with the depot, two lock-free
+// stacks of full and empty magazines; only carving a new slab or creating
+// a magazine takes the mutex. Objects freed on another thread come back
+// to the allocating threads through the depot. A thread's magazines are
+// returned to the depot when it exits.
+
+namespace SSCP
+{
+    // Thread-side bookkeeping shared by every ObjectSlabAllocator: the ids of
+    // live allocators, and each thread's list of the caches it owns so they
+    // can be flushed at thread exit.
+    class ObjectSlabRegistry
+    {
+    public:
+        typedef void (*FlushFn)(void* allocator, void* cache);
+
+        struct Entry
+        {
+            UINT64  id;
+            void*   allocator;
+            void*   cache;
+            FlushFn flush;
+        };
+
+        struct ThreadCaches
+        {
+            UINT64 lastId;
+            void*  lastCache;
+            std::vector<Entry> entries;
+
+            ThreadCaches() : lastId(0), lastCache(NULL)
+            {
+            }
+
+            ~ThreadCaches()
+            {
+                CSDLock<CSDMutex> lock(Mutex());
+                for (size_t i = 0; i < entries.size(); ++i)
+                {
+                    if (Live().count(entries[i].id))
+                    {
+                        entries[i].flush(entries[i].allocator, entries[i].cache);
+                    }
+                }
+            }
+        };
+
+        static CSDMutex& Mutex()
+        {
+            static CSDMutex mutex;
+            return mutex;
+        }
+
+        static std::unordered_set<UINT64>& Live()
+        {
+            static std::unordered_set<UINT64> live;
+            return live;
+        }
+
+        static ThreadCaches& Local()
+        {
+            static thread_local ThreadCaches caches;
+            return caches;
+        }
+
+        static UINT64 Register()
+        {
+            static std::atomic<UINT64> next(0);
+            UINT64 id = ++next;
+            CSDLock<CSDMutex> lock(Mutex());
+            Live().insert(id);
+            return id;
+        }
+
+        // Once this returns no thread is flushing into the allocator.
+        static void Unregister(UINT64 id)
+        {
+            CSDLock<CSDMutex> lock(Mutex());
+            Live().erase(id);
+        }
+
+        // Adds a cache to the calling thread, dropping entries of allocators
+        // that have gone away.
+        static void Attach(const Entry& entry)
+        {
+            ThreadCaches& local = Local();
+            CSDLock<CSDMutex> lock(Mutex());
+            size_t kept = 0;
+            for (size_t i = 0; i < local.entries.size(); ++i)
+            {
+                if (Live().count(local.entries[i].id))
+                {
+                    local.entries[kept++] = local.entries[i];
+                }
+            }
+            local.entries.resize(kept);
+            local.entries.push_back(entry);
+            local.lastId = entry.id;
+            local.lastCache = entry.cache;
+        }
+    };
+
+    template<typename T, UINT32 MAGAZINE_SIZE = 64>
+    class ObjectSlabAllocator
+    {
+        enum
+        {
+            SLAB_MIN_OBJECTS = MAGAZINE_SIZE * 4,
+            CHUNK_MAGAZINES = 1024,
+            MAX_CHUNKS = 1024,
+        };
+
+        struct Magazine
+        {
+            std::atomic<UINT32> next;   // depot link: index + 1, 0 ends the stack
+            UINT32 index;
+            UINT32 count;
+            T* items[MAGAZINE_SIZE];
+        };
+
+        // Magazines of one thread; owned is cleared when the thread exits so
+        // a later thread can adopt the cache.
+        struct Cache
+        {
+            Magazine* loaded;
+            Magazine* previous;
+            bool owned;
+        };
+
+        // Treiber stack of magazine indices. The head packs a change count
+        // above the top index, so a magazine popped and pushed back between
+        // a reader's load and its CAS cannot be mistaken for the old top.
+        // Magazines are never freed before the allocator, so reading next
+        // of a stale top is harmless.
+        struct alignas(64) Depot
+        {
+            std::atomic<UINT64> head;
+
+            Depot() : head(0)
+            {
+            }
+        };
+
+    public:
+        typedef size_t   size_type;
+        typedef T*       pointer;
+        typedef T&       reference;
+        typedef const T* const_pointer;
+        typedef const T& const_reference;
+        typedef T        value_type;
+
+        ObjectSlabAllocator(INT32 initSize = 0, INT32 growSize = 1)
+        {
+            m_id = ObjectSlabRegistry::Register();
+            m_growSize = growSize > SLAB_MIN_OBJECTS ? growSize : SLAB_MIN_OBJECTS;
+            m_cursor = NULL;
+            m_left = 0;
+            m_carved = 0;
+            m_magazines = 0;
+            for (UINT32 i = 0; i < MAX_CHUNKS; ++i)
+            {
+                m_chunks[i] = NULL;
+            }
+            if (initSize > 0)
+            {
+                CSDLock<CSDMutex> lock(m_mutex);
+                newSlab(initSize);
+            }
+        }
+
+        ~ObjectSlabAllocator() throw()
+        {
+            ObjectSlabRegistry::Unregister(m_id);
+            for (size_t i = 0; i < m_caches.size(); ++i)
+            {
+                delete m_caches[i];
+            }
+            for (UINT32 i = 0; i < MAX_CHUNKS && m_chunks[i]; ++i)
+            {
+                delete[] m_chunks[i];
+            }
+            for (size_t i = 0; i < m_slabs.size(); ++i)
+            {
+                freeSlab(m_slabs[i]);
+            }
+        }
+
+        pointer address(reference __x) const
+        {
+            return &__x;
+        }
+
+        const_pointer address(const_reference __x) const
+        {
+            return &__x;
+        }
+
+        T* allocate()
+        {
+            Cache* cache = localCache();
+            Magazine* m = cache->loaded;
+            if (m->count == 0)
+            {
+                if (cache->previous->count != 0)
+                {
+                    cache->loaded = cache->previous;
+                    cache->previous = m;
+                }
+                else
+                {
+                    Magazine* full = pop(m_full);
+                    if (full)
+                    {
+                        push(m_empty, cache->previous);
+                        cache->previous = m;
+                        cache->loaded = full;
+                    }
+                    else
+                    {
+                        fill(m);
+                    }
+                }
+                m = cache->loaded;
+            }
+            return m->items[--m->count];
+        }
+
+        // __p is not permitted to be a null pointer.
+        void deallocate(pointer __p)
+        {
+            Cache* cache = localCache();
+            Magazine* m = cache->loaded;
+            if (m->count == MAGAZINE_SIZE)
+            {
+                if (cache->previous->count != MAGAZINE_SIZE)
+                {
+                    cache->loaded = cache->previous;
+                    cache->previous = m;
+                }
+                else
+                {
+                    // Take the empty magazine first: if that throws, the
+                    // cache is left as it was.
+                    Magazine* empty = takeEmpty();
+                    push(m_full, cache->previous);
+                    cache->previous = m;
+                    cache->loaded = empty;
+                }
+                m = cache->loaded;
+            }
+            m->items[m->count++] = __p;
+        }
+
+        // Objects carved from slabs so far, whether in use or free.
+        inline size_type capacity()
+        {
+            CSDLock<CSDMutex> lock(m_mutex);
+            return m_carved;
+        }
+
+        inline size_type slab_count()
+        {
+            CSDLock<CSDMutex> lock(m_mutex);
+            return m_slabs.size();
+        }
+
+    private:
+        Cache* localCache()
+        {
+            ObjectSlabRegistry::ThreadCaches& local = ObjectSlabRegistry::Local();
+            if (local.lastId == m_id)
+            {
+                return static_cast<Cache*>(local.lastCache);
+            }
+            for (size_t i = 0; i < local.entries.size(); ++i)
+            {
+                if (local.entries[i].id == m_id)
+                {
+                    local.lastId = m_id;
+                    local.lastCache = local.entries[i].cache;
+                    return static_cast<Cache*>(local.lastCache);
+                }
+            }
+            return attach();
+        }
+
+        // Adopts a cache left by an exited thread, or makes a new one.
+        Cache* attach()
+        {
+            Cache* cache = NULL;
+            {
+                CSDLock<CSDMutex> lock(m_mutex);
+                for (size_t i = 0; i < m_caches.size() && !cache; ++i)
+                {
+                    if (!m_caches[i]->owned)
+                    {
+                        cache = m_caches[i];
+                    }
+                }
+                if (!cache)
+                {
+                    cache = new Cache;
+                    cache->loaded = NULL;
+                    cache->previous = NULL;
+                    m_caches.push_back(cache);
+                }
+                cache->owned = true;
+            }
+            if (!cache->loaded)
+            {
+                cache->loaded = takeEmpty();
+            }
+            if (!cache->previous)
+            {
+                cache->previous = takeEmpty();
+            }
+            ObjectSlabRegistry::Entry entry = { m_id, this, cache, &ObjectSlabAllocator::flush };
+            ObjectSlabRegistry::Attach(entry);
+            return cache;
+        }
+
+        // Thread exit: hands the cached objects to the depot and frees the
+        // cache for adoption.
+        static void flush(void* allocator, void* cache)
+        {
+            ObjectSlabAllocator* self = static_cast<ObjectSlabAllocator*>(allocator);
+            Cache* c = static_cast<Cache*>(cache);
+            if (c->loaded->count)
+            {
+                self->push(self->m_full, c->loaded);
+                c->loaded = NULL;
+            }
+            if (c->previous->count)
+            {
+                self->push(self->m_full, c->previous);
+                c->previous = NULL;
+            }
+            CSDLock<CSDMutex> lock(self->m_mutex);
+            c->owned = false;
+        }
+
+        Magazine* magazine(UINT32 index)
+        {
+            return &m_chunks[index / CHUNK_MAGAZINES][index % CHUNK_MAGAZINES];
+        }
+
+        void push(Depot& depot, Magazine* m)
+        {
+            UINT64 old = depot.head.load(std::memory_order_relaxed);
+            UINT64 top;
+            do
+            {
+                m->next.store(static_cast<UINT32>(old), std::memory_order_relaxed);
+                top = (((old >> 32) + 1) << 32) | (m->index + 1);
+            } while (!depot.head.compare_exchange_weak(old, top, std::memory_order_release, std::memory_order_relaxed));
+        }
+
+        Magazine* pop(Depot& depot)
+        {
+            UINT64 old = depot.head.load(std::memory_order_acquire);
+            for (;;)
+            {
+                UINT32 index = static_cast<UINT32>(old);
+                if (index == 0)
+                {
+                    return NULL;
+                }
+                Magazine* m = magazine(index - 1);
+                UINT64 top = (((old >> 32) + 1) << 32) | m->next.load(std::memory_order_relaxed);
+                if (depot.head.compare_exchange_weak(old, top, std::memory_order_acquire, std::memory_order_acquire))
+                {
+                    return m;
+                }
+            }
+        }
+
+        Magazine* takeEmpty()
+        {
+            Magazine* m = pop(m_empty);
+            if (m)
+            {
+                return m;
+            }
+            CSDLock<CSDMutex> lock(m_mutex);
+            if (m_magazines == MAX_CHUNKS * CHUNK_MAGAZINES)
+            {
+                throw std::bad_alloc();
+            }
+            UINT32 index = m_magazines++;
+            Magazine*& chunk = m_chunks[index / CHUNK_MAGAZINES];
+            if (!chunk)
+            {
+                // Allocation failure here throws, like the other allocators.
+                chunk = new Magazine[CHUNK_MAGAZINES];
+            }
+            m = &chunk[index % CHUNK_MAGAZINES];
+            m->next.store(0, std::memory_order_relaxed);
+            m->index = index;
+            m->count = 0;
+            return m;
+        }
+
+        // Loads an empty magazine straight from the slabs.
+        void fill(Magazine* m)
+        {
+            CSDLock<CSDMutex> lock(m_mutex);
+            while (m->count < MAGAZINE_SIZE)
+            {
+                if (m_left == 0)
+                {
+                    newSlab(m_growSize);
+                }
+                m->items[m->count++] = reinterpret_cast<T*>(m_cursor);
+                m_cursor += sizeof(T);
+                --m_left;
+            }
+        }
+
+        //NOTICE: locked outside
+        void newSlab(INT32 count)
+        {
+            void* slab = alignof(T) > __STDCPP_DEFAULT_NEW_ALIGNMENT__
+                ? ::operator new(sizeof(T) * count, std::align_val_t(alignof(T)))
+                : ::operator new(sizeof(T) * count);
+            m_slabs.push_back(slab);
+            m_cursor = static_cast<char*>(slab);
+            m_left = count;
+            m_carved += count;
+        }
+
+        static void freeSlab(void* slab)
+        {
+            if (alignof(T) > __STDCPP_DEFAULT_NEW_ALIGNMENT__)
+            {
+                ::operator delete(slab, std::align_val_t(alignof(T)));
+            }
+            else
+            {
+                ::operator delete(slab);
+            }
+        }
+
+        // not allow copy
+        ObjectSlabAllocator(const ObjectSlabAllocator&);
+        void operator = (const ObjectSlabAllocator&);
+
+        UINT64 m_id;
+        Depot m_full;
+        Depot m_empty;
+        CSDMutex m_mutex;
+        std::vector<void*> m_slabs;
+        std::vector<Cache*> m_caches;
+        Magazine* m_chunks[MAX_CHUNKS];
+        UINT32 m_magazines;
+        char* m_cursor;
+        INT32 m_left;
+        INT32 m_growSize;
+        size_type m_carved;
+    };
+}
+#endif //
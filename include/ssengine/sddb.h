@@ -85,6 +85,51 @@ enum SDDBDataBaseType
 	SDDB_DBTYPE_ADO = 2  //ADOݿ
 };
 
+/**
+* @brief ʱֱͼͰ0ͰͳƺʱΪ0΢ĴiͰͳƺʱ
+* [2^(i-1), 2^i)΢ڵĴһͰͬʱĺʱ
+*/
+#define SDDB_LATENCY_BUCKETS            32
+
+/**
+* @brief һκʱͳƣλΪ΢
+*/
+typedef struct tagSDDBLatency
+{
+    UINT64 m_qwCount;                               // 
+    UINT64 m_qwTotalUs;                             // ܺʱ
+    UINT64 m_qwMaxUs;                               // ʱ
+    UINT64 m_aqwBuckets[SDDB_LATENCY_BUCKETS];      // 2ݷͰĴ
+} SDDBLatency;
+
+/**
+* @brief ѽ(ִйOnExecuted)DBͳƣ(ISSDBCommand::GetCommandName)Ự
+*/
+typedef struct tagSDDBCommandStats
+{
+    CHAR m_szName[SDDB_MAX_NAME_SIZE];              // ͣỰʱΪ
+    UINT64 m_qwCommands;                            // 
+    UINT64 m_qwSlow;                                // ִкʱﵽѯֵ
+    SDDBLatency m_stQueue;                          // Ŷӣ -> ʼִ
+    SDDBLatency m_stExecute;                        // ִУOnExecuteSql(ϲִ)ĺʱ
+    SDDBLatency m_stDeliver;                        // ִ -> RunеOnExecuted
+    SDDBLatency m_stTotal;                          // ܼƣ -> RunеOnExecuted
+} SDDBCommandStats;
+
+/**
+* @brief DBSession״̬
+*/
+typedef struct tagSDDBSessionStats
+{
+    UINT32 m_dwQueued;                              // ȴִеδϲ͵
+    UINT32 m_dwRunning;                             // ִе
+    UINT32 m_dwCompleted;                           // ִϡȴRunͬGetDBCommandCount
+    UINT32 m_dwConnections;                         // ִ첽
+    UINT32 m_dwIdleConnections;                     // пе
+    UINT64 m_qwSlowQueries;                         // ʱﵽѯֵSQL
+    SDDBCommandStats m_stTotal;                     // Ļ
+} SDDBSessionStats;
+
 /**
 *  @brief SQLӿ࣬SQLĽӿڣṩ
 */
@@ -154,6 +199,136 @@ public:
 	* 0ýΪNULL
 	*/
 	virtual INT32 SSAPI GetFieldLengthByName(const CHAR *pszFieldName) = 0;
+
+	/**
+	* @brief ȡӦIndexʱӦڱǰô˺һԽ
+	* ֮Indexʣÿֲ
+	* @param pszFieldName 
+	* @return IndexҲ򷵻-1
+	*/
+	virtual INT32 SSAPI GetFieldIndex(const CHAR *pszFieldName) = 0;
+
+	/**
+	* @brief ǰضindexǷΪNULL
+	* @param dwIndex Index
+	* @return ΪNULLûиIndex򣬷true
+	*/
+	virtual bool SSAPI IsFieldNull(UINT32 dwIndex) = 0;
+
+	/**
+	* @brief з64λȡǰضindexֵ
+	* @param dwIndex Index
+	* @param nDefault ΪNULLڻֿͷʱķֵ
+	* @return ֵ
+	*/
+	virtual INT64 SSAPI GetFieldInt64(UINT32 dwIndex, INT64 nDefault = 0) = 0;
+
+	/**
+	* @brief ޷64λȡǰضindexֵ
+	* @param dwIndex Index
+	* @param qwDefault ΪNULLڻֿͷʱķֵ
+	* @return ֵ
+	*/
+	virtual UINT64 SSAPI GetFieldUInt64(UINT32 dwIndex, UINT64 qwDefault = 0) = 0;
+
+	/**
+	* @brief ˫ȸȡǰضindexֵ
+	* @param dwIndex Index
+	* @param dDefault ΪNULLڻʱķֵ
+	* @return ĸֵ
+	*/
+	virtual DOUBLE SSAPI GetFieldDouble(UINT32 dwIndex, DOUBLE dDefault = 0) = 0;
+
+	/**
+	* @brief ԶݻȡǰضindexֵתҲ
+	* @param dwIndex Index
+	* @param pdwLen ݵĳȣΪNULL
+	* @return ݵĵַڽRelease֮ǰЧΪNULL򲻴ʱNULL
+	*/
+	virtual const CHAR * SSAPI GetFieldBlob(UINT32 dwIndex, UINT32 *pdwLen) = 0;
+};
+
+/**
+* @brief Ԥӿ࣬ISSDBConnection::Prepareȡã±0ʼ
+* 󶨵Ĳڶִ֮䱣ֲ䣬Releaseʱ
+*/
+class ISSDBStatement
+{
+public:
+	virtual SSAPI ~ISSDBStatement() {};
+
+	/**
+	* @brief ȡ?ռλĸ
+	*
+	* @return 
+	*/
+	virtual UINT32 SSAPI GetParamCount() = 0;
+
+	/**
+	* @brief ΪNULL
+	*
+	* @param dwIndex ±
+	* @return ±Խʱfalse
+	*/
+	virtual bool SSAPI BindNull(UINT32 dwIndex) = 0;
+
+	/**
+	* @brief з
+	*
+	* @param dwIndex ±
+	* @param nValue ֵ
+	* @return ±Խʱfalse
+	*/
+	virtual bool SSAPI BindInt64(UINT32 dwIndex, INT64 nValue) = 0;
+
+	/**
+	* @brief ޷
+	*
+	* @param dwIndex ±
+	* @param qwValue ֵ
+	* @return ±Խʱfalse
+	*/
+	virtual bool SSAPI BindUInt64(UINT32 dwIndex, UINT64 qwValue) = 0;
+
+	/**
+	* @brief 󶨸
+	*
+	* @param dwIndex ±
+	* @param dValue ֵ
+	* @return ±Խʱfalse
+	*/
+	virtual bool SSAPI BindDouble(UINT32 dwIndex, DOUBLE dValue) = 0;
+
+	/**
+	* @brief ַƲݱƣɺ0ֽ
+	*
+	* @param dwIndex ±
+	* @param pData ݵĵַΪNULLʱΪNULL
+	* @param dwLen ݵĳ
+	* @return ±Խʱfalse
+	*/
+	virtual bool SSAPI BindString(UINT32 dwIndex, const CHAR *pData, UINT32 dwLen) = 0;
+
+	/**
+	* @brief Եǰ󶨵Ĳִ޷ֵ䣬δ󶨵ĲΪNULL
+	*
+	* @param pInsertId Ϊ䣬زеIDΪNULL
+	* @return ͬISSDBConnection::ExecuteSql
+	*/
+	virtual INT32 SSAPI Execute(UINT64 *pInsertId = NULL) = 0;
+
+	/**
+	* @brief Եǰ󶨵Ĳִзؽ
+	*
+	* @param ppoRs صĽϣɲҪ(*ppoRs)->Release()
+	* @return ͬISSDBConnection::ExecuteSqlRs
+	*/
+	virtual INT32 SSAPI ExecuteRs(ISSDBRecordSet **ppoRs) = 0;
+
+	/**
+	* @brief 黹䣬ӵĻ
+	*/
+	virtual void SSAPI Release() = 0;
 };
 
 /**
@@ -242,6 +417,15 @@ public:
 	*/
 	virtual bool SSAPI SelectDB(const CHAR *pcDBName) = 0;
 
+	/**
+	* @brief ȡԤ䣬?ռλBindϵкԶƷʽ룬ת
+	* 䰴SQLıڱ(LRU)ͬSQLٴPrepareʱɷ
+	*
+	* @param pSQL ?ռλSQL
+	* @return Ԥ䣬ʹϺRelease黹ڱRelease֮ǰ黹ʧܷNULL
+	*/
+	virtual ISSDBStatement * SSAPI Prepare(const CHAR *pSQL) = 0;
+
 	/**
 	* @brief ͷISSDBConn
 	*/
@@ -265,6 +449,12 @@ public:
 	*/
 	virtual int SSAPI GetGroupId() {return -1;};
 
+	/**
+	* @brief ڰͳƺʱ(ISSDBSession::GetCommandStats)Լѯ־
+	* صַRelease֮ǰЧNULLʱʹC++
+	*/
+	virtual const CHAR * SSAPI GetCommandName() {return NULL;};
+
 	/**
 	* @brief ִSQL
 	*
@@ -291,6 +481,50 @@ public:
     virtual void SSAPI Release(void) = 0;
 };
 
+/**
+* @brief ɺϲִеDBڴͬСSQLʱUPDATE/INSERT
+* ͨAddDBCommandӡGroupIdΪ-1GetBatchHeadGetBatchTailͬ
+* һˢڣﵽÿʱϲΪһݿ
+* GetBatchHeadǿʱϲΪһ䣺Head + Row1,Row2,... + Tail
+* GetBatchHeadΪʱÿRowһ䣬Щһһη͡
+* ϲִʧʱִУÿõԼĽ
+* ÿȻִУOnBatchResult(첽)->OnExecuted(ͬ)->Release(ͬ)
+* зԼQuickAddDBCommandӵϲִС
+*/
+class ISSDBBatchCommand : public ISSDBCommand
+{
+public:
+	/**
+	* @brief ϲͷ"INSERT INTO item(id,cnt) VALUES "
+	* ؿַʾRowΪ䣬ϲ
+	* ע⣺GetBatchHeadGetBatchRowGetBatchTail߳еã
+	* صַֻAddDBCommandǰЧ
+	*/
+	virtual const CHAR * SSAPI GetBatchHead() = 0;
+
+	/**
+	* @brief У"(1,5)"ģʽΪһ
+	*/
+	virtual const CHAR * SSAPI GetBatchRow() = 0;
+
+	/**
+	* @brief ϲβ" ON DUPLICATE KEY UPDATE cnt=VALUES(cnt)"
+	*/
+	virtual const CHAR * SSAPI GetBatchTail() {return "";};
+
+	/**
+	* @brief ִнOnExecuteSqlڹ߳е
+	* @param nResult ISSDBConnection::ExecuteSqlķֵͬ
+	* ϲִгɹʱΪӰ
+	*/
+	virtual void SSAPI OnBatchResult(INT32 nResult) = 0;
+
+	/**
+	* @brief ϲʹô˺
+	*/
+	virtual void SSAPI OnExecuteSql(ISSDBConnection * /*poDBConnection*/) {};
+};
+
 /**
 * @brief DBSessionӿ࣬һݿӵĻỰûỰҲά
 */
@@ -390,6 +624,30 @@ public:
 	* @return صǰִSQL䣬δִ߼DB
 	*/
 	virtual UINT32 SSAPI GetDBCommandCount() = 0;
+
+	/**
+	* @brief ȡûỰǰ״̬գȡԼѽĺʱͳ
+	*
+	* @param pstStats ״̬գõַռɵṩ
+	* @return pstStatsΪNULLʱfalse
+	*/
+	virtual bool SSAPI GetStats(SDDBSessionStats *pstStats) = 0;
+
+	/**
+	* @brief ȡðͻܵĺʱͳ
+	*
+	* @param pstStats ͳ飬õַռɵṩΪNULL
+	* @param dwCount ĳ
+	* @return ͵ܴdwCountʱֻдǰdwCount
+	*/
+	virtual UINT32 SSAPI GetCommandStats(SDDBCommandStats *pstStats, UINT32 dwCount) = 0;
+
+	/**
+	* @brief ѯֵʱﵽֵSQLͬд־(LOGLV_WARN)
+	*
+	* @param dwMilliseconds ֵλ룬0Ϊر(ȱʡ)
+	*/
+	virtual void SSAPI SetSlowQueryTime(UINT32 dwMilliseconds) = 0;
 };
 
 /**
@@ -402,6 +660,10 @@ public:
 	* @brief ConfigStringϢDBSession.
 	* ʾ: HostName=IPAddress;LoginName=YourLoginName;LoginPwd=Password;DBName=YourDBName;CharacterSet=latin1;CoreSize=5;MaxSize=10;DBType=0;Port=3306;
 	* ,ȱʡDBTypeΪ0,MySQL(Ϊ3MS SQL);MySQLȱʡ˿ںΪ3306,MS SQLȱʡ˿ںΪ1433.
+	* ѡBatchIntervalΪϲ(ISSDBBatchCommand)ˢ,λ,ȱʡΪ10;
+	* ѡBatchMaxRowsΪÿκϲ,ȱʡΪ256.
+	* ѡStmtCacheSizeΪÿӻԤ(ISSDBStatement),ȱʡΪ64.
+	* ѡSlowQueryTimeΪѯֵ,λ,ȱʡΪ0¼,ISSDBSession::SetSlowQueryTime.
 	*
 	* @param pszConfigString ݿϢ
 	* @return DBSessionʧܣNULL
@@ -32,9 +32,103 @@ enum ESDGATEERR_CODE
 	SDGATEERR_PACKET_ERROR				 = 1006 , //packet error
 	SDGATEERR_CONN_SVR_ERROR			 = 1007 , //connect server error
 	SDGATEERR_CLI_KICK					 = 1008 , //client kicked by server
+	SDGATEERR_CLI_FLOOD					 = 1009 , //client kicked for exceeding its rate limit
+	SDGATEERR_PACKET_TOO_LARGE			 = 1010 , //client packet above the size limit
 	SDGATEERR_SYS_ERROR                  = 1020   //system error
 };
 
+//
+// Gate <-> server link protocol. Every frame starts with an SGateLinkHead in
+// network byte order; dwLen counts the whole frame including the head. A
+// client ID is [generation: 12 bits][slot: 20 bits] and is never 0; once the
+// client is gone its ID stops matching, even after the slot is reused, so
+// frames for it are dropped. Enter/Leave frames carry the 8-byte transaction ID as body
+// and are answered by the server with the same command and wErr set.
+//
+// Groups belong to one link. Group GATE_GROUP_ENTERED holds every client that
+// entered the server and is maintained by Enter/Leave; other group IDs are
+// joined and left by the server. A group or multicast frame is fanned out by
+// the gate to every listed client straight from the received frame; its
+// dwClientID names one client to skip (0 for none).
+//
+enum ESDGateLinkCmd
+{
+	GATE_LINK_SERVER_DATA	= 1,	// gate <-> server, no client
+	GATE_LINK_CLIENT_DATA	= 2,	// gate -> server: from client; server -> gate: to client
+	GATE_LINK_ENTER			= 3,	// gate -> server request, server -> gate answer
+	GATE_LINK_LEAVE			= 4,	// gate -> server request, server -> gate answer
+	GATE_LINK_KICK			= 5,	// server -> gate: close the client
+	GATE_LINK_CLIENT_CLOSE	= 6,	// gate -> server: an entered client went away
+	GATE_LINK_GROUP_JOIN	= 7,	// server -> gate: body [UINT32 group]
+	GATE_LINK_GROUP_LEAVE	= 8,	// server -> gate: body [UINT32 group]
+	GATE_LINK_GROUP_CAST	= 9,	// server -> gate: body [UINT32 group][payload]
+	GATE_LINK_MULTICAST		= 10	// server -> gate: body [UINT32 n][n x UINT32 client ID][payload]
+};
+
+const UINT32 GATE_GROUP_ENTERED = 0;
+
+struct SGateLinkHead
+{
+	UINT32	dwLen;
+	UINT16	wCmd;
+	UINT16	wErr;
+	UINT32	dwClientID;
+};
+
+const UINT32 GATE_LINK_HEAD_LEN = 12;
+const UINT32 GATE_LINK_MAX_FRAME = 16 * 1024 * 1024;
+
+//
+// ISSGate::SetOpt options.
+//
+
+//
+// Maximum number of clients served at once (default 65536, at most 1 << 20).
+// Connections beyond it are closed on accept. Can only be changed while no
+// client is connected.
+//
+const INT32 GATE_OPT_MAX_CLIENT = 1;
+
+struct SGateOptMaxClient
+{
+	UINT32 dwMaxClient;
+};
+
+//
+// Per-client flood protection, applied to every client from the moment it is
+// set. Each client has two token buckets (packets and bytes) refilled at the
+// given rates; a packet that finds either bucket short is dropped before its
+// session sees it. A packet above dwMaxPacketSize closes the client with
+// SDGATEERR_PACKET_TOO_LARGE, and a client that has dropped dwKickAfterDrops
+// packets is closed with SDGATEERR_CLI_FLOOD. Zero disables a limit; a zero
+// burst defaults to one second's worth.
+//
+const INT32 GATE_OPT_CLIENT_LIMIT = 2;
+
+struct SGateOptClientLimit
+{
+	UINT32 dwPacketsPerSec;
+	UINT32 dwPacketBurst;
+	UINT32 dwBytesPerSec;
+	UINT32 dwByteBurst;
+	UINT32 dwMaxPacketSize;
+	UINT32 dwKickAfterDrops;
+};
+
+//
+// Read-only: SetOpt copies the gate's counters into the SGateStats given.
+//
+const INT32 GATE_OPT_STATS = 3;
+
+struct SGateStats
+{
+	UINT32 dwClients;
+	UINT64 qwDroppedPackets;
+	UINT64 qwDroppedBytes;
+	UINT64 qwFloodKicks;
+	UINT64 qwOversizeKicks;
+};
+
 class ISSServerConnection;
 class ISSServerSession;
 class ISSClientConnection;
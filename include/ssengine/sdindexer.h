@@ -45,7 +45,7 @@ namespace SSCP
 		* @param value : IDӦӦ
 		* @return IDֵЧΪSDINVAID_INDEX
 		*/
-		inline UINT32 Alloc( T & data)
+		inline UINT32 Alloc(const T & data)
 		{
 			return m_indexerImpl.Alloc(data); 
 		}
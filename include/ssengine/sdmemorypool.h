@@ -13,6 +13,14 @@ Copyright (C) 2025 Cui Hairu. All rights reserved.
 *
 **/
 #include "sdtype.h"
+#include <string>
+
+/**
+* @brief Եλ("ļ:к")ΪǴCSDVarMemoryPoolڴ棬ģʽ¿ɰλͳ
+*/
+#define SD_POOL_MALLOC(pool, len) (pool).Malloc((len), __FILE__ ":" SD_POOL_STR(__LINE__))
+#define SD_POOL_STR(x) SD_POOL_STR2(x)
+#define SD_POOL_STR2(x) #x
 
 namespace SSCP
 {
@@ -22,9 +30,41 @@ namespace SSCP
     * @{
     */
 
+    /**
+    * @brief CSDVarMemoryPoolһߴ絵ͳ
+    */
+    struct SVarMemPoolClassStats
+    {
+        UINT32 dwUnitSize;      /**<ڴС*/
+        UINT32 dwInUse;         /**<ʹõڴ*/
+        UINT32 dwFree;          /**<еڴ*/
+        UINT32 dwPeakInUse;     /**<ʹõڴķֵ*/
+        UINT64 qwAllocs;        /**<ۼƷ*/
+    };
+
+    /**
+    * @brief CSDVarMemoryPoolͳƣֽĴС
+    */
+    struct SVarMemPoolStats
+    {
+        UINT32 dwPageCount;     /**<ڴҳ*/
+        UINT64 qwPageBytes;     /**<ڴҳֽ*/
+        UINT64 qwCarvedBytes;   /**<Ѵڴҳзֳڴֽÿ4ֽڵͷ*/
+        UINT64 qwWastedBytes;   /**<ҳʱҳĩβзֶֽ*/
+        UINT64 qwInUseBytes;    /**<ʹõֱֽϵͳĴڴ*/
+        UINT64 qwPeakInUseBytes;/**<ʹõֽķֵ*/
+        UINT32 dwLargeInUse;    /**<ʹõĴڴ*/
+        UINT64 qwLargeBytes;    /**<ʹõĴڴֽ*/
+        UINT32 dwGuardErrors;   /**<ģʽͷʱֱֱдĴ*/
+        UINT32 dwDoubleFrees;   /**<ģʽظͷŵĴ*/
+        SVarMemPoolClassStats astClass[16]; /**<ߴ絵8ֽһ*/
+    };
+
     /**
     * @brief ɱڴСڴأ
     * ڴڴ治Զͷţֻڴʱͷš
+    * GetStats/DumpStatsߴ絵ʹԵģʽʱÿڴǰӱ֣
+    * ¼λãͷʱԽظͷţDumpStatsλгδͷŵڴ档
     * ע⣺ࡰǡ̰߳ȫ
     * ʹʾ
     * CSDVarMemoryPool pool;
@@ -54,9 +94,10 @@ namespace SSCP
         * @brief
         * ɱڴ
         * @param dwPageSize : ڲڴҳСڴ治ʱڴػһµڴҳ
+        * @param bDebug : ǷԵģʽģʽÿڴռԼ40ֽ
         * @return ɹTRUE򷵻FALSE
         **/
-        BOOL SSAPI Create(UINT32 dwPageSize = 0x80000);
+        BOOL SSAPI Create(UINT32 dwPageSize = 0x80000, BOOL bDebug = FALSE);
 
         /**
         * @brief
@@ -66,6 +107,15 @@ namespace SSCP
         **/
         void* SSAPI Malloc(UINT32 dwLen);
 
+        /**
+        * @brief
+        * LenȵBufferpszTagǷλãͨSD_POOL_MALLOC
+        * @param dwLen : õڴС
+        * @param pszTag : λãڴصЧַǵģʽº
+        * @return  صڴ棬ΪNULLʧ
+        **/
+        void* SSAPI Malloc(UINT32 dwLen, const CHAR* pszTag);
+
         /**
         * @brief
         * ڴ
@@ -88,9 +138,27 @@ namespace SSCP
         **/
         INT32 SSAPI GetMemUsed();
 
+        /**
+        * @brief
+        * ȡڴصͳ
+        * @param stStats : ͳƽ
+        * @return void
+        **/
+        void SSAPI GetStats(SVarMemPoolStats& stStats);
+
+        /**
+        * @brief
+        * ӡڴصͳƣڴҳ͸ߴ絵ʹģʽ»λгδͷŵڴ
+        * @return ı
+        **/
+        std::string SSAPI DumpStats();
+
     private:
         void* GetPoolMemory(UINT32 dwLen);
-        void FreePoolMemory(void* pMemBlock, UCHAR dwType);
+        void FreePoolMemory(void* p);
+        void* DebugMalloc(UINT32 dwLen, const CHAR* pszTag);
+        void DebugFree(void* p);
+        void ResetStats();
 
         BOOL AddFreeMemory(INT32 dwIndex);
         BOOL SetMemoryPage();
@@ -119,11 +187,98 @@ namespace SSCP
         MemoryPage* m_pWorkPage;
         BYTE* m_pPageBuf;
         UINT32 m_nPageSize;
+
+        // statistics
+        UINT32 m_nInUse[UNIT_TYPE_COUNT];
+        UINT32 m_nPeakInUse[UNIT_TYPE_COUNT];
+        UINT64 m_qwAllocs[UNIT_TYPE_COUNT];
+        UINT32 m_nPageCount;
+        UINT64 m_qwCarved;
+        UINT64 m_qwWasted;
+        UINT64 m_qwInUseBytes;
+        UINT64 m_qwPeakInUseBytes;
+        UINT32 m_nLargeInUse;
+        UINT64 m_qwLargeBytes;
+
+        // debug mode
+        BOOL m_bDebug;
+        void* m_pDebugHead;                 // live blocks, most recent first
+        UINT32 m_nGuardErrors;
+        UINT32 m_nDoubleFrees;
     };
 
 
 
 
+    class CSDMTVarMemoryPoolImpl;
+
+    /**
+    * @brief ̰߳ȫĿɱڴСڴأһ̷߳䡢һ߳ͷš
+    * ÿ߳ԼĻ棬ڱ̷߳ͷŶ
+    * ߳ͷŵڴҵڴεϣ߳ȱڴʱջء
+    * ڴ水8ֽڵСߴÿ4Ĵߴֵ8KBڴֱϵͳ롣
+    * ÿ64KBڴз֣ڴֱϵͳ룬ȫͬʱ黹
+    * ߳˳Ļһ״ʹñڴص߳̽ӹܡ
+    * ʹʾ
+    * CSDMTVarMemoryPool pool;
+    * pool.Create();
+    * I/Ọ߳
+    * char * p = (char*)pool.Malloc(512);//
+    *
+    * ߼̣߳
+    * pool.Free(p);//
+    */
+    class CSDMTVarMemoryPool
+    {
+    public:
+        CSDMTVarMemoryPool();
+        ~CSDMTVarMemoryPool();
+
+        /**
+        * @brief
+        * ڴ
+        * @return ɹTRUE򷵻FALSE
+        **/
+        BOOL SSAPI Create();
+
+        /**
+        * @brief
+        * LenȵBuffer8ֽڶ룬̵߳
+        * @param dwLen : õڴС
+        * @return  صڴ棬ΪNULLʧ
+        **/
+        void* SSAPI Malloc(UINT32 dwLen);
+
+        /**
+        * @brief
+        * ڴ棬̵߳ãǷ߳
+        * @param p : ָҪյڴ
+        * @return void
+        **/
+        void SSAPI Free(void* p);
+
+        /**
+        * @brief
+        * ջ߳ͷŵ̻߳ڴ棬ѱ̻߳ȫеڴλϵͳ
+        * @return void
+        **/
+        void SSAPI Trim();
+
+        /**
+        * @brief
+        * ȡǰϵͳڴ
+        * @return ǰڴʹ
+        **/
+        INT64 SSAPI GetMemUsed();
+
+    private:
+        CSDMTVarMemoryPool(const CSDMTVarMemoryPool&);
+        CSDMTVarMemoryPool& operator=(const CSDMTVarMemoryPool&);
+
+        CSDMTVarMemoryPoolImpl* m_pImpl;
+    };
+
+
     /**
     *@brief ̶ڴСڴأڷ̶Сڴ
     * ڴڴ治Զͷţֻڴʱͷ
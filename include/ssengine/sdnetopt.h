@@ -12,6 +12,7 @@ Copyright (C) 2025 Cui Hairu. All rights reserved.
 #define SSCP_SDNETOPT_H_20070614
 
 #include "sdbase.h"
+#include "sdthread.h"
 
 namespace SSCP{
 
@@ -98,6 +99,14 @@ struct SNetLinOptAdvanceParam
     INT32 nParam2;  // -1 means use default value
 };
 
+//
+// Set the attributes (cpu set, NUMA node, priority, name) of the sdnet I/O threads,
+// that is the accept thread of each listener and the receive thread of each connection.
+// pOpt points to an SThreadAttr, see sdthread.h. Threads already running keep theirs.
+// Note: this flag is only apply for linux version of sdnet
+//
+const UINT32 NETLIN_OPT_THREAD_ATTR = 204;
+
 //
 // This option is used to set the max connection limit number for sdnet.
 // Note: this flag is only apply for windows version of sdnet
@@ -142,6 +151,12 @@ struct SNetWinOptWorkThreadParam
 {
 	INT32 nParam1;  // -1 means use default value
 };
+
+//
+// The same as NETLIN_OPT_THREAD_ATTR for the windows version of sdnet. Only the
+// first 64 cpus (processor group 0) can be used.
+//
+const UINT32 NETWIN_OPT_THREAD_ATTR = 305;
 //
 // To bind the socket's IP and Port
 //
@@ -17,12 +17,13 @@ sdobjectpool.h - 
 #include "detail/sdobject_allocator.h"
 #include "detail/sdobject_allocator_ex.h"
 #include "detail/sdobject_dqueue_allocator.h"
+#include "detail/sdobject_slab_allocator.h"
 #include "sdmacros.h"
 #include "sdtype.h"
 
-#if SDU_WITH_BOOST
-#include <boost/preprocessor/repetition.hpp>
-#endif
+#include <memory>
+#include <new>
+#include <utility>
 
 namespace SSCP
 {
@@ -34,83 +35,84 @@ namespace SSCP
 
     /**
     *@brief 
+    *
+    * ̸߳Ƶ/ͷʱʹ ObjectSlabAllocator<_Tp> Ϊ _Alloc
+    *  slab з֣ÿ̳߳б magazineȫֲֿ
+    * ʱ MT 
     */
     template <typename _Tp,typename MT = CSDNonMutex,
              typename _Alloc=ObjectAllocator<_Tp,MT> >
     class CSDObjectPool
     {
     public:
-        CSDObjectPool(UINT32 dwInitCount = 0, UINT32 dwGrouCount = 1)
-            :m_allocator(dwInitCount,dwGrouCount)
-        {
-        }
-
-#if SDU_WITH_BOOST
-
         /**
-        * @brief
-        * һ, ʹboost⣬Խֵ֧Ĺ캯ĲչΪ20
-        * @return ضָ룬ʧܷNULL
+        * @brief 黹صɾ
         */
-#define DECL(z,n,text) T##n t##n
-#define MALLOC_DECL(z,n,text)  \
-	BOOST_PP_IF(n,template < , ) BOOST_PP_ENUM_PARAMS(n,typename T) BOOST_PP_IF(n,>, ) \
-	_Tp* SSAPI Alloc(BOOST_PP_ENUM(n,DECL,~))   \
-		{ \
-		return new (m_allocator.allocate())_Tp(BOOST_PP_ENUM_PARAMS(n,t)); \
-		}
-
-        BOOST_PP_REPEAT (20,MALLOC_DECL,~)
+        class Deleter
+        {
+        public:
+            Deleter(CSDObjectPool* poPool = NULL) : m_pool(poPool)
+            {
+            }
 
+            void operator()(_Tp* p) const
+            {
+                m_pool->Free(p);
+            }
 
+        private:
+            CSDObjectPool* m_pool;
+        };
 
-#else
         /**
-        * @brief
-        * һ, 캯ûвʹô˽ӿ
-        * @return ضָ룬ʧܷNULL
+        * @brief гڶָ룬ʱص Free
         */
-        inline _Tp* SSAPI  Alloc()
+        typedef std::unique_ptr<_Tp, Deleter> UniquePtr;
+
+        CSDObjectPool(UINT32 dwInitCount = 0, UINT32 dwGrouCount = 1)
+            :m_allocator(dwInitCount,dwGrouCount)
         {
-            return new (m_allocator.allocate())_Tp;
         }
 
         /**
         * @brief
-        * һ, Ĺ캯һһΪ
-        * @return ضָ룬ʧܷNULL
+        * һ, תĹ캯ֵ(ַ)
+        * ֱƶ󣬲ٿ; ûвʱ new _Tp ֵͬʼ
+        * @return ضָ룬캯׳쳣ʱڴ黹ز׳
         */
-        template<typename P1>
-        _Tp * SSAPI Alloc(P1 p1)
+        template<typename... Args>
+        _Tp* SSAPI Alloc(Args&&... args)
         {
-            return new (m_allocator.allocate())_Tp(p1);
+            _Tp* p = m_allocator.allocate();
+            try
+            {
+                if constexpr (sizeof...(Args) == 0)
+                {
+                    return new (p)_Tp;
+                }
+                else
+                {
+                    return new (p)_Tp(std::forward<Args>(args)...);
+                }
+            }
+            catch (...)
+            {
+                m_allocator.deallocate(p);
+                throw;
+            }
         }
 
-        template<typename P1,typename P2>
-        _Tp* SSAPI Alloc(P1 p1,P2 p2)
-        {
-            return new (m_allocator.allocate())_Tp(p1,p2);
-        }
-
-
-        template<typename P1,typename P2,typename P3>
-        _Tp* SSAPI Alloc(P1 p1,P2 p2,P3 p3)
-        {
-            return new (m_allocator.allocate())_Tp(p1,p2,p3);
-        }
-
-        template<typename P1,typename P2,typename P3,typename P4>
-        _Tp* SSAPI Alloc(P1 p1,P2 p2,P3 p3,P4 p4)
-        {
-            return new (m_allocator.allocate())_Tp(p1,p2,p3,p4);
-        }
-
-        template<typename P1,typename P2,typename P3,typename P4,typename P5>
-        _Tp* SSAPI Alloc(P1 p1,P2 p2,P3 p3,P4 p4,P5 p5)
+        /**
+        * @brief
+        * һ UniquePtr У뿪(ǰغ쳣)ʱ
+        * Զ黹; ر UniquePtr ø
+        * @return ж UniquePtr
+        */
+        template<typename... Args>
+        UniquePtr SSAPI AllocUnique(Args&&... args)
         {
-            return new (m_allocator.allocate())_Tp(p1,p2,p3,p4,p5);
+            return UniquePtr(Alloc(std::forward<Args>(args)...), Deleter(this));
         }
-#endif // 
         /**
         * @brief
         * 黹һ
@@ -72,6 +72,26 @@ enum ESDPipeCode{
     PIPE_SUCCESS        = 0     
 };
 
+//
+// Result of a pipe RPC call, passed to ISSPipeRpcCallback::OnResponse
+//
+enum ESDPipeRpcCode{
+    //
+    // Pipe disconnected before the response arrived
+    //
+    PIPE_RPC_DISCONNECT = -2,
+
+    //
+    // No response within the call timeout
+    //
+    PIPE_RPC_TIMEOUT    = -1,
+
+    //
+    // Response received
+    //
+    PIPE_RPC_SUCCESS    = 0
+};
+
 //
 // Default parameters
 //
@@ -86,6 +106,21 @@ enum ESDPipeCode{
 //
 #define PIPE_DFLT_RECVBUF_SIZE       PIPE_DFLT_SENDBUF_SIZE
 
+//
+// Ring size per direction of the same-host shared memory transport. Pipes whose
+// remote end runs on the same host switch from TCP to a pair of shared memory
+// rings after connecting; the TCP connection stays up as the liveness channel.
+//
+#define PIPE_SHM_RING_SIZE           (0x00000001<<20)
+
+//
+// Business ids reserved for pipe control messages and RPC framing. Never
+// delivered to a sink; do not use them as application business ids.
+//
+const UINT16 PIPE_CTRL_BUSINESSID    = 0xFFFF;
+const UINT16 PIPE_RPC_REQ_BUSINESSID = 0xFFFE;
+const UINT16 PIPE_RPC_RSP_BUSINESSID = 0xFFFD;
+
 //
 // Pipe id elements
 //
@@ -132,6 +167,43 @@ public:
 
 };
 
+class ISSPipe;
+
+// 
+// Name     : ISSPipeRpcCallback
+// Function : Completion callback of ISSPipe::Call, invoked from
+//            ISSPipeModule::Run exactly once per call unless it is cancelled.
+//
+class ISSPipeRpcCallback
+{
+public:
+    virtual ~ISSPipeRpcCallback() {}
+
+    //
+    // Name     : OnResponse
+    // Function : nResult is one of ESDPipeRpcCode; pData/dwLen hold the reply
+    //            on PIPE_RPC_SUCCESS and are NULL/0 otherwise.
+    //
+    virtual void SSAPI OnResponse(UINT32 dwCallID, INT32 nResult, const char* pData, UINT32 dwLen) = 0;
+};
+
+// 
+// Name     : ISSPipeRpcSink
+// Function : Request handler for one business id. Answer with ISSPipe::Reply,
+//            either inside OnRequest or later.
+//
+class ISSPipeRpcSink
+{
+public:
+    virtual ~ISSPipeRpcSink() {}
+
+    //
+    // Name     : OnRequest
+    // Function : Request arriving callback.
+    //
+    virtual void SSAPI OnRequest(ISSPipe* poPipe, UINT16 wBusinessID, UINT32 dwCallID, const char* pData, UINT32 dwLen) = 0;
+};
+
 // 
 // Name     : ISSPipe
 // Function : Represent a remote pipe.
@@ -185,6 +257,33 @@ public:
 	//close remote pipe.
 	virtual void SSAPI Close(void) = 0;
 
+    //
+    // Name     : Call
+    // Function : Send a request and get its response through pCallback. The
+    //            32-bit call id travels in the frame; pdwCallID (optional)
+    //            receives it for CancelCall.
+    //
+    virtual bool SSAPI Call(UINT16 wBusinessID, const char* pData, UINT32 dwLen, UINT32 dwTimeoutMs, ISSPipeRpcCallback* pCallback, UINT32* pdwCallID = NULL) = 0;
+
+    //
+    // Name     : Reply
+    // Function : Answer a request received through ISSPipeRpcSink.
+    //
+    virtual bool SSAPI Reply(UINT16 wBusinessID, UINT32 dwCallID, const char* pData, UINT32 dwLen) = 0;
+
+    //
+    // Name     : SetRpcSink
+    // Function : Set request handler for business id.
+    //
+    virtual bool SSAPI SetRpcSink(UINT16 wBusinessID, ISSPipeRpcSink* pSink) = 0;
+
+    //
+    // Name     : IsShmActive
+    // Function : Whether both directions of the pipe have switched to the
+    //            same-host shared memory rings.
+    //
+    virtual bool SSAPI IsShmActive(void) = 0;
+
 };
 
 // 
@@ -277,6 +376,18 @@ public:
 	// Function : Reload ip list.
 	//
 	virtual bool SSAPI CheckIpValid(const char* ip) = 0;
+
+    //
+    // Name     : CancelCall
+    // Function : Drop a pending call; its callback is not invoked.
+    //
+    virtual bool SSAPI CancelCall(UINT32 dwCallID) = 0;
+
+    //
+    // Name     : GetPendingCallCount
+    // Function : Number of calls waiting for a response.
+    //
+    virtual UINT32 SSAPI GetPendingCallCount(void) = 0;
 };
 
 //
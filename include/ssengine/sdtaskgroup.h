@@ -0,0 +1,304 @@
+/******************************************************************************
+Copyright (C) 2025 Cui Hairu. All rights reserved.
+
+	sdtaskgroup.h - 벢ѭ
+******************************************************************************/
+
+
+#ifndef SDTASKGROUP_H
+#define SDTASKGROUP_H
+/**
+* @file sdtaskgroup.h
+* @author lw
+* @brief ̳߳صͲ for ѭ
+**/
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <memory>
+#include <new>
+#include <thread>
+#include <type_traits>
+#include <utility>
+#include <vector>
+#include "sdlock.h"
+#include "sdthreadpool.h"
+
+namespace SSCP
+{
+    /**
+    * @addtogroup groupthread
+    * @{
+    */
+
+    /**
+    *@brief 飺̳߳ύһɵö󣬲ȴȫ
+    *
+    * ڵԼв Wait ֮ãΪÿ񵥶ڴ;
+    * 񲻳 TASK_STORAGE ֽڵĿɵöֱӴڽڵڣĲڶ
+    * 䡣Wait ڼִ̻̳߳߳Ŷӵûпִеʱ
+    * ֱһɡ̳߳ TerminateQuick ִУ
+    * ɼơRun  Wait ͬһ̵߳; ׳쳣
+    */
+    class CSDTaskGroup
+    {
+    public:
+        static const size_t TASK_STORAGE = 64;
+
+        explicit CSDTaskGroup(CSDThreadPool &oPool)
+            : m_pool(oPool), m_outstanding(0), m_used(0)
+        {
+        }
+
+        ~CSDTaskGroup()
+        {
+            Wait();
+        }
+
+        /**
+        * @brief
+        * ύһ̳߳ؾܾ(ﵽ޻ڽ)ʱڵֱִ߳
+        * @param fn : ޲Ŀɵö
+        * @return void
+        **/
+        template<typename Fn>
+        void Run(Fn &&fn)
+        {
+            typedef typename std::decay<Fn>::type F;
+            Task *task = NextTask();
+            task->Bind<F>(std::forward<Fn>(fn));
+            m_outstanding.fetch_add(1, std::memory_order_relaxed);
+            if (!m_pool.ScheduleJob(task))
+            {
+                task->Run();
+            }
+        }
+
+        /**
+        * @brief
+        * ȴύɣȴڼڵִ̳߳߳Ŷӵ
+        * @return void
+        **/
+        void Wait()
+        {
+            UINT32 spins = 0;
+            while (m_outstanding.load(std::memory_order_acquire) != 0)
+            {
+                if (m_pool.RunPendingJob())
+                {
+                    spins = 0;
+                    continue;
+                }
+                if (spins < WAIT_SPINS)
+                {
+                    ++spins;
+                    std::this_thread::yield();
+                    continue;
+                }
+                // ʣµڱִ߳; ʱûŶӵ԰æ
+                CSDMutexLock lock(m_doneMutex);
+                if (m_outstanding.load(std::memory_order_acquire) != 0)
+                {
+                    m_done.Wait(m_doneMutex, WAIT_SLICE_MS);
+                }
+            }
+            // һڼ֪ͨһȷѾٷ
+            {
+                CSDMutexLock lock(m_doneMutex);
+            }
+            m_used = 0;
+        }
+
+        /**
+        * @brief
+        * õ̳߳
+        * @return ̳߳
+        **/
+        CSDThreadPool &GetPool()
+        {
+            return m_pool;
+        }
+
+    private:
+        enum
+        {
+            INLINE_TASKS = 8,
+            CHUNK_TASKS = 64,
+            WAIT_SPINS = 64,                            // idle rounds before Wait blocks
+            WAIT_SLICE_MS = 1,
+        };
+
+        class Task : public ISSRunable
+        {
+        public:
+            Task() : m_group(NULL), m_invoke(NULL)
+            {
+            }
+
+            template<typename F, typename Arg>
+            void Bind(Arg &&fn)
+            {
+                if constexpr (sizeof(F) <= TASK_STORAGE && alignof(F) <= alignof(std::max_align_t))
+                {
+                    new (m_storage) F(std::forward<Arg>(fn));
+                    m_invoke = &InvokeInline<F>;
+                }
+                else
+                {
+                    *reinterpret_cast<F **>(m_storage) = new F(std::forward<Arg>(fn));
+                    m_invoke = &InvokeHeap<F>;
+                }
+            }
+
+            virtual void Run()
+            {
+                m_invoke(m_storage, true);
+                m_group->Finish();
+            }
+
+            // ̳߳ؽʱ: ֻٿɵö󣬲ִ
+            virtual void OnCancel()
+            {
+                m_invoke(m_storage, false);
+                m_group->Finish();
+            }
+
+            CSDTaskGroup *m_group;
+
+        private:
+            template<typename F>
+            static void InvokeInline(void *storage, bool bRun)
+            {
+                F *fn = std::launder(reinterpret_cast<F *>(storage));
+                if (bRun)
+                {
+                    (*fn)();
+                }
+                fn->~F();
+            }
+
+            template<typename F>
+            static void InvokeHeap(void *storage, bool bRun)
+            {
+                F *fn = *reinterpret_cast<F **>(storage);
+                if (bRun)
+                {
+                    (*fn)();
+                }
+                delete fn;
+            }
+
+            alignas(std::max_align_t) unsigned char m_storage[TASK_STORAGE];
+            void (*m_invoke)(void *, bool);
+        };
+
+        Task *NextTask()
+        {
+            size_t index = m_used++;
+            Task *task;
+            if (index < INLINE_TASKS)
+            {
+                task = &m_inline[index];
+            }
+            else
+            {
+                index -= INLINE_TASKS;
+                if (index / CHUNK_TASKS == m_chunks.size())
+                {
+                    m_chunks.emplace_back(new Task[CHUNK_TASKS]);
+                }
+                task = &m_chunks[index / CHUNK_TASKS][index % CHUNK_TASKS];
+            }
+            task->m_group = this;
+            return task;
+        }
+
+        // һɡһڼ 0  Wait֮ٷ
+        void Finish()
+        {
+            size_t n = m_outstanding.load(std::memory_order_relaxed);
+            while (n > 1)
+            {
+                if (m_outstanding.compare_exchange_weak(n, n - 1, std::memory_order_release, std::memory_order_relaxed))
+                {
+                    return;
+                }
+            }
+            CSDMutexLock lock(m_doneMutex);
+            m_outstanding.fetch_sub(1, std::memory_order_release);
+            m_done.Signal();
+        }
+
+        CSDTaskGroup(const CSDTaskGroup &other);        // no implementation
+        void operator = (const CSDTaskGroup &other);    // no implementation
+
+        CSDThreadPool &m_pool;
+        std::atomic<size_t> m_outstanding;
+        CSDMutex m_doneMutex;                           // guards the last completion
+        CSDCondition m_done;
+        size_t m_used;                                  // nodes handed out since the last Wait
+        Task m_inline[INLINE_TASKS];
+        std::vector<std::unique_ptr<Task[]> > m_chunks;
+    };
+
+    /**
+    * @brief
+    * ִ [begin, end) 䣬䰴 grain Сп飬̳̺߳߳͵߳
+    * ͬһȡ飬ֱȫɺ󷵻
+    * @param oPool : ̳߳
+    * @param begin : ʼ±
+    * @param end : ±()
+    * @param grain : ÿ±0 Ϊ 1
+    * @param fn : fn(i) ±ã fn(chunkBegin, chunkEnd) 
+    * @return void
+    **/
+    template<typename Fn>
+    void SDParallelFor(CSDThreadPool &oPool, INT64 begin, INT64 end, INT64 grain, Fn &&fn)
+    {
+        if (end <= begin)
+        {
+            return;
+        }
+        if (grain <= 0)
+        {
+            grain = 1;
+        }
+        std::atomic<INT64> next(begin);
+        auto worker = [&next, end, grain, &fn]()
+        {
+            for (;;)
+            {
+                INT64 first = next.fetch_add(grain, std::memory_order_relaxed);
+                if (first >= end)
+                {
+                    return;
+                }
+                INT64 last = std::min(end, first + grain);
+                if constexpr (std::is_invocable<Fn &, INT64, INT64>::value)
+                {
+                    fn(first, last);
+                }
+                else
+                {
+                    for (INT64 i = first; i < last; ++i)
+                    {
+                        fn(i);
+                    }
+                }
+            }
+        };
+        INT64 chunks = (end - begin + grain - 1) / grain;
+        INT64 helpers = std::min<INT64>(chunks - 1, std::max<UINT32>(oPool.GetThreadNum(), 1));
+        CSDTaskGroup group(oPool);
+        for (INT64 i = 0; i < helpers; ++i)
+        {
+            group.Run(worker);
+        }
+        worker();
+        group.Wait();
+    }
+
+    /** @} */
+}//
+
+#endif
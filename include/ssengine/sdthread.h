@@ -37,11 +37,86 @@ namespace SSCP
     */
     SDTHREADID SSAPI SDGetThreadId();
 
-    typedef struct tagSThreadAttr
+    /**
+    * @brief SThreadAttr CPU
+    */
+    #define SDTHREAD_MAX_CPUS           256
+
+    /**
+    * @brief ߳󳤶(β0)Linux ںֻǰ15ַ
+    */
+    #define SDTHREAD_NAME_LEN           16
+
+    /**
+    * @brief ̵߳ȼWindows ¶Ӧ THREAD_PRIORITY_*
+    * Linux ¶Ӧ̵߳ nice ֵ(+10/+5/-5/-10)ȼҪ CAP_SYS_NICE
+    * SDTHREAD_PRIORITY_NORMAL ʾ
+    */
+    enum ESDThreadPriority
     {
+        SDTHREAD_PRIORITY_LOWEST = -2,
+        SDTHREAD_PRIORITY_BELOW_NORMAL = -1,
+        SDTHREAD_PRIORITY_NORMAL = 0,
+        SDTHREAD_PRIORITY_ABOVE_NORMAL = 1,
+        SDTHREAD_PRIORITY_HIGHEST = 2,
+    };
 
+    /**
+    * @brief ߳ԣ SDThreadAttrInit ʼ
+    *  SDCreateThread ִ̺֮߳߳ǰã̺߳
+    * ״дڴ(̱߳صڴص)ڰ󶨵 NUMA ڵ
+    */
+    typedef struct tagSThreadAttr
+    {
+        UINT64 m_aqwCpuMask[SDTHREAD_MAX_CPUS / 64];    // еCPUϣȫ0ʾ
+        INT32  m_nNumaNode;                             // ֻڸ NUMA ڵCPUУ-1ʾ;
+                                                        // ͬʱָCPUʱȡ
+        INT32  m_nPriority;                             // ȼ ESDThreadPriority
+        CHAR   m_szName[SDTHREAD_NAME_LEN];             // ߳մʾ
     } SThreadAttr;
 
+    /**
+    * @brief
+    * ʼ߳: CPU NUMA ڵ㣬ͨȼ߳
+    * @param pAttr : ߳
+    * @return void
+    */
+    void SSAPI SDThreadAttrInit(SThreadAttr *pAttr);
+
+    /**
+    * @brief
+    * һCPU߳ԵCPU
+    * @param pAttr : ߳
+    * @param dwCpu : CPUţС SDTHREAD_MAX_CPUS ʱ
+    * @return void
+    */
+    void SSAPI SDThreadAttrAddCpu(SThreadAttr *pAttr, UINT32 dwCpu);
+
+    /**
+    * @brief
+    * ߳еֽ߳ض
+    * @param pAttr : ߳
+    * @param pszName : ߳
+    * @return void
+    */
+    void SSAPI SDThreadAttrSetName(SThreadAttr *pAttr, const CHAR *pszName);
+
+    /**
+    * @brief
+    * õ NUMA ڵ֧ NUMA ϵͳ1
+    * @return NUMA ڵ
+    */
+    UINT32 SSAPI SDGetNumaNodeCount();
+
+    /**
+    * @brief
+    * õ߳ϣ SDCreateThread ߳( std::thread)ʹ
+    * @param pAttr : ߳
+    * @return ȫóɹTRUE; һʧ(CPUΪաȨ޲)FALSE
+    * ȻЧ
+    */
+    BOOL SSAPI SDSetCurrentThreadAttr(const SThreadAttr *pAttr);
+
 #if defined(WINDOWS)
     typedef unsigned int (WINAPI *PFThrdProc)(void *);
 #define SDTHREAD_DECLARE(x)  unsigned int WINAPI  x
@@ -53,6 +128,16 @@ namespace SSCP
 #endif // 
 
 
+    /**
+    * @brief
+    * ߳
+    * @param pAttr : ߳ԣΪNULLִ߳ pThrdProc
+    * @param pThrdProc : ̺߳
+    * @param pArg : ̺߳
+    * @param pThreadId : ߳idΪNULL
+    * @param bSuspend : ֻWindowsЧ
+    * @return ߳̾ʧܷ SDINVALID_HANDLE
+    */
     SDHANDLE SSAPI SDCreateThread(
         SThreadAttr * pAttr,
         PFThrdProc pThrdProc,
@@ -70,8 +155,18 @@ namespace SSCP
 
     void SSAPI SDThreadResume(SDHANDLE handle);
 
-    void SSAPI SDSetThreadAttr(SDHANDLE,SThreadAttr * pAttr);
+    /**
+    * @brief
+    * ̵߳
+    * @return ȫóɹTRUE
+    */
+    BOOL SSAPI SDSetThreadAttr(SDHANDLE,SThreadAttr * pAttr);
 
+    /**
+    * @brief
+    * õ߳һõԣûùЧNULL
+    * صָ SDThreadWait ֮ǰЧ
+    */
     SThreadAttr* SSAPI SDGetThreadAttr(SDHANDLE);
 
     /**
@@ -143,16 +238,16 @@ namespace SSCP
 
         /**
         * @brief
-        * ߳
-        * @param pAttr : õԽṹ
-        * @return void
+        * ߳ԡ߳ǰõʱЧõЧ
+        * @param pAttr : õԽṹ壬NULLʾ
+        * @return ɹTRUE
         */
-        void SSAPI SetAttribute(SThreadAttr *pAttr);
+        BOOL SSAPI SetAttribute(SThreadAttr *pAttr);
 
         /**
         * @brief
         * ȡ߳
-        * @return ػȡ߳
+        * @return ػȡ߳ԣûùNULL
         */
         SThreadAttr* SSAPI GetAttribute();
 
@@ -176,6 +271,8 @@ namespace SSCP
         SDTHREADID m_tid;
         SDHANDLE m_handle;
         void* m_arg;			/**<̺߳*/
+        SThreadAttr m_attr;
+        BOOL m_bAttr;           /**<m_attr ǷЧ*/
     };
 
 
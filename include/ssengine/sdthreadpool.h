@@ -12,6 +12,7 @@ Copyright (C) 2025 Cui Hairu. All rights reserved.
 * @author lw
 * @brief ̳߳صʵ
 **/
+#include <atomic>
 #include <deque>
 #include <vector>
 #include <map>
@@ -40,22 +41,115 @@ namespace SSCP
         * @return void
         **/
         virtual void Run() = 0;
+
+        /**
+        * @brief
+        * ֹʱʱѳֹʱ䣬ִ߳ϵô˽ӿڴ Run
+        * жϡĬ϶; 񲻻ٱ RunҪͷŵڴͷ
+        * @param dwLateMs : ֹʱĺ
+        * @return TRUEȻִRunFALSE
+        **/
+        virtual BOOL OnDeadlineMissed(UINT32 /*dwLateMs*/)
+        {
+            return FALSE;
+        }
+
+        /**
+        * @brief
+        * TerminateQuick δִеʱڵ TerminateQuick ߳ϵ
+        * ˽ӿڴ RunĬʲôҲ; ҪͷԴ֪ͨȴڴ˴
+        * @return void
+        **/
+        virtual void OnCancel()
+        {
+        }
+    };
+
+    /**
+    *@brief ȼ(ͨ)ͨȨؼȨתӣͬһͨȽȳ
+    */
+    enum ESDJobPriority
+    {
+        SDJOB_PRIORITY_HIGH = 0,        ///< ӳе¼У飬ĬȨ 8
+        SDJOB_PRIORITY_NORMAL = 1,      ///< ScheduleJob(pJob) ĬͨĬȨ 4
+        SDJOB_PRIORITY_LOW = 2,         ///< ̨־ѹ浵ĬȨ 1
+        SDJOB_PRIORITY_COUNT = 3,
     };
 
+    /**
+    * @brief ŶӺʱֱͼͰ0ͰͳƺʱΪ0΢ĴiͰͳƺʱ
+    * [2^(i-1), 2^i)΢ڵĴһͰͬʱĺʱ
+    */
+    #define SDJOB_WAIT_BUCKETS          32
+
+    /**
+    *@brief һȼͨͳƣʱλΪ΢
+    */
+    typedef struct tagSDJobLaneStats
+    {
+        UINT32 m_dwPending;                             // ǰŶӵ
+        UINT32 m_dwWeight;                              // Ȩ
+        UINT64 m_qwScheduled;                           // ӵ
+        UINT64 m_qwDequeued;                            // ӵ
+        UINT64 m_qwLate;                                // ʱѳֹʱ
+        UINT64 m_qwDropped;                             // б
+        UINT64 m_qwWaitTotalUs;                         // ŶӺʱ
+        UINT64 m_qwWaitMaxUs;                           // ŶӺʱ
+        UINT64 m_aqwWaitBuckets[SDJOB_WAIT_BUCKETS];    // ŶӺʱ2ݷͰĴ
+    } SDJobLaneStats;
+
+    /**
+    *@brief ̳߳ͳƣʱλΪ΢롣ж dwMaxThrds Ƿ:
+    * ŶӺʱ߳æµʸ˵̲߳㣬̶߳൫æµʵ˵ƫ
+    */
+    typedef struct tagSDThreadPoolStats
+    {
+        UINT32 m_dwThreads;                             // ǰ߳
+        UINT32 m_dwThreadsPeak;                         // ֵ߳
+        UINT64 m_qwThreadsSpawned;                      // ScheduleJob ѹݴ߳
+        UINT64 m_qwJobsExecuted;                        // ִе RunPendingJob æִе
+        UINT64 m_qwWaitAvgUs;                           // ƽŶӺʱ
+        UINT64 m_qwWaitP99Us;                           // ŶӺʱ99λ(ֱͼͰϽ)
+        UINT64 m_qwBusyUs;                              // йִ߳ܺʱ
+    } SDThreadPoolStats;
+
+    /**
+    *@brief ̵߳ͳƣʱλΪ΢
+    */
+    typedef struct tagSDThreadPoolWorkerStats
+    {
+        UINT32 m_dwIndex;                               // ߳
+        UINT64 m_qwJobs;                                // ִе
+        UINT64 m_qwBusyUs;                              // ִĺʱ
+        UINT64 m_qwAliveUs;                             // ̴߳ʱm_qwBusyUs / m_qwAliveUs æµ
+    } SDThreadPoolWorkerStats;
+
+    /**
+    *@brief ̳߳صģʽ
+    */
+    enum ESDThreadPoolMode
+    {
+        SDTHREADPOOL_SHARED_QUEUE = 0,  ///< ̹߳һ(Ĭ)
+        SDTHREADPOOL_WORK_STEALING = 1, ///< ÿ߳һ˫˶У߳ȡ
+    };
+
+    class CSDWorkStealing;
+    class CSDJobLanes;
+    class CSDThreadPoolMetrics;
+
     /**
     *@brief ̳߳ز
     */
     class CSDThreadPool
     {
-        typedef std::deque<ISSRunable*> JobContainer;
-
         typedef std::vector<CSDThread*> ThreadContainer;
 
         typedef struct _tagThreadArg
         {
             CSDThreadPool* pThreadPool;
             CSDThread* pThread;
-            volatile BOOL keepWorking;
+            UINT32 dwIndex;
+            std::atomic<BOOL> keepWorking;
         } ThreadArg;
 
         typedef std::vector<ThreadArg*> ThreadArgContainer;
@@ -74,9 +168,23 @@ namespace SSCP
         * @param dwMinThrds : ̳߳С߳
         * @param dwMaxThrds : ̳߳߳
         * @param dwMaxPendJobs : Ϊִ
+        * @param eMode : ģʽSDTHREADPOOL_WORK_STEALING ģʽʱ
+        * dwMaxThrds ߳Ҳ; ⲿ߳ύȫעУ
+        * ִύ뵱ǰ߳ԼĶ
         * @return  ɹtrueʧܷfalse
         **/
-        BOOL Init(UINT32 dwMinThrds, UINT32 dwMaxThrds, UINT32 dwMaxPendJobs);
+        BOOL Init(UINT32 dwMinThrds, UINT32 dwMaxThrds, UINT32 dwMaxPendJobs,
+            ESDThreadPoolMode eMode = SDTHREADPOOL_SHARED_QUEUE);
+
+        /**
+        * @brief
+        * ù̵߳(CPUϡNUMA ڵ㡢ȼ߳)֮߳Ч
+        * Ӧ Init ֮ǰá߳"-߳"ʱضǰĲ֡
+        * ִ֮߳ǰã̱߳صڴ״дڰ󶨵 NUMA ڵ
+        * @param pAttr : ߳ԣNULLʾ
+        * @return void
+        **/
+        void SetThreadAttr(const SThreadAttr *pAttr);
 
         /**
         * @brief
@@ -88,14 +196,38 @@ namespace SSCP
 
         /**
         * @brief
-        * ִ̳̣߳߳ȴδִеִɣٵʱ
+        * ȼ̳߳أָֹʱ䡣ʱѳֹʱ
+        *  ISSRunable::OnDeadlineMissed ִлǶ
+        * SDTHREADPOOL_WORK_STEALING ģʽֻͨȼ޽ֹʱ
+        * Ż빤߳ԼĶУ񶼽ȫͨ
+        * @param pJob : 
+        * @param ePriority : ȼͨ
+        * @param dwDeadlineMs : Ľֹʱ()0ʾûнֹʱ
+        * @return  ɹtrueʧܷfalse
+        **/
+        BOOL ScheduleJob(ISSRunable *pJob, ESDJobPriority ePriority, UINT32 dwDeadlineMs = 0);
+
+        /**
+        * @brief
+        * ȼͨĳȨأͨʱȨر
+        * @param ePriority : ȼͨ
+        * @param dwWeight : Ȩأ0Ϊ1
+        * @return void
+        **/
+        void SetLaneWeight(ESDJobPriority ePriority, UINT32 dwWeight);
+
+        /**
+        * @brief
+        * ִ̳̣߳߳ȴδִеִɣٵʱ
+        * δִеִУ OnCancel
         * @return void
         **/
         void TerminateQuick();
 
         /**
         * @brief
-        * ִ̳̣߳߳ȴִٽ̣߳ٵʱ
+        * ִ̳̣߳߳ȴִٽ̣߳ٵʱ
+        * ſպ󼴷أ̶ٰѯ
         * @return void
         **/
         void TerminateWaitJobs();
@@ -114,9 +246,63 @@ namespace SSCP
         **/
         UINT32 GetJobPending();
 
+        /**
+        * @brief
+        * õһȼͨеȴִеĿ
+        * SDTHREADPOOL_WORK_STEALING ģʽ²߳Լе
+        * @param ePriority : ȼͨ
+        * @return ȴִеĿ
+        **/
+        UINT32 GetJobPending(ESDJobPriority ePriority);
+
+        /**
+        * @brief
+        * õһȼͨŶͳ(ȡŶӺʱֱͼʱ)
+        * ͳ Init ʱ
+        * @param ePriority : ȼͨ
+        * @param stStats : ͳ
+        * @return ȼЧfalse
+        **/
+        BOOL GetLaneStats(ESDJobPriority ePriority, SDJobLaneStats &stStats);
+
+        /**
+        * @brief
+        * õ̳߳صͳơŶӺʱȡԸȼͨ
+        * SDTHREADPOOL_WORK_STEALING ģʽ²빤߳Լе
+        * ͳ Init ʱ㣬̳߳ؽԿɶȡ
+        * @param stStats : ͳ
+        * @return void
+        **/
+        void GetStats(SDThreadPoolStats &stStats);
+
+        /**
+        * @brief
+        * õ̵߳ͳƣѽ߳
+        * @param pStats : 
+        * @param dwCount : ĳ
+        * @return ߳
+        **/
+        UINT32 GetWorkerStats(SDThreadPoolWorkerStats *pStats, UINT32 dwCount);
+
+        /**
+        * @brief
+        * õ̳߳صĵģʽ
+        * @return ģʽ
+        **/
+        ESDThreadPoolMode GetMode();
+
+        /**
+        * @brief
+        * ڵִ߳һŶе񣬹ȴɵ̰߳æִ( CSDTaskGroup)
+        * @return ִһ񷵻trueûпִе񷵻false
+        **/
+        BOOL RunPendingJob();
 
     private:
         static SDTHREAD_DECLARE( WorkThreadFunc)(void *pArg);
+        static void StealingWork(ThreadArg *pArg);
+        void JoinThreads(BOOL bStop);
+        BOOL StartThread(ThreadArg *pArg);
 
         CSDThreadPool(const CSDThreadPool &other);              // no implementation
         void operator = (const CSDThreadPool &other);       // no implementation
@@ -125,20 +311,24 @@ namespace SSCP
         static const UINT32 WAITTIME = 32;
         static const UINT32 WAITCOUNT = 16384;
 
-        JobContainer	   m_jobContainer;
+        CSDJobLanes       *m_pLanes;        ///< SDTHREADPOOL_SHARED_QUEUE ģʽ
         ThreadArgContainer m_threadArgContainer;
 
         ThreadArgMap  m_threadArgMap;
         CSDMutex	  m_jobMutex;
         CSDMutex	  m_threadMutex;
         CSDCondition  m_jobCondition;
+        CSDWorkStealing *m_pStealing;   ///<  SDTHREADPOOL_WORK_STEALING ģʽ·ǿ
+        CSDThreadPoolMetrics *m_pMetrics;
 
         UINT32 m_minThreads;
         UINT32 m_maxThreads;
         UINT32 m_maxPendingJobs;
+        SThreadAttr m_threadAttr;
+        BOOL m_bThreadAttr;             ///< m_threadAttr ǷЧ
 
-        volatile BOOL m_waitTerminate;
-        volatile BOOL m_quickTerminate;
+        std::atomic<BOOL> m_waitTerminate;
+        std::atomic<BOOL> m_quickTerminate;
     };
 
 
@@ -372,6 +372,45 @@ namespace SSCP
     */
     UINT64 SSAPI SDTimeSecs();
 
+    /**
+    * @brief
+    * ȡǰʱ䣬SDTimeMicroSecʱͬ
+    * SDTscEnableɹУ׼TSC㣬ٽϵͳãÿյʱ
+    * ¶һΣSDTimeMicroSecƫ΢뼶Ҳ
+    * @return ǰʱ
+    */
+    UINT64 SSAPI SDTimeNanoSec();
+
+    /**
+    * @brief
+    * TSCʱȷCPUTSCƵʺ㶨󣬶յʱУ׼Լ10룬
+    * ֮ʱƵʡֻУ׼һΣ֮ĵֱӷصһεĽ
+    * @return óɹTRUEx86TSCɿʱFALSEʹõʱ
+    */
+    BOOL SSAPI SDTscEnable();
+
+    /**
+    * @brief
+    * ˢ±̵߳֡ʱӣѭÿֵһμɣCSDTimer::Runã
+    * @return ˢºĺʱ䣬SDTimeMilliSecʱͬ
+    */
+    UINT64 SSAPI SDFrameClockUpdate();
+
+    /**
+    * @brief
+    * ȡ߳֡ʱӵĺʱ䣬߳ϴSDFrameClockUpdateʱʱ䡣
+    * ֻȡһ̴ֲ߳̾߳δˢ¹ʱˢһ
+    * @return ֡ĺʱ
+    */
+    UINT64 SSAPI SDFrameMilliSec();
+
+    /**
+    * @brief
+    * ȡ߳֡ʱӵ΢ʱ䣬ͬSDFrameMilliSec
+    * @return ֡΢ʱ
+    */
+    UINT64 SSAPI SDFrameMicroSec();
+
     /** @} */
 
 }//
@@ -86,7 +86,7 @@ namespace SSCP
         /**
         * @brief
         * ӡʱϢ
-        * @return void
+        * @return ʱʱֲ۵ռԼڵغʹһı
         */
 		std::string SSAPI DumpTimerInfo();
 
@@ -43,6 +43,7 @@ Copyright (C) 2025 Cui Hairu. All rights reserved.
 #include "sdstring.h"
 #include "sdthread.h"
 #include "sdthreadpool.h"
+#include "sdtaskgroup.h"
 #include "sdtime.h"
 #include "sdtimer.h"
 #include "sdutil.h"
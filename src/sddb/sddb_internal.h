@@ -0,0 +1,21 @@
+// Internal declarations shared by the sddb translation units.
+#ifndef SSCP_SDDB_INTERNAL_H
+#define SSCP_SDDB_INTERNAL_H
+
+#include "ssengine/sddb.h"
+#include <string>
+
+namespace SSCP {
+
+// Writes text through the logger installed with SSDBSetLogger when dwLevel
+// is enabled.
+void SDDBLog(UINT32 dwLevel, const std::string& text);
+
+// Escapes nSrcSize bytes of pSrc for use inside a quoted SQL literal, the way
+// mysql_real_escape_string does. Returns the escaped length, or 0 when pDest
+// is too small (pDest is then an empty string).
+UINT32 SDDBEscapeString(const CHAR* pSrc, INT32 nSrcSize, CHAR* pDest, INT32 nDstSize);
+
+} // namespace SSCP
+
+#endif
@@ -1,8 +1,15 @@
 #include "ssengine/sddb.h"
 #include "ssengine/sddb_ver.h"
 #include "ssengine/sdlogger.h"
+#include "sddb_internal.h"
+#include "sddb_session.h"
+#include "sddb_stats.h"
 
+#include <algorithm>
 #include <atomic>
+#include <cctype>
+#include <cstdlib>
+#include <cstring>
 #include <deque>
 #include <mutex>
 #include <sstream>
@@ -18,32 +25,65 @@ UINT32 g_sddbLogLevel = LOGLV_INFO | LOGLV_WARN | LOGLV_CRITICAL;
 std::mutex g_loggerMutex;
 
 void logInfo(const std::string& text) {
-    std::lock_guard<std::mutex> lk(g_loggerMutex);
-    if (g_sddbLogger && (g_sddbLogLevel & LOGLV_INFO)) {
-        g_sddbLogger->LogText(text.c_str());
-    }
+    SDDBLog(LOGLV_INFO, text);
 }
 
-UINT32 escapeString(const CHAR* pSrc, INT32 nSrcSize,
-                    CHAR* pDest, INT32 nDstSize) {
-    if (!pSrc || !pDest || nSrcSize <= 0 || nDstSize <= 0) {
-        if (pDest && nDstSize > 0) {
-            pDest[0] = '\0';
-        }
-        return 0;
-    }
-    INT32 written = 0;
-    for (INT32 i = 0; i < nSrcSize && pSrc[i] != '\0'; ++i) {
-        char c = pSrc[i];
-        if (written >= nDstSize - 1) break;
-        if (c == '\'' || c == '\"' || c == '\\') {
-            if (written + 1 >= nDstSize - 1) break;
-            pDest[written++] = '\\';
-        }
-        pDest[written++] = c;
+std::string trim(const std::string& s) {
+    size_t b = s.find_first_not_of(" \t\r\n");
+    if (b == std::string::npos) return std::string();
+    size_t e = s.find_last_not_of(" \t\r\n");
+    return s.substr(b, e - b + 1);
+}
+
+void copyField(CHAR* pDest, size_t nSize, const std::string& value) {
+    size_t n = std::min(value.size(), nSize - 1);
+    value.copy(pDest, n);
+    pDest[n] = '\0';
+}
+
+// Session settings that are not part of SDDBAccount.
+struct SessionOptions {
+    UINT32 coreSize = 1;
+    UINT32 maxSize = 1;
+    MySQLBatchOptions batch;
+    UINT32 stmtCacheSize = MySQLConfig().stmtCacheSize;
+    UINT32 slowQueryMs = 0;
+};
+
+// Parses "HostName=..;LoginName=..;LoginPwd=..;DBName=..;CharacterSet=..;
+// CoreSize=..;MaxSize=..;DBType=..;Port=..;BatchInterval=..;BatchMaxRows=..;
+// StmtCacheSize=..;SlowQueryTime=..;". Keys are case-insensitive.
+void parseConfigString(const CHAR* pszConfig, SDDBAccount& account, SessionOptions& opt) {
+    std::memset(&account, 0, sizeof(account));
+    account.m_wConnPort = 3306;
+    account.m_wDBType = SDDB_DBTYPE_MYSQL;
+    std::string text = pszConfig ? pszConfig : "";
+    size_t pos = 0;
+    while (pos < text.size()) {
+        size_t end = text.find(';', pos);
+        if (end == std::string::npos) end = text.size();
+        std::string item = text.substr(pos, end - pos);
+        pos = end + 1;
+        size_t eq = item.find('=');
+        if (eq == std::string::npos) continue;
+        std::string key = trim(item.substr(0, eq));
+        std::string value = trim(item.substr(eq + 1));
+        std::transform(key.begin(), key.end(), key.begin(),
+                       [](unsigned char c) { return static_cast<char>(std::tolower(c)); });
+        if (key == "hostname") copyField(account.m_szHostName, sizeof(account.m_szHostName), value);
+        else if (key == "loginname") copyField(account.m_szLoginName, sizeof(account.m_szLoginName), value);
+        else if (key == "loginpwd") copyField(account.m_szLoginPwd, sizeof(account.m_szLoginPwd), value);
+        else if (key == "dbname") copyField(account.m_szDBName, sizeof(account.m_szDBName), value);
+        else if (key == "characterset") copyField(account.m_szCharactSet, sizeof(account.m_szCharactSet), value);
+        else if (key == "coresize") opt.coreSize = static_cast<UINT32>(std::strtoul(value.c_str(), nullptr, 10));
+        else if (key == "maxsize") opt.maxSize = static_cast<UINT32>(std::strtoul(value.c_str(), nullptr, 10));
+        else if (key == "dbtype") account.m_wDBType = std::atoi(value.c_str());
+        else if (key == "port") account.m_wConnPort = static_cast<UINT16>(std::atoi(value.c_str()));
+        else if (key == "batchinterval") opt.batch.intervalMs = static_cast<UINT32>(std::strtoul(value.c_str(), nullptr, 10));
+        else if (key == "batchmaxrows") opt.batch.maxRows = static_cast<UINT32>(std::strtoul(value.c_str(), nullptr, 10));
+        else if (key == "stmtcachesize") opt.stmtCacheSize = static_cast<UINT32>(std::strtoul(value.c_str(), nullptr, 10));
+        else if (key == "slowquerytime") opt.slowQueryMs = static_cast<UINT32>(std::strtoul(value.c_str(), nullptr, 10));
     }
-    pDest[written] = '\0';
-    return static_cast<UINT32>(written);
 }
 
 class MockRecordSet : public ISSDBRecordSet {
@@ -63,11 +103,55 @@ public:
     void SSAPI Release(void) override { delete this; }
     const CHAR* SSAPI GetFieldValueByName(const CHAR*) override { return nullptr; }
     INT32 SSAPI GetFieldLengthByName(const CHAR*) override { return 0; }
+    INT32 SSAPI GetFieldIndex(const CHAR*) override { return -1; }
+    bool SSAPI IsFieldNull(UINT32) override { return true; }
+    INT64 SSAPI GetFieldInt64(UINT32, INT64 nDefault = 0) override { return nDefault; }
+    UINT64 SSAPI GetFieldUInt64(UINT32, UINT64 qwDefault = 0) override { return qwDefault; }
+    DOUBLE SSAPI GetFieldDouble(UINT32, DOUBLE dDefault = 0) override { return dDefault; }
+    const CHAR* SSAPI GetFieldBlob(UINT32, UINT32* pdwLen) override {
+        if (pdwLen) *pdwLen = 0;
+        return nullptr;
+    }
 
 private:
     bool m_retrieved;
 };
 
+class MockStatement : public ISSDBStatement {
+public:
+    explicit MockStatement(const CHAR* pSQL) : m_sql(pSQL) {}
+
+    UINT32 SSAPI GetParamCount() override {
+        return static_cast<UINT32>(std::count(m_sql.begin(), m_sql.end(), '?'));
+    }
+    bool SSAPI BindNull(UINT32 dwIndex) override { return dwIndex < GetParamCount(); }
+    bool SSAPI BindInt64(UINT32 dwIndex, INT64) override { return dwIndex < GetParamCount(); }
+    bool SSAPI BindUInt64(UINT32 dwIndex, UINT64) override { return dwIndex < GetParamCount(); }
+    bool SSAPI BindDouble(UINT32 dwIndex, DOUBLE) override { return dwIndex < GetParamCount(); }
+    bool SSAPI BindString(UINT32 dwIndex, const CHAR*, UINT32) override { return dwIndex < GetParamCount(); }
+
+    INT32 SSAPI Execute(UINT64* pInsertId = nullptr) override {
+        if (pInsertId) {
+            *pInsertId = 0;
+        }
+        logInfo("Execute: " + m_sql);
+        return SDDB_SUCCESS;
+    }
+
+    INT32 SSAPI ExecuteRs(ISSDBRecordSet** ppoRs) override {
+        logInfo("ExecuteRs: " + m_sql);
+        if (ppoRs) {
+            *ppoRs = nullptr;
+        }
+        return SDDB_NO_RECORDSET;
+    }
+
+    void SSAPI Release() override { delete this; }
+
+private:
+    std::string m_sql;
+};
+
 class MockConnection : public ISSDBConnection {
 public:
     MockConnection() = default;
@@ -77,7 +161,7 @@ public:
 
     UINT32 SSAPI EscapeString(const CHAR* pSrc, INT32 nSrcSize,
                               CHAR* pDest, INT32 nDstSize) override {
-        return escapeString(pSrc, nSrcSize, pDest, nDstSize);
+        return SDDBEscapeString(pSrc, nSrcSize, pDest, nDstSize);
     }
 
     INT32 SSAPI ExecuteSql(const CHAR* pSQL, UINT64* pInsertId = nullptr) override {
@@ -105,6 +189,9 @@ public:
     void SSAPI RollbackTransaction() override {}
     bool SSAPI CreateDB(const CHAR*, bool, const CHAR*) override { return true; }
     bool SSAPI SelectDB(const CHAR*) override { return true; }
+    ISSDBStatement* SSAPI Prepare(const CHAR* pSQL) override {
+        return pSQL ? new MockStatement(pSQL) : nullptr;
+    }
     void SSAPI Release() override { delete this; }
 };
 
@@ -123,7 +210,7 @@ public:
 
     UINT32 SSAPI EscapeString(const CHAR* pSrc, INT32 nSrcSize,
                               CHAR* pDest, INT32 nDstSize, INT32 /*timeout*/ = -1) override {
-        return escapeString(pSrc, nSrcSize, pDest, nDstSize);
+        return SDDBEscapeString(pSrc, nSrcSize, pDest, nDstSize);
     }
 
     INT32 SSAPI ExecuteSql(const CHAR* pSQL, UINT64* pInsertId = nullptr, INT32 /*timeout*/ = -1) override {
@@ -153,18 +240,20 @@ public:
     bool SSAPI Run(INT32 nCount = -1) override {
         INT32 processed = 0;
         while (nCount < 0 || processed < nCount) {
-            ISSDBCommand* cmd = nullptr;
+            Done done;
             {
                 std::lock_guard<std::mutex> lk(m_mutex);
                 if (m_completed.empty()) {
                     break;
                 }
-                cmd = m_completed.front();
+                done = m_completed.front();
                 m_completed.pop_front();
             }
+            ISSDBCommand* cmd = done.cmd;
             if (!cmd) {
                 continue;
             }
+            m_stats.record(cmd, done.timing, SDDBStatsTable::Clock::now());
             cmd->OnExecuted();
             cmd->Release();
             ++processed;
@@ -177,7 +266,30 @@ public:
         return static_cast<UINT32>(m_completed.size());
     }
 
+    // Commands run inside AddDBCommand, so nothing is ever queued or running.
+    bool SSAPI GetStats(SDDBSessionStats* pstStats) override {
+        if (!pstStats) {
+            return false;
+        }
+        std::memset(pstStats, 0, sizeof(*pstStats));
+        pstStats->m_dwCompleted = GetDBCommandCount();
+        pstStats->m_dwConnections = 1;
+        m_stats.total(pstStats->m_stTotal);
+        return true;
+    }
+
+    UINT32 SSAPI GetCommandStats(SDDBCommandStats* pstStats, UINT32 dwCount) override {
+        return m_stats.byType(pstStats, dwCount);
+    }
+
+    void SSAPI SetSlowQueryTime(UINT32 dwMilliseconds) override { m_stats.setSlowMs(dwMilliseconds); }
+
 private:
+    struct Done {
+        ISSDBCommand* cmd = nullptr;
+        SDDBStatsTable::Timing timing;
+    };
+
     bool enqueueCommand(ISSDBCommand* poDBCommand) {
         if (!poDBCommand) {
             return false;
@@ -185,16 +297,28 @@ private:
         if (!m_connection) {
             return false;
         }
-        poDBCommand->OnExecuteSql(m_connection);
+        Done done;
+        done.cmd = poDBCommand;
+        done.timing.enqueued = done.timing.started = SDDBStatsTable::Clock::now();
+        if (auto* batch = dynamic_cast<ISSDBBatchCommand*>(poDBCommand)) {
+            std::string sql;
+            if (const CHAR* head = batch->GetBatchHead()) sql += head;
+            if (const CHAR* row = batch->GetBatchRow()) sql += row;
+            if (const CHAR* tail = batch->GetBatchTail()) sql += tail;
+            batch->OnBatchResult(m_connection->ExecuteSql(sql.c_str()));
+        } else {
+            poDBCommand->OnExecuteSql(m_connection);
+        }
+        done.timing.finished = SDDBStatsTable::Clock::now();
         std::lock_guard<std::mutex> lk(m_mutex);
-        m_completed.push_back(poDBCommand);
+        m_completed.push_back(done);
         return true;
     }
 
     void clearPending() {
         std::lock_guard<std::mutex> lk(m_mutex);
         while (!m_completed.empty()) {
-            ISSDBCommand* cmd = m_completed.front();
+            ISSDBCommand* cmd = m_completed.front().cmd;
             m_completed.pop_front();
             if (cmd) {
                 cmd->Release();
@@ -204,8 +328,9 @@ private:
 
 private:
     MockConnection* m_connection;
-    std::deque<ISSDBCommand*> m_completed;
+    std::deque<Done> m_completed;
     std::mutex m_mutex;
+    SDDBStatsTable m_stats;
 };
 
 class MockDBModule : public ISSDBModule {
@@ -213,7 +338,7 @@ public:
     MockDBModule() : m_ref(1) {}
     ~MockDBModule() override {
         std::lock_guard<std::mutex> lk(m_mutex);
-        for (MockSession* session : m_sessions) {
+        for (ISSDBSession* session : m_sessions) {
             if (session) {
                 delete session;
             }
@@ -234,35 +359,61 @@ public:
     SSSVersion SSAPI GetVersion(void) override { return SDDB_VERSION; }
     const char* SSAPI GetModuleName(void) override { return SDDB_MODULENAME; }
 
-    ISSDBSession* SSAPI GetDBSession(const CHAR* /*pszConfigString*/) override {
-        return createSession();
+    ISSDBSession* SSAPI GetDBSession(const CHAR* pszConfigString) override {
+        SDDBAccount account;
+        SessionOptions opt;
+        parseConfigString(pszConfigString, account, opt);
+        return createSession(&account, opt);
     }
 
-    ISSDBSession* SSAPI GetDBSession(SDDBAccount* /*pstDBAccount*/) override {
-        return createSession();
+    ISSDBSession* SSAPI GetDBSession(SDDBAccount* pstDBAccount) override {
+        return createSession(pstDBAccount, SessionOptions());
     }
 
-    ISSDBSession* SSAPI GetDBSession(SDDBAccount* /*pstDBAccount*/, UINT32 /*coreSize*/, UINT32 /*maxSize*/) override {
-        return createSession();
+    ISSDBSession* SSAPI GetDBSession(SDDBAccount* pstDBAccount, UINT32 coreSize, UINT32 maxSize) override {
+        SessionOptions opt;
+        opt.coreSize = coreSize;
+        opt.maxSize = maxSize;
+        return createSession(pstDBAccount, opt);
     }
 
     void SSAPI Close(ISSDBSession* pDBSession) override {
         if (!pDBSession) return;
-        std::lock_guard<std::mutex> lk(m_mutex);
-        auto it = m_sessions.begin();
-        while (it != m_sessions.end()) {
-            if (*it == pDBSession) {
-                delete *it;
-                it = m_sessions.erase(it);
-            } else {
-                ++it;
-            }
+        {
+            std::lock_guard<std::mutex> lk(m_mutex);
+            auto it = std::find(m_sessions.begin(), m_sessions.end(), pDBSession);
+            if (it == m_sessions.end()) return;
+            m_sessions.erase(it);
         }
+        // A pooled session finishes its queued commands here, so do not
+        // hold the module lock meanwhile.
+        delete pDBSession;
     }
 
 private:
-    ISSDBSession* createSession() {
-        auto* session = new MockSession();
+    ISSDBSession* createSession(SDDBAccount* pstDBAccount, const SessionOptions& opt) {
+        if (!pstDBAccount) return nullptr;
+        ISSDBSession* session = nullptr;
+        switch (pstDBAccount->m_wDBType) {
+        case SDDB_DBTYPE_MOCK:
+            session = new MockSession();
+            break;
+        case SDDB_DBTYPE_MYSQL: {
+            MySQLConfig config = MySQLConfig::fromAccount(*pstDBAccount);
+            config.stmtCacheSize = opt.stmtCacheSize;
+            auto* mysql = new MySQLSession(config, opt.coreSize, opt.maxSize, opt.batch);
+            if (!mysql->start()) {
+                delete mysql;
+                return nullptr;
+            }
+            session = mysql;
+            break;
+        }
+        default:
+            SDDBLog(LOGLV_WARN, "SSDB database type " + std::to_string(pstDBAccount->m_wDBType) + " is not supported");
+            return nullptr;
+        }
+        session->SetSlowQueryTime(opt.slowQueryMs);
         std::lock_guard<std::mutex> lk(m_mutex);
         m_sessions.push_back(session);
         return session;
@@ -271,11 +422,18 @@ private:
 private:
     std::atomic<UINT32> m_ref;
     std::mutex m_mutex;
-    std::vector<MockSession*> m_sessions;
+    std::vector<ISSDBSession*> m_sessions;
 };
 
 } // namespace
 
+void SDDBLog(UINT32 dwLevel, const std::string& text) {
+    std::lock_guard<std::mutex> lk(g_loggerMutex);
+    if (g_sddbLogger && (g_sddbLogLevel & dwLevel)) {
+        g_sddbLogger->LogText(text.c_str());
+    }
+}
+
 ISSDBModule* SSAPI SSDBGetModule(const SSSVersion* /*pstVersion*/) {
     return new MockDBModule();
 }
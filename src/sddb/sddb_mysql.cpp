@@ -0,0 +1,1127 @@
+#include "sddb_mysql.h"
+#include "sddb_internal.h"
+
+#include <algorithm>
+#include <charconv>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+#if defined(_WIN32)
+#  include <winsock2.h>
+#  include <ws2tcpip.h>
+#else
+#  include <netdb.h>
+#  include <netinet/in.h>
+#  include <netinet/tcp.h>
+#  include <sys/socket.h>
+#  include <sys/time.h>
+#  include <unistd.h>
+#endif
+
+namespace SSCP {
+
+namespace {
+
+// Capability flags
+const UINT32 CLIENT_LONG_PASSWORD     = 0x00000001;
+const UINT32 CLIENT_CONNECT_WITH_DB   = 0x00000008;
+const UINT32 CLIENT_PROTOCOL_41       = 0x00000200;
+const UINT32 CLIENT_TRANSACTIONS      = 0x00002000;
+const UINT32 CLIENT_SECURE_CONNECTION = 0x00008000;
+const UINT32 CLIENT_MULTI_RESULTS     = 0x00020000;
+const UINT32 CLIENT_PLUGIN_AUTH       = 0x00080000;
+
+const UINT16 SERVER_MORE_RESULTS_EXISTS = 0x0008;
+
+const UINT8 COM_QUIT    = 0x01;
+const UINT8 COM_INIT_DB = 0x02;
+const UINT8 COM_QUERY   = 0x03;
+const UINT8 COM_PING    = 0x0e;
+const UINT8 COM_STMT_PREPARE = 0x16;
+const UINT8 COM_STMT_EXECUTE = 0x17;
+const UINT8 COM_STMT_CLOSE   = 0x19;
+const UINT8 COM_SET_OPTION = 0x1b;
+
+// Column and parameter types of the binary protocol
+const UINT8 TYPE_TINY      = 0x01;
+const UINT8 TYPE_SHORT     = 0x02;
+const UINT8 TYPE_LONG      = 0x03;
+const UINT8 TYPE_FLOAT     = 0x04;
+const UINT8 TYPE_DOUBLE    = 0x05;
+const UINT8 TYPE_NULL      = 0x06;
+const UINT8 TYPE_TIMESTAMP = 0x07;
+const UINT8 TYPE_LONGLONG  = 0x08;
+const UINT8 TYPE_INT24     = 0x09;
+const UINT8 TYPE_DATE      = 0x0a;
+const UINT8 TYPE_TIME      = 0x0b;
+const UINT8 TYPE_DATETIME  = 0x0c;
+const UINT8 TYPE_YEAR      = 0x0d;
+const UINT8 TYPE_STRING    = 0xfe;
+const UINT16 UNSIGNED_FLAG = 0x0020;
+const UINT16 TYPE_UNSIGNED = 0x8000;   // our marker on a type, not on the wire
+
+const char MULTI_STATEMENTS_ON[]  = {0, 0};
+const char MULTI_STATEMENTS_OFF[] = {1, 0};
+
+const size_t MAX_PACKET = 0xFFFFFF;
+const char NATIVE_PASSWORD[] = "mysql_native_password";
+
+//
+// SHA-1, only needed for mysql_native_password.
+//
+class Sha1 {
+public:
+    Sha1() : m_len(0), m_used(0) {
+        m_h[0] = 0x67452301; m_h[1] = 0xEFCDAB89; m_h[2] = 0x98BADCFE; m_h[3] = 0x10325476; m_h[4] = 0xC3D2E1F0;
+    }
+    void update(const void* pData, size_t nLen) {
+        const unsigned char* p = static_cast<const unsigned char*>(pData);
+        m_len += nLen;
+        while (nLen) {
+            size_t take = std::min(nLen, sizeof(m_buf) - m_used);
+            std::memcpy(m_buf + m_used, p, take);
+            m_used += take; p += take; nLen -= take;
+            if (m_used == sizeof(m_buf)) { block(m_buf); m_used = 0; }
+        }
+    }
+    void final(unsigned char out[20]) {
+        UINT64 bits = m_len * 8;
+        unsigned char pad = 0x80;
+        update(&pad, 1);
+        pad = 0;
+        while (m_used != 56) update(&pad, 1);
+        unsigned char lenBytes[8];
+        for (int i = 0; i < 8; ++i) lenBytes[i] = static_cast<unsigned char>(bits >> (56 - 8 * i));
+        update(lenBytes, 8);
+        for (int i = 0; i < 20; ++i) out[i] = static_cast<unsigned char>(m_h[i / 4] >> (24 - 8 * (i % 4)));
+    }
+
+private:
+    static UINT32 rol(UINT32 v, int n) { return (v << n) | (v >> (32 - n)); }
+    void block(const unsigned char* p) {
+        UINT32 w[80];
+        for (int i = 0; i < 16; ++i) {
+            w[i] = (UINT32(p[4 * i]) << 24) | (UINT32(p[4 * i + 1]) << 16) | (UINT32(p[4 * i + 2]) << 8) | p[4 * i + 3];
+        }
+        for (int i = 16; i < 80; ++i) w[i] = rol(w[i - 3] ^ w[i - 8] ^ w[i - 14] ^ w[i - 16], 1);
+        UINT32 a = m_h[0], b = m_h[1], c = m_h[2], d = m_h[3], e = m_h[4];
+        for (int i = 0; i < 80; ++i) {
+            UINT32 f, k;
+            if (i < 20)      { f = (b & c) | (~b & d);           k = 0x5A827999; }
+            else if (i < 40) { f = b ^ c ^ d;                    k = 0x6ED9EBA1; }
+            else if (i < 60) { f = (b & c) | (b & d) | (c & d);  k = 0x8F1BBCDC; }
+            else             { f = b ^ c ^ d;                    k = 0xCA62C1D6; }
+            UINT32 t = rol(a, 5) + f + e + k + w[i];
+            e = d; d = c; c = rol(b, 30); b = a; a = t;
+        }
+        m_h[0] += a; m_h[1] += b; m_h[2] += c; m_h[3] += d; m_h[4] += e;
+    }
+
+    UINT32 m_h[5];
+    UINT64 m_len;
+    unsigned char m_buf[64];
+    size_t m_used;
+};
+
+// SHA1(password) XOR SHA1(scramble + SHA1(SHA1(password))); empty for an
+// empty password.
+std::string nativePassword(const std::string& password, const char* scramble, size_t nScramble) {
+    if (password.empty()) return std::string();
+    unsigned char stage1[20], stage2[20], mix[20];
+    Sha1 s1; s1.update(password.data(), password.size()); s1.final(stage1);
+    Sha1 s2; s2.update(stage1, 20); s2.final(stage2);
+    Sha1 s3; s3.update(scramble, nScramble); s3.update(stage2, 20); s3.final(mix);
+    std::string out(20, '\0');
+    for (int i = 0; i < 20; ++i) out[i] = static_cast<char>(stage1[i] ^ mix[i]);
+    return out;
+}
+
+UINT8 collationOf(const std::string& charset) {
+    static const struct { const char* name; UINT8 id; } table[] = {
+        {"big5", 1}, {"latin1", 8}, {"ascii", 11}, {"gb2312", 24}, {"gbk", 28},
+        {"utf8", 33}, {"utf8mb3", 33}, {"utf8mb4", 45}, {"binary", 63},
+    };
+    for (const auto& t : table) {
+        if (charset == t.name) return t.id;
+    }
+    return 33;
+}
+
+// Bounds-checked reader over one packet payload.
+struct Reader {
+    Reader(const std::string& s) : p(reinterpret_cast<const unsigned char*>(s.data())), n(s.size()), pos(0), ok(true) {}
+
+    bool need(size_t k) { if (pos + k > n) ok = false; return ok; }
+    size_t left() const { return n - pos; }
+    UINT8 u8() { return need(1) ? p[pos++] : 0; }
+    UINT32 uint(int bytes) {
+        if (!need(static_cast<size_t>(bytes))) return 0;
+        UINT32 v = 0;
+        for (int i = 0; i < bytes; ++i) v |= UINT32(p[pos + i]) << (8 * i);
+        pos += static_cast<size_t>(bytes);
+        return v;
+    }
+    UINT64 lenenc(bool* pNull = nullptr) {
+        UINT8 b = u8();
+        if (pNull) *pNull = (b == 0xFB);
+        if (b < 0xFB) return b;
+        if (b == 0xFC) return uint(2);
+        if (b == 0xFD) return uint(3);
+        if (b == 0xFE) { UINT64 lo = uint(4); return lo | (UINT64(uint(4)) << 32); }
+        return 0;
+    }
+    bool lenencStr(const char*& s, UINT32& len, bool* pNull = nullptr) {
+        UINT64 l = lenenc(pNull);
+        if (!ok || l > left()) { ok = false; return false; }
+        s = reinterpret_cast<const char*>(p + pos);
+        len = static_cast<UINT32>(l);
+        pos += static_cast<size_t>(l);
+        return true;
+    }
+    std::string cstr() {
+        size_t end = pos;
+        while (end < n && p[end]) ++end;
+        std::string s(reinterpret_cast<const char*>(p + pos), end - pos);
+        pos = end < n ? end + 1 : end;
+        return s;
+    }
+    void skip(size_t k) { if (need(k)) pos += k; }
+
+    const unsigned char* p;
+    size_t n;
+    size_t pos;
+    bool ok;
+};
+
+void putInt(std::string& s, UINT64 v, int bytes) {
+    for (int i = 0; i < bytes; ++i) s.push_back(static_cast<char>((v >> (8 * i)) & 0xFF));
+}
+
+void putLenenc(std::string& s, UINT64 v) {
+    if (v < 0xFB) { s.push_back(static_cast<char>(v)); return; }
+    if (v <= 0xFFFF) { s.push_back(static_cast<char>(0xFC)); putInt(s, v, 2); return; }
+    if (v <= 0xFFFFFF) { s.push_back(static_cast<char>(0xFD)); putInt(s, v, 3); return; }
+    s.push_back(static_cast<char>(0xFE));
+    putInt(s, v, 8);
+}
+
+template <typename T>
+void appendNumber(std::string& out, T v) {
+    char buf[32];
+    auto res = std::to_chars(buf, buf + sizeof(buf), v);
+    out.append(buf, res.ptr);
+}
+
+// Appends the text form of one binary-protocol value, as the text protocol
+// would have sent it.
+bool appendBinaryValue(Reader& r, UINT16 wType, std::string& out) {
+    bool uns = (wType & TYPE_UNSIGNED) != 0;
+    switch (wType & 0xFF) {
+    case TYPE_TINY: {
+        UINT8 v = r.u8();
+        if (uns) appendNumber(out, UINT32(v)); else appendNumber(out, INT32(static_cast<INT8>(v)));
+        break;
+    }
+    case TYPE_SHORT:
+    case TYPE_YEAR: {
+        UINT16 v = static_cast<UINT16>(r.uint(2));
+        if (uns) appendNumber(out, UINT32(v)); else appendNumber(out, INT32(static_cast<INT16>(v)));
+        break;
+    }
+    case TYPE_LONG:
+    case TYPE_INT24: {
+        UINT32 v = r.uint(4);
+        if (uns) appendNumber(out, v); else appendNumber(out, static_cast<INT32>(v));
+        break;
+    }
+    case TYPE_LONGLONG: {
+        UINT64 v = r.uint(4);
+        v |= UINT64(r.uint(4)) << 32;
+        if (uns) appendNumber(out, v); else appendNumber(out, static_cast<INT64>(v));
+        break;
+    }
+    case TYPE_FLOAT: {
+        UINT32 bits = r.uint(4);
+        float f;
+        std::memcpy(&f, &bits, sizeof(f));
+        appendNumber(out, f);
+        break;
+    }
+    case TYPE_DOUBLE: {
+        UINT64 bits = r.uint(4);
+        bits |= UINT64(r.uint(4)) << 32;
+        DOUBLE d;
+        std::memcpy(&d, &bits, sizeof(d));
+        appendNumber(out, d);
+        break;
+    }
+    case TYPE_DATE:
+    case TYPE_DATETIME:
+    case TYPE_TIMESTAMP: {
+        UINT8 len = r.u8();
+        UINT32 year = 0, month = 0, day = 0, hour = 0, minute = 0, second = 0, micro = 0;
+        if (len >= 4) { year = r.uint(2); month = r.u8(); day = r.u8(); }
+        if (len >= 7) { hour = r.u8(); minute = r.u8(); second = r.u8(); }
+        if (len >= 11) micro = r.uint(4);
+        char buf[40];
+        int n = (wType & 0xFF) == TYPE_DATE
+                    ? std::snprintf(buf, sizeof(buf), "%04u-%02u-%02u", year, month, day)
+                    : std::snprintf(buf, sizeof(buf), "%04u-%02u-%02u %02u:%02u:%02u", year, month, day, hour,
+                                    minute, second);
+        if (len >= 11 && (wType & 0xFF) != TYPE_DATE) n += std::snprintf(buf + n, sizeof(buf) - n, ".%06u", micro);
+        out.append(buf, static_cast<size_t>(n));
+        break;
+    }
+    case TYPE_TIME: {
+        UINT8 len = r.u8();
+        UINT32 neg = 0, days = 0, hour = 0, minute = 0, second = 0, micro = 0;
+        if (len >= 8) { neg = r.u8(); days = r.uint(4); hour = r.u8(); minute = r.u8(); second = r.u8(); }
+        if (len >= 12) micro = r.uint(4);
+        char buf[40];
+        int n = std::snprintf(buf, sizeof(buf), "%s%02u:%02u:%02u", neg ? "-" : "", days * 24 + hour, minute, second);
+        if (len >= 12) n += std::snprintf(buf + n, sizeof(buf) - n, ".%06u", micro);
+        out.append(buf, static_cast<size_t>(n));
+        break;
+    }
+    default: {
+        // Strings, decimals, blobs, bits, JSON: length-encoded bytes.
+        const char* p;
+        UINT32 len;
+        if (r.lenencStr(p, len)) out.append(p, len);
+        break;
+    }
+    }
+    return r.ok;
+}
+
+bool isEof(const std::string& pkt) { return !pkt.empty() && static_cast<UINT8>(pkt[0]) == 0xFE && pkt.size() < 9; }
+bool isErr(const std::string& pkt) { return !pkt.empty() && static_cast<UINT8>(pkt[0]) == 0xFF; }
+bool isOk(const std::string& pkt) { return !pkt.empty() && pkt[0] == 0; }
+
+std::string quoteName(const CHAR* pszName) {
+    std::string out = "`";
+    for (const CHAR* p = pszName; *p; ++p) {
+        if (*p == '`') out += '`';
+        out += *p;
+    }
+    return out + "`";
+}
+
+#if defined(_WIN32)
+void closeSocket(UINT64 s) { ::closesocket(static_cast<SOCKET>(s)); }
+#else
+void closeSocket(int s) { ::close(s); }
+#endif
+
+} // namespace
+
+UINT32 SDDBEscapeString(const CHAR* pSrc, INT32 nSrcSize, CHAR* pDest, INT32 nDstSize) {
+    if (!pDest || nDstSize <= 0) return 0;
+    pDest[0] = '\0';
+    if (!pSrc || nSrcSize <= 0) return 0;
+    INT32 written = 0;
+    for (INT32 i = 0; i < nSrcSize; ++i) {
+        char esc = 0;
+        switch (pSrc[i]) {
+        case '\0':   esc = '0'; break;
+        case '\n':   esc = 'n'; break;
+        case '\r':   esc = 'r'; break;
+        case '\\':   esc = '\\'; break;
+        case '\'':   esc = '\''; break;
+        case '"':    esc = '"'; break;
+        case '\032': esc = 'Z'; break;
+        default: break;
+        }
+        INT32 need = esc ? 2 : 1;
+        if (written + need > nDstSize - 1) { pDest[0] = '\0'; return 0; }
+        if (esc) { pDest[written++] = '\\'; pDest[written++] = esc; }
+        else pDest[written++] = pSrc[i];
+    }
+    pDest[written] = '\0';
+    return static_cast<UINT32>(written);
+}
+
+MySQLConfig MySQLConfig::fromAccount(const SDDBAccount& account) {
+    MySQLConfig c;
+    c.host.assign(account.m_szHostName, strnlen(account.m_szHostName, sizeof(account.m_szHostName)));
+    c.database.assign(account.m_szDBName, strnlen(account.m_szDBName, sizeof(account.m_szDBName)));
+    c.user.assign(account.m_szLoginName, strnlen(account.m_szLoginName, sizeof(account.m_szLoginName)));
+    c.password.assign(account.m_szLoginPwd, strnlen(account.m_szLoginPwd, sizeof(account.m_szLoginPwd)));
+    c.charset.assign(account.m_szCharactSet, strnlen(account.m_szCharactSet, sizeof(account.m_szCharactSet)));
+    c.port = account.m_wConnPort ? account.m_wConnPort : 3306;
+    return c;
+}
+
+//
+// MySQLRecordSet
+//
+
+void MySQLRecordSet::addField(const std::string& name) {
+    // The first of several equally named columns wins, as with a scan.
+    m_names.emplace(name, static_cast<UINT32>(m_columns.size()));
+    m_columns.emplace_back();
+    m_columns.back().name = name;
+}
+
+bool MySQLRecordSet::addRow(size_t nStart) {
+    // The spare byte terminates the row's last value.
+    m_arena.push_back('\0');
+    size_t end = m_arena.size() - 1;
+    if (end > 0xFFFFFFFEu) return false;
+    const unsigned char* p = reinterpret_cast<const unsigned char*>(m_arena.data());
+    size_t pos = nStart;
+    for (Column& col : m_columns) {
+        if (pos >= end) return false;
+        UINT8 b = p[pos++];
+        UINT64 len = b;
+        if (b == 0xFB) {
+            col.offset.push_back(0);
+            col.len.push_back(NULL_LEN);
+            continue;
+        }
+        int bytes = b == 0xFC ? 2 : b == 0xFD ? 3 : b == 0xFE ? 8 : 0;
+        if (b == 0xFF || pos + bytes > end) return false;
+        if (bytes) {
+            len = 0;
+            for (int i = 0; i < bytes; ++i) len |= UINT64(p[pos + i]) << (8 * i);
+            pos += static_cast<size_t>(bytes);
+        }
+        if (len > end - pos) return false;
+        col.offset.push_back(static_cast<UINT32>(pos));
+        col.len.push_back(static_cast<UINT32>(len));
+        pos += static_cast<size_t>(len);
+    }
+    // Every prefix is decoded, so the byte after each value is free.
+    for (Column& col : m_columns) {
+        if (col.len.back() != NULL_LEN) m_arena[col.offset.back() + col.len.back()] = '\0';
+    }
+    ++m_rows;
+    return true;
+}
+
+bool MySQLRecordSet::addBinaryRow(const std::string& packet, const std::vector<UINT16>& types) {
+    if (types.size() != m_columns.size()) return false;
+    Reader r(packet);
+    if (r.u8() != 0) return false;
+    // The NULL bitmap starts at bit 2.
+    size_t bitmapLen = (m_columns.size() + 7 + 2) / 8;
+    if (!r.need(bitmapLen)) return false;
+    const unsigned char* bitmap = r.p + r.pos;
+    r.skip(bitmapLen);
+    for (size_t i = 0; i < m_columns.size(); ++i) {
+        Column& col = m_columns[i];
+        size_t bit = i + 2;
+        if (bitmap[bit / 8] & (1u << (bit % 8))) {
+            col.offset.push_back(0);
+            col.len.push_back(NULL_LEN);
+            continue;
+        }
+        size_t at = m_arena.size();
+        if (!appendBinaryValue(r, types[i], m_arena) || m_arena.size() >= 0xFFFFFFFEu) return false;
+        col.offset.push_back(static_cast<UINT32>(at));
+        col.len.push_back(static_cast<UINT32>(m_arena.size() - at));
+        m_arena.push_back('\0');
+    }
+    ++m_rows;
+    return true;
+}
+
+bool MySQLRecordSet::GetRecord(void) {
+    if (m_cursor + 1 >= static_cast<INT64>(m_rows)) {
+        m_cursor = static_cast<INT64>(m_rows);
+        return false;
+    }
+    ++m_cursor;
+    return true;
+}
+
+const CHAR* MySQLRecordSet::value(UINT32 dwIndex, UINT32* pdwLen) const {
+    if (pdwLen) *pdwLen = 0;
+    if (m_cursor < 0 || m_cursor >= static_cast<INT64>(m_rows) || dwIndex >= m_columns.size()) return nullptr;
+    const Column& col = m_columns[dwIndex];
+    UINT32 len = col.len[static_cast<size_t>(m_cursor)];
+    if (len == NULL_LEN) return nullptr;
+    if (pdwLen) *pdwLen = len;
+    return m_arena.data() + col.offset[static_cast<size_t>(m_cursor)];
+}
+
+const CHAR* MySQLRecordSet::GetFieldValue(UINT32 dwIndex) {
+    return value(dwIndex, nullptr);
+}
+
+INT32 MySQLRecordSet::GetFieldLength(UINT32 dwIndex) {
+    UINT32 len;
+    value(dwIndex, &len);
+    return static_cast<INT32>(len);
+}
+
+INT32 MySQLRecordSet::GetFieldIndex(const CHAR* pszFieldName) {
+    if (!pszFieldName) return -1;
+    auto it = m_names.find(pszFieldName);
+    return it == m_names.end() ? -1 : static_cast<INT32>(it->second);
+}
+
+const CHAR* MySQLRecordSet::GetFieldValueByName(const CHAR* pszFieldName) {
+    INT32 idx = GetFieldIndex(pszFieldName);
+    return idx < 0 ? nullptr : GetFieldValue(static_cast<UINT32>(idx));
+}
+
+INT32 MySQLRecordSet::GetFieldLengthByName(const CHAR* pszFieldName) {
+    INT32 idx = GetFieldIndex(pszFieldName);
+    return idx < 0 ? 0 : GetFieldLength(static_cast<UINT32>(idx));
+}
+
+bool MySQLRecordSet::IsFieldNull(UINT32 dwIndex) {
+    return value(dwIndex, nullptr) == nullptr;
+}
+
+UINT64 MySQLRecordSet::GetFieldUInt64(UINT32 dwIndex, UINT64 qwDefault) {
+    UINT32 len;
+    const CHAR* p = value(dwIndex, &len);
+    if (!p) return qwDefault;
+    UINT32 i = (len && p[0] == '+') ? 1 : 0;
+    if (i >= len || p[i] < '0' || p[i] > '9') return qwDefault;
+    UINT64 v = 0;
+    for (; i < len && p[i] >= '0' && p[i] <= '9'; ++i) v = v * 10 + static_cast<UINT64>(p[i] - '0');
+    return v;
+}
+
+INT64 MySQLRecordSet::GetFieldInt64(UINT32 dwIndex, INT64 nDefault) {
+    UINT32 len;
+    const CHAR* p = value(dwIndex, &len);
+    if (!p) return nDefault;
+    bool neg = len && p[0] == '-';
+    UINT32 i = (len && (p[0] == '-' || p[0] == '+')) ? 1 : 0;
+    if (i >= len || p[i] < '0' || p[i] > '9') return nDefault;
+    UINT64 v = 0;
+    for (; i < len && p[i] >= '0' && p[i] <= '9'; ++i) v = v * 10 + static_cast<UINT64>(p[i] - '0');
+    return neg ? static_cast<INT64>(0 - v) : static_cast<INT64>(v);
+}
+
+DOUBLE MySQLRecordSet::GetFieldDouble(UINT32 dwIndex, DOUBLE dDefault) {
+    const CHAR* p = value(dwIndex, nullptr);
+    if (!p) return dDefault;
+    char* end = nullptr;
+    DOUBLE d = std::strtod(p, &end);
+    return end == p ? dDefault : d;
+}
+
+const CHAR* MySQLRecordSet::GetFieldBlob(UINT32 dwIndex, UINT32* pdwLen) {
+    return value(dwIndex, pdwLen);
+}
+
+//
+// MySQLStatement
+//
+
+bool MySQLStatement::bind(UINT32 dwIndex, UINT16 wType, const char* pData, size_t nLen) {
+    if (dwIndex >= m_params.size()) return false;
+    m_params[dwIndex].type = wType;
+    m_params[dwIndex].value.assign(pData, nLen);
+    return true;
+}
+
+void MySQLStatement::clearParams() {
+    for (Param& p : m_params) {
+        p.type = TYPE_NULL;
+        p.value.clear();
+    }
+}
+
+bool MySQLStatement::BindNull(UINT32 dwIndex) {
+    return bind(dwIndex, TYPE_NULL, "", 0);
+}
+
+bool MySQLStatement::BindInt64(UINT32 dwIndex, INT64 nValue) {
+    std::string v;
+    putInt(v, static_cast<UINT64>(nValue), 8);
+    return bind(dwIndex, TYPE_LONGLONG, v.data(), v.size());
+}
+
+bool MySQLStatement::BindUInt64(UINT32 dwIndex, UINT64 qwValue) {
+    std::string v;
+    putInt(v, qwValue, 8);
+    return bind(dwIndex, TYPE_LONGLONG | TYPE_UNSIGNED, v.data(), v.size());
+}
+
+bool MySQLStatement::BindDouble(UINT32 dwIndex, DOUBLE dValue) {
+    UINT64 bits;
+    std::memcpy(&bits, &dValue, sizeof(bits));
+    std::string v;
+    putInt(v, bits, 8);
+    return bind(dwIndex, TYPE_DOUBLE, v.data(), v.size());
+}
+
+bool MySQLStatement::BindString(UINT32 dwIndex, const CHAR* pData, UINT32 dwLen) {
+    if (!pData) return BindNull(dwIndex);
+    std::string v;
+    v.reserve(dwLen + 9);
+    putLenenc(v, dwLen);
+    v.append(pData, dwLen);
+    return bind(dwIndex, TYPE_STRING, v.data(), v.size());
+}
+
+INT32 MySQLStatement::Execute(UINT64* pInsertId) {
+    if (pInsertId) *pInsertId = 0;
+    return m_conn->executeStmt(this, pInsertId, nullptr);
+}
+
+INT32 MySQLStatement::ExecuteRs(ISSDBRecordSet** ppoRs) {
+    if (!ppoRs) return SDDB_ERR_UNKNOWN;
+    *ppoRs = nullptr;
+    MySQLRecordSet* rs = nullptr;
+    INT32 ret = m_conn->executeStmt(this, nullptr, &rs);
+    if (ret == SDDB_HAS_RECORDSET) {
+        *ppoRs = rs;
+        return ret;
+    }
+    return ret < 0 ? ret : SDDB_NO_RECORDSET;
+}
+
+void MySQLStatement::Release() {
+    m_conn->releaseStmt(this);
+}
+
+//
+// MySQLConnection
+//
+
+MySQLConnection::MySQLConnection(const MySQLConfig& config)
+    : m_config(config), m_sock(INVALID_SOCK), m_seq(0), m_caps(0), m_epoch(0), m_stats(nullptr),
+      m_context(nullptr) {}
+
+MySQLConnection::~MySQLConnection() {
+    for (MySQLStatement* st : m_stmts) delete st;
+    if (connected()) {
+        m_seq = 0;
+        char quit = static_cast<char>(COM_QUIT);
+        writePacket(&quit, 1);
+    }
+    close();
+}
+
+void MySQLConnection::close() {
+    if (m_sock != INVALID_SOCK) {
+        closeSocket(m_sock);
+        m_sock = INVALID_SOCK;
+    }
+}
+
+void MySQLConnection::setError(const std::string& text) {
+    m_lastError = text;
+    SDDBLog(LOGLV_WARN, "SSDB mysql " + m_config.host + ":" + std::to_string(m_config.port) + ": " + text);
+}
+
+bool MySQLConnection::connect() {
+    close();
+    // Statement ids belong to the old session.
+    ++m_epoch;
+    addrinfo hints;
+    std::memset(&hints, 0, sizeof(hints));
+    hints.ai_family = AF_INET;
+    hints.ai_socktype = SOCK_STREAM;
+    addrinfo* res = nullptr;
+    std::string port = std::to_string(m_config.port);
+    if (::getaddrinfo(m_config.host.c_str(), port.c_str(), &hints, &res) != 0 || !res) {
+        setError("cannot resolve host");
+        return false;
+    }
+    for (addrinfo* ai = res; ai; ai = ai->ai_next) {
+        Socket s = static_cast<Socket>(::socket(ai->ai_family, ai->ai_socktype, ai->ai_protocol));
+        if (s == INVALID_SOCK) continue;
+        if (::connect(s, ai->ai_addr, static_cast<int>(ai->ai_addrlen)) == 0) {
+            m_sock = s;
+            break;
+        }
+        closeSocket(s);
+    }
+    ::freeaddrinfo(res);
+    if (m_sock == INVALID_SOCK) {
+        setError("connect failed");
+        return false;
+    }
+    int on = 1;
+    ::setsockopt(m_sock, IPPROTO_TCP, TCP_NODELAY, reinterpret_cast<const char*>(&on), sizeof(on));
+    if (!handshake()) {
+        close();
+        return false;
+    }
+    return true;
+}
+
+void MySQLConnection::setTimeout(INT32 nTimeoutMs) {
+    if (m_sock == INVALID_SOCK) return;
+#if defined(_WIN32)
+    DWORD tv = nTimeoutMs < 0 ? 0 : static_cast<DWORD>(nTimeoutMs);
+#else
+    timeval tv;
+    tv.tv_sec = nTimeoutMs < 0 ? 0 : nTimeoutMs / 1000;
+    tv.tv_usec = nTimeoutMs < 0 ? 0 : (nTimeoutMs % 1000) * 1000;
+#endif
+    ::setsockopt(m_sock, SOL_SOCKET, SO_RCVTIMEO, reinterpret_cast<const char*>(&tv), sizeof(tv));
+    ::setsockopt(m_sock, SOL_SOCKET, SO_SNDTIMEO, reinterpret_cast<const char*>(&tv), sizeof(tv));
+}
+
+bool MySQLConnection::handshake() {
+    m_seq = 0;
+    std::string pkt;
+    if (!readPacket(pkt)) return false;
+    if (isErr(pkt)) { serverError(pkt); return false; }
+    Reader r(pkt);
+    if (r.u8() != 10) { setError("unsupported protocol version"); return false; }
+    r.cstr();           // server version
+    r.uint(4);          // connection id
+    std::string scramble;
+    if (r.need(8)) scramble.assign(reinterpret_cast<const char*>(r.p + r.pos), 8);
+    r.skip(8 + 1);
+    UINT32 serverCaps = r.uint(2);
+    std::string plugin = NATIVE_PASSWORD;
+    if (r.left()) {
+        r.u8();         // charset
+        r.uint(2);      // status
+        serverCaps |= r.uint(2) << 16;
+        UINT8 authLen = r.u8();
+        r.skip(10);
+        if (serverCaps & CLIENT_SECURE_CONNECTION) {
+            size_t part2 = std::max<int>(13, authLen - 8);
+            if (r.need(part2)) scramble.append(reinterpret_cast<const char*>(r.p + r.pos), part2 - 1);
+            r.skip(part2);
+        }
+        if (serverCaps & CLIENT_PLUGIN_AUTH) plugin = r.cstr();
+    }
+    if (!r.ok || !(serverCaps & CLIENT_PROTOCOL_41)) { setError("malformed or pre-4.1 handshake"); return false; }
+
+    m_caps = CLIENT_LONG_PASSWORD | CLIENT_PROTOCOL_41 | CLIENT_TRANSACTIONS | CLIENT_SECURE_CONNECTION |
+             CLIENT_MULTI_RESULTS | (serverCaps & CLIENT_PLUGIN_AUTH);
+    if (!m_config.database.empty()) m_caps |= CLIENT_CONNECT_WITH_DB;
+    m_caps &= serverCaps | CLIENT_CONNECT_WITH_DB;
+
+    std::string auth = nativePassword(m_config.password, scramble.data(), std::min<size_t>(scramble.size(), 20));
+    std::string rsp;
+    putInt(rsp, m_caps, 4);
+    putInt(rsp, 16 * 1024 * 1024, 4);
+    rsp.push_back(static_cast<char>(collationOf(m_config.charset)));
+    rsp.append(23, '\0');
+    rsp.append(m_config.user).push_back('\0');
+    rsp.push_back(static_cast<char>(auth.size()));
+    rsp.append(auth);
+    if (m_caps & CLIENT_CONNECT_WITH_DB) rsp.append(m_config.database).push_back('\0');
+    if (m_caps & CLIENT_PLUGIN_AUTH) rsp.append(NATIVE_PASSWORD).push_back('\0');
+    if (!writePacket(rsp.data(), rsp.size())) return false;
+
+    for (int round = 0; round < 2; ++round) {
+        if (!readPacket(pkt)) return false;
+        if (isOk(pkt)) return true;
+        if (isErr(pkt)) { serverError(pkt); return false; }
+        if (static_cast<UINT8>(pkt[0]) != 0xFE || round) break;
+        // Auth switch: only mysql_native_password is spoken.
+        Reader sw(pkt);
+        sw.u8();
+        std::string name = sw.cstr();
+        if (name != NATIVE_PASSWORD) {
+            setError("unsupported auth plugin " + name);
+            return false;
+        }
+        std::string data(reinterpret_cast<const char*>(sw.p + sw.pos), sw.left());
+        if (!data.empty() && data.back() == '\0') data.pop_back();
+        auth = nativePassword(m_config.password, data.data(), std::min<size_t>(data.size(), 20));
+        if (!writePacket(auth.data(), auth.size())) return false;
+    }
+    setError("unexpected authentication response");
+    return false;
+}
+
+std::chrono::steady_clock::time_point MySQLConnection::slowStart() const {
+    return m_stats && m_stats->slowMs() ? std::chrono::steady_clock::now() : std::chrono::steady_clock::time_point();
+}
+
+void MySQLConnection::slowCheck(std::chrono::steady_clock::time_point start, const char* pSQL, size_t nLen) {
+    if (start == std::chrono::steady_clock::time_point()) return;
+    auto ms = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - start).count();
+    if (ms >= static_cast<INT64>(m_stats->slowMs())) m_stats->slowStatement(static_cast<UINT64>(ms), m_context, pSQL, nLen);
+}
+
+INT32 MySQLConnection::serverError(const std::string& packet) {
+    Reader r(packet);
+    r.u8();
+    UINT32 code = r.uint(2);
+    std::string msg;
+    if (r.left() && r.p[r.pos] == '#') r.skip(6);
+    if (r.ok) msg.assign(reinterpret_cast<const char*>(r.p + r.pos), r.left());
+    setError("error " + std::to_string(code) + ": " + msg);
+    return SDDB_ERR_UNKNOWN;
+}
+
+INT32 MySQLConnection::readResultSet(UINT64 qwColumns, MySQLRecordSet* poRs, UINT16& wStatus, bool bBinary) {
+    std::string pkt;
+    std::vector<UINT16> types;
+    for (UINT64 i = 0; i < qwColumns; ++i) {
+        if (!readPacket(pkt)) return SDDB_ERR_CONN;
+        if (!poRs) continue;
+        Reader r(pkt);
+        const char* s;
+        UINT32 len;
+        for (int k = 0; k < 4; ++k) r.lenencStr(s, len);   // catalog, schema, table, org_table
+        if (!r.lenencStr(s, len)) return SDDB_ERR_UNKNOWN;
+        poRs->addField(std::string(s, len));
+        if (!bBinary) continue;
+        r.lenencStr(s, len);    // org_name
+        r.lenenc();             // length of the fixed fields
+        r.skip(2 + 4);          // charset, column length
+        UINT16 type = r.u8();
+        if (r.uint(2) & UNSIGNED_FLAG) type |= TYPE_UNSIGNED;
+        if (!r.ok) return SDDB_ERR_UNKNOWN;
+        types.push_back(type);
+    }
+    if (!readPacket(pkt)) return SDDB_ERR_CONN;
+    if (!isEof(pkt)) return SDDB_ERR_UNKNOWN;
+    // Text rows go straight into the record set's arena; anything else is
+    // moved out of it again. Binary rows are rendered into it from pkt.
+    bool inPlace = poRs && !bBinary;
+    std::string& rows = inPlace ? poRs->arena() : pkt;
+    bool malformed = false;
+    for (;;) {
+        size_t start = inPlace ? rows.size() : 0;
+        if (!inPlace) rows.clear();
+        if (!appendPacket(rows)) return SDDB_ERR_CONN;
+        size_t len = rows.size() - start;
+        UINT8 first = len ? static_cast<UINT8>(rows[start]) : 0;
+        if (first == 0xFF || (first == 0xFE && len < 9)) {
+            std::string tail = rows.substr(start);
+            rows.resize(start);
+            if (first == 0xFF) return serverError(tail);
+            Reader r(tail);
+            r.skip(3);
+            wStatus = static_cast<UINT16>(r.uint(2));
+            return malformed ? SDDB_ERR_UNKNOWN : SDDB_SUCCESS;
+        }
+        // A bad row fails the query, but the rest is still read so the
+        // connection stays in step.
+        if (poRs && !malformed && !(bBinary ? poRs->addBinaryRow(rows, types) : poRs->addRow(start))) {
+            setError("malformed row");
+            malformed = true;
+        }
+        if (malformed) rows.resize(start);
+    }
+}
+
+INT32 MySQLConnection::command(UINT8 byCmd, const char* pArg, size_t nLen, UINT64* pInsertId, MySQLRecordSet** ppoRs,
+                               std::vector<INT32>* pResults) {
+    if (!connected() && !connect()) return SDDB_ERR_CONN;
+    std::string out;
+    out.reserve(nLen + 1);
+    out.push_back(static_cast<char>(byCmd));
+    out.append(pArg, nLen);
+    m_seq = 0;
+    if (!writePacket(out.data(), out.size())) return SDDB_ERR_CONN;
+    return readResponse(pInsertId, ppoRs, pResults, false);
+}
+
+INT32 MySQLConnection::readResponse(UINT64* pInsertId, MySQLRecordSet** ppoRs, std::vector<INT32>* pResults,
+                                    bool bBinary) {
+    INT32 result = SDDB_SUCCESS;
+    bool first = true;
+    UINT16 status = 0;
+    do {
+        std::string pkt;
+        if (!readPacket(pkt)) return SDDB_ERR_CONN;
+        INT32 ret;
+        if (isErr(pkt)) {
+            ret = serverError(pkt);
+            status = 0;
+        } else if (isOk(pkt)) {
+            Reader r(pkt);
+            r.u8();
+            UINT64 affected = r.lenenc();
+            UINT64 insertId = r.lenenc();
+            status = static_cast<UINT16>(r.uint(2));
+            if (first && pInsertId) *pInsertId = insertId;
+            ret = static_cast<INT32>(std::min<UINT64>(affected, 0x7FFFFFFF));
+        } else if (isEof(pkt)) {
+            // COM_SET_OPTION answers with a bare EOF.
+            status = 0;
+            ret = SDDB_SUCCESS;
+        } else if (static_cast<UINT8>(pkt[0]) == 0xFB) {
+            // LOCAL INFILE request: refuse by sending an empty file.
+            writePacket("", 0);
+            continue;
+        } else {
+            Reader r(pkt);
+            UINT64 columns = r.lenenc();
+            MySQLRecordSet* rs = (first && ppoRs) ? new MySQLRecordSet : nullptr;
+            ret = readResultSet(columns, rs, status, bBinary);
+            if (ret == SDDB_SUCCESS && rs) { *ppoRs = rs; ret = SDDB_HAS_RECORDSET; }
+            else delete rs;
+            if (ret == SDDB_ERR_CONN) return ret;
+        }
+        if (first) result = ret;
+        if (pResults) pResults->push_back(ret);
+        first = false;
+    } while (status & SERVER_MORE_RESULTS_EXISTS);
+    return result;
+}
+
+INT32 MySQLConnection::executeMulti(const std::string& sql, std::vector<INT32>& results) {
+    results.clear();
+    INT32 ret = command(COM_SET_OPTION, MULTI_STATEMENTS_ON, sizeof(MULTI_STATEMENTS_ON), nullptr, nullptr);
+    if (ret < 0) return ret;
+    auto start = slowStart();
+    ret = command(COM_QUERY, sql.data(), sql.size(), nullptr, nullptr, &results);
+    slowCheck(start, sql.data(), sql.size());
+    if (ret == SDDB_ERR_CONN) return ret;
+    command(COM_SET_OPTION, MULTI_STATEMENTS_OFF, sizeof(MULTI_STATEMENTS_OFF), nullptr, nullptr);
+    for (INT32 r : results) {
+        if (r < 0) return r;
+    }
+    return SDDB_SUCCESS;
+}
+
+bool MySQLConnection::CheckConnection() {
+    if (connected() && command(COM_PING, "", 0, nullptr, nullptr) >= 0) return true;
+    return connect();
+}
+
+UINT32 MySQLConnection::EscapeString(const CHAR* pSrc, INT32 nSrcSize, CHAR* pDest, INT32 nDstSize) {
+    return SDDBEscapeString(pSrc, nSrcSize, pDest, nDstSize);
+}
+
+INT32 MySQLConnection::ExecuteSql(const CHAR* pSQL, UINT64* pInsertId) {
+    if (!pSQL) return SDDB_ERR_UNKNOWN;
+    if (pInsertId) *pInsertId = 0;
+    size_t len = std::strlen(pSQL);
+    auto start = slowStart();
+    INT32 ret = command(COM_QUERY, pSQL, len, pInsertId, nullptr);
+    slowCheck(start, pSQL, len);
+    return ret;
+}
+
+INT32 MySQLConnection::ExecuteSqlRs(const CHAR* pSQL, ISSDBRecordSet** ppoRs) {
+    if (!pSQL || !ppoRs) return SDDB_ERR_UNKNOWN;
+    *ppoRs = nullptr;
+    MySQLRecordSet* rs = nullptr;
+    size_t len = std::strlen(pSQL);
+    auto start = slowStart();
+    INT32 ret = command(COM_QUERY, pSQL, len, nullptr, &rs);
+    slowCheck(start, pSQL, len);
+    if (ret == SDDB_HAS_RECORDSET) {
+        *ppoRs = rs;
+        return ret;
+    }
+    return ret < 0 ? ret : SDDB_NO_RECORDSET;
+}
+
+bool MySQLConnection::CreateDB(const CHAR* pcDBName, bool bForce, const CHAR* pcCharSet) {
+    if (!pcDBName || !*pcDBName) return false;
+    std::string name = quoteName(pcDBName);
+    if (bForce && ExecuteSql(("DROP DATABASE IF EXISTS " + name).c_str()) < 0) return false;
+    std::string sql = "CREATE DATABASE IF NOT EXISTS " + name;
+    if (pcCharSet && *pcCharSet) sql += std::string(" CHARACTER SET ") + pcCharSet;
+    return ExecuteSql(sql.c_str()) >= 0;
+}
+
+bool MySQLConnection::SelectDB(const CHAR* pcDBName) {
+    if (!pcDBName) return false;
+    if (command(COM_INIT_DB, pcDBName, std::strlen(pcDBName), nullptr, nullptr) < 0) return false;
+    // Reconnects come back to the selected database.
+    m_config.database = pcDBName;
+    return true;
+}
+
+ISSDBStatement* MySQLConnection::Prepare(const CHAR* pSQL) {
+    if (!pSQL) return nullptr;
+    auto it = m_stmtIndex.find(pSQL);
+    if (it != m_stmtIndex.end() && !(*it->second)->m_inUse) {
+        m_stmts.splice(m_stmts.begin(), m_stmts, it->second);
+        MySQLStatement* st = *it->second;
+        st->m_inUse = true;
+        return st;
+    }
+    MySQLStatement* st = new MySQLStatement(this, pSQL);
+    if (!prepareStmt(st)) {
+        delete st;
+        return nullptr;
+    }
+    st->m_inUse = true;
+    if (it == m_stmtIndex.end() && m_config.stmtCacheSize) {
+        st->m_cached = true;
+        m_stmts.push_front(st);
+        m_stmtIndex[st->m_sql] = m_stmts.begin();
+        trimStmtCache();
+    }
+    return st;
+}
+
+bool MySQLConnection::prepareStmt(MySQLStatement* poStmt) {
+    if (!connected() && !connect()) return false;
+    std::string out;
+    out.reserve(poStmt->m_sql.size() + 1);
+    out.push_back(static_cast<char>(COM_STMT_PREPARE));
+    out.append(poStmt->m_sql);
+    m_seq = 0;
+    if (!writePacket(out.data(), out.size())) return false;
+    std::string pkt;
+    if (!readPacket(pkt)) return false;
+    if (isErr(pkt)) {
+        serverError(pkt);
+        return false;
+    }
+    Reader r(pkt);
+    r.u8();
+    UINT32 id = r.uint(4);
+    UINT32 columns = r.uint(2);
+    UINT32 params = r.uint(2);
+    if (!isOk(pkt) || !r.ok) {
+        setError("malformed prepare response");
+        close();
+        return false;
+    }
+    // The parameter and column definitions, each list closed by an EOF, are
+    // not needed: execution reports the columns again.
+    for (UINT32 list : {params, columns}) {
+        if (!list) continue;
+        for (UINT32 i = 0; i <= list; ++i) {
+            if (!readPacket(pkt)) return false;
+        }
+    }
+    poStmt->m_id = id;
+    poStmt->m_epoch = m_epoch;
+    poStmt->m_params.resize(params);
+    return true;
+}
+
+INT32 MySQLConnection::executeStmt(MySQLStatement* poStmt, UINT64* pInsertId, MySQLRecordSet** ppoRs) {
+    if (!connected() && !connect()) return SDDB_ERR_CONN;
+    // After a reconnect the statement is prepared again on first use.
+    if (poStmt->m_epoch != m_epoch && !prepareStmt(poStmt)) return connected() ? SDDB_ERR_UNKNOWN : SDDB_ERR_CONN;
+    const std::vector<MySQLStatement::Param>& params = poStmt->m_params;
+    size_t size = 10 + (params.size() + 7) / 8 + 1 + 2 * params.size();
+    for (const MySQLStatement::Param& p : params) size += p.value.size();
+    std::string out;
+    out.reserve(size);
+    out.push_back(static_cast<char>(COM_STMT_EXECUTE));
+    putInt(out, poStmt->m_id, 4);
+    out.push_back(0);           // no cursor
+    putInt(out, 1, 4);          // iteration count
+    if (!params.empty()) {
+        size_t bitmap = out.size();
+        out.append((params.size() + 7) / 8, '\0');
+        for (size_t i = 0; i < params.size(); ++i) {
+            if ((params[i].type & 0xFF) == TYPE_NULL) out[bitmap + i / 8] |= static_cast<char>(1 << (i % 8));
+        }
+        out.push_back(1);       // types follow
+        for (const MySQLStatement::Param& p : params) {
+            out.push_back(static_cast<char>(p.type & 0xFF));
+            out.push_back(static_cast<char>((p.type & TYPE_UNSIGNED) ? 0x80 : 0));
+        }
+        for (const MySQLStatement::Param& p : params) out.append(p.value);
+    }
+    auto start = slowStart();
+    m_seq = 0;
+    if (!writePacket(out.data(), out.size())) return SDDB_ERR_CONN;
+    INT32 ret = readResponse(pInsertId, ppoRs, nullptr, true);
+    slowCheck(start, poStmt->m_sql.data(), poStmt->m_sql.size());
+    return ret;
+}
+
+void MySQLConnection::releaseStmt(MySQLStatement* poStmt) {
+    if (!poStmt->m_cached) {
+        closeStmt(poStmt);
+        delete poStmt;
+        return;
+    }
+    poStmt->m_inUse = false;
+    poStmt->clearParams();
+    trimStmtCache();
+}
+
+void MySQLConnection::closeStmt(MySQLStatement* poStmt) {
+    // COM_STMT_CLOSE has no response.
+    if (!connected() || poStmt->m_epoch != m_epoch) return;
+    std::string out;
+    out.push_back(static_cast<char>(COM_STMT_CLOSE));
+    putInt(out, poStmt->m_id, 4);
+    m_seq = 0;
+    writePacket(out.data(), out.size());
+}
+
+void MySQLConnection::trimStmtCache() {
+    auto it = m_stmts.end();
+    while (m_stmts.size() > m_config.stmtCacheSize && it != m_stmts.begin()) {
+        --it;
+        MySQLStatement* st = *it;
+        if (st->m_inUse) continue;
+        closeStmt(st);
+        m_stmtIndex.erase(st->m_sql);
+        delete st;
+        it = m_stmts.erase(it);
+    }
+}
+
+//
+// Packet I/O
+//
+
+bool MySQLConnection::sendAll(const char* pData, size_t nLen) {
+    while (nLen) {
+#if defined(_WIN32)
+        int n = ::send(m_sock, pData, static_cast<int>(std::min<size_t>(nLen, 1 << 30)), 0);
+#else
+        ssize_t n = ::send(m_sock, pData, nLen, MSG_NOSIGNAL);
+#endif
+        if (n <= 0) { setError("send failed"); close(); return false; }
+        pData += n;
+        nLen -= static_cast<size_t>(n);
+    }
+    return true;
+}
+
+bool MySQLConnection::recvAll(char* pData, size_t nLen) {
+    while (nLen) {
+#if defined(_WIN32)
+        int n = ::recv(m_sock, pData, static_cast<int>(std::min<size_t>(nLen, 1 << 30)), 0);
+#else
+        ssize_t n = ::recv(m_sock, pData, nLen, 0);
+#endif
+        if (n <= 0) { setError(n == 0 ? "connection closed by server" : "receive failed or timed out"); close(); return false; }
+        pData += n;
+        nLen -= static_cast<size_t>(n);
+    }
+    return true;
+}
+
+bool MySQLConnection::writePacket(const char* pData, size_t nLen) {
+    if (m_sock == INVALID_SOCK) return false;
+    // Payloads of 16M or more are split; an exact multiple ends with an
+    // empty packet.
+    for (;;) {
+        size_t chunk = std::min(nLen, MAX_PACKET);
+        char head[4] = {static_cast<char>(chunk & 0xFF), static_cast<char>((chunk >> 8) & 0xFF),
+                        static_cast<char>((chunk >> 16) & 0xFF), static_cast<char>(m_seq++)};
+        if (!sendAll(head, 4) || !sendAll(pData, chunk)) return false;
+        pData += chunk;
+        nLen -= chunk;
+        if (chunk < MAX_PACKET) return true;
+    }
+}
+
+bool MySQLConnection::readPacket(std::string& out) {
+    out.clear();
+    return appendPacket(out);
+}
+
+bool MySQLConnection::appendPacket(std::string& out) {
+    if (m_sock == INVALID_SOCK) return false;
+    for (;;) {
+        unsigned char head[4];
+        if (!recvAll(reinterpret_cast<char*>(head), 4)) return false;
+        size_t len = head[0] | (size_t(head[1]) << 8) | (size_t(head[2]) << 16);
+        m_seq = static_cast<UINT8>(head[3] + 1);
+        size_t at = out.size();
+        out.resize(at + len);
+        if (len && !recvAll(&out[at], len)) return false;
+        if (len < MAX_PACKET) return true;
+    }
+}
+
+} // namespace SSCP
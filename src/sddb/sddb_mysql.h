@@ -0,0 +1,215 @@
+// MySQL client/server protocol (protocol 41, text result sets) over a
+// blocking TCP socket.
+//
+// MySQLConnection speaks just enough of the protocol for ISSDBConnection:
+// handshake with mysql_native_password, COM_QUERY with OK/ERR/result set
+// responses (including MULTI_RESULTS trailers), COM_INIT_DB, COM_PING and
+// prepared statements (COM_STMT_PREPARE/EXECUTE/CLOSE, binary result sets).
+// A connection is used by one thread at a time.
+#ifndef SSCP_SDDB_MYSQL_H
+#define SSCP_SDDB_MYSQL_H
+
+#include "ssengine/sddb.h"
+#include "sddb_stats.h"
+#include <chrono>
+#include <list>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace SSCP {
+
+struct MySQLConfig {
+    std::string host;
+    UINT16 port = 3306;
+    std::string user;
+    std::string password;
+    std::string database;
+    std::string charset;
+    UINT32 stmtCacheSize = 64;      // prepared statements kept per connection
+
+    static MySQLConfig fromAccount(const SDDBAccount& account);
+};
+
+// Result set of one text-protocol query, stored column-major over a single
+// arena. Row packets are read straight into the arena and decoded in place:
+// each column keeps the offset and length of its value in every row, and the
+// byte after each value (the next cell's length prefix, already decoded, or
+// a spare byte per row) is overwritten with NUL so values can be handed out
+// as C strings without copying.
+class MySQLRecordSet : public ISSDBRecordSet {
+public:
+    MySQLRecordSet() : m_rows(0), m_cursor(-1) {}
+
+    UINT32 SSAPI GetRecordCount(void) override { return static_cast<UINT32>(m_rows); }
+    UINT32 SSAPI GetFieldCount(void) override { return static_cast<UINT32>(m_columns.size()); }
+    bool SSAPI GetRecord(void) override;
+    const CHAR* SSAPI GetFieldValue(UINT32 dwIndex) override;
+    INT32 SSAPI GetFieldLength(UINT32 dwIndex) override;
+    void SSAPI Release(void) override { delete this; }
+    const CHAR* SSAPI GetFieldValueByName(const CHAR* pszFieldName) override;
+    INT32 SSAPI GetFieldLengthByName(const CHAR* pszFieldName) override;
+    INT32 SSAPI GetFieldIndex(const CHAR* pszFieldName) override;
+    bool SSAPI IsFieldNull(UINT32 dwIndex) override;
+    INT64 SSAPI GetFieldInt64(UINT32 dwIndex, INT64 nDefault = 0) override;
+    UINT64 SSAPI GetFieldUInt64(UINT32 dwIndex, UINT64 qwDefault = 0) override;
+    DOUBLE SSAPI GetFieldDouble(UINT32 dwIndex, DOUBLE dDefault = 0) override;
+    const CHAR* SSAPI GetFieldBlob(UINT32 dwIndex, UINT32* pdwLen) override;
+
+    // Filled by MySQLConnection while reading the result: a row packet is
+    // appended to arena() and then decoded from nStart with addRow.
+    void addField(const std::string& name);
+    std::string& arena() { return m_arena; }
+    bool addRow(size_t nStart);
+    // Binary-protocol row: values are rendered as text into the arena, so
+    // every accessor behaves as for a text result. types holds each column's
+    // type, with 0x8000 set for unsigned integer columns.
+    bool addBinaryRow(const std::string& packet, const std::vector<UINT16>& types);
+
+private:
+    static constexpr UINT32 NULL_LEN = 0xFFFFFFFF;
+    struct Column {
+        std::string name;
+        std::vector<UINT32> offset;
+        std::vector<UINT32> len;    // NULL_LEN for NULL
+    };
+    // Current row's value of column dwIndex; NULL when absent or NULL.
+    const CHAR* value(UINT32 dwIndex, UINT32* pdwLen) const;
+
+    std::vector<Column> m_columns;
+    std::unordered_map<std::string, UINT32> m_names;
+    std::string m_arena;
+    size_t m_rows;
+    INT64 m_cursor;
+};
+
+class MySQLConnection;
+
+// Server-side prepared statement, owned by its connection's statement cache.
+// Parameters are kept already encoded for COM_STMT_EXECUTE.
+class MySQLStatement : public ISSDBStatement {
+public:
+    MySQLStatement(MySQLConnection* poConn, const std::string& sql) : m_conn(poConn), m_sql(sql) {}
+
+    UINT32 SSAPI GetParamCount() override { return static_cast<UINT32>(m_params.size()); }
+    bool SSAPI BindNull(UINT32 dwIndex) override;
+    bool SSAPI BindInt64(UINT32 dwIndex, INT64 nValue) override;
+    bool SSAPI BindUInt64(UINT32 dwIndex, UINT64 qwValue) override;
+    bool SSAPI BindDouble(UINT32 dwIndex, DOUBLE dValue) override;
+    bool SSAPI BindString(UINT32 dwIndex, const CHAR* pData, UINT32 dwLen) override;
+    INT32 SSAPI Execute(UINT64* pInsertId = NULL) override;
+    INT32 SSAPI ExecuteRs(ISSDBRecordSet** ppoRs) override;
+    void SSAPI Release() override;
+
+private:
+    friend class MySQLConnection;
+    struct Param {
+        UINT16 type = 0x06;         // MYSQL_TYPE_NULL, 0x8000 when unsigned
+        std::string value;          // binary encoding, empty for NULL
+    };
+    bool bind(UINT32 dwIndex, UINT16 wType, const char* pData, size_t nLen);
+    void clearParams();
+
+    MySQLConnection* m_conn;
+    std::string m_sql;
+    UINT32 m_id = 0;
+    UINT32 m_epoch = 0;             // connection epoch m_id was prepared in
+    bool m_inUse = false;
+    bool m_cached = false;
+    std::vector<Param> m_params;
+};
+
+class MySQLConnection : public ISSDBConnection {
+public:
+    explicit MySQLConnection(const MySQLConfig& config);
+    ~MySQLConnection() override;
+
+    // Opens the socket and authenticates; false leaves the connection closed.
+    bool connect();
+    bool connected() const { return m_sock != INVALID_SOCK; }
+    void close();
+    // Per-call socket timeout in milliseconds, negative for none. A call that
+    // times out closes the connection, since the protocol state is lost.
+    void setTimeout(INT32 nTimeoutMs);
+    const std::string& lastError() const { return m_lastError; }
+    // Sends several ';'-separated statements in one COM_QUERY, with
+    // multi-statements switched on only for this call. results gets one
+    // entry per statement the server ran; the server stops at the first
+    // error, whose code is returned. SDDB_SUCCESS when every statement ran.
+    INT32 executeMulti(const std::string& sql, std::vector<INT32>& results);
+    // Statements are timed against the table's slow-query threshold and
+    // reported to it, naming the current context (the running command).
+    void setStats(SDDBStatsTable* poStats) { m_stats = poStats; }
+    void setContext(const CHAR* pszContext) { m_context = pszContext; }
+
+    bool SSAPI CheckConnection() override;
+    UINT32 SSAPI EscapeString(const CHAR* pSrc, INT32 nSrcSize, CHAR* pDest, INT32 nDstSize) override;
+    INT32 SSAPI ExecuteSql(const CHAR* pSQL, UINT64* pInsertId = NULL) override;
+    INT32 SSAPI ExecuteSqlRs(const CHAR* pSQL, ISSDBRecordSet** ppoRs) override;
+    void SSAPI BeginTransaction() override { ExecuteSql("START TRANSACTION"); }
+    void SSAPI CommitTransaction() override { ExecuteSql("COMMIT"); }
+    void SSAPI RollbackTransaction() override { ExecuteSql("ROLLBACK"); }
+    bool SSAPI CreateDB(const CHAR* pcDBName, bool bForce, const CHAR* pcCharSet) override;
+    bool SSAPI SelectDB(const CHAR* pcDBName) override;
+    // Returns the cached statement for pSQL, preparing it on a miss; a
+    // statement already handed out is prepared again, uncached.
+    ISSDBStatement* SSAPI Prepare(const CHAR* pSQL) override;
+    void SSAPI Release() override { delete this; }
+
+private:
+#if defined(_WIN32)
+    typedef UINT64 Socket;
+#else
+    typedef int Socket;
+#endif
+    static const Socket INVALID_SOCK = static_cast<Socket>(-1);
+
+    bool handshake();
+    // Start of a statement for slow-query timing; the zero time point when
+    // the threshold is off.
+    std::chrono::steady_clock::time_point slowStart() const;
+    void slowCheck(std::chrono::steady_clock::time_point start, const char* pSQL, size_t nLen);
+    // Runs one command and reads its whole response. ppoRs may be NULL, in
+    // which case rows are read and discarded. Returns the first result's
+    // code; pResults, when given, collects the code of every result.
+    INT32 command(UINT8 byCmd, const char* pArg, size_t nLen, UINT64* pInsertId, MySQLRecordSet** ppoRs,
+                  std::vector<INT32>* pResults = nullptr);
+    // Reads the response to a command already sent; bBinary for
+    // COM_STMT_EXECUTE, whose result sets use binary rows.
+    INT32 readResponse(UINT64* pInsertId, MySQLRecordSet** ppoRs, std::vector<INT32>* pResults, bool bBinary);
+    INT32 readResultSet(UINT64 qwColumns, MySQLRecordSet* poRs, UINT16& wStatus, bool bBinary);
+
+    friend class MySQLStatement;
+    // Statement cache, most recently used first. Entries handed out are
+    // never evicted; the cache may exceed its size until they come back.
+    typedef std::list<MySQLStatement*> StmtList;
+    bool prepareStmt(MySQLStatement* poStmt);
+    INT32 executeStmt(MySQLStatement* poStmt, UINT64* pInsertId, MySQLRecordSet** ppoRs);
+    void releaseStmt(MySQLStatement* poStmt);
+    void closeStmt(MySQLStatement* poStmt);
+    void trimStmtCache();
+    void setError(const std::string& text);
+    INT32 serverError(const std::string& packet);
+
+    bool writePacket(const char* pData, size_t nLen);
+    bool readPacket(std::string& out);
+    // Appends the next packet's payload to out.
+    bool appendPacket(std::string& out);
+    bool sendAll(const char* pData, size_t nLen);
+    bool recvAll(char* pData, size_t nLen);
+
+    MySQLConfig m_config;
+    Socket m_sock;
+    UINT8 m_seq;
+    UINT32 m_caps;
+    UINT32 m_epoch;             // bumped by every connect; stale statement ids
+    std::string m_lastError;
+    SDDBStatsTable* m_stats;
+    const CHAR* m_context;
+    StmtList m_stmts;
+    std::unordered_map<std::string, StmtList::iterator> m_stmtIndex;
+};
+
+} // namespace SSCP
+
+#endif
@@ -0,0 +1,465 @@
+#include "sddb_session.h"
+#include "sddb_internal.h"
+
+#include <algorithm>
+#include <chrono>
+#include <memory>
+
+namespace SSCP {
+
+namespace {
+
+// Workers above coreSize that see no work for this long are retired.
+const std::chrono::seconds WORKER_IDLE_TIMEOUT(60);
+
+// Points per worker on the group ring; enough to keep the split even for
+// small pools.
+const UINT32 RING_POINTS = 64;
+
+UINT32 mix32(UINT32 h) {
+    h ^= h >> 16;
+    h *= 0x85EBCA6B;
+    h ^= h >> 13;
+    h *= 0xC2B2AE35;
+    h ^= h >> 16;
+    return h;
+}
+
+std::string cstr(const CHAR* psz) {
+    return psz ? std::string(psz) : std::string();
+}
+
+} // namespace
+
+MySQLSession::MySQLSession(const MySQLConfig& config, UINT32 dwCoreSize, UINT32 dwMaxSize,
+                           const MySQLBatchOptions& batch)
+    : m_config(config), m_dbEpoch(0),
+      m_coreSize(dwCoreSize ? dwCoreSize : 1),
+      m_maxSize(dwMaxSize > m_coreSize ? dwMaxSize : m_coreSize),
+      m_batchOpt(batch), m_queued(0), m_waitingCmds(0), m_runningCmds(0), m_live(0), m_stop(false),
+      m_sync(config) {
+    m_sync.setStats(&m_stats);
+}
+
+MySQLSession::~MySQLSession() {
+    {
+        std::lock_guard<std::mutex> lk(m_mutex);
+        flushDueBatchesLocked(true);
+        m_stop = true;
+        for (Worker& w : m_workers) w.cv.notify_one();
+    }
+    for (Worker& w : m_workers) {
+        if (w.thread.joinable()) w.thread.join();
+    }
+    // Nothing is left to run these once every worker is gone.
+    auto drop = [](const Job& job) {
+        if (!job.batch) {
+            job.cmd->Release();
+            return;
+        }
+        for (ISSDBBatchCommand* cmd : job.batch->cmds) cmd->Release();
+        delete job.batch;
+    };
+    for (const Job& job : m_ready) drop(job);
+    for (Worker& w : m_workers) {
+        for (const Job& job : w.queue) drop(job);
+    }
+    for (const Done& done : m_completed) done.cmd->Release();
+}
+
+bool MySQLSession::start() {
+    std::lock_guard<std::mutex> lk(m_mutex);
+    for (UINT32 i = 0; i < m_coreSize; ++i) {
+        MySQLConnection* conn = new MySQLConnection(m_config);
+        if (!conn->connect()) {
+            delete conn;
+            continue;
+        }
+        spawnLocked(conn);
+    }
+    if (!m_live) {
+        SDDBLog(LOGLV_CRITICAL, "SSDB session to " + m_config.host + " has no usable connection");
+        return false;
+    }
+    return true;
+}
+
+UINT32 MySQLSession::workerCount() {
+    std::lock_guard<std::mutex> lk(m_mutex);
+    return m_live;
+}
+
+//
+// Asynchronous commands
+//
+
+bool SSAPI MySQLSession::AddDBCommand(ISSDBCommand* poDBCommand) {
+    return enqueue(poDBCommand, false);
+}
+
+bool SSAPI MySQLSession::QuickAddDBCommand(ISSDBCommand* poDBCommand) {
+    return enqueue(poDBCommand, true);
+}
+
+bool MySQLSession::enqueue(ISSDBCommand* poDBCommand, bool bFront) {
+    if (!poDBCommand) return false;
+    // Quick commands jump the queue and give up ordering.
+    INT32 group = bFront ? -1 : poDBCommand->GetGroupId();
+    ISSDBBatchCommand* batchCmd = dynamic_cast<ISSDBBatchCommand*>(poDBCommand);
+    std::string head, row, tail;
+    if (batchCmd) {
+        head = cstr(batchCmd->GetBatchHead());
+        row = cstr(batchCmd->GetBatchRow());
+        tail = cstr(batchCmd->GetBatchTail());
+    }
+    Clock::time_point now = Clock::now();
+    std::lock_guard<std::mutex> lk(m_mutex);
+    if (m_stop) return false;
+    ++m_waitingCmds;
+    if (batchCmd && !bFront && group < 0) {
+        addBatchLocked(batchCmd, head, row, tail, now);
+        return true;
+    }
+    // Grouped or quick batch commands run alone, as a batch of one.
+    Batch* single = nullptr;
+    if (batchCmd) {
+        single = new Batch;
+        single->head = head;
+        single->tail = tail;
+        single->rows = row;
+        single->ends.push_back(row.size());
+        single->cmds.push_back(batchCmd);
+        single->enqueued.push_back(now);
+    }
+    Worker* owner = nullptr;
+    if (group >= 0) {
+        auto it = m_groups.find(group);
+        if (it != m_groups.end()) {
+            owner = it->second.owner;
+            ++it->second.pending;
+        } else if ((owner = ringOwnerLocked(group)) != nullptr) {
+            m_groups.emplace(group, Group{owner, 1});
+        }
+    }
+    ++m_queued;
+    if (owner) {
+        owner->queue.push_back(Job{poDBCommand, group, single, now});
+        auto idle = std::find(m_idle.begin(), m_idle.end(), owner);
+        if (idle != m_idle.end()) m_idle.erase(idle);
+        owner->cv.notify_one();
+    } else {
+        if (bFront) m_ready.push_front(Job{poDBCommand, -1, single, now});
+        else m_ready.push_back(Job{poDBCommand, -1, single, now});
+        wakeOneLocked();
+    }
+    growLocked();
+    return true;
+}
+
+void MySQLSession::wakeOneLocked() {
+    if (m_idle.empty()) return;
+    Worker* w = m_idle.back();
+    m_idle.pop_back();
+    w->cv.notify_one();
+}
+
+void MySQLSession::addBatchLocked(ISSDBBatchCommand* poCmd, const std::string& head, const std::string& row,
+                                  const std::string& tail, Clock::time_point now) {
+    std::string key = head;
+    key.push_back('\0');
+    key += tail;
+    Batch*& b = m_batches[key];
+    if (!b) {
+        b = new Batch;
+        b->head = head;
+        b->tail = tail;
+        b->due = now + std::chrono::milliseconds(m_batchOpt.intervalMs);
+    }
+    b->rows += row;
+    b->ends.push_back(b->rows.size());
+    b->cmds.push_back(poCmd);
+    b->enqueued.push_back(now);
+    if (b->cmds.size() >= m_batchOpt.maxRows || b->rows.size() >= m_batchOpt.maxBytes) {
+        flushBatchLocked(b);
+        m_batches.erase(key);
+    }
+}
+
+void MySQLSession::flushBatchLocked(Batch* poBatch) {
+    m_ready.push_back(Job{nullptr, -1, poBatch, Clock::time_point()});
+    ++m_queued;
+    wakeOneLocked();
+    growLocked();
+}
+
+void MySQLSession::flushDueBatchesLocked(bool bAll) {
+    if (m_batches.empty()) return;
+    auto now = Clock::now();
+    for (auto it = m_batches.begin(); it != m_batches.end();) {
+        if (bAll || it->second->due <= now) {
+            flushBatchLocked(it->second);
+            it = m_batches.erase(it);
+        } else {
+            ++it;
+        }
+    }
+}
+
+void MySQLSession::growLocked() {
+    if (m_queued <= m_idle.size() || m_live >= m_maxSize) return;
+    // Reap retired workers before adding a new one.
+    for (auto it = m_workers.begin(); it != m_workers.end();) {
+        if (it->done) {
+            it->thread.join();
+            it = m_workers.erase(it);
+        } else {
+            ++it;
+        }
+    }
+    spawnLocked(new MySQLConnection(m_config));
+}
+
+void MySQLSession::spawnLocked(MySQLConnection* poConn) {
+    m_workers.emplace_back();
+    Worker* w = &m_workers.back();
+    // The lowest free slot, so a pool that shrinks and grows back maps
+    // groups to the same ring points again.
+    auto free = std::find(m_slots.begin(), m_slots.end(), false);
+    w->slot = static_cast<UINT32>(free - m_slots.begin());
+    if (free == m_slots.end()) m_slots.push_back(true);
+    else *free = true;
+    ++m_live;
+    // Connected workers take groups at once; new ones after connecting.
+    if (poConn->connected()) joinRingLocked(w);
+    poConn->setStats(&m_stats);
+    w->thread = std::thread(&MySQLSession::workerMain, this, w, poConn, m_dbEpoch);
+}
+
+void MySQLSession::joinRingLocked(Worker* poWorker) {
+    for (UINT32 i = 0; i < RING_POINTS; ++i) {
+        m_ring.emplace_back(mix32(poWorker->slot * RING_POINTS + i), poWorker);
+    }
+    std::sort(m_ring.begin(), m_ring.end(),
+              [](const std::pair<UINT32, Worker*>& a, const std::pair<UINT32, Worker*>& b) { return a.first < b.first; });
+}
+
+void MySQLSession::leaveRingLocked(Worker* poWorker) {
+    m_ring.erase(std::remove_if(m_ring.begin(), m_ring.end(),
+                                [poWorker](const std::pair<UINT32, Worker*>& p) { return p.second == poWorker; }),
+                 m_ring.end());
+}
+
+MySQLSession::Worker* MySQLSession::ringOwnerLocked(INT32 nGroup) const {
+    if (m_ring.empty()) return nullptr;
+    UINT32 point = mix32(static_cast<UINT32>(nGroup) ^ 0x9E3779B9);
+    auto it = std::lower_bound(m_ring.begin(), m_ring.end(), point,
+                               [](const std::pair<UINT32, Worker*>& p, UINT32 v) { return p.first < v; });
+    return it == m_ring.end() ? m_ring.front().second : it->second;
+}
+
+void MySQLSession::workerMain(Worker* poWorker, MySQLConnection* poConn, UINT32 dwDBEpoch) {
+    std::unique_ptr<MySQLConnection> conn(poConn);
+    bool joined = conn->connected();
+    bool usable = joined || conn->connect();
+    std::unique_lock<std::mutex> lk(m_mutex);
+    if (usable && !joined) joinRingLocked(poWorker);
+    while (usable) {
+        Job job;
+        if (!poWorker->queue.empty()) {
+            job = poWorker->queue.front();
+            poWorker->queue.pop_front();
+        } else if (!m_ready.empty()) {
+            job = m_ready.front();
+            m_ready.pop_front();
+        } else {
+            if (m_stop) break;
+            m_idle.push_back(poWorker);
+            auto wake = [this, poWorker] { return !poWorker->queue.empty() || !m_ready.empty() || m_stop; };
+            bool spare = m_ring.size() / RING_POINTS > m_coreSize;
+            bool woken = true;
+            if (spare) woken = poWorker->cv.wait_for(lk, WORKER_IDLE_TIMEOUT, wake);
+            else poWorker->cv.wait(lk, wake);
+            auto idle = std::find(m_idle.begin(), m_idle.end(), poWorker);
+            if (idle != m_idle.end()) m_idle.erase(idle);
+            // An empty queue means no group is left on this worker.
+            if (!woken && m_ring.size() / RING_POINTS > m_coreSize) {
+                leaveRingLocked(poWorker);
+                break;
+            }
+            continue;
+        }
+        --m_queued;
+        UINT32 cmds = job.batch ? static_cast<UINT32>(job.batch->cmds.size()) : 1;
+        m_waitingCmds -= cmds;
+        m_runningCmds += cmds;
+        std::string database;
+        if (dwDBEpoch != m_dbEpoch) {
+            dwDBEpoch = m_dbEpoch;
+            database = m_config.database;
+        }
+        lk.unlock();
+        if (!database.empty()) conn->SelectDB(database.c_str());
+        Clock::time_point started = Clock::now();
+        conn->setContext(SDDBCommandName(job.batch ? job.batch->cmds.front() : job.cmd));
+        if (job.batch) runBatch(conn.get(), *job.batch);
+        else job.cmd->OnExecuteSql(conn.get());
+        conn->setContext(nullptr);
+        Clock::time_point finished = Clock::now();
+        lk.lock();
+        m_runningCmds -= cmds;
+        if (job.batch) {
+            for (size_t i = 0; i < job.batch->cmds.size(); ++i) {
+                m_completed.push_back(Done{job.batch->cmds[i], {job.batch->enqueued[i], started, finished}});
+            }
+            delete job.batch;
+        } else {
+            m_completed.push_back(Done{job.cmd, {job.enqueued, started, finished}});
+        }
+        if (job.group >= 0) {
+            auto it = m_groups.find(job.group);
+            if (--it->second.pending == 0) m_groups.erase(it);
+        }
+    }
+    m_slots[poWorker->slot] = false;
+    --m_live;
+    poWorker->done = true;
+}
+
+void MySQLSession::runBatch(MySQLConnection* poConn, Batch& oBatch) {
+    size_t n = oBatch.cmds.size();
+    auto row = [&oBatch](size_t i) {
+        size_t begin = i ? oBatch.ends[i - 1] : 0;
+        return oBatch.rows.substr(begin, oBatch.ends[i] - begin);
+    };
+    if (n > 1) {
+        std::string sql;
+        sql.reserve(oBatch.head.size() + oBatch.rows.size() + oBatch.tail.size() + 2 * n + 32);
+        if (!oBatch.head.empty()) {
+            sql = oBatch.head;
+            for (size_t i = 0; i < n; ++i) {
+                if (i) sql += ',';
+                sql += row(i);
+            }
+            sql += oBatch.tail;
+            INT32 ret = poConn->ExecuteSql(sql.c_str());
+            if (ret >= 0 || ret == SDDB_ERR_CONN) {
+                for (ISSDBBatchCommand* cmd : oBatch.cmds) cmd->OnBatchResult(ret);
+                return;
+            }
+        } else {
+            sql = "START TRANSACTION";
+            for (size_t i = 0; i < n; ++i) {
+                sql += ';';
+                sql += row(i);
+            }
+            sql += ";COMMIT";
+            std::vector<INT32> results;
+            INT32 ret = poConn->executeMulti(sql, results);
+            if (ret == SDDB_SUCCESS && results.size() == n + 2) {
+                for (size_t i = 0; i < n; ++i) oBatch.cmds[i]->OnBatchResult(results[i + 1]);
+                return;
+            }
+            if (ret == SDDB_ERR_CONN) {
+                for (ISSDBBatchCommand* cmd : oBatch.cmds) cmd->OnBatchResult(ret);
+                return;
+            }
+            poConn->ExecuteSql("ROLLBACK");
+        }
+        SDDBLog(LOGLV_WARN, "SSDB batch of " + std::to_string(n) + " failed (" + poConn->lastError() +
+                                "), running its commands one by one");
+    }
+    for (size_t i = 0; i < n; ++i) {
+        std::string sql = oBatch.head.empty() ? row(i) : oBatch.head + row(i) + oBatch.tail;
+        oBatch.cmds[i]->OnBatchResult(poConn->ExecuteSql(sql.c_str()));
+    }
+}
+
+bool SSAPI MySQLSession::Run(INT32 nCount) {
+    std::deque<Done> batch;
+    {
+        std::lock_guard<std::mutex> lk(m_mutex);
+        flushDueBatchesLocked(m_batchOpt.intervalMs == 0);
+        if (nCount < 0 || static_cast<size_t>(nCount) >= m_completed.size()) {
+            batch.swap(m_completed);
+        } else {
+            batch.assign(m_completed.begin(), m_completed.begin() + nCount);
+            m_completed.erase(m_completed.begin(), m_completed.begin() + nCount);
+        }
+    }
+    for (const Done& done : batch) {
+        m_stats.record(done.cmd, done.timing, Clock::now());
+        done.cmd->OnExecuted();
+        done.cmd->Release();
+    }
+    return nCount < 0 || batch.size() >= static_cast<size_t>(nCount);
+}
+
+UINT32 SSAPI MySQLSession::GetDBCommandCount() {
+    std::lock_guard<std::mutex> lk(m_mutex);
+    return static_cast<UINT32>(m_completed.size());
+}
+
+bool SSAPI MySQLSession::GetStats(SDDBSessionStats* pstStats) {
+    if (!pstStats) return false;
+    {
+        std::lock_guard<std::mutex> lk(m_mutex);
+        pstStats->m_dwQueued = m_waitingCmds;
+        pstStats->m_dwRunning = m_runningCmds;
+        pstStats->m_dwCompleted = static_cast<UINT32>(m_completed.size());
+        pstStats->m_dwConnections = m_live;
+        pstStats->m_dwIdleConnections = static_cast<UINT32>(m_idle.size());
+    }
+    pstStats->m_qwSlowQueries = m_stats.slowQueries();
+    m_stats.total(pstStats->m_stTotal);
+    return true;
+}
+
+UINT32 SSAPI MySQLSession::GetCommandStats(SDDBCommandStats* pstStats, UINT32 dwCount) {
+    return m_stats.byType(pstStats, dwCount);
+}
+
+//
+// Synchronous calls
+//
+
+MySQLConnection* MySQLSession::syncConnection(INT32 nTimeoutMs) {
+    if (!m_sync.connected() && !m_sync.connect()) return nullptr;
+    m_sync.setTimeout(nTimeoutMs);
+    return &m_sync;
+}
+
+UINT32 SSAPI MySQLSession::EscapeString(const CHAR* pSrc, INT32 nSrcSize, CHAR* pDest, INT32 nDstSize, INT32 /*timeout*/) {
+    return SDDBEscapeString(pSrc, nSrcSize, pDest, nDstSize);
+}
+
+INT32 SSAPI MySQLSession::ExecuteSql(const CHAR* pSQL, UINT64* pInsertId, INT32 timeout) {
+    std::lock_guard<std::mutex> lk(m_syncMutex);
+    MySQLConnection* conn = syncConnection(timeout);
+    return conn ? conn->ExecuteSql(pSQL, pInsertId) : SDDB_ERR_CONN;
+}
+
+INT32 SSAPI MySQLSession::ExecuteSqlRs(const CHAR* pSQL, ISSDBRecordSet** ppoRs, INT32 timeout) {
+    std::lock_guard<std::mutex> lk(m_syncMutex);
+    if (ppoRs) *ppoRs = nullptr;
+    MySQLConnection* conn = syncConnection(timeout);
+    return conn ? conn->ExecuteSqlRs(pSQL, ppoRs) : SDDB_ERR_CONN;
+}
+
+bool SSAPI MySQLSession::CreateDB(const CHAR* pcDBName, bool bForce, const CHAR* pcCharSet, INT32 timeout) {
+    std::lock_guard<std::mutex> lk(m_syncMutex);
+    MySQLConnection* conn = syncConnection(timeout);
+    return conn && conn->CreateDB(pcDBName, bForce, pcCharSet);
+}
+
+bool SSAPI MySQLSession::SelectDB(const CHAR* pcDBName, INT32 timeout) {
+    std::lock_guard<std::mutex> lk(m_syncMutex);
+    MySQLConnection* conn = syncConnection(timeout);
+    if (!conn || !conn->SelectDB(pcDBName)) return false;
+    // Worker connections switch before their next command.
+    std::lock_guard<std::mutex> poolLk(m_mutex);
+    m_config.database = pcDBName;
+    ++m_dbEpoch;
+    return true;
+}
+
+} // namespace SSCP
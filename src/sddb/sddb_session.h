@@ -0,0 +1,160 @@
+// Asynchronous ISSDBSession backed by a pool of MySQL worker connections.
+//
+// Every worker thread owns one MySQLConnection. AddDBCommand queues a command
+// and returns; a worker runs OnExecuteSql on its connection and moves the
+// command to the completed queue, which Run() drains on the caller's thread
+// (OnExecuted, then Release).
+//
+// Commands of the same group (GetGroupId() >= 0) all run on one worker, in
+// insertion order, so different groups proceed in parallel. A group is placed
+// on a consistent-hash ring of the connected workers and keeps its worker for
+// as long as it has commands outstanding; when the pool grows or shrinks only
+// the groups whose ring segment moved change worker, and only once idle.
+// Ungrouped commands go to a shared queue that any worker takes from.
+//
+// Ungrouped ISSDBBatchCommands are held in open batches keyed by their
+// statement head and tail. Run() flushes batches older than the batch
+// interval, and a batch that reaches maxRows or maxBytes is flushed at once;
+// a flushed batch is one job that a worker runs as a single multi-row
+// statement, or as one multi-statement transaction when the head is empty.
+//
+// The pool starts coreSize connections, adds workers up to maxSize while
+// commands are waiting and no worker is idle, and retires workers above
+// coreSize after they have been idle for a while. The synchronous methods use
+// a separate connection of their own; a successful SelectDB there is applied
+// to each worker connection before its next command.
+//
+// Every command is stamped when added, started and finished, and Run()
+// records the stamps in m_stats as it delivers the command.
+#ifndef SSCP_SDDB_SESSION_H
+#define SSCP_SDDB_SESSION_H
+
+#include "sddb_mysql.h"
+
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <list>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+namespace SSCP {
+
+struct MySQLBatchOptions {
+    UINT32 intervalMs = 10;       // 0 flushes open batches on every Run
+    UINT32 maxRows = 256;
+    UINT32 maxBytes = 1 << 20;    // of row text, well under max_allowed_packet
+};
+
+class MySQLSession : public ISSDBSession {
+public:
+    MySQLSession(const MySQLConfig& config, UINT32 dwCoreSize, UINT32 dwMaxSize,
+                 const MySQLBatchOptions& batch = MySQLBatchOptions());
+    // Runs every queued command, then releases completed commands whose
+    // OnExecuted was never called.
+    ~MySQLSession() override;
+
+    // Opens the core connections; false when none of them could connect.
+    bool start();
+
+    UINT32 SSAPI EscapeString(const CHAR* pSrc, INT32 nSrcSize, CHAR* pDest, INT32 nDstSize, INT32 timeout = -1) override;
+    INT32 SSAPI ExecuteSql(const CHAR* pSQL, UINT64* pInsertId = NULL, INT32 timeout = -1) override;
+    INT32 SSAPI ExecuteSqlRs(const CHAR* pSQL, ISSDBRecordSet** ppoRs, INT32 timeout = -1) override;
+    bool SSAPI CreateDB(const CHAR* pcDBName, bool bForce, const CHAR* pcCharSet, INT32 timeout = -1) override;
+    bool SSAPI SelectDB(const CHAR* pcDBName, INT32 timeout = -1) override;
+    bool SSAPI AddDBCommand(ISSDBCommand* poDBCommand) override;
+    bool SSAPI QuickAddDBCommand(ISSDBCommand* poDBCommand) override;
+    bool SSAPI Run(INT32 nCount = -1) override;
+    UINT32 SSAPI GetDBCommandCount() override;
+    bool SSAPI GetStats(SDDBSessionStats* pstStats) override;
+    UINT32 SSAPI GetCommandStats(SDDBCommandStats* pstStats, UINT32 dwCount) override;
+    void SSAPI SetSlowQueryTime(UINT32 dwMilliseconds) override { m_stats.setSlowMs(dwMilliseconds); }
+
+    // Number of live worker connections, for tests and diagnostics.
+    UINT32 workerCount();
+
+private:
+    typedef SDDBStatsTable::Clock Clock;
+    struct Batch {
+        std::string head;
+        std::string tail;
+        std::string rows;               // row texts back to back
+        std::vector<size_t> ends;       // end offset of each row in rows
+        std::vector<ISSDBBatchCommand*> cmds;
+        std::vector<Clock::time_point> enqueued;   // per command
+        Clock::time_point due;
+    };
+    struct Job {
+        ISSDBCommand* cmd;
+        INT32 group;            // -1 when the command is not ordered
+        Batch* batch = nullptr; // set instead of cmd for batch commands
+        Clock::time_point enqueued;
+    };
+    struct Done {
+        ISSDBCommand* cmd;
+        SDDBStatsTable::Timing timing;
+    };
+    struct Worker {
+        std::thread thread;
+        UINT32 slot = 0;            // fixes the worker's points on the ring
+        bool done = false;
+        std::deque<Job> queue;      // commands of the groups it owns
+        std::condition_variable cv;
+    };
+    struct Group {
+        Worker* owner;
+        UINT32 pending;             // queued or running commands
+    };
+
+    bool enqueue(ISSDBCommand* poDBCommand, bool bFront);
+    // The following are called with m_mutex held.
+    void growLocked();
+    void spawnLocked(MySQLConnection* poConn);
+    void joinRingLocked(Worker* poWorker);
+    void leaveRingLocked(Worker* poWorker);
+    Worker* ringOwnerLocked(INT32 nGroup) const;
+    void wakeOneLocked();
+    void addBatchLocked(ISSDBBatchCommand* poCmd, const std::string& head, const std::string& row,
+                        const std::string& tail, Clock::time_point now);
+    void flushBatchLocked(Batch* poBatch);
+    void flushDueBatchesLocked(bool bAll);
+    void workerMain(Worker* poWorker, MySQLConnection* poConn, UINT32 dwDBEpoch);
+    // Runs a flushed batch on a worker and reports each command's result;
+    // falls back to one statement per command when the combined one fails.
+    static void runBatch(MySQLConnection* poConn, Batch& oBatch);
+    MySQLConnection* syncConnection(INT32 nTimeoutMs);
+
+    MySQLConfig m_config;       // guarded by m_mutex once workers run
+    UINT32 m_dbEpoch;           // bumped by SelectDB; workers follow it
+    UINT32 m_coreSize;
+    UINT32 m_maxSize;
+    MySQLBatchOptions m_batchOpt;
+
+    std::mutex m_mutex;
+    std::deque<Job> m_ready;    // ungrouped commands
+    std::unordered_map<INT32, Group> m_groups;
+    std::unordered_map<std::string, Batch*> m_batches;   // open, by head and tail
+    std::deque<Done> m_completed;
+    std::list<Worker> m_workers;
+    std::vector<std::pair<UINT32, Worker*>> m_ring;   // sorted by point
+    std::vector<bool> m_slots;
+    std::vector<Worker*> m_idle;
+    UINT32 m_queued;            // jobs not yet picked up by a worker
+    UINT32 m_waitingCmds;       // commands in those jobs and in open batches
+    UINT32 m_runningCmds;
+    UINT32 m_live;
+    bool m_stop;
+
+    SDDBStatsTable m_stats;
+
+    std::mutex m_syncMutex;
+    MySQLConnection m_sync;
+};
+
+} // namespace SSCP
+
+#endif
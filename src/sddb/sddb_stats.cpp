@@ -0,0 +1,93 @@
+#include "sddb_stats.h"
+#include "sddb_internal.h"
+
+#include <algorithm>
+#include <cstring>
+#include <typeinfo>
+
+namespace SSCP {
+
+namespace {
+
+// Longest statement text written to the slow-query log.
+const size_t SLOW_SQL_MAX = 1024;
+
+UINT64 micros(SDDBStatsTable::Clock::duration d) {
+    auto us = std::chrono::duration_cast<std::chrono::microseconds>(d).count();
+    return us > 0 ? static_cast<UINT64>(us) : 0;
+}
+
+void add(SDDBLatency& lat, UINT64 qwUs) {
+    UINT32 bucket = 0;
+    for (UINT64 v = qwUs; v && bucket < SDDB_LATENCY_BUCKETS - 1; v >>= 1) ++bucket;
+    ++lat.m_aqwBuckets[bucket];
+    ++lat.m_qwCount;
+    lat.m_qwTotalUs += qwUs;
+    lat.m_qwMaxUs = std::max(lat.m_qwMaxUs, qwUs);
+}
+
+void add(SDDBCommandStats& s, UINT64 qwQueue, UINT64 qwExec, UINT64 qwDeliver, UINT64 qwTotal, bool bSlow) {
+    ++s.m_qwCommands;
+    if (bSlow) ++s.m_qwSlow;
+    add(s.m_stQueue, qwQueue);
+    add(s.m_stExecute, qwExec);
+    add(s.m_stDeliver, qwDeliver);
+    add(s.m_stTotal, qwTotal);
+}
+
+} // namespace
+
+const CHAR* SDDBCommandName(ISSDBCommand* poCmd) {
+    const CHAR* name = poCmd->GetCommandName();
+    return name && *name ? name : typeid(*poCmd).name();
+}
+
+SDDBStatsTable::SDDBStatsTable() : m_slowMs(0), m_slowQueries(0) {
+    std::memset(&m_total, 0, sizeof(m_total));
+}
+
+void SDDBStatsTable::record(ISSDBCommand* poCmd, const Timing& oTiming, Clock::time_point delivered) {
+    UINT64 queue = micros(oTiming.started - oTiming.enqueued);
+    UINT64 exec = micros(oTiming.finished - oTiming.started);
+    UINT64 deliver = micros(delivered - oTiming.finished);
+    UINT64 total = micros(delivered - oTiming.enqueued);
+    UINT32 slow = slowMs();
+    bool isSlow = slow && exec >= UINT64(slow) * 1000;
+    const CHAR* name = SDDBCommandName(poCmd);
+    std::lock_guard<std::mutex> lk(m_mutex);
+    add(m_total, queue, exec, deliver, total, isSlow);
+    auto it = m_types.find(name);
+    if (it == m_types.end()) {
+        SDDBCommandStats s;
+        std::memset(&s, 0, sizeof(s));
+        std::strncpy(s.m_szName, name, sizeof(s.m_szName) - 1);
+        it = m_types.emplace(name, s).first;
+    }
+    add(it->second, queue, exec, deliver, total, isSlow);
+}
+
+void SDDBStatsTable::total(SDDBCommandStats& out) {
+    std::lock_guard<std::mutex> lk(m_mutex);
+    out = m_total;
+}
+
+UINT32 SDDBStatsTable::byType(SDDBCommandStats* pstStats, UINT32 dwCount) {
+    std::lock_guard<std::mutex> lk(m_mutex);
+    if (pstStats) {
+        UINT32 i = 0;
+        for (auto it = m_types.begin(); it != m_types.end() && i < dwCount; ++it) pstStats[i++] = it->second;
+    }
+    return static_cast<UINT32>(m_types.size());
+}
+
+void SDDBStatsTable::slowStatement(UINT64 qwMs, const CHAR* pszContext, const char* pSQL, size_t nLen) {
+    m_slowQueries.fetch_add(1, std::memory_order_relaxed);
+    std::string text = "SSDB slow query (" + std::to_string(qwMs) + " ms";
+    if (pszContext) text += std::string(", ") + pszContext;
+    text += "): ";
+    text.append(pSQL, std::min(nLen, SLOW_SQL_MAX));
+    if (nLen > SLOW_SQL_MAX) text += "...";
+    SDDBLog(LOGLV_WARN, text);
+}
+
+} // namespace SSCP
@@ -0,0 +1,60 @@
+// Command timing for ISSDBSession::GetStats and GetCommandStats.
+//
+// A session stamps each command when it is added, when a worker starts it
+// and when it finishes; Run() hands the stamps to record() as it delivers the
+// command, which folds the queue, execute, deliver and total times into
+// log2 histograms for the session and for the command's type. Snapshots may
+// be taken from any thread.
+//
+// The table also holds the slow-query threshold: connections time their
+// statements against it and report the slow ones, which are counted and
+// logged with the SQL text.
+#ifndef SSCP_SDDB_STATS_H
+#define SSCP_SDDB_STATS_H
+
+#include "ssengine/sddb.h"
+
+#include <atomic>
+#include <chrono>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+
+namespace SSCP {
+
+// GetCommandName(), or the C++ type name when the command has none.
+const CHAR* SDDBCommandName(ISSDBCommand* poCmd);
+
+class SDDBStatsTable {
+public:
+    typedef std::chrono::steady_clock Clock;
+    struct Timing {
+        Clock::time_point enqueued;
+        Clock::time_point started;
+        Clock::time_point finished;
+    };
+
+    SDDBStatsTable();
+
+    void record(ISSDBCommand* poCmd, const Timing& oTiming, Clock::time_point delivered);
+    void total(SDDBCommandStats& out);
+    UINT32 byType(SDDBCommandStats* pstStats, UINT32 dwCount);
+
+    UINT32 slowMs() const { return m_slowMs.load(std::memory_order_relaxed); }
+    void setSlowMs(UINT32 dwMs) { m_slowMs.store(dwMs, std::memory_order_relaxed); }
+    UINT64 slowQueries() const { return m_slowQueries.load(std::memory_order_relaxed); }
+    // Counts and logs one statement that reached the threshold; pszContext
+    // names the command it ran for, if any.
+    void slowStatement(UINT64 qwMs, const CHAR* pszContext, const char* pSQL, size_t nLen);
+
+private:
+    std::mutex m_mutex;
+    SDDBCommandStats m_total;
+    std::unordered_map<std::string, SDDBCommandStats> m_types;
+    std::atomic<UINT32> m_slowMs;
+    std::atomic<UINT64> m_slowQueries;
+};
+
+} // namespace SSCP
+
+#endif
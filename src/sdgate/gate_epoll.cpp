@@ -0,0 +1,1257 @@
+// Reactor implementation of ISSGate.
+//
+// One epoll set per gate holds the listeners, every client socket and the
+// links to the backend servers. ISSGate::Run polls it without blocking and
+// dispatches ready sockets on the caller's thread, so every callback arrives
+// on the thread that drives Run, as with ISSNet. Received packets are handed
+// to sessions straight out of the socket's receive buffer, and SendClientData
+// gathers the link head and the caller's buffer into one sendmsg, so the
+// client -> server path only copies the payload when the link is congested.
+#if defined(__linux__)
+
+#include "gate_internal.h"
+#include "ssengine/sdlogger.h"
+#include "ssengine/sdnetopt.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstring>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+#include <arpa/inet.h>
+#include <errno.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/epoll.h>
+#include <sys/socket.h>
+#include <sys/uio.h>
+#include <unistd.h>
+
+namespace SSCP {
+
+namespace {
+
+const UINT32 GATE_CLIENT_RECVBUF = 8 * 1024;
+const UINT32 GATE_CLIENT_SENDBUF = 256 * 1024;
+const UINT32 GATE_LINK_RECVBUF = 256 * 1024;
+const UINT32 GATE_LINK_SENDBUF = 16 * 1024 * 1024;
+const UINT32 GATE_RECONNECT_MS = 1000;
+const UINT32 GATE_DEFAULT_MAX_CLIENT = 65536;
+const int GATE_MAX_EVENTS = 1024;
+
+UINT64 nowMs() {
+    return static_cast<UINT64>(std::chrono::duration_cast<std::chrono::milliseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count());
+}
+
+void putBE64(char* p, UINT64 v) {
+    for (int i = 7; i >= 0; --i) { p[i] = static_cast<char>(v & 0xFF); v >>= 8; }
+}
+
+UINT64 getBE64(const char* p) {
+    UINT64 v = 0;
+    for (int i = 0; i < 8; ++i) v = (v << 8) | static_cast<unsigned char>(p[i]);
+    return v;
+}
+
+bool applySockOpt(int fd, INT32 nType, void* pOpt) {
+    if (fd == -1 || nType != static_cast<INT32>(CONNECTION_OPT_SOCKOPT) || !pOpt) return false;
+    const SConnectionOptSockopt* opt = static_cast<const SConnectionOptSockopt*>(pOpt);
+    return ::setsockopt(fd, opt->nLevel, opt->nOptName, opt->pOptVal, static_cast<socklen_t>(opt->nOptLen)) == 0;
+}
+
+class GateReactor;
+class GateServerConn;
+
+// Flood limits in force, derived from SGateOptClientLimit. Bucket levels are
+// kept in thousandths of a token so that a refill of rate tokens per second
+// is exactly rate units per millisecond.
+struct GateLimit {
+    GateLimit() : pps(0), bps(0), maxPacket(0), kickAfter(0), pktCap(0), byteCap(0) {}
+    UINT32 pps;
+    UINT32 bps;
+    UINT32 maxPacket;
+    UINT32 kickAfter;
+    UINT64 pktCap;
+    UINT64 byteCap;
+};
+
+struct GateBucket {
+    GateBucket() : pkt(0), bytes(0), last(0) {}
+
+    void reset(const GateLimit& lim, UINT64 qwNow) {
+        pkt = lim.pktCap;
+        bytes = lim.byteCap;
+        last = qwNow;
+    }
+
+    bool take(const GateLimit& lim, UINT64 qwNow, UINT32 dwLen) {
+        if (qwNow > last) {
+            UINT64 dt = std::min<UINT64>(qwNow - last, 1000 * 1000);
+            last = qwNow;
+            pkt = std::min(pkt + dt * lim.pps, lim.pktCap);
+            bytes = std::min(bytes + dt * lim.bps, lim.byteCap);
+        }
+        UINT64 needPkt = lim.pps ? 1000 : 0;
+        UINT64 needBytes = lim.bps ? static_cast<UINT64>(dwLen) * 1000 : 0;
+        if (pkt < needPkt || bytes < needBytes) return false;
+        pkt -= needPkt;
+        bytes -= needBytes;
+        return true;
+    }
+
+    UINT64 pkt;
+    UINT64 bytes;
+    UINT64 last;
+};
+
+// Anything registered in the epoll set; epoll_event.data.ptr points here.
+class GateHandler {
+public:
+    virtual ~GateHandler() {}
+    virtual void onEvent(UINT32 dwEvents) = 0;
+};
+
+// Non-blocking socket with a flat receive buffer and a send queue that only
+// fills up when the kernel buffer is full.
+class GateStream {
+public:
+    GateStream() : m_fd(-1), m_inLen(0), m_outPos(0), m_maxOut(0), m_watchOut(false) {}
+    ~GateStream() { closeFd(); }
+
+    void attach(int fd, UINT32 dwRecvBuf, UINT32 dwSendBuf) {
+        m_fd = fd;
+        m_in.resize(dwRecvBuf);
+        m_inLen = 0;
+        m_out.clear();
+        m_outPos = 0;
+        m_maxOut = dwSendBuf;
+        m_watchOut = false;
+    }
+    void closeFd() {
+        if (m_fd != -1) { ::close(m_fd); m_fd = -1; }
+        m_inLen = 0;
+        m_out.clear();
+        m_outPos = 0;
+    }
+    void setBufferSize(UINT32 dwRecvBuf, UINT32 dwSendBuf) {
+        if (dwRecvBuf > m_in.size()) m_in.resize(dwRecvBuf);
+        m_maxOut = dwSendBuf;
+    }
+
+    int fd() const { return m_fd; }
+    char* data() { return m_in.data(); }
+    UINT32 size() const { return m_inLen; }
+    UINT32 capacity() const { return static_cast<UINT32>(m_in.size()); }
+    void grow(UINT32 dwCap) { if (dwCap > m_in.size()) m_in.resize(dwCap); }
+    void consume(UINT32 dwLen) {
+        if (dwLen == 0) return;
+        m_inLen -= dwLen;
+        if (m_inLen) std::memmove(m_in.data(), m_in.data() + dwLen, m_inLen);
+    }
+
+    // Reads into the free tail of the receive buffer. Returns the number of
+    // bytes read, 0 when nothing was available or the buffer is full, and -1
+    // when the peer closed (nSysErr 0) or the socket failed.
+    int fill(int& nSysErr) {
+        if (m_inLen == m_in.size()) return 0;
+        ssize_t n = ::recv(m_fd, m_in.data() + m_inLen, m_in.size() - m_inLen, 0);
+        if (n > 0) { m_inLen += static_cast<UINT32>(n); return static_cast<int>(n); }
+        if (n == 0) { nSysErr = 0; return -1; }
+        if (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR) return 0;
+        nSysErr = errno;
+        return -1;
+    }
+
+    // Sends the gathered buffers, queueing whatever the kernel does not take.
+    // Returns false when the socket failed or the queue would outgrow the
+    // send buffer size.
+    bool send(const iovec* iov, int nCount, int& nSysErr) {
+        size_t total = 0;
+        for (int i = 0; i < nCount; ++i) total += iov[i].iov_len;
+        size_t sent = 0;
+        if (!pending()) {
+            msghdr msg;
+            std::memset(&msg, 0, sizeof(msg));
+            msg.msg_iov = const_cast<iovec*>(iov);
+            msg.msg_iovlen = static_cast<size_t>(nCount);
+            ssize_t n = ::sendmsg(m_fd, &msg, MSG_NOSIGNAL);
+            if (n < 0) {
+                if (errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR) { nSysErr = errno; return false; }
+                n = 0;
+            }
+            sent = static_cast<size_t>(n);
+            if (sent == total) return true;
+        }
+        if (m_out.size() - m_outPos + (total - sent) > m_maxOut) { nSysErr = 0; return false; }
+        for (int i = 0; i < nCount; ++i) {
+            const char* p = static_cast<const char*>(iov[i].iov_base);
+            size_t len = iov[i].iov_len;
+            if (sent >= len) { sent -= len; continue; }
+            m_out.insert(m_out.end(), p + sent, p + len);
+            sent = 0;
+        }
+        return true;
+    }
+
+    // Writes queued bytes; returns false when the socket failed.
+    bool flush(int& nSysErr) {
+        while (pending()) {
+            ssize_t n = ::send(m_fd, m_out.data() + m_outPos, m_out.size() - m_outPos, MSG_NOSIGNAL);
+            if (n > 0) { m_outPos += static_cast<size_t>(n); continue; }
+            if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR)) break;
+            nSysErr = n < 0 ? errno : 0;
+            return false;
+        }
+        if (!pending()) {
+            m_out.clear();
+            m_outPos = 0;
+        } else if (m_outPos > m_out.size() / 2) {
+            m_out.erase(m_out.begin(), m_out.begin() + static_cast<std::ptrdiff_t>(m_outPos));
+            m_outPos = 0;
+        }
+        return true;
+    }
+
+    bool pending() const { return m_outPos < m_out.size(); }
+    bool& watchOut() { return m_watchOut; }
+
+private:
+    int m_fd;
+    std::vector<char> m_in;
+    UINT32 m_inLen;
+    std::vector<char> m_out;
+    size_t m_outPos;
+    UINT32 m_maxOut;
+    bool m_watchOut;
+};
+
+class GateClient : public GateHandler, public ISSClientConnection {
+public:
+    GateClient(GateReactor& gate, int fd, const sockaddr_in& remote, const sockaddr_in& local);
+
+    ISSClientSession* SSAPI GetSession(void) override { return m_session; }
+    bool SSAPI Send(const char* pData, UINT32 nLen) override;
+    void SSAPI Close(void) override;
+    UINT32 SSAPI GetRemoteIP(void) override { return m_remoteIP; }
+    const char* SSAPI GetRemoteIPStr(void) override { return m_remoteIPStr; }
+    UINT16 SSAPI GetRemotePort(void) override { return m_remotePort; }
+    UINT32 SSAPI GetLocalIP(void) override { return m_localIP; }
+    const char* SSAPI GetLocalIPStr(void) override { return m_localIPStr; }
+    UINT16 SSAPI GetLocalPort(void) override { return m_localPort; }
+    bool SSAPI SetOpt(INT32 nType, void* pOpt) override { return applySockOpt(m_stream.fd(), nType, pOpt); }
+
+    void onEvent(UINT32 dwEvents) override;
+
+    UINT32 id() const { return m_id; }
+    bool closed() const { return m_closed; }
+
+    // Group memberships, mirrored by GateServerConn::m_groups.
+    struct Membership {
+        GateServerConn* link;
+        UINT32 group;
+    };
+    bool member(const GateServerConn* srv, UINT32 dwGroup) const {
+        for (const Membership& m : m_groups) {
+            if (m.link == srv && m.group == dwGroup) return true;
+        }
+        return false;
+    }
+    bool entered(const GateServerConn* srv) const { return member(srv, GATE_GROUP_ENTERED); }
+
+private:
+    friend class GateReactor;
+    friend class GateServerConn;
+    void parse();
+
+    GateReactor& m_gate;
+    UINT32 m_id;
+    ISSClientSession* m_session;
+    GateStream m_stream;
+    bool m_closed;
+    GateBucket m_bucket;
+    UINT32 m_drops;
+    std::vector<Membership> m_groups;
+    UINT32 m_remoteIP;
+    UINT32 m_localIP;
+    UINT16 m_remotePort;
+    UINT16 m_localPort;
+    char m_remoteIPStr[INET_ADDRSTRLEN];
+    char m_localIPStr[INET_ADDRSTRLEN];
+};
+
+class GateServerConn : public GateHandler, public ISSServerConnection {
+public:
+    GateServerConn(GateReactor& gate, ISSServerSession* poSession);
+    ~GateServerConn() override { m_stream.closeFd(); }
+
+    ISSServerSession* SSAPI GetSession(void) override { return m_session; }
+    void SSAPI SetBufferSize(UINT32 dwRecvBufSize, UINT32 dwSendBufSize) override;
+    int SSAPI Connect(const char* pszIP, UINT16 wPort, bool bAutoReconnect) override;
+    void SSAPI Close(void) override;
+    bool SSAPI SendServerData(const char* pData, UINT32 nLen) override;
+    bool SSAPI SendClientData(ISSClientConnection* poClient, const char* pData, UINT32 nLen) override;
+    bool SSAPI Enter(ISSClientConnection* poClient, UINT64 dwTransID) override;
+    bool SSAPI Leave(ISSClientConnection* poClient, UINT64 dwTransID) override;
+    UINT32 SSAPI GetRemoteIP(void) override { return m_remoteIP; }
+    UINT16 SSAPI GetRemotePort(void) override { return m_remotePort; }
+    UINT32 SSAPI GetLocalIP(void) override { return m_localIP; }
+    UINT16 SSAPI GetLocalPort(void) override { return m_localPort; }
+    bool SSAPI SetOpt(INT32 nType, void* pOpt) override { return applySockOpt(m_stream.fd(), nType, pOpt); }
+    void SSAPI Release(void) override;
+
+    void onEvent(UINT32 dwEvents) override;
+
+    // Called by the reactor.
+    void tick(UINT64 qwNow) {
+        if (m_state == IDLE && m_reconnectAt && qwNow >= m_reconnectAt) {
+            m_reconnectAt = 0;
+            startConnect();
+        }
+    }
+    void notifyClientClose(UINT32 dwClientID) {
+        if (m_state == CONNECTED) sendFrame(GATE_LINK_CLIENT_CLOSE, dwClientID, nullptr, 0, nullptr, 0);
+    }
+    bool released() const { return m_released; }
+
+    void join(GateClient* c, UINT32 dwGroup);
+    void leave(GateClient* c, UINT32 dwGroup);
+    // Removes the client from every group of this link.
+    void leaveAll(GateClient* c);
+    // Link is gone: every member forgets its groups here.
+    void clearGroups();
+    // Drops c from one member list without touching c's own memberships.
+    void unlink(GateClient* c, UINT32 dwGroup);
+
+private:
+    enum State { IDLE, CONNECTING, CONNECTED };
+
+    int startConnect();
+    void onConnected();
+    void connectFailed(int nSysErr);
+    void drop(INT32 nSDError, INT32 nSysError);
+    void parse();
+    void dispatch(UINT16 wCmd, UINT16 wErr, UINT32 dwClientID, const char* pBody, UINT32 dwLen);
+    bool sendFrame(UINT16 wCmd, UINT32 dwClientID, const char* p1, UINT32 n1, const char* p2, UINT32 n2);
+    GateClient* liveClient(ISSClientConnection* poClient);
+    void groupCast(UINT32 dwSkipID, const char* pBody, UINT32 dwLen);
+    void multicast(UINT32 dwSkipID, const char* pBody, UINT32 dwLen);
+
+    GateReactor& m_gate;
+    ISSServerSession* m_session;
+    GateStream m_stream;
+    State m_state;
+    bool m_autoReconnect;
+    bool m_released;
+    UINT64 m_reconnectAt;
+    UINT32 m_recvBuf;
+    UINT32 m_sendBuf;
+    std::string m_ip;
+    UINT32 m_remoteIP;
+    UINT32 m_localIP;
+    UINT16 m_remotePort;
+    UINT16 m_localPort;
+    std::unordered_map<UINT32, std::vector<GateClient*>> m_groups;
+};
+
+// Client table: a fixed slot array in the style of CSDIDPool, whose FIFO free
+// list reuses a slot as late as possible, plus a generation per slot that is
+// folded into the wire ID. A lookup is a bounds check and one compare, and a
+// freed ID stops matching for the next 4095 reuses of its slot.
+class GateClientTable {
+public:
+    static const UINT32 INDEX_BITS = 20;
+    static const UINT32 INDEX_MASK = (1u << INDEX_BITS) - 1;
+    static const UINT32 MAX_CAPACITY = INDEX_MASK + 1;
+    static const UINT32 GEN_MAX = 0xFFFu;
+
+    GateClientTable() : m_head(NIL), m_tail(NIL), m_used(0) {}
+
+    // Only valid while the table is empty.
+    bool init(UINT32 dwCapacity) {
+        if (m_used || dwCapacity == 0 || dwCapacity > MAX_CAPACITY) return false;
+        m_slots.assign(dwCapacity, Slot());
+        for (UINT32 i = 0; i < dwCapacity; ++i) {
+            m_slots[i].gen = 1;
+            m_slots[i].next = i + 1 < dwCapacity ? i + 1 : NIL;
+        }
+        m_head = 0;
+        m_tail = dwCapacity - 1;
+        return true;
+    }
+
+    bool ready() const { return !m_slots.empty(); }
+    bool full() const { return m_head == NIL; }
+    UINT32 size() const { return m_used; }
+
+    // Returns the new ID, or 0 when the table is full.
+    UINT32 alloc(GateClient* c) {
+        if (m_head == NIL) return 0;
+        UINT32 idx = m_head;
+        Slot& slot = m_slots[idx];
+        m_head = slot.next;
+        if (m_head == NIL) m_tail = NIL;
+        slot.obj = c;
+        slot.next = NIL;
+        ++m_used;
+        return (slot.gen << INDEX_BITS) | idx;
+    }
+
+    GateClient* find(UINT32 dwID) const {
+        UINT32 idx = dwID & INDEX_MASK;
+        if (idx >= m_slots.size()) return nullptr;
+        const Slot& slot = m_slots[idx];
+        return slot.gen == (dwID >> INDEX_BITS) ? slot.obj : nullptr;
+    }
+
+    void free(UINT32 dwID) {
+        UINT32 idx = dwID & INDEX_MASK;
+        if (idx >= m_slots.size()) return;
+        Slot& slot = m_slots[idx];
+        if (!slot.obj || slot.gen != (dwID >> INDEX_BITS)) return;
+        slot.obj = nullptr;
+        slot.gen = slot.gen == GEN_MAX ? 1 : slot.gen + 1;
+        if (m_tail == NIL) m_head = idx;
+        else m_slots[m_tail].next = idx;
+        m_tail = idx;
+        --m_used;
+    }
+
+    template <class Fn>
+    void forEach(Fn&& fn) {
+        for (Slot& slot : m_slots) {
+            if (slot.obj) fn(slot.obj);
+        }
+    }
+
+private:
+    static const UINT32 NIL = 0xFFFFFFFFu;
+    struct Slot {
+        Slot() : obj(nullptr), gen(0), next(NIL) {}
+        GateClient* obj;
+        UINT32 gen;
+        UINT32 next;
+    };
+
+    std::vector<Slot> m_slots;
+    UINT32 m_head;
+    UINT32 m_tail;
+    UINT32 m_used;
+};
+
+class GateListener : public GateHandler {
+public:
+    GateListener(GateReactor& gate, int fd) : m_gate(gate), m_fd(fd) {}
+    ~GateListener() override { ::close(m_fd); }
+    void onEvent(UINT32 dwEvents) override;
+    int fd() const { return m_fd; }
+
+private:
+    GateReactor& m_gate;
+    int m_fd;
+};
+
+class GateReactor : public ISSGate {
+public:
+    GateReactor()
+        : m_ref(1)
+        , m_ep(::epoll_create1(EPOLL_CLOEXEC))
+        , m_clientParser(nullptr)
+        , m_factory(nullptr)
+        , m_clientRecvBuf(GATE_CLIENT_RECVBUF)
+        , m_clientSendBuf(GATE_CLIENT_SENDBUF)
+        , m_nextListenerID(1)
+        , m_maxClient(GATE_DEFAULT_MAX_CLIENT)
+        , m_now(nowMs()) {
+        std::memset(&m_stats, 0, sizeof(m_stats));
+    }
+
+    ~GateReactor() override {
+        // Sessions are released without OnClose, as ISSNet does on teardown.
+        m_clients.forEach([](GateClient* c) {
+            c->m_closed = true;
+            c->m_stream.closeFd();
+            if (c->m_session) c->m_session->Release();
+            delete c;
+        });
+        for (GateServerConn* srv : m_servers) delete srv;
+        m_servers.clear();
+        for (auto& it : m_listeners) delete it.second;
+        m_listeners.clear();
+        reap();
+        if (m_ep != -1) ::close(m_ep);
+    }
+
+    bool valid() const { return m_ep != -1; }
+
+    void SSAPI AddRef(void) override { m_ref.fetch_add(1); }
+    UINT32 SSAPI QueryRef(void) override { return m_ref.load(); }
+    void SSAPI Release(void) override { if (m_ref.fetch_sub(1) == 1) delete this; }
+    SSSVersion SSAPI GetVersion(void) override { return SDGATE_VERSION; }
+    const char* SSAPI GetModuleName(void) override { return SDGATE_MODULENAME; }
+
+    ISSServerConnection* SSAPI CreateServerConnection(ISSServerSession* poSession, ISSPacketParser* /*poSvrPacketParser*/) override {
+        // Link frames carry their own length, so no server parser is needed.
+        GateServerConn* srv = new GateServerConn(*this, poSession);
+        m_servers.insert(srv);
+        return srv;
+    }
+
+    void SSAPI SetClientPacketParser(ISSPacketParser* poPacketParser) override { m_clientParser = poPacketParser; }
+    void SSAPI SetClientSessionFactory(ISSClientSessionFactory* poFactory) override { m_factory = poFactory; }
+
+    bool SSAPI SetClientBufferSize(UINT32 dwRecvBufSize, UINT32 dwSendBufSize) override {
+        if (dwRecvBufSize == 0 || dwSendBufSize == 0) return false;
+        m_clientRecvBuf = dwRecvBufSize;
+        m_clientSendBuf = dwSendBufSize;
+        return true;
+    }
+
+    INT32 SSAPI AddListen(const char* pszIP, UINT16 wPort) override {
+        sockaddr_in addr;
+        std::memset(&addr, 0, sizeof(addr));
+        addr.sin_family = AF_INET;
+        addr.sin_port = htons(wPort);
+        if (!pszIP || !*pszIP || std::strcmp(pszIP, "0.0.0.0") == 0) addr.sin_addr.s_addr = htonl(INADDR_ANY);
+        else if (::inet_pton(AF_INET, pszIP, &addr.sin_addr) != 1) return -1;
+
+        int fd = ::socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+        if (fd == -1) return -1;
+        int on = 1;
+        ::setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &on, sizeof(on));
+        if (::bind(fd, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) != 0 || ::listen(fd, SOMAXCONN) != 0) {
+            GateLog(LOGLV_WARN, "SSGate listen failed on port " + std::to_string(wPort) + ": " + std::strerror(errno));
+            ::close(fd);
+            return -1;
+        }
+        GateListener* lis = new GateListener(*this, fd);
+        watch(lis, fd, EPOLL_CTL_ADD, false);
+        INT32 id = m_nextListenerID++;
+        m_listeners[id] = lis;
+        GateLog(LOGLV_INFO, "SSGate listening on port " + std::to_string(wPort));
+        return id;
+    }
+
+    bool SSAPI DelListen(INT32 nID) override {
+        auto it = m_listeners.find(nID);
+        if (it == m_listeners.end()) return false;
+        unwatch(it->second->fd());
+        m_deadListeners.push_back(it->second);
+        m_listeners.erase(it);
+        return true;
+    }
+
+    bool SSAPI Run(INT32 nCount) override {
+        m_now = nowMs();
+        for (GateServerConn* srv : m_servers) srv->tick(m_now);
+        int maxEvents = (nCount > 0 && nCount < GATE_MAX_EVENTS) ? nCount : GATE_MAX_EVENTS;
+        int n = ::epoll_wait(m_ep, m_events, maxEvents, 0);
+        for (int i = 0; i < n; ++i) {
+            static_cast<GateHandler*>(m_events[i].data.ptr)->onEvent(m_events[i].events);
+        }
+        reap();
+        return n > 0;
+    }
+
+    bool SSAPI SetOpt(INT32 nType, void* pOpt) override {
+        if (!pOpt) return false;
+        switch (nType) {
+        case GATE_OPT_MAX_CLIENT: {
+            UINT32 max = static_cast<SGateOptMaxClient*>(pOpt)->dwMaxClient;
+            if (m_clients.size() || max == 0 || max > GateClientTable::MAX_CAPACITY) return false;
+            m_maxClient = max;
+            if (m_clients.ready()) m_clients.init(max);
+            return true;
+        }
+        case GATE_OPT_CLIENT_LIMIT: {
+            const SGateOptClientLimit* opt = static_cast<const SGateOptClientLimit*>(pOpt);
+            GateLimit lim;
+            lim.pps = opt->dwPacketsPerSec;
+            lim.bps = opt->dwBytesPerSec;
+            lim.maxPacket = opt->dwMaxPacketSize;
+            lim.kickAfter = opt->dwKickAfterDrops;
+            lim.pktCap = static_cast<UINT64>(opt->dwPacketBurst ? opt->dwPacketBurst : lim.pps) * 1000;
+            lim.byteCap = static_cast<UINT64>(opt->dwByteBurst ? opt->dwByteBurst : lim.bps) * 1000;
+            m_limit = lim;
+            m_now = nowMs();
+            m_clients.forEach([this](GateClient* c) { c->m_bucket.reset(m_limit, m_now); });
+            return true;
+        }
+        case GATE_OPT_STATS: {
+            m_stats.dwClients = m_clients.size();
+            *static_cast<SGateStats*>(pOpt) = m_stats;
+            return true;
+        }
+        default:
+            return false;
+        }
+    }
+
+    // Socket registration. bOut adds EPOLLOUT for sockets with queued data
+    // or a connect in progress.
+    void watch(GateHandler* h, int fd, int nOp, bool bOut) {
+        epoll_event ev;
+        std::memset(&ev, 0, sizeof(ev));
+        ev.events = EPOLLIN | EPOLLRDHUP | (bOut ? static_cast<uint32_t>(EPOLLOUT) : 0u);
+        ev.data.ptr = h;
+        ::epoll_ctl(m_ep, nOp, fd, &ev);
+    }
+    void watchOut(GateHandler* h, GateStream& s) {
+        bool want = s.pending();
+        if (want != s.watchOut()) {
+            s.watchOut() = want;
+            watch(h, s.fd(), EPOLL_CTL_MOD, want);
+        }
+    }
+    void unwatch(int fd) {
+        if (fd != -1) ::epoll_ctl(m_ep, EPOLL_CTL_DEL, fd, nullptr);
+    }
+
+    void accepted(int fd, const sockaddr_in& remote) {
+        if (!m_clients.ready()) m_clients.init(m_maxClient);
+        if (!m_factory || m_clients.full()) {
+            if (m_factory) GateLog(LOGLV_WARN, "SSGate client table full, connection refused");
+            ::close(fd);
+            return;
+        }
+        ISSClientSession* session = m_factory->CreateSession();
+        if (!session) { ::close(fd); return; }
+        int on = 1;
+        ::setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &on, sizeof(on));
+        sockaddr_in local;
+        socklen_t len = sizeof(local);
+        std::memset(&local, 0, sizeof(local));
+        ::getsockname(fd, reinterpret_cast<sockaddr*>(&local), &len);
+
+        GateClient* c = new GateClient(*this, fd, remote, local);
+        c->m_id = m_clients.alloc(c);
+        c->m_session = session;
+        c->m_bucket.reset(m_limit, m_now);
+        watch(c, fd, EPOLL_CTL_ADD, false);
+        session->SetConnection(c);
+        session->OnConnect();
+    }
+
+    GateClient* findClient(UINT32 dwID) const { return m_clients.find(dwID); }
+
+    bool clientSend(GateClient* c, const char* pData, UINT32 nLen) {
+        iovec iov;
+        iov.iov_base = const_cast<char*>(pData);
+        iov.iov_len = nLen;
+        int sysErr = 0;
+        if (!c->m_stream.send(&iov, 1, sysErr)) {
+            closeClient(c, sysErr ? NET_SEND_ERROR : NET_SEND_OVERFLOW, sysErr, false);
+            return false;
+        }
+        watchOut(c, c->m_stream);
+        return true;
+    }
+
+    // Closes a client once: servers it entered are told, the session gets
+    // OnError (for nSDError != 0) and OnClose and is released. The object
+    // itself is freed at the end of Run.
+    void closeClient(GateClient* c, INT32 nSDError, INT32 nSysError, bool bFlush) {
+        if (c->m_closed) return;
+        c->m_closed = true;
+        if (bFlush) {
+            int sysErr = 0;
+            c->m_stream.flush(sysErr);
+        }
+        unwatch(c->m_stream.fd());
+        c->m_stream.closeFd();
+        m_clients.free(c->m_id);
+        std::vector<GateClient::Membership> groups;
+        groups.swap(c->m_groups);
+        for (const GateClient::Membership& m : groups) m.link->unlink(c, m.group);
+        for (const GateClient::Membership& m : groups) {
+            if (m.group == GATE_GROUP_ENTERED) m.link->notifyClientClose(c->m_id);
+        }
+        if (ISSClientSession* session = c->m_session) {
+            c->m_session = nullptr;
+            if (nSDError) session->OnError(nSDError, nSysError);
+            session->OnClose();
+            session->Release();
+        }
+        m_deadClients.push_back(c);
+    }
+
+    void linkDown(GateServerConn* srv) { srv->clearGroups(); }
+
+    // Fan-out send: a client whose send fails is closed only after the
+    // caller's loop is done, since closing edits the member lists.
+    void castSend(GateClient* c, const char* pData, UINT32 nLen) {
+        if (c->m_closed) return;
+        iovec iov;
+        iov.iov_base = const_cast<char*>(pData);
+        iov.iov_len = nLen;
+        int sysErr = 0;
+        if (!c->m_stream.send(&iov, 1, sysErr)) {
+            m_castFailed.push_back(CastFailure{c, sysErr});
+            return;
+        }
+        watchOut(c, c->m_stream);
+    }
+    void castDone() {
+        if (m_castFailed.empty()) return;
+        std::vector<CastFailure> failed;
+        failed.swap(m_castFailed);
+        for (const CastFailure& f : failed) {
+            closeClient(f.client, f.sysErr ? NET_SEND_ERROR : NET_SEND_OVERFLOW, f.sysErr, false);
+        }
+    }
+
+    void releaseServer(GateServerConn* srv) {
+        linkDown(srv);
+        m_servers.erase(srv);
+        m_deadServers.push_back(srv);
+    }
+
+    ISSPacketParser* clientParser() const { return m_clientParser; }
+    const GateLimit& limit() const { return m_limit; }
+    UINT64 now() const { return m_now; }
+    SGateStats& stats() { return m_stats; }
+    UINT32 clientRecvBuf() const { return m_clientRecvBuf; }
+    UINT32 clientSendBuf() const { return m_clientSendBuf; }
+
+private:
+    // Objects closed during a Run pass may still have events later in the
+    // same batch, so they are only freed once the batch is done.
+    void reap() {
+        for (GateClient* c : m_deadClients) delete c;
+        m_deadClients.clear();
+        for (GateServerConn* srv : m_deadServers) delete srv;
+        m_deadServers.clear();
+        for (GateListener* lis : m_deadListeners) delete lis;
+        m_deadListeners.clear();
+    }
+
+    std::atomic<UINT32> m_ref;
+    int m_ep;
+    ISSPacketParser* m_clientParser;
+    ISSClientSessionFactory* m_factory;
+    UINT32 m_clientRecvBuf;
+    UINT32 m_clientSendBuf;
+    INT32 m_nextListenerID;
+    UINT32 m_maxClient;
+    UINT64 m_now;  // taken once per Run pass
+    GateLimit m_limit;
+    SGateStats m_stats;
+    std::unordered_map<INT32, GateListener*> m_listeners;
+    GateClientTable m_clients;
+    std::unordered_set<GateServerConn*> m_servers;
+    std::vector<GateClient*> m_deadClients;
+    std::vector<GateServerConn*> m_deadServers;
+    std::vector<GateListener*> m_deadListeners;
+    struct CastFailure {
+        GateClient* client;
+        int sysErr;
+    };
+    std::vector<CastFailure> m_castFailed;
+    epoll_event m_events[GATE_MAX_EVENTS];
+};
+
+//
+// GateListener
+//
+
+void GateListener::onEvent(UINT32) {
+    for (;;) {
+        sockaddr_in remote;
+        socklen_t len = sizeof(remote);
+        int fd = ::accept4(m_fd, reinterpret_cast<sockaddr*>(&remote), &len, SOCK_NONBLOCK | SOCK_CLOEXEC);
+        if (fd == -1) {
+            if (errno == EINTR || errno == ECONNABORTED) continue;
+            if (errno != EAGAIN && errno != EWOULDBLOCK) {
+                GateLog(LOGLV_WARN, std::string("SSGate accept failed: ") + std::strerror(errno));
+            }
+            return;
+        }
+        m_gate.accepted(fd, remote);
+    }
+}
+
+//
+// GateClient
+//
+
+GateClient::GateClient(GateReactor& gate, int fd, const sockaddr_in& remote, const sockaddr_in& local)
+    : m_gate(gate)
+    , m_id(0)
+    , m_session(nullptr)
+    , m_closed(false)
+    , m_drops(0)
+    , m_remoteIP(remote.sin_addr.s_addr)
+    , m_localIP(local.sin_addr.s_addr)
+    , m_remotePort(ntohs(remote.sin_port))
+    , m_localPort(ntohs(local.sin_port)) {
+    m_stream.attach(fd, gate.clientRecvBuf(), gate.clientSendBuf());
+    ::inet_ntop(AF_INET, &remote.sin_addr, m_remoteIPStr, sizeof(m_remoteIPStr));
+    ::inet_ntop(AF_INET, &local.sin_addr, m_localIPStr, sizeof(m_localIPStr));
+}
+
+bool GateClient::Send(const char* pData, UINT32 nLen) {
+    if (m_closed || !pData || nLen == 0) return false;
+    return m_gate.clientSend(this, pData, nLen);
+}
+
+void GateClient::Close(void) {
+    m_gate.closeClient(this, 0, 0, true);
+}
+
+void GateClient::onEvent(UINT32 dwEvents) {
+    if (m_closed) return;
+    int sysErr = 0;
+    if (dwEvents & EPOLLOUT) {
+        if (!m_stream.flush(sysErr)) { m_gate.closeClient(this, NET_SEND_ERROR, sysErr, false); return; }
+        m_gate.watchOut(this, m_stream);
+    }
+    if (dwEvents & (EPOLLIN | EPOLLRDHUP | EPOLLHUP | EPOLLERR)) {
+        int n = m_stream.fill(sysErr);
+        parse();
+        if (!m_closed && n < 0) m_gate.closeClient(this, sysErr ? NET_RECV_ERROR : 0, sysErr, false);
+    }
+}
+
+// Delivers every complete packet in place; a packet that cannot fit the
+// receive buffer is a protocol error. Flood limits are applied per packet
+// before the session sees it, so a dropped packet costs a bucket update.
+void GateClient::parse() {
+    ISSPacketParser* parser = m_gate.clientParser();
+    const GateLimit& lim = m_gate.limit();
+    bool limited = lim.pps || lim.bps;
+    char* p = m_stream.data();
+    UINT32 total = m_stream.size();
+    UINT32 off = 0;
+    while (off < total) {
+        UINT32 avail = total - off;
+        INT32 n = parser ? parser->ParsePacket(p + off, avail) : static_cast<INT32>(avail);
+        if (n < 0) { m_gate.closeClient(this, SDGATEERR_PACKET_ERROR, 0, false); return; }
+        UINT32 len = static_cast<UINT32>(n);
+        // An unfinished packet already longer than the limit is oversized too.
+        UINT32 seen = (n == 0 || len > avail) ? avail : len;
+        if (lim.maxPacket && seen > lim.maxPacket) {
+            ++m_gate.stats().qwOversizeKicks;
+            m_gate.closeClient(this, SDGATEERR_PACKET_TOO_LARGE, 0, false);
+            return;
+        }
+        if (n == 0 || len > avail) {
+            if (off == 0 && avail == m_stream.capacity()) m_gate.closeClient(this, SDGATEERR_PACKET_ERROR, 0, false);
+            break;
+        }
+        off += len;
+        if (limited && !m_bucket.take(lim, m_gate.now(), len)) {
+            SGateStats& st = m_gate.stats();
+            ++st.qwDroppedPackets;
+            st.qwDroppedBytes += len;
+            if (lim.kickAfter && ++m_drops >= lim.kickAfter) {
+                ++st.qwFloodKicks;
+                m_gate.closeClient(this, SDGATEERR_CLI_FLOOD, 0, false);
+                return;
+            }
+            continue;
+        }
+        m_session->OnRecv(p + off - len, len);
+        if (m_closed) return;
+    }
+    if (!m_closed) m_stream.consume(off);
+}
+
+//
+// GateServerConn
+//
+
+GateServerConn::GateServerConn(GateReactor& gate, ISSServerSession* poSession)
+    : m_gate(gate)
+    , m_session(poSession)
+    , m_state(IDLE)
+    , m_autoReconnect(false)
+    , m_released(false)
+    , m_reconnectAt(0)
+    , m_recvBuf(GATE_LINK_RECVBUF)
+    , m_sendBuf(GATE_LINK_SENDBUF)
+    , m_remoteIP(0)
+    , m_localIP(0)
+    , m_remotePort(0)
+    , m_localPort(0) {
+    if (m_session) m_session->SetConnection(this);
+}
+
+void GateServerConn::SetBufferSize(UINT32 dwRecvBufSize, UINT32 dwSendBufSize) {
+    if (dwRecvBufSize) m_recvBuf = dwRecvBufSize;
+    if (dwSendBufSize) m_sendBuf = dwSendBufSize;
+    if (m_state != IDLE) m_stream.setBufferSize(m_recvBuf, m_sendBuf);
+}
+
+int GateServerConn::Connect(const char* pszIP, UINT16 wPort, bool bAutoReconnect) {
+    if (m_released || m_state != IDLE || !pszIP) return NET_CONNECT_FAIL;
+    m_ip = pszIP;
+    m_remotePort = wPort;
+    m_autoReconnect = bAutoReconnect;
+    m_reconnectAt = 0;
+    return startConnect();
+}
+
+int GateServerConn::startConnect() {
+    sockaddr_in addr;
+    std::memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(m_remotePort);
+    if (::inet_pton(AF_INET, m_ip.c_str(), &addr.sin_addr) != 1) return NET_CONNECT_FAIL;
+    m_remoteIP = addr.sin_addr.s_addr;
+
+    int fd = ::socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if (fd == -1) return NET_SYSTEM_ERROR;
+    int on = 1;
+    ::setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &on, sizeof(on));
+    if (::connect(fd, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) != 0 && errno != EINPROGRESS) {
+        int err = errno;
+        ::close(fd);
+        if (m_autoReconnect) m_reconnectAt = nowMs() + GATE_RECONNECT_MS;
+        GateLog(LOGLV_WARN, "SSGate connect to " + m_ip + " failed: " + std::strerror(err));
+        return NET_CONNECT_FAIL;
+    }
+    // Completion, successful or not, is reported through EPOLLOUT.
+    m_stream.attach(fd, m_recvBuf, m_sendBuf);
+    m_state = CONNECTING;
+    m_gate.watch(this, fd, EPOLL_CTL_ADD, true);
+    return NET_SUCCESS;
+}
+
+void GateServerConn::onConnected() {
+    m_state = CONNECTED;
+    m_stream.watchOut() = true;
+    m_gate.watchOut(this, m_stream);
+    sockaddr_in local;
+    socklen_t len = sizeof(local);
+    if (::getsockname(m_stream.fd(), reinterpret_cast<sockaddr*>(&local), &len) == 0) {
+        m_localIP = local.sin_addr.s_addr;
+        m_localPort = ntohs(local.sin_port);
+    }
+    GateLog(LOGLV_INFO, "SSGate connected to server " + m_ip + ":" + std::to_string(m_remotePort));
+    if (m_session) m_session->OnConnect(true);
+}
+
+void GateServerConn::connectFailed(int nSysErr) {
+    m_gate.unwatch(m_stream.fd());
+    m_stream.closeFd();
+    m_state = IDLE;
+    if (m_autoReconnect) m_reconnectAt = nowMs() + GATE_RECONNECT_MS;
+    if (m_session) {
+        m_session->OnError(SDGATEERR_CONN_SVR_ERROR, nSysErr);
+        m_session->OnConnect(false);
+    }
+}
+
+void GateServerConn::drop(INT32 nSDError, INT32 nSysError) {
+    if (m_state != CONNECTED) return;
+    m_gate.unwatch(m_stream.fd());
+    m_stream.closeFd();
+    m_state = IDLE;
+    m_gate.linkDown(this);
+    if (m_autoReconnect) m_reconnectAt = nowMs() + GATE_RECONNECT_MS;
+    if (m_session) {
+        if (nSDError) m_session->OnError(nSDError, nSysError);
+        m_session->OnClose();
+    }
+}
+
+void GateServerConn::Close(void) {
+    m_autoReconnect = false;
+    m_reconnectAt = 0;
+    if (m_state == CONNECTING) {
+        m_gate.unwatch(m_stream.fd());
+        m_stream.closeFd();
+        m_state = IDLE;
+    } else if (m_state == CONNECTED) {
+        int sysErr = 0;
+        m_stream.flush(sysErr);
+        drop(0, 0);
+    }
+}
+
+void GateServerConn::Release(void) {
+    if (m_released) return;
+    Close();
+    m_released = true;
+    m_gate.releaseServer(this);
+}
+
+void GateServerConn::onEvent(UINT32 dwEvents) {
+    if (m_released) return;
+    if (m_state == CONNECTING) {
+        int err = 0;
+        socklen_t len = sizeof(err);
+        if (::getsockopt(m_stream.fd(), SOL_SOCKET, SO_ERROR, &err, &len) != 0) err = errno;
+        if (err || (dwEvents & (EPOLLERR | EPOLLHUP))) connectFailed(err);
+        else onConnected();
+        return;
+    }
+    if (m_state != CONNECTED) return;
+    int sysErr = 0;
+    if (dwEvents & EPOLLOUT) {
+        if (!m_stream.flush(sysErr)) { drop(NET_SEND_ERROR, sysErr); return; }
+        m_gate.watchOut(this, m_stream);
+    }
+    if (dwEvents & (EPOLLIN | EPOLLRDHUP | EPOLLHUP | EPOLLERR)) {
+        int n = m_stream.fill(sysErr);
+        parse();
+        if (m_state == CONNECTED && n < 0) drop(sysErr ? NET_RECV_ERROR : 0, sysErr);
+    }
+}
+
+void GateServerConn::parse() {
+    char* p = m_stream.data();
+    UINT32 total = m_stream.size();
+    UINT32 off = 0;
+    while (total - off >= GATE_LINK_HEAD_LEN) {
+        SGateLinkHead head;
+        std::memcpy(&head, p + off, sizeof(head));
+        UINT32 len = ntohl(head.dwLen);
+        if (len < GATE_LINK_HEAD_LEN || len > GATE_LINK_MAX_FRAME) { drop(NET_PACKET_ERROR, 0); return; }
+        if (len > total - off) {
+            // Large frames grow the buffer once instead of failing the link.
+            if (len > m_stream.capacity()) {
+                m_stream.consume(off);
+                m_stream.grow(len);
+                return;
+            }
+            break;
+        }
+        dispatch(ntohs(head.wCmd), ntohs(head.wErr), ntohl(head.dwClientID), p + off + GATE_LINK_HEAD_LEN, len - GATE_LINK_HEAD_LEN);
+        if (m_state != CONNECTED || m_released) return;
+        off += len;
+    }
+    m_stream.consume(off);
+}
+
+void GateServerConn::dispatch(UINT16 wCmd, UINT16 wErr, UINT32 dwClientID, const char* pBody, UINT32 dwLen) {
+    if (!m_session) return;
+    switch (wCmd) {
+    case GATE_LINK_SERVER_DATA:
+        m_session->OnRecvServerData(pBody, dwLen);
+        return;
+    case GATE_LINK_GROUP_CAST:
+        groupCast(dwClientID, pBody, dwLen);
+        return;
+    case GATE_LINK_MULTICAST:
+        multicast(dwClientID, pBody, dwLen);
+        return;
+    default:
+        break;
+    }
+    // Frames for a client that has gone away are dropped.
+    GateClient* c = m_gate.findClient(dwClientID);
+    if (!c) return;
+    switch (wCmd) {
+    case GATE_LINK_CLIENT_DATA:
+        m_session->OnRecvClientData(c, pBody, dwLen);
+        break;
+    case GATE_LINK_ENTER:
+    case GATE_LINK_LEAVE: {
+        UINT64 trans = dwLen >= 8 ? getBE64(pBody) : 0;
+        if (wCmd == GATE_LINK_ENTER) {
+            if (wErr != SDGATEERR_SUCCESS) leaveAll(c);
+            m_session->OnEnter(c, wErr, trans);
+        } else {
+            if (wErr == SDGATEERR_SUCCESS) leaveAll(c);
+            m_session->OnLeave(c, wErr, trans);
+        }
+        break;
+    }
+    case GATE_LINK_KICK:
+        // A backend may only kick clients that entered it.
+        if (c->entered(this)) m_gate.closeClient(c, SDGATEERR_CLI_KICK, 0, true);
+        break;
+    case GATE_LINK_GROUP_JOIN:
+    case GATE_LINK_GROUP_LEAVE:
+        if (dwLen >= 4) {
+            UINT32 group;
+            std::memcpy(&group, pBody, sizeof(group));
+            group = ntohl(group);
+            // Only entered clients can join; the entered group itself is
+            // driven by Enter/Leave.
+            if (group == GATE_GROUP_ENTERED || !c->entered(this)) break;
+            if (wCmd == GATE_LINK_GROUP_JOIN) join(c, group);
+            else leave(c, group);
+        }
+        break;
+    default:
+        GateLog(LOGLV_WARN, "SSGate unknown link command " + std::to_string(wCmd));
+        break;
+    }
+}
+
+bool GateServerConn::sendFrame(UINT16 wCmd, UINT32 dwClientID, const char* p1, UINT32 n1, const char* p2, UINT32 n2) {
+    if (m_state != CONNECTED) return false;
+    UINT32 len = GATE_LINK_HEAD_LEN + n1 + n2;
+    if (len > GATE_LINK_MAX_FRAME) return false;
+    SGateLinkHead head;
+    head.dwLen = htonl(len);
+    head.wCmd = htons(wCmd);
+    head.wErr = 0;
+    head.dwClientID = htonl(dwClientID);
+    iovec iov[3];
+    int cnt = 0;
+    iov[cnt].iov_base = &head;
+    iov[cnt++].iov_len = GATE_LINK_HEAD_LEN;
+    if (n1) { iov[cnt].iov_base = const_cast<char*>(p1); iov[cnt++].iov_len = n1; }
+    if (n2) { iov[cnt].iov_base = const_cast<char*>(p2); iov[cnt++].iov_len = n2; }
+    int sysErr = 0;
+    if (!m_stream.send(iov, cnt, sysErr)) {
+        drop(sysErr ? NET_SEND_ERROR : NET_SEND_OVERFLOW, sysErr);
+        return false;
+    }
+    m_gate.watchOut(this, m_stream);
+    return true;
+}
+
+GateClient* GateServerConn::liveClient(ISSClientConnection* poClient) {
+    GateClient* c = static_cast<GateClient*>(poClient);
+    return (c && !c->closed()) ? c : nullptr;
+}
+
+void GateServerConn::join(GateClient* c, UINT32 dwGroup) {
+    if (c->member(this, dwGroup)) return;
+    m_groups[dwGroup].push_back(c);
+    c->m_groups.push_back(GateClient::Membership{this, dwGroup});
+}
+
+void GateServerConn::unlink(GateClient* c, UINT32 dwGroup) {
+    auto it = m_groups.find(dwGroup);
+    if (it == m_groups.end()) return;
+    std::vector<GateClient*>& members = it->second;
+    auto pos = std::find(members.begin(), members.end(), c);
+    if (pos != members.end()) {
+        *pos = members.back();
+        members.pop_back();
+    }
+    if (members.empty()) m_groups.erase(it);
+}
+
+void GateServerConn::leave(GateClient* c, UINT32 dwGroup) {
+    std::vector<GateClient::Membership>& groups = c->m_groups;
+    for (size_t i = 0; i < groups.size(); ++i) {
+        if (groups[i].link == this && groups[i].group == dwGroup) {
+            groups[i] = groups.back();
+            groups.pop_back();
+            unlink(c, dwGroup);
+            return;
+        }
+    }
+}
+
+void GateServerConn::leaveAll(GateClient* c) {
+    std::vector<GateClient::Membership>& groups = c->m_groups;
+    for (size_t i = 0; i < groups.size();) {
+        if (groups[i].link == this) {
+            unlink(c, groups[i].group);
+            groups[i] = groups.back();
+            groups.pop_back();
+        } else {
+            ++i;
+        }
+    }
+}
+
+void GateServerConn::clearGroups() {
+    std::unordered_map<UINT32, std::vector<GateClient*>> groups;
+    groups.swap(m_groups);
+    for (auto& it : groups) {
+        for (GateClient* c : it.second) {
+            std::vector<GateClient::Membership>& mine = c->m_groups;
+            mine.erase(std::remove_if(mine.begin(), mine.end(),
+                [this](const GateClient::Membership& m) { return m.link == this; }), mine.end());
+        }
+    }
+}
+
+// Body: [UINT32 group][payload]. Every member is sent the payload straight
+// from the link's receive buffer.
+void GateServerConn::groupCast(UINT32 dwSkipID, const char* pBody, UINT32 dwLen) {
+    if (dwLen < 4) return;
+    UINT32 group;
+    std::memcpy(&group, pBody, sizeof(group));
+    auto it = m_groups.find(ntohl(group));
+    if (it == m_groups.end() || dwLen == 4) return;
+    for (GateClient* c : it->second) {
+        if (c->id() != dwSkipID) m_gate.castSend(c, pBody + 4, dwLen - 4);
+    }
+    m_gate.castDone();
+}
+
+// Body: [UINT32 n][n x UINT32 client ID][payload].
+void GateServerConn::multicast(UINT32 dwSkipID, const char* pBody, UINT32 dwLen) {
+    if (dwLen < 4) return;
+    UINT32 n;
+    std::memcpy(&n, pBody, sizeof(n));
+    n = ntohl(n);
+    if (n > (dwLen - 4) / 4) {
+        GateLog(LOGLV_WARN, "SSGate malformed multicast frame");
+        return;
+    }
+    const char* ids = pBody + 4;
+    const char* payload = ids + n * 4;
+    UINT32 len = dwLen - 4 - n * 4;
+    if (len == 0) return;
+    for (UINT32 i = 0; i < n; ++i) {
+        UINT32 id;
+        std::memcpy(&id, ids + i * 4, sizeof(id));
+        id = ntohl(id);
+        if (id == dwSkipID) continue;
+        GateClient* c = m_gate.findClient(id);
+        // Like groupCast and SendClientData, only clients entered on this backend.
+        if (c && c->entered(this)) m_gate.castSend(c, payload, len);
+    }
+    m_gate.castDone();
+}
+
+bool GateServerConn::SendServerData(const char* pData, UINT32 nLen) {
+    return sendFrame(GATE_LINK_SERVER_DATA, 0, pData, nLen, nullptr, 0);
+}
+
+bool GateServerConn::SendClientData(ISSClientConnection* poClient, const char* pData, UINT32 nLen) {
+    GateClient* c = liveClient(poClient);
+    if (!c || !c->entered(this)) return false;
+    return sendFrame(GATE_LINK_CLIENT_DATA, c->id(), pData, nLen, nullptr, 0);
+}
+
+bool GateServerConn::Enter(ISSClientConnection* poClient, UINT64 dwTransID) {
+    GateClient* c = liveClient(poClient);
+    if (!c) return false;
+    char body[8];
+    putBE64(body, dwTransID);
+    if (!sendFrame(GATE_LINK_ENTER, c->id(), body, sizeof(body), nullptr, 0)) return false;
+    // Counted as entered from the request on: the link is ordered, so data
+    // sent now reaches the server after the ENTER, and a client that closes
+    // before the answer still produces GATE_LINK_CLIENT_CLOSE.
+    join(c, GATE_GROUP_ENTERED);
+    return true;
+}
+
+bool GateServerConn::Leave(ISSClientConnection* poClient, UINT64 dwTransID) {
+    GateClient* c = liveClient(poClient);
+    if (!c) return false;
+    char body[8];
+    putBE64(body, dwTransID);
+    return sendFrame(GATE_LINK_LEAVE, c->id(), body, sizeof(body), nullptr, 0);
+}
+
+} // namespace
+
+// Sockets are served by the gate's own epoll set; the net module is unused.
+ISSGate* GateCreateReactor(ISSNet* /*poNet*/) {
+    GateReactor* gate = new GateReactor();
+    if (!gate->valid()) {
+        GateLog(LOGLV_CRITICAL, std::string("SSGate epoll_create1 failed: ") + std::strerror(errno));
+        gate->Release();
+        return nullptr;
+    }
+    return gate;
+}
+
+} // namespace SSCP
+
+#endif // __linux__
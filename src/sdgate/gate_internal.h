@@ -0,0 +1,20 @@
+// Internal declarations shared by the sdgate translation units.
+#ifndef SSCP_GATE_INTERNAL_H
+#define SSCP_GATE_INTERNAL_H
+
+#include "ssengine/sdgate.h"
+#include <string>
+
+namespace SSCP {
+
+// Writes text through the logger installed with SSGateSetLogger when
+// dwLevel is enabled.
+void GateLog(UINT32 dwLevel, const std::string& text);
+
+// Reactor gate: client and server sockets are served by one epoll set that
+// is driven from ISSGate::Run. Returns NULL where epoll is not available.
+ISSGate* GateCreateReactor(ISSNet* poNet);
+
+} // namespace SSCP
+
+#endif
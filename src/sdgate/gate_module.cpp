@@ -1,4 +1,4 @@
-#include "ssengine/sdgate.h"
+#include "gate_internal.h"
 
 #include "ssengine/sdlogger.h"
 #include "ssengine/sdnet.h"
@@ -18,13 +18,21 @@ ISSLogger* g_gateLogger = nullptr;
 UINT32 g_gateLogLevel = LOGLV_INFO | LOGLV_WARN | LOGLV_CRITICAL;
 std::mutex g_loggerMutex;
 
-void logInfo(const std::string& text) {
+} // namespace
+
+void GateLog(UINT32 dwLevel, const std::string& text) {
     std::lock_guard<std::mutex> lk(g_loggerMutex);
-    if (g_gateLogger && (g_gateLogLevel & LOGLV_INFO)) {
+    if (g_gateLogger && (g_gateLogLevel & dwLevel)) {
         g_gateLogger->LogText(text.c_str());
     }
 }
 
+#if !defined(__linux__)
+
+// Loopback stand-in used where the reactor gate is not available: server
+// calls are answered by the session itself and nothing is listened on.
+namespace {
+
 class MockGate;
 
 class MockServerConnection : public ISSServerConnection {
@@ -59,7 +67,7 @@ public:
         if (m_session) {
             m_session->OnConnect(true);
         }
-        logInfo("MockServerConnection connected to " + m_remoteIpStr);
+        GateLog(LOGLV_INFO, "MockServerConnection connected to " + m_remoteIpStr);
         return NET_SUCCESS;
     }
 
@@ -188,7 +196,7 @@ public:
         std::lock_guard<std::mutex> lk(m_mutex);
         INT32 id = m_nextListenerId++;
         m_listeners.emplace(id, ListenerInfo{pszIP ? pszIP : "", wPort});
-        logInfo("MockGate listening on id " + std::to_string(id));
+        GateLog(LOGLV_INFO, "MockGate listening on id " + std::to_string(id));
         return id;
     }
 
@@ -229,8 +237,14 @@ void MockServerConnection::Release(void) {
 
 } // namespace
 
+#endif // !__linux__
+
 ISSGate* SSAPI SSCreateGate(const SSSVersion* /*pstVersion*/, ISSNet* poNet) {
+#if defined(__linux__)
+    return GateCreateReactor(poNet);
+#else
     return new MockGate(poNet);
+#endif
 }
 
 bool SSAPI SSGateSetLogger(ISSLogger* poLogger, UINT32 dwLevel) {
@@ -23,16 +23,29 @@
 
 namespace SSCP {
 
-struct NetLinOptions { UINT32 recvBuf{0}; UINT32 sendBuf{0}; INT32 maxConn{-1}; };
+struct NetLinOptions { UINT32 recvBuf{0}; UINT32 sendBuf{0}; INT32 maxConn{-1}; bool hasThreadAttr{false}; SThreadAttr threadAttr{}; };
 static NetLinOptions g_linopts;
 
+// I/O threads take NETLIN_OPT_THREAD_ATTR as set when they are started.
+template <typename Fn>
+static std::thread startIoThread(Fn fn) {
+    bool has = g_linopts.hasThreadAttr; SThreadAttr attr = g_linopts.threadAttr;
+    return std::thread([has, attr, fn]() { if (has) SDSetCurrentThreadAttr(&attr); fn(); });
+}
+
 enum class NetEventType { Established, Terminated, Error, Recv };
 struct NetEvent { NetEventType type; class Connection* conn; std::string data; int modErr{0}; int sysErr{0}; };
 
 class Connection : public ISSConnection {
 public:
     Connection():_sock(-1),_connected(false),_parser(nullptr),_session(nullptr) { _remoteIpStr[0]=0; _localIpStr[0]=0; }
-    ~Connection() override { Disconnect(); }
+    ~Connection() override {
+        Disconnect();
+        // The recv thread and queued events both point at this object.
+        if (_recvThread.joinable()) _recvThread.join();
+        purgeEvents();
+        releaseSession();
+    }
     bool SSAPI IsConnected(void) override { return _connected.load(); }
     void SSAPI Send(const char* pBuf,UINT32 dwLen) override {
         if (!_connected.load() || !pBuf || dwLen==0) return; std::lock_guard<std::mutex> lk(_sendMtx);
@@ -88,7 +101,7 @@ public:
 
 private:
     void startRecvThread() {
-        _recvThread = std::thread([this](){
+        _recvThread = startIoThread([this](){
             char buf[8192];
             while (_connected.load()) {
                 ssize_t n = ::recv(_sock, buf, sizeof(buf), 0);
@@ -100,7 +113,13 @@ private:
                 }
             }
         });
-        _recvThread.detach();
+    }
+    void purgeEvents() {
+        if (!_eq || !_eqmtx) return;
+        std::lock_guard<std::mutex> lk(*_eqmtx);
+        std::queue<NetEvent> keep;
+        while (!_eq->empty()) { if (_eq->front().conn != this) keep.push(std::move(_eq->front())); _eq->pop(); }
+        _eq->swap(keep);
     }
     void postEvent(const NetEvent& ev) { if (!_eq || !_eqmtx) return; { std::lock_guard<std::mutex> lk(*_eqmtx); _eq->push(ev);} if (_eqcv) _eqcv->notify_one(); }
 
@@ -126,7 +145,7 @@ public:
         if (::bind(ls, reinterpret_cast<sockaddr*>(&addr), sizeof(addr))<0) { ::close(ls); return false; }
         if (::listen(ls, SOMAXCONN)<0) { ::close(ls); return false; }
         _sock=ls; _running.store(true);
-        _th=std::thread([this](){ acceptLoop(); }); _th.detach();
+        _th=startIoThread([this](){ acceptLoop(); }); _th.detach();
         return true;
     }
     bool SSAPI Stop(void) override { _running.store(false); if (_sock!=-1){::close(_sock); _sock=-1;} return true; }
@@ -205,6 +224,9 @@ void SSAPI SSNetSetOpt(UINT32 dwType, void* pOpt) {
     } else if (dwType == NETLIN_OPT_MAX_CONNECTION) {
         auto* o = reinterpret_cast<SNetLinOptMaxConnection*>(pOpt);
         g_linopts.maxConn = o->nMaxConnection;
+    } else if (dwType == NETLIN_OPT_THREAD_ATTR) {
+        g_linopts.threadAttr = *reinterpret_cast<SThreadAttr*>(pOpt);
+        g_linopts.hasThreadAttr = true;
     }
 }
 
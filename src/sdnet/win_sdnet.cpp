@@ -35,9 +35,16 @@ static ISSLogger* g_logger = nullptr;
 static UINT32 g_log_level = 0;
 
 // module-level options (defaults)
-struct NetWinOptions { UINT32 recvBuf{0}; UINT32 sendBuf{0}; INT32 maxConn{-1}; };
+struct NetWinOptions { UINT32 recvBuf{0}; UINT32 sendBuf{0}; INT32 maxConn{-1}; bool hasThreadAttr{false}; SThreadAttr threadAttr{}; };
 static NetWinOptions g_winopts;
 
+// I/O threads take NETWIN_OPT_THREAD_ATTR as set when they are started.
+template <typename Fn>
+static std::thread startIoThread(Fn fn) {
+    bool has = g_winopts.hasThreadAttr; SThreadAttr attr = g_winopts.threadAttr;
+    return std::thread([has, attr, fn]() { if (has) SDSetCurrentThreadAttr(&attr); fn(); });
+}
+
 class Connection : public ISSConnection {
 public:
     Connection():_sock(INVALID_SOCKET),_connected(false),_parser(nullptr),_session(nullptr),_recvThreadRunning(false){
@@ -143,7 +150,7 @@ private:
     void startRecvThread() {
         if (_recvThreadRunning.load()) return;
         _recvThreadRunning.store(true);
-        _recvThread = std::thread([this](){
+        _recvThread = startIoThread([this](){
 #ifdef _WIN32
             char buf[8192];
             while (_connected.load()) {
@@ -262,7 +269,7 @@ public:
             _th.join();
             _running.store(true);
         }
-        _th = std::thread([this](){ this->acceptLoop(); });
+        _th = startIoThread([this](){ this->acceptLoop(); });
         return true;
 #else
         (void)pszIP; (void)wPort; (void)bReUseAddr; return false;
@@ -476,6 +483,9 @@ void SSAPI SSNetSetOpt(UINT32 dwType, void* pOpt) {
     } else if (dwType == NETWIN_OPT_MAX_CONNECTION) {
         auto* o = reinterpret_cast<SNetWinOptMaxConnection*>(pOpt);
         g_winopts.maxConn = o->nMaxConnection;
+    } else if (dwType == NETWIN_OPT_THREAD_ATTR) {
+        g_winopts.threadAttr = *reinterpret_cast<SThreadAttr*>(pOpt);
+        g_winopts.hasThreadAttr = true;
     }
 }
 
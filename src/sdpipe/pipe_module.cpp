@@ -2,6 +2,9 @@
 #include "ssengine/sdpkg.h"
 #include "ssengine/sdnet.h"
 #include "ssengine/sdnetutils.h"
+#include "ssengine/sdtime.h"
+#include "pipe_shm.h"
+#include "pipe_rpc.h"
 #include <unordered_map>
 #include <vector>
 #include <mutex>
@@ -10,6 +13,10 @@
 #include <fstream>
 #include <memory>
 #include <cstring>
+#include <algorithm>
+#include <cstdlib>
+#include <deque>
+#include <string>
 
 namespace SSCP {
 
@@ -18,30 +25,107 @@ static UINT32 g_pipe_loglevel = 0;
 
 struct SinkEntry {
     ISSPipeSink* sink{nullptr};
+    ISSPipeRpcSink* rpcSink{nullptr};
     UINT32 userData{0};
 };
 
+// RPC frames travel on reserved business ids with this head in front of the
+// data: [businessID (2 bytes, network)][callID (4 bytes, network)].
+const UINT32 PIPE_RPC_HEAD_LEN = 6;
+
+// Bytes a pipe may queue for the shm ring before Send starts failing.
+const size_t PIPE_SHM_BACKLOG_MAX = 8 * static_cast<size_t>(PIPE_SHM_RING_SIZE);
+
+class PipeModule;
+
+// Compiled IP whitelist: merged, sorted [lo, hi] ranges of host-order IPv4
+// addresses. Entries are either a plain address or a CIDR block such as
+// "10.12.0.0/16"; lookups are a binary search on the integer address.
+class IPRangeTable {
+public:
+    struct Range { UINT32 lo; UINT32 hi; };
+
+    bool empty() const { return _ranges.empty(); }
+    size_t size() const { return _ranges.size(); }
+
+    // Parse one whitelist entry ("a.b.c.d" or "a.b.c.d/n"); returns false on malformed input.
+    bool add(const std::string& entry) {
+        std::string addr = entry;
+        UINT32 prefix = 32;
+        size_t slash = entry.find('/');
+        if (slash != std::string::npos) {
+            addr = entry.substr(0, slash);
+            std::string bits = entry.substr(slash + 1);
+            if (bits.empty() || bits.size() > 2 || bits.find_first_not_of("0123456789") != std::string::npos) return false;
+            prefix = static_cast<UINT32>(std::atoi(bits.c_str()));
+            if (prefix > 32) return false;
+        }
+        in_addr in{};
+        if (!SDNetInetPton(AF_INET, addr.c_str(), &in)) return false;
+        UINT32 ip = SDNtohl(in.s_addr);
+        UINT32 mask = prefix == 0 ? 0 : (0xFFFFFFFFu << (32 - prefix));
+        _ranges.push_back(Range{ip & mask, (ip & mask) | ~mask});
+        return true;
+    }
+
+    // Sort and merge overlapping/adjacent ranges so contains() is a single lower bound.
+    void compile() {
+        std::sort(_ranges.begin(), _ranges.end(), [](const Range& a, const Range& b) { return a.lo < b.lo; });
+        std::vector<Range> merged;
+        merged.reserve(_ranges.size());
+        for (const Range& r : _ranges) {
+            if (!merged.empty() && (merged.back().hi == 0xFFFFFFFFu || r.lo <= merged.back().hi + 1)) {
+                merged.back().hi = std::max(merged.back().hi, r.hi);
+            } else {
+                merged.push_back(r);
+            }
+        }
+        merged.shrink_to_fit();
+        _ranges.swap(merged);
+    }
+
+    // dwHostIP is in host byte order.
+    bool contains(UINT32 dwHostIP) const {
+        auto it = std::upper_bound(_ranges.begin(), _ranges.end(), dwHostIP,
+                                   [](UINT32 ip, const Range& r) { return ip < r.lo; });
+        if (it == _ranges.begin()) return false;
+        --it;
+        return dwHostIP <= it->hi;
+    }
+
+private:
+    std::vector<Range> _ranges;
+};
+
 class PipeImpl : public ISSPipe {
 public:
-    PipeImpl(UINT32 id) : _id(id), _conn(nullptr), _ip(0) {}
+    PipeImpl(PipeModule* owner, UINT32 id) : _owner(owner), _id(id), _conn(nullptr), _ip(0) {}
     ~PipeImpl() override {}
 
     bool isConnected() const { return _conn != nullptr; }
+    UINT32 connGen() const { return _connGen; }
 
     UINT32 SSAPI GetID(void) override { return _id; }
 
     bool SSAPI Send(UINT16 wBusinessID, const char* pData, UINT32 dwLen) override {
-        if (!_conn || !pData) { fprintf(stderr, "[PipeImpl %u] Send fail: no conn or null data\n", _id); return false; }
-        // Build sdpkg with payload: [businessID(2 bytes, network)] + data
-        std::vector<char> buf; buf.resize(sizeof(SSDPkgHead16) + 2 + dwLen);
-        auto* head = reinterpret_cast<SSDPkgHead16*>(buf.data());
-        BuildSDPkgHead16(head, static_cast<UINT16>(2 + dwLen));
-        UINT16 bid = SDHtons(wBusinessID);
-        std::memcpy(buf.data() + sizeof(SSDPkgHead16), &bid, 2);
-        std::memcpy(buf.data() + sizeof(SSDPkgHead16) + 2, pData, dwLen);
-        _conn->Send(buf.data(), static_cast<UINT32>(buf.size()));
-        fprintf(stderr, "[PipeImpl %u] Sent bid=%u len=%u\n", _id, (unsigned)wBusinessID, (unsigned)dwLen);
+        if (!pData) { fprintf(stderr, "[PipeImpl %u] Send fail: null data\n", _id); return false; }
+        if (!_shmTx && !_conn) { fprintf(stderr, "[PipeImpl %u] Send fail: no conn\n", _id); return false; }
         // No local deliver; use network and peer fallback in module
+        return sendFrame(wBusinessID, nullptr, 0, pData, dwLen);
+    }
+
+    bool SSAPI Call(UINT16 wBusinessID, const char* pData, UINT32 dwLen, UINT32 dwTimeoutMs, ISSPipeRpcCallback* pCallback, UINT32* pdwCallID) override;
+
+    bool SSAPI Reply(UINT16 wBusinessID, UINT32 dwCallID, const char* pData, UINT32 dwLen) override {
+        if (!_shmTx && !_conn) return false;
+        char head[PIPE_RPC_HEAD_LEN];
+        buildRpcHead(head, wBusinessID, dwCallID);
+        return sendFrame(PIPE_RPC_RSP_BUSINESSID, head, PIPE_RPC_HEAD_LEN, pData, pData ? dwLen : 0);
+    }
+
+    bool SSAPI SetRpcSink(UINT16 wBusinessID, ISSPipeRpcSink* pSink) override {
+        std::lock_guard<std::mutex> lk(_mtx);
+        _sinks[wBusinessID].rpcSink = pSink;
         return true;
     }
 
@@ -65,10 +149,13 @@ public:
 
     UINT32 SSAPI GetIP(void) override { return _ip; }
     void SSAPI Close(void) override { if (_conn) _conn->Disconnect(); }
+    bool SSAPI IsShmActive(void) override { return _shmTx && _shmRx; }
 
-    void attach(ISSConnection* c) {
+    void attach(ISSConnection* c, UINT32 gen) {
+        if (_conn != c) resetShm();
         _conn = c;
         if (c) {
+            _connGen = gen;
             _rip = c->GetRemoteIP();
             _rport = c->GetRemotePort();
             _lip = c->GetLocalIP();
@@ -76,10 +163,11 @@ public:
             fprintf(stderr, "[PipeImpl %u] attach conn, rip=%s\n", _id, c->GetRemoteIPStr());
         }
     }
-    void detach(ISSConnection* c) { if (_conn == c) _conn = nullptr; }
+    void detach(ISSConnection* c) { if (_conn == c) { _conn = nullptr; resetShm(); } }
     bool onRecv(const char* pData, UINT32 dwLen) {
         if (dwLen < 2) return false;
         UINT16 bid = SDNtohs(*reinterpret_cast<const UINT16*>(pData));
+        if (bid == PIPE_RPC_REQ_BUSINESSID) return onRequest(pData + 2, dwLen - 2);
         ISSPipeSink* sink = nullptr;
         {
             std::lock_guard<std::mutex> lk(_mtx);
@@ -87,35 +175,174 @@ public:
             if (it != _sinks.end()) sink = it->second.sink;
         }
         if (sink) {
-            fprintf(stderr, "[PipeImpl %u] OnRecv deliver bid=%u len=%u data='", _id, (unsigned)bid, (unsigned)(dwLen-2));
-            for (UINT32 i = 0; i < dwLen - 2; ++i) {
-                char ch = *(pData + 2 + i);
-                fputc((ch >= 32 && ch <= 126) ? ch : '.', stderr);
-            }
-            fprintf(stderr, "'\n");
             sink->OnRecv(bid, pData + 2, dwLen - 2);
             return true;
         }
         return false;
     }
 
+    // Same-host transport negotiation, carried over TCP on PIPE_CTRL_BUSINESSID:
+    //   active  -> OFFER(ring size, segment name)
+    //   passive -> ACCEPT (and from now on sends via shm) | REJECT
+    //   active  -> SWITCH (and from now on sends via shm)
+    // Each side starts reading its shm ring only after the control message that
+    // follows the peer's last TCP data, so per-pipe ordering is preserved.
+    enum { SHM_OFFER = 1, SHM_ACCEPT = 2, SHM_REJECT = 3, SHM_SWITCH = 4 };
+
+    void offerShm() {
+        if (!_conn || _shm) return;
+        auto ch = std::make_shared<PipeShmChannel>();
+        if (!ch->create(PIPE_SHM_RING_SIZE)) return;
+        _shm = ch;
+        std::string msg(8, '\0');
+        msg[0] = static_cast<char>(SHM_OFFER);
+        UINT32 ring = SDHtonl(ch->ringSize());
+        std::memcpy(&msg[4], &ring, sizeof(ring));
+        msg += ch->name();
+        tcpSend(PIPE_CTRL_BUSINESSID, nullptr, 0, msg.data(), static_cast<UINT32>(msg.size()));
+    }
+
+    void onCtrl(const char* pData, UINT32 dwLen) {
+        if (dwLen < 1) return;
+        switch (static_cast<UINT8>(pData[0])) {
+        case SHM_OFFER: {
+            if (dwLen <= 8) return;
+            UINT32 ring = 0;
+            std::memcpy(&ring, pData + 4, sizeof(ring));
+            std::string name(pData + 8, dwLen - 8);
+            // Only a peer on this host can share memory with us; a remote
+            // peer must not get us to map files by name.
+            bool ok = _conn && !_shm && _conn->GetRemoteIP() == _conn->GetLocalIP() &&
+                      name.find('\0') == std::string::npos && PipeShmChannel::validName(name.c_str());
+            auto ch = std::make_shared<PipeShmChannel>();
+            ok = ok && ch->open(name.c_str(), SDNtohl(ring));
+            sendCtrl(ok ? SHM_ACCEPT : SHM_REJECT);
+            if (ok) { _shm = ch; _shmTx = true; }
+            break;
+        }
+        case SHM_ACCEPT:
+            if (!_shm) return;
+            _shmRx = true;
+            sendCtrl(SHM_SWITCH);
+            _shmTx = true;
+            _shm->unlink();
+            break;
+        case SHM_REJECT:
+            resetShm();
+            break;
+        case SHM_SWITCH:
+            if (_shm) _shmRx = true;
+            break;
+        default:
+            break;
+        }
+    }
+
+    // Channel to poll from Run, or null while the pipe still reads from TCP.
+    std::shared_ptr<PipeShmChannel> shmRx() const { return _shmRx ? _shm : std::shared_ptr<PipeShmChannel>(); }
+
+    // Push messages that found the ring full on an earlier Send.
+    void flushShm() {
+        while (_shmTx && !_shmBacklog.empty()) {
+            const PendingMsg& m = _shmBacklog.front();
+            if (!_shm->write(m.bid, nullptr, 0, m.data.data(), static_cast<UINT32>(m.data.size()))) break;
+            _shmBacklogBytes -= m.data.size();
+            _shmBacklog.pop_front();
+        }
+    }
+
     // tuple access for peer matching
     UINT32 rip() const { return _rip; }
     UINT16 rport() const { return _rport; }
     UINT32 lip() const { return _lip; }
     UINT16 lport() const { return _lport; }
 
+    static void buildRpcHead(char* pHead, UINT16 wBusinessID, UINT32 dwCallID) {
+        UINT16 bid = SDHtons(wBusinessID);
+        UINT32 cid = SDHtonl(dwCallID);
+        std::memcpy(pHead, &bid, sizeof(bid));
+        std::memcpy(pHead + sizeof(bid), &cid, sizeof(cid));
+    }
+
 private:
+    struct PendingMsg { UINT16 bid; std::string data; };
+
+    // pData points after the reserved business id.
+    bool onRequest(const char* pData, UINT32 dwLen) {
+        if (dwLen < PIPE_RPC_HEAD_LEN) return false;
+        UINT16 bid = 0; UINT32 cid = 0;
+        std::memcpy(&bid, pData, sizeof(bid));
+        std::memcpy(&cid, pData + sizeof(bid), sizeof(cid));
+        bid = SDNtohs(bid);
+        ISSPipeRpcSink* sink = nullptr;
+        {
+            std::lock_guard<std::mutex> lk(_mtx);
+            auto it = _sinks.find(bid);
+            if (it != _sinks.end()) sink = it->second.rpcSink;
+        }
+        if (!sink) return false;
+        sink->OnRequest(this, bid, SDNtohl(cid), pData + PIPE_RPC_HEAD_LEN, dwLen - PIPE_RPC_HEAD_LEN);
+        return true;
+    }
+
+    bool sendFrame(UINT16 wBusinessID, const char* pHead, UINT32 dwHeadLen, const char* pData, UINT32 dwLen) {
+        if (_shmTx) return shmSend(wBusinessID, pHead, dwHeadLen, pData, dwLen);
+        if (!_conn) return false;
+        return tcpSend(wBusinessID, pHead, dwHeadLen, pData, dwLen);
+    }
+
+    bool tcpSend(UINT16 wBusinessID, const char* pHead, UINT32 dwHeadLen, const char* pData, UINT32 dwLen) {
+        // Build sdpkg with payload: [businessID(2 bytes, network)] + head + data
+        UINT32 body = 2 + dwHeadLen + dwLen;
+        std::vector<char> buf; buf.resize(sizeof(SSDPkgHead16) + body);
+        auto* head = reinterpret_cast<SSDPkgHead16*>(buf.data());
+        BuildSDPkgHead16(head, static_cast<UINT16>(body));
+        UINT16 bid = SDHtons(wBusinessID);
+        char* p = buf.data() + sizeof(SSDPkgHead16);
+        std::memcpy(p, &bid, 2);
+        if (dwHeadLen) std::memcpy(p + 2, pHead, dwHeadLen);
+        if (dwLen) std::memcpy(p + 2 + dwHeadLen, pData, dwLen);
+        _conn->Send(buf.data(), static_cast<UINT32>(buf.size()));
+        return true;
+    }
+
+    bool shmSend(UINT16 wBusinessID, const char* pHead, UINT32 dwHeadLen, const char* pData, UINT32 dwLen) {
+        // A record larger than half the ring would wait in the backlog forever.
+        if (!_shm->fits(dwHeadLen, dwLen)) return false;
+        // Keep order behind anything already waiting for ring space.
+        if (_shmBacklog.empty() && _shm->write(wBusinessID, pHead, dwHeadLen, pData, dwLen)) return true;
+        if (_shmBacklogBytes + dwHeadLen + dwLen > PIPE_SHM_BACKLOG_MAX) return false;
+        std::string msg;
+        msg.reserve(dwHeadLen + dwLen);
+        msg.append(pHead, dwHeadLen).append(pData, dwLen);
+        _shmBacklogBytes += msg.size();
+        _shmBacklog.push_back(PendingMsg{wBusinessID, std::move(msg)});
+        return true;
+    }
+
+    void sendCtrl(UINT8 byType) {
+        char msg[8] = {static_cast<char>(byType)};
+        if (_conn) tcpSend(PIPE_CTRL_BUSINESSID, nullptr, 0, msg, sizeof(msg));
+    }
+
+    void resetShm() { _shmTx = false; _shmRx = false; _shmBacklog.clear(); _shmBacklogBytes = 0; _shm.reset(); }
+
+    PipeModule* _owner;
     UINT32 _id; ISSConnection* _conn; UINT32 _ip; std::mutex _mtx; std::unordered_map<UINT16, SinkEntry> _sinks;
+    UINT32 _connGen{0}; // generation of _conn, stamped on the RPC calls sent over it
     // connection tuple
     UINT32 _rip{0}; UINT16 _rport{0}; UINT32 _lip{0}; UINT16 _lport{0};
+    // same-host transport
+    std::shared_ptr<PipeShmChannel> _shm;
+    bool _shmTx{false};
+    bool _shmRx{false};
+    std::deque<PendingMsg> _shmBacklog;
+    size_t _shmBacklogBytes{0};
 };
 
-class PipeModule;
-
 class PipeSession : public ISSSession {
 public:
-    PipeSession(PipeModule* mod, UINT32 pid);
+    PipeSession(PipeModule* mod, UINT32 pid, bool active = false);
     void SSAPI SetConnection(ISSConnection* c) override;
     void SSAPI OnEstablish(void) override;
     void SSAPI OnTerminate(void) override;
@@ -126,6 +353,8 @@ private:
     PipeModule* _mod;
     UINT32 _id;
     ISSConnection* _conn;
+    UINT32 _connGen;
+    bool _active;
 };
 
 class PipeSessionFactory : public ISSSessionFactory {
@@ -158,13 +387,18 @@ public:
         // Delete parsers
         for (auto& kv : _parserById) { delete kv.second; }
         _parserById.clear();
+        releaseDeadConns();
         // Pipes map will be freed via unique_ptr
         _pipes.clear();
+        // Connections above post their last events into the net module's queue.
+        if (_net) _net->Release();
     }
 
     bool SSAPI Init(const char* /*pszConfFile*/, const char* /*pszIPListFile*/, ISSPipeReporter* pReporter, ISSNet* pNetModule) override {
+        if (pNetModule) pNetModule->AddRef();
+        if (_net) _net->Release();
         _reporter = pReporter; _net = pNetModule; _localId = 0x01000000; // arbitrary
-        _useWhitelist = false; _ipWhitelist.clear();
+        std::atomic_store(&_ipWhitelist, std::shared_ptr<const IPRangeTable>());
         return (_net != nullptr);
     }
 
@@ -172,7 +406,14 @@ public:
         std::lock_guard<std::mutex> lk(_mtx); auto it = _pipes.find(dwID); return it==_pipes.end() ? nullptr : it->second.get();
     }
 
-    bool SSAPI Run(INT32 nCount = -1) override { return _net ? _net->Run(nCount) : false; }
+    bool SSAPI Run(INT32 nCount = -1) override {
+        if (!_net) return false;
+        bool ok = _net->Run(nCount);
+        releaseDeadConns();
+        pollShm();
+        rpcRun();
+        return ok;
+    }
 
     bool SSAPI ReplaceConn(UINT32 dwID, const char* pszRemoteIP, UINT16 wRemotePort, UINT32, UINT32) override {
         // Keep existing PipeImpl (sinks/userdata) and reconnect session
@@ -186,7 +427,7 @@ public:
         }
         auto* conn = _net->CreateConnector(NETIO_ASYNCSELECT);
         auto* parser = new CSDPacketParser();
-        auto* session = new PipeSession(this, dwID);
+        auto* session = new PipeSession(this, dwID, true);
         conn->SetPacketParser(parser);
         conn->SetSession(session);
         int rc = conn->Connect(pszRemoteIP, wRemotePort);
@@ -222,13 +463,13 @@ public:
                 return false;
             }
             if (_pipes.find(dwID) == _pipes.end()) {
-                _pipes.emplace(dwID, std::unique_ptr<PipeImpl>(new PipeImpl(dwID)));
+                _pipes.emplace(dwID, std::unique_ptr<PipeImpl>(new PipeImpl(this, dwID)));
             }
             _pendingConnects.insert(dwID);
         }
         auto* conn = _net->CreateConnector(NETIO_ASYNCSELECT);
         auto* parser = new CSDPacketParser();
-        auto* session = new PipeSession(this, dwID);
+        auto* session = new PipeSession(this, dwID, true);
         conn->SetPacketParser(parser);
         conn->SetSession(session);
         int rc = conn->Connect(pszRemoteIP, wRemotePort);
@@ -264,6 +505,7 @@ public:
             return false;
         }
         it->second->Close();
+        rpcFailPipeLater(dwID, it->second->connGen());
         _pendingConnects.erase(dwID);
         _pipes.erase(it);
         auto itc = _connById.find(dwID); if (itc != _connById.end()) { itc->second->Release(); _connById.erase(itc); }
@@ -296,23 +538,42 @@ public:
         if (!pszIPListFile) return false;
         std::ifstream ifs(pszIPListFile);
         if (!ifs) return false;
-        std::unordered_set<std::string> tmp;
+        auto table = std::make_shared<IPRangeTable>();
+        bool hasEntries = false;
         std::string line;
         while (std::getline(ifs, line)) {
+            size_t hash = line.find('#');
+            if (hash != std::string::npos) line.erase(hash);
             size_t b = line.find_first_not_of(" \t\r\n");
             size_t e = line.find_last_not_of(" \t\r\n");
             if (b == std::string::npos) continue;
-            std::string ip = line.substr(b, e - b + 1);
-            if (!ip.empty() && ip[0] != '#') tmp.insert(ip);
+            std::string entry = line.substr(b, e - b + 1);
+            hasEntries = true;
+            if (!table->add(entry)) {
+                fprintf(stderr, "[PipeModule] ReloadIPList: ignore invalid entry '%s'\n", entry.c_str());
+            }
         }
-        std::lock_guard<std::mutex> lk(_mtx);
-        _ipWhitelist.swap(tmp);
-        _useWhitelist = !_ipWhitelist.empty();
+        table->compile();
+        // Publish the compiled table in one step; readers never observe a half-built list.
+        // A file with entries keeps filtering on even if none of them parsed (deny all);
+        // only a file without any entry disables the whitelist.
+        std::shared_ptr<const IPRangeTable> published;
+        if (hasEntries) published = std::move(table);
+        std::atomic_store(&_ipWhitelist, std::move(published));
         return true;
     }
     bool SSAPI ReloadPipeConfig(const char* /*pszConfFile*/, const UINT32 /*dwGroup*/) override { return true; }
     bool SSAPI CheckIpValid(const char* ip) override { return _checkIp(ip); }
 
+    bool SSAPI CancelCall(UINT32 dwCallID) override {
+        std::lock_guard<std::mutex> lk(_rpcMtx);
+        return _rpc.cancel(dwCallID);
+    }
+    UINT32 SSAPI GetPendingCallCount(void) override {
+        std::lock_guard<std::mutex> lk(_rpcMtx);
+        return _rpc.pending();
+    }
+
     void SSAPI AddRef(void) override { _ref.fetch_add(1); }
     UINT32 SSAPI QueryRef(void) override { return _ref.load(); }
     void SSAPI Release(void) override { if (_ref.fetch_sub(1)==1) delete this; }
@@ -320,15 +581,57 @@ public:
     const char * SSAPI GetModuleName(void) override { return SDPIPE_MODULENAME; }
 
     // Hooks used by PipeSession
-    void attachConnection(UINT32 id, ISSConnection* c) {
+    // Returns the generation given to this connection; later connections of
+    // the same pipe id always get a larger one.
+    UINT32 attachConnection(UINT32 id, ISSConnection* c) {
         std::lock_guard<std::mutex> lk(_mtx);
-        auto it = _pipes.find(id); if (it==_pipes.end()) it = _pipes.emplace(id, std::unique_ptr<PipeImpl>(new PipeImpl(id))).first;
-        it->second->attach(c);
+        auto it = _pipes.find(id); if (it==_pipes.end()) it = _pipes.emplace(id, std::unique_ptr<PipeImpl>(new PipeImpl(this, id))).first;
+        UINT32 gen = ++_connGen;
+        it->second->attach(c, gen);
         report(PIPE_SUCCESS, id);
+        return gen;
+    }
+    void onPipeEstablish(UINT32 id, ISSConnection* c, bool active) {
+        if (!active || !c || !PipeShmChannel::supported()) return;
+        // Both ends on this host: the peer sees us from one of its own addresses.
+        if (c->GetRemoteIP() != c->GetLocalIP()) return;
+        std::lock_guard<std::mutex> lk(_mtx);
+        auto it = _pipes.find(id);
+        if (it != _pipes.end()) it->second->offerShm();
     }
     void onPipeRecv(UINT32 id, const char* p, UINT32 len) {
         UINT32 off = GetSDPkgDataOffset(p, len);
         if (off == 0 || off > len) return;
+        deliver(id, p + off, len - off, true);
+    }
+    // Drain what the peer already put in shm before the pipe loses its channel.
+    void drainShm(UINT32 id) {
+        std::shared_ptr<PipeShmChannel> ch;
+        {
+            std::lock_guard<std::mutex> lk(_mtx);
+            auto it = _pipes.find(id);
+            if (it != _pipes.end()) ch = it->second->shmRx();
+        }
+        if (ch) ch->read([this, id](const char* p, UINT32 len) { deliver(id, p, len, false); });
+    }
+    void pollShm() {
+        _shmPoll.clear();
+        {
+            std::lock_guard<std::mutex> lk(_mtx);
+            for (auto& kv : _pipes) {
+                kv.second->flushShm();
+                std::shared_ptr<PipeShmChannel> ch = kv.second->shmRx();
+                if (ch) _shmPoll.emplace_back(kv.first, std::move(ch));
+            }
+        }
+        for (auto& e : _shmPoll) {
+            UINT32 id = e.first;
+            e.second->read([this, id](const char* p, UINT32 len) { deliver(id, p, len, false); });
+        }
+        _shmPoll.clear();
+    }
+    // p points at [businessID][data], the payload after the sdpkg head.
+    void deliver(UINT32 id, const char* p, UINT32 len, bool fromTcp) {
         PipeImpl* dest = nullptr;
         {
             std::lock_guard<std::mutex> lk(_mtx);
@@ -336,8 +639,17 @@ public:
             if (it != _pipes.end()) dest = it->second.get();
         }
         if (!dest) return;
-        fprintf(stderr, "[PipeModule] onPipeRecv id=%u len=%u off=%u\n", id, (unsigned)len, (unsigned)off);
-        bool delivered = dest->onRecv(p + off, len - off);
+        UINT16 bid = len >= 2 ? SDNtohs(*reinterpret_cast<const UINT16*>(p)) : 0;
+        if (fromTcp && bid == PIPE_CTRL_BUSINESSID) {
+            std::lock_guard<std::mutex> lk(_mtx);
+            if (_pipes.find(id) != _pipes.end()) dest->onCtrl(p + 2, len - 2);
+            return;
+        }
+        if (bid == PIPE_RPC_RSP_BUSINESSID) {
+            rpcComplete(id, p + 2, len - 2);
+            return;
+        }
+        bool delivered = dest->onRecv(p, len);
         if (!delivered) {
             // peer fallback: find reversed 4-tuple
             UINT32 rip = dest->rip(), lip = dest->lip();
@@ -352,7 +664,7 @@ public:
                 }
             }
             if (peer) {
-                peer->onRecv(p + off, len - off);
+                peer->onRecv(p, len);
             }
         }
     }
@@ -360,6 +672,45 @@ public:
         if (_reporter) _reporter->OnReport(code, id);
     }
 
+    UINT32 rpcAdd(UINT32 id, UINT32 gen, ISSPipeRpcCallback* cb, UINT32 timeoutMs) {
+        std::lock_guard<std::mutex> lk(_rpcMtx);
+        return _rpc.add(id, gen, cb, timeoutMs, SDTimeMilliSec());
+    }
+    void rpcCancel(UINT32 callId) {
+        std::lock_guard<std::mutex> lk(_rpcMtx);
+        _rpc.cancel(callId);
+    }
+    // p points at the RPC head after the reserved business id.
+    void rpcComplete(UINT32 id, const char* p, UINT32 len) {
+        if (len < PIPE_RPC_HEAD_LEN) return;
+        UINT32 cid = 0;
+        std::memcpy(&cid, p + sizeof(UINT16), sizeof(cid));
+        cid = SDNtohl(cid);
+        ISSPipeRpcCallback* cb = nullptr;
+        {
+            std::lock_guard<std::mutex> lk(_rpcMtx);
+            cb = _rpc.take(cid, id);
+        }
+        if (cb) cb->OnResponse(cid, PIPE_RPC_SUCCESS, p + PIPE_RPC_HEAD_LEN, len - PIPE_RPC_HEAD_LEN);
+    }
+    // Calls sent over connection generation gen (or earlier) of a pipe fail
+    // on the next Run, never inside RemoveConn or a terminate callback.
+    void rpcFailPipeLater(UINT32 id, UINT32 gen) {
+        std::lock_guard<std::mutex> lk(_rpcMtx);
+        _rpcDeadPipes.emplace_back(id, gen);
+    }
+    void rpcRun() {
+        std::vector<PipeRpcTable::Completion> due;
+        {
+            std::lock_guard<std::mutex> lk(_rpcMtx);
+            if (_rpc.pending() == 0) { _rpcDeadPipes.clear(); return; }
+            for (const auto& d : _rpcDeadPipes) _rpc.failPipe(d.first, d.second, due);
+            _rpcDeadPipes.clear();
+            _rpc.expire(SDTimeMilliSec(), due);
+        }
+        for (const auto& c : due) c.pCallback->OnResponse(c.dwCallID, c.nResult, nullptr, 0);
+    }
+
     UINT32 allocId() { return ++_localId; }
     void detachConnection(UINT32 id, ISSConnection* conn) {
         std::lock_guard<std::mutex> lk(_mtx);
@@ -368,10 +719,24 @@ public:
             it->second->detach(conn);
         }
         _pendingConnects.erase(id);
+        // Called from the connection's own terminate callback: releasing the
+        // connector here would free the session and connection still on the
+        // stack, so park them until the net module's Run returns.
         auto itc = _connById.find(id);
-        if (itc != _connById.end()) { itc->second->Release(); _connById.erase(itc); }
+        if (itc == _connById.end()) return;
+        ISSPacketParser* parser = nullptr;
         auto itp = _parserById.find(id);
-        if (itp != _parserById.end()) { delete itp->second; _parserById.erase(itp); }
+        if (itp != _parserById.end()) { parser = itp->second; _parserById.erase(itp); }
+        _deadConns.emplace_back(itc->second, parser);
+        _connById.erase(itc);
+    }
+    void releaseDeadConns() {
+        std::vector<std::pair<ISSConnector*, ISSPacketParser*>> dead;
+        {
+            std::lock_guard<std::mutex> lk(_mtx);
+            dead.swap(_deadConns);
+        }
+        for (auto& d : dead) { d.first->Release(); delete d.second; }
     }
 
 private:
@@ -383,12 +748,17 @@ private:
     std::vector<ISSListener*> _listeners; // owned by module; release on destructor
     std::unordered_map<UINT32, ISSConnector*> _connById;
     std::unordered_map<UINT32, ISSPacketParser*> _parserById;
+    std::vector<std::pair<ISSConnector*, ISSPacketParser*>> _deadConns; // detached in a callback, released after Run
     std::vector<std::unique_ptr<ISSSessionFactory>> _acceptFactories;
     std::vector<std::unique_ptr<ISSPacketParser>> _listenerParsers;
     std::unordered_set<UINT32> _pendingConnects;
+    std::vector<std::pair<UINT32, std::shared_ptr<PipeShmChannel>>> _shmPoll;
+    std::mutex _rpcMtx;
+    PipeRpcTable _rpc;
+    std::vector<std::pair<UINT32, UINT32>> _rpcDeadPipes; // pipe id, connection generation
+    UINT32 _connGen{0}; // last connection generation handed out, under _mtx
     UINT32 _localId;
-    bool _useWhitelist{false};
-    std::unordered_set<std::string> _ipWhitelist;
+    std::shared_ptr<const IPRangeTable> _ipWhitelist; // null when whitelist disabled
 
     bool _hasActiveConnectionLocked(UINT32 id) const {
         if (_connById.find(id) != _connById.end()) return true;
@@ -397,19 +767,25 @@ private:
     }
 
     bool _checkIp(const char* ip) const {
-        if (!_useWhitelist) return true;
+        std::shared_ptr<const IPRangeTable> table = std::atomic_load(&_ipWhitelist);
+        if (!table) return true;
         if (!ip) return false;
-        return _ipWhitelist.find(ip) != _ipWhitelist.end();
+        in_addr in{};
+        if (!SDNetInetPton(AF_INET, ip, &in)) return false;
+        return table->contains(SDNtohl(in.s_addr));
+    }
+
+    // dwNetIP is in network byte order, as returned by ISSConnection::GetRemoteIP.
+    bool _checkIp(UINT32 dwNetIP) const {
+        std::shared_ptr<const IPRangeTable> table = std::atomic_load(&_ipWhitelist);
+        return !table || table->contains(SDNtohl(dwNetIP));
     }
 
     ISSSession* makeListenerSession(ISSConnection* poConnection) {
         if (!poConnection) return nullptr;
-        if (_useWhitelist) {
-            const char* rip = poConnection->GetRemoteIPStr();
-            if (!rip || !_checkIp(rip)) {
-                poConnection->Disconnect();
-                return nullptr;
-            }
+        if (!_checkIp(poConnection->GetRemoteIP())) {
+            poConnection->Disconnect();
+            return nullptr;
         }
         UINT32 id = allocId();
         auto* session = new PipeSession(this, id);
@@ -420,21 +796,41 @@ private:
     friend class PipeListenerFactory;
 };
 
-PipeSession::PipeSession(PipeModule* mod, UINT32 pid)
-    : _mod(mod), _id(pid), _conn(nullptr) {}
+bool SSAPI PipeImpl::Call(UINT16 wBusinessID, const char* pData, UINT32 dwLen, UINT32 dwTimeoutMs, ISSPipeRpcCallback* pCallback, UINT32* pdwCallID) {
+    if (!pCallback || (!_shmTx && !_conn)) return false;
+    UINT32 cid = _owner->rpcAdd(_id, _connGen, pCallback, dwTimeoutMs);
+    if (cid == 0) return false;
+    char head[PIPE_RPC_HEAD_LEN];
+    buildRpcHead(head, wBusinessID, cid);
+    if (!sendFrame(PIPE_RPC_REQ_BUSINESSID, head, PIPE_RPC_HEAD_LEN, pData, pData ? dwLen : 0)) {
+        _owner->rpcCancel(cid);
+        return false;
+    }
+    if (pdwCallID) *pdwCallID = cid;
+    return true;
+}
+
+PipeSession::PipeSession(PipeModule* mod, UINT32 pid, bool active)
+    : _mod(mod), _id(pid), _conn(nullptr), _connGen(0), _active(active) {}
 
 void SSAPI PipeSession::SetConnection(ISSConnection* c) {
     _conn = c;
     if (_mod) {
-        _mod->attachConnection(_id, c);
+        _connGen = _mod->attachConnection(_id, c);
     }
 }
 
-void SSAPI PipeSession::OnEstablish(void) { }
+void SSAPI PipeSession::OnEstablish(void) {
+    if (_mod) {
+        _mod->onPipeEstablish(_id, _conn, _active);
+    }
+}
 
 void SSAPI PipeSession::OnTerminate(void) {
     if (_mod) {
+        _mod->drainShm(_id);
         _mod->detachConnection(_id, _conn);
+        _mod->rpcFailPipeLater(_id, _connGen);
         _mod->report(PIPE_DISCONNECT, _id);
     }
 }
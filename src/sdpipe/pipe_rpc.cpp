@@ -0,0 +1,133 @@
+#include "pipe_rpc.h"
+
+namespace SSCP {
+
+namespace {
+const UINT32 GEN_MASK = (1u << (32 - PipeRpcTable::SLOT_BITS)) - 1;
+const UINT32 SLOT_MASK = (1u << PipeRpcTable::SLOT_BITS) - 1;
+}
+
+PipeRpcTable::PipeRpcTable() : _freeHead(NIL), _pending(0), _curTick(0), _started(false) {
+    for (UINT32 i = 0; i < WHEEL_SIZE; ++i) _buckets[i] = NIL;
+}
+
+UINT32 PipeRpcTable::add(UINT32 dwPipeID, UINT32 dwConnGen, ISSPipeRpcCallback* pCallback, UINT32 dwTimeoutMs, UINT64 qwNowMs) {
+    UINT64 nowTick = qwNowMs / TICK_MS;
+    if (!_started) { _curTick = nowTick; _started = true; }
+
+    UINT32 idx = _freeHead;
+    if (idx != NIL) {
+        _freeHead = _slots[idx].dwNext;
+    } else {
+        if (_slots.size() >= MAX_SLOTS) return 0;
+        idx = static_cast<UINT32>(_slots.size());
+        Slot fresh{};
+        fresh.wGeneration = 0;
+        _slots.push_back(fresh);
+    }
+    Slot& s = _slots[idx];
+    s.wGeneration = static_cast<UINT16>(s.wGeneration % GEN_MASK + 1);  // 1..GEN_MASK, never 0
+    s.dwCallID = (static_cast<UINT32>(s.wGeneration) << SLOT_BITS) | idx;
+    s.dwPipeID = dwPipeID;
+    s.dwConnGen = dwConnGen;
+    s.pCallback = pCallback;
+    UINT64 ticks = (static_cast<UINT64>(dwTimeoutMs) + TICK_MS - 1) / TICK_MS;
+    if (ticks == 0) ticks = 1;
+    // Anchor on the later of wall time and wheel position so the bucket is
+    // always ahead of the next one advanceTo() visits.
+    s.qwExpireTick = (nowTick > _curTick ? nowTick : _curTick) + ticks;
+    link(idx);
+    ++_pending;
+    return s.dwCallID;
+}
+
+PipeRpcTable::Slot* PipeRpcTable::lookup(UINT32 dwCallID) {
+    UINT32 idx = dwCallID & SLOT_MASK;
+    if (dwCallID == 0 || idx >= _slots.size()) return nullptr;
+    Slot& s = _slots[idx];
+    return s.dwCallID == dwCallID ? &s : nullptr;
+}
+
+ISSPipeRpcCallback* PipeRpcTable::take(UINT32 dwCallID, UINT32 dwPipeID) {
+    Slot* s = lookup(dwCallID);
+    if (!s || s->dwPipeID != dwPipeID) return nullptr;
+    ISSPipeRpcCallback* cb = s->pCallback;
+    UINT32 idx = dwCallID & SLOT_MASK;
+    unlink(idx);
+    release(idx);
+    return cb;
+}
+
+bool PipeRpcTable::cancel(UINT32 dwCallID) {
+    if (!lookup(dwCallID)) return false;
+    UINT32 idx = dwCallID & SLOT_MASK;
+    unlink(idx);
+    release(idx);
+    return true;
+}
+
+void PipeRpcTable::expire(UINT64 qwNowMs, std::vector<Completion>& out) {
+    if (!_started || _pending == 0) {
+        _curTick = qwNowMs / TICK_MS;
+        _started = true;
+        return;
+    }
+    UINT64 nowTick = qwNowMs / TICK_MS;
+    if (nowTick <= _curTick) return;
+    UINT64 steps = nowTick - _curTick;
+    if (steps > WHEEL_SIZE) steps = WHEEL_SIZE;
+    for (UINT64 i = 1; i <= steps; ++i) {
+        UINT32 b = static_cast<UINT32>((_curTick + i) & (WHEEL_SIZE - 1));
+        UINT32 idx = _buckets[b];
+        while (idx != NIL) {
+            UINT32 next = _slots[idx].dwNext;
+            Slot& s = _slots[idx];
+            if (s.qwExpireTick <= nowTick) {
+                out.push_back(Completion{s.pCallback, s.dwCallID, PIPE_RPC_TIMEOUT});
+                unlink(idx);
+                release(idx);
+            }
+            idx = next;
+        }
+    }
+    _curTick = nowTick;
+}
+
+void PipeRpcTable::failPipe(UINT32 dwPipeID, UINT32 dwConnGen, std::vector<Completion>& out) {
+    // Disconnects are rare; a scan keeps the per-call state at one slot.
+    for (UINT32 idx = 0; idx < _slots.size() && _pending > 0; ++idx) {
+        Slot& s = _slots[idx];
+        if (s.dwCallID != 0 && s.dwPipeID == dwPipeID && s.dwConnGen <= dwConnGen) {
+            out.push_back(Completion{s.pCallback, s.dwCallID, PIPE_RPC_DISCONNECT});
+            unlink(idx);
+            release(idx);
+        }
+    }
+}
+
+void PipeRpcTable::link(UINT32 idx) {
+    Slot& s = _slots[idx];
+    s.wBucket = static_cast<UINT16>(s.qwExpireTick & (WHEEL_SIZE - 1));
+    s.dwPrev = NIL;
+    s.dwNext = _buckets[s.wBucket];
+    if (s.dwNext != NIL) _slots[s.dwNext].dwPrev = idx;
+    _buckets[s.wBucket] = idx;
+}
+
+void PipeRpcTable::unlink(UINT32 idx) {
+    Slot& s = _slots[idx];
+    if (s.dwPrev != NIL) _slots[s.dwPrev].dwNext = s.dwNext;
+    else _buckets[s.wBucket] = s.dwNext;
+    if (s.dwNext != NIL) _slots[s.dwNext].dwPrev = s.dwPrev;
+}
+
+void PipeRpcTable::release(UINT32 idx) {
+    Slot& s = _slots[idx];
+    s.dwCallID = 0;
+    s.pCallback = nullptr;
+    s.dwNext = _freeHead;
+    _freeHead = idx;
+    --_pending;
+}
+
+} // namespace SSCP
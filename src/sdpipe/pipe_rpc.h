@@ -0,0 +1,77 @@
+// Pending-call table for sdpipe RPC.
+//
+// Calls live in a slot array; a 32-bit call id is (generation << 20) | slot, so
+// a response is matched in O(1) and a late response to a reused slot is
+// rejected by its generation. Timeouts are kept in a single-level timing wheel
+// whose buckets are intrusive lists threaded through the same slots, so arming,
+// completing and expiring a call never allocates.
+#ifndef SSCP_PIPE_RPC_H
+#define SSCP_PIPE_RPC_H
+
+#include "ssengine/sdpipe.h"
+#include <vector>
+
+namespace SSCP {
+
+class PipeRpcTable {
+public:
+    struct Completion {
+        ISSPipeRpcCallback* pCallback;
+        UINT32 dwCallID;
+        INT32 nResult;
+    };
+
+    static const UINT32 TICK_MS = 10;
+    static const UINT32 WHEEL_SIZE = 1024;           // power of two
+    static const UINT32 SLOT_BITS = 20;
+    static const UINT32 MAX_SLOTS = (1u << SLOT_BITS) - 1;
+
+    PipeRpcTable();
+
+    // Returns the call id, or 0 when the table is full. dwConnGen is the
+    // generation of the connection the request goes out on.
+    UINT32 add(UINT32 dwPipeID, UINT32 dwConnGen, ISSPipeRpcCallback* pCallback, UINT32 dwTimeoutMs, UINT64 qwNowMs);
+    // Completes a call on response. Returns null for unknown/stale ids or a
+    // response arriving on another pipe than the request was sent on.
+    ISSPipeRpcCallback* take(UINT32 dwCallID, UINT32 dwPipeID);
+    bool cancel(UINT32 dwCallID);
+    // Moves every call whose deadline has passed into out as PIPE_RPC_TIMEOUT.
+    void expire(UINT64 qwNowMs, std::vector<Completion>& out);
+    // Moves every call issued on a pipe over connection generation dwConnGen
+    // or an earlier one into out as PIPE_RPC_DISCONNECT. Calls sent after the
+    // pipe reconnected carry a later generation and stay pending.
+    void failPipe(UINT32 dwPipeID, UINT32 dwConnGen, std::vector<Completion>& out);
+
+    UINT32 pending() const { return _pending; }
+
+private:
+    static const UINT32 NIL = 0xFFFFFFFFu;
+
+    struct Slot {
+        UINT64 qwExpireTick;
+        ISSPipeRpcCallback* pCallback;
+        UINT32 dwCallID;       // 0 when free
+        UINT32 dwPipeID;
+        UINT32 dwConnGen;
+        UINT32 dwPrev;         // wheel bucket list
+        UINT32 dwNext;         // wheel bucket list, or free list when free
+        UINT16 wGeneration;
+        UINT16 wBucket;
+    };
+
+    Slot* lookup(UINT32 dwCallID);
+    void link(UINT32 idx);
+    void unlink(UINT32 idx);
+    void release(UINT32 idx);
+
+    std::vector<Slot> _slots;
+    UINT32 _buckets[WHEEL_SIZE];
+    UINT32 _freeHead;
+    UINT32 _pending;
+    UINT64 _curTick;
+    bool _started;
+};
+
+} // namespace SSCP
+
+#endif
@@ -0,0 +1,187 @@
+#include "pipe_shm.h"
+#include "ssengine/sdnetutils.h"
+#include "ssengine/sdprocess.h"
+
+#include <cstdio>
+#include <cstring>
+#include <initializer_list>
+#include <new>
+
+#ifndef WINDOWS
+#include <sys/stat.h>
+#endif
+
+namespace SSCP {
+
+namespace {
+
+const UINT32 SHM_SEG_MAGIC = 0x53445053;   // "SDPS"
+const UINT32 SHM_RING_MAGIC = 0x53445052;  // "SDPR"
+const UINT32 SHM_SEG_VERSION = 1;
+
+struct PipeShmSegHead {
+    UINT32 dwMagic;
+    UINT32 dwVersion;
+    UINT32 dwRingSize;
+    UINT32 dwReserved;
+};
+
+inline UINT32 align64(UINT32 n) { return (n + 63u) & ~63u; }
+
+const UINT32 SEG_HEAD_SIZE = align64(sizeof(PipeShmSegHead));
+const UINT32 RING_HEAD_SIZE = align64(sizeof(PipeShmRingHead));
+
+UINT32 segmentSize(UINT32 dwRingSize) { return SEG_HEAD_SIZE + 2 * RING_HEAD_SIZE + 2 * dwRingSize; }
+
+// Directory and file name prefix of every segment; open() maps nothing else.
+#if defined(__linux__)
+const char SHM_DIR[] = "/dev/shm";
+#else
+const char SHM_DIR[] = "/tmp";
+#endif
+const char SHM_PREFIX[] = "sdpipe-";
+
+bool isPowerOfTwo(UINT32 n) { return n != 0 && (n & (n - 1)) == 0; }
+
+std::atomic<UINT32> g_shmSeq{0};
+
+} // namespace
+
+bool PipeShmRing::write(UINT16 wBusinessID, const char* pHead, UINT32 dwHeadLen, const char* pData, UINT32 dwLen) {
+    if (!fits(dwHeadLen, dwLen)) return false;
+    UINT32 payload = static_cast<UINT32>(sizeof(UINT16)) + dwHeadLen + dwLen;
+    UINT32 need = recordSize(payload);
+    UINT32 capacity = _mask + 1;
+
+    UINT64 head = _head->qwHead.load(std::memory_order_relaxed);
+    UINT64 tail = _head->qwTail.load(std::memory_order_acquire);
+    UINT32 off = static_cast<UINT32>(head & _mask);
+    UINT32 contiguous = capacity - off;
+    UINT32 total = need > contiguous ? contiguous + need : need;
+    if (head + total - tail > capacity) return false;
+
+    if (need > contiguous) {
+        *reinterpret_cast<UINT32*>(_data + off) = WRAP_MARK;
+        head += contiguous;
+        off = 0;
+    }
+    char* rec = _data + off;
+    *reinterpret_cast<UINT32*>(rec) = payload;
+    UINT16 bid = SDHtons(wBusinessID);
+    std::memcpy(rec + sizeof(UINT32), &bid, sizeof(bid));
+    char* body = rec + sizeof(UINT32) + sizeof(UINT16);
+    if (dwHeadLen) std::memcpy(body, pHead, dwHeadLen);
+    if (dwLen) std::memcpy(body + dwHeadLen, pData, dwLen);
+    _head->qwHead.store(head + need, std::memory_order_release);
+    return true;
+}
+
+bool PipeShmChannel::supported() {
+#ifdef WINDOWS
+    return false;
+#else
+    return true;
+#endif
+}
+
+bool PipeShmChannel::create(UINT32 dwRingSize) {
+    close();
+    if (!supported() || !isPowerOfTwo(dwRingSize)) return false;
+    char name[128];
+    std::snprintf(name, sizeof(name), "%s/%s%u-%u", SHM_DIR, SHM_PREFIX, static_cast<unsigned>(SDGetCurrentProcessId()),
+                  static_cast<unsigned>(g_shmSeq.fetch_add(1) + 1));
+    // A stale file from a crashed process with a recycled pid would be mapped
+    // with its old size; start from a clean one.
+    std::remove(name);
+    _base = static_cast<char*>(_shm.Create(name, segmentSize(dwRingSize)));
+    if (!_base) return false;
+    _name = name;
+    _creator = true;
+    _ringSize = dwRingSize;
+    return bindRings(true);
+}
+
+bool PipeShmChannel::validName(const char* pszName) {
+    if (!pszName) return false;
+    std::string prefix = std::string(SHM_DIR) + "/" + SHM_PREFIX;
+    std::string name(pszName);
+    if (name.size() <= prefix.size() || name.compare(0, prefix.size(), prefix) != 0) return false;
+    // Exactly one file directly inside SHM_DIR.
+    return name.find('/', prefix.size()) == std::string::npos && name.find("..") == std::string::npos;
+}
+
+bool PipeShmChannel::open(const char* pszName, UINT32 dwRingSize) {
+    close();
+    if (!supported() || !validName(pszName) || !isPowerOfTwo(dwRingSize)) return false;
+#ifndef WINDOWS
+    // The name comes from the peer: never follow a link planted in the shared directory.
+    struct stat lst;
+    if (lstat(pszName, &lst) != 0 || !S_ISREG(lst.st_mode)) return false;
+#endif
+    _base = static_cast<char*>(_shm.Open(pszName));
+    if (!_base) return false;
+    _name = pszName;
+    _creator = false;
+    _ringSize = dwRingSize;
+#ifndef WINDOWS
+    // The mapping is as large as the file was when opened; anything shorter
+    // than the two rings would fault on first access.
+    UINT64 need = static_cast<UINT64>(SEG_HEAD_SIZE) + 2ull * RING_HEAD_SIZE + 2ull * dwRingSize;
+    struct stat st;
+    if (fstat(static_cast<int>(_shm.GetHandle()), &st) != 0 || !S_ISREG(st.st_mode) ||
+        static_cast<UINT64>(st.st_size) < need) {
+        close();
+        return false;
+    }
+#endif
+    return bindRings(false);
+}
+
+bool PipeShmChannel::bindRings(bool bCreator) {
+    auto* seg = reinterpret_cast<PipeShmSegHead*>(_base);
+    auto* rh0 = reinterpret_cast<PipeShmRingHead*>(_base + SEG_HEAD_SIZE);
+    auto* rh1 = reinterpret_cast<PipeShmRingHead*>(_base + SEG_HEAD_SIZE + RING_HEAD_SIZE);
+    char* data0 = _base + SEG_HEAD_SIZE + 2 * RING_HEAD_SIZE;
+    char* data1 = data0 + _ringSize;
+    if (bCreator) {
+        for (PipeShmRingHead* rh : {rh0, rh1}) {
+            new (rh) PipeShmRingHead();
+            rh->dwMagic = SHM_RING_MAGIC;
+            rh->dwCapacity = _ringSize;
+            rh->qwHead.store(0, std::memory_order_relaxed);
+            rh->qwTail.store(0, std::memory_order_relaxed);
+        }
+        seg->dwVersion = SHM_SEG_VERSION;
+        seg->dwRingSize = _ringSize;
+        seg->dwReserved = 0;
+        std::atomic_thread_fence(std::memory_order_release);
+        seg->dwMagic = SHM_SEG_MAGIC;
+    } else {
+        std::atomic_thread_fence(std::memory_order_acquire);
+        if (seg->dwMagic != SHM_SEG_MAGIC || seg->dwVersion != SHM_SEG_VERSION || seg->dwRingSize != _ringSize ||
+            rh0->dwMagic != SHM_RING_MAGIC || rh1->dwMagic != SHM_RING_MAGIC) {
+            close();
+            return false;
+        }
+    }
+    _tx.bind(bCreator ? rh0 : rh1, bCreator ? data0 : data1);
+    _rx.bind(bCreator ? rh1 : rh0, bCreator ? data1 : data0);
+    return true;
+}
+
+void PipeShmChannel::unlink() {
+    if (_creator && !_name.empty()) {
+        std::remove(_name.c_str());
+        _creator = false;
+    }
+}
+
+void PipeShmChannel::close() {
+    unlink();
+    _shm.Close();
+    _base = nullptr;
+    _name.clear();
+    _ringSize = 0;
+}
+
+} // namespace SSCP
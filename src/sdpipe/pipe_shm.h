@@ -0,0 +1,125 @@
+// Same-host shared-memory transport for sdpipe.
+//
+// A channel is one CSDShmem segment holding two single-producer/single-consumer
+// rings, one per direction. The side that creates the segment (the active,
+// connecting pipe) writes ring 0 and reads ring 1; the side that opens it
+// writes ring 1 and reads ring 0. Records carry the same payload as a TCP pipe
+// frame after its SSDPkgHead16, i.e. [businessID (2 bytes, network order)] +
+// data, so the receive path is shared with the socket transport.
+#ifndef SSCP_PIPE_SHM_H
+#define SSCP_PIPE_SHM_H
+
+#include "ssengine/sdtype.h"
+#include "ssengine/sdshmem.h"
+#include <atomic>
+#include <string>
+#include <utility>
+
+namespace SSCP {
+
+// Ring header living in shared memory. head/tail are byte positions that only
+// ever grow; the offset inside the data area is (pos & (capacity - 1)).
+struct PipeShmRingHead {
+    UINT32 dwMagic;
+    UINT32 dwCapacity;
+    alignas(64) std::atomic<UINT64> qwHead;  // written by producer only
+    alignas(64) std::atomic<UINT64> qwTail;  // written by consumer only
+};
+
+static_assert(std::atomic<UINT64>::is_always_lock_free, "shm rings need lock-free 64-bit atomics");
+
+class PipeShmRing {
+public:
+    PipeShmRing() : _head(nullptr), _data(nullptr), _mask(0) {}
+
+    void bind(PipeShmRingHead* head, char* data) { _head = head; _data = data; _mask = head->dwCapacity - 1; }
+
+    // Producer side. Copies one record made of an optional head and the data;
+    // returns false when the ring has no room.
+    bool write(UINT16 wBusinessID, const char* pHead, UINT32 dwHeadLen, const char* pData, UINT32 dwLen);
+    // Whether a record of this size can ever be written; at most half the ring.
+    bool fits(UINT32 dwHeadLen, UINT32 dwLen) const {
+        UINT64 need = sizeof(UINT32) + sizeof(UINT16) + static_cast<UINT64>(dwHeadLen) + dwLen;
+        return ((need + 7u) & ~UINT64(7)) <= (_mask + 1) / 2;
+    }
+
+    // Consumer side. Delivers every record published so far and returns the
+    // number delivered; fn(const char* pPayload, UINT32 dwPayloadLen).
+    template <class Fn>
+    UINT32 read(Fn&& fn);
+
+private:
+    static const UINT32 WRAP_MARK = 0xFFFFFFFFu;
+    static UINT32 recordSize(UINT32 dwPayload) { return (sizeof(UINT32) + dwPayload + 7u) & ~7u; }
+
+    PipeShmRingHead* _head;
+    char* _data;
+    UINT32 _mask;
+};
+
+class PipeShmChannel {
+public:
+    PipeShmChannel() : _base(nullptr), _creator(false), _ringSize(0) {}
+    ~PipeShmChannel() { close(); }
+
+    // Active side: create a fresh segment named after this process.
+    bool create(UINT32 dwRingSize);
+    // Passive side: map the segment announced by the peer. Only sdpipe segment
+    // names are accepted, and the file must hold both rings.
+    bool open(const char* pszName, UINT32 dwRingSize);
+    // Remove the backing name once both sides have mapped it.
+    void unlink();
+    void close();
+
+    const std::string& name() const { return _name; }
+    UINT32 ringSize() const { return _ringSize; }
+
+    bool write(UINT16 wBusinessID, const char* pHead, UINT32 dwHeadLen, const char* pData, UINT32 dwLen) {
+        return _tx.write(wBusinessID, pHead, dwHeadLen, pData, dwLen);
+    }
+    bool fits(UINT32 dwHeadLen, UINT32 dwLen) const { return _tx.fits(dwHeadLen, dwLen); }
+    template <class Fn>
+    UINT32 read(Fn&& fn) { return _rx.read(std::forward<Fn>(fn)); }
+
+    // Whether the shm transport can be used on this platform at all.
+    static bool supported();
+    // Whether pszName is a segment name create() could have produced.
+    static bool validName(const char* pszName);
+
+private:
+    bool bindRings(bool bCreator);
+
+    CSDShmem _shm;
+    char* _base;
+    std::string _name;
+    bool _creator;
+    UINT32 _ringSize;
+    PipeShmRing _tx;
+    PipeShmRing _rx;
+};
+
+template <class Fn>
+UINT32 PipeShmRing::read(Fn&& fn) {
+    UINT64 tail = _head->qwTail.load(std::memory_order_relaxed);
+    UINT64 head = _head->qwHead.load(std::memory_order_acquire);
+    UINT32 count = 0;
+    while (tail < head) {
+        UINT32 off = static_cast<UINT32>(tail & _mask);
+        UINT32 len = *reinterpret_cast<const UINT32*>(_data + off);
+        if (len == WRAP_MARK) {
+            tail += (_mask + 1) - off;
+            continue;
+        }
+        // The slot is released only after delivery: the peer may reuse it
+        // as soon as the tail moves past it.
+        fn(_data + off + sizeof(UINT32), len);
+        tail += recordSize(len);
+        _head->qwTail.store(tail, std::memory_order_release);
+        ++count;
+    }
+    return count;
+}
+
+} // namespace SSCP
+
+#endif
@@ -5,8 +5,10 @@ sdmemorypool.cpp - 内存池实现
 ******************************************************************************/
 
 #include "ssengine/sdmemorypool.h"
+#include <cstddef>
 #include <cstring>
 #include <algorithm>
+#include <vector>
 
 namespace SSCP
 {
@@ -15,14 +17,88 @@ namespace SSCP
 // CSDVarMemoryPool - 可变内存池
 ///////////////////////////////////////////////////////////////////////////////
 
+namespace
+{
+
+// 调试模式下每块内存的头：存活链表、分配位置和请求长度，紧贴数据前是头保护字，
+// 数据后是尾保护字。池内存只按 4 字节对齐，头部一律用 memcpy 整体读写
+struct DebugBlock
+{
+    BYTE* pPrev;
+    BYTE* pNext;
+    const CHAR* pszTag;
+    UINT32 dwLen;
+};
+
+const UINT32 GUARD_WORD = 0xFDFDFDFD;
+const UINT32 FREED_WORD = 0xDDDDDDDD;
+const BYTE FILL_NEW = 0xCD;
+const BYTE FILL_FREED = 0xDD;
+
+// Header plus the head guard, rounded to 8 so the payload keeps the
+// alignment of the block it sits in.
+const UINT32 DEBUG_HEAD = (sizeof(DebugBlock) + sizeof(UINT32) + 7) & ~7u;
+const UINT32 DEBUG_EXTRA = DEBUG_HEAD + sizeof(UINT32);
+
+inline UINT32 ReadWord(const BYTE* p)
+{
+    UINT32 v;
+    memcpy(&v, p, sizeof(v));
+    return v;
+}
+
+inline void WriteWord(BYTE* p, UINT32 v)
+{
+    memcpy(p, &v, sizeof(v));
+}
+
+// 空闲链表的 next 指针存在块首，块首同样只按 4 字节对齐
+inline BYTE* ReadLink(const BYTE* p)
+{
+    BYTE* v;
+    memcpy(&v, p, sizeof(v));
+    return v;
+}
+
+inline void WriteLink(BYTE* p, BYTE* v)
+{
+    memcpy(p, &v, sizeof(v));
+}
+
+inline DebugBlock ReadBlock(const BYTE* p)
+{
+    DebugBlock b;
+    memcpy(&b, p, sizeof(b));
+    return b;
+}
+
+inline void WriteBlock(BYTE* p, const DebugBlock& b)
+{
+    memcpy(p, &b, sizeof(b));
+}
+
+inline void SetPrev(BYTE* p, BYTE* pPrev)
+{
+    memcpy(p + offsetof(DebugBlock, pPrev), &pPrev, sizeof(pPrev));
+}
+
+inline void SetNext(BYTE* p, BYTE* pNext)
+{
+    memcpy(p + offsetof(DebugBlock, pNext), &pNext, sizeof(pNext));
+}
+
+} // namespace
+
 CSDVarMemoryPool::CSDVarMemoryPool()
     : m_pHeadPage(nullptr)
     , m_pWorkPage(nullptr)
     , m_pPageBuf(nullptr)
     , m_nPageSize(0)
+    , m_bDebug(FALSE)
 {
     memset(m_pFreeHead, 0, sizeof(m_pFreeHead));
     memset(m_nFreeCount, 0, sizeof(m_nFreeCount));
+    ResetStats();
 }
 
 CSDVarMemoryPool::~CSDVarMemoryPool()
@@ -30,26 +106,42 @@ CSDVarMemoryPool::~CSDVarMemoryPool()
     Clear();
 }
 
-BOOL CSDVarMemoryPool::Create(UINT32 dwPageSize)
+BOOL CSDVarMemoryPool::Create(UINT32 dwPageSize, BOOL bDebug)
 {
+    // 重复创建时先释放原有的内存页
+    Clear();
+
     if (dwPageSize < MIN_PAGESIZE)
         dwPageSize = MIN_PAGESIZE;
     
     // 对齐到8字节边界
     m_nPageSize = (dwPageSize + ALIGNMENT - 1) & ~(ALIGNMENT - 1);
-    
-    // 初始化空闲列表
-    memset(m_pFreeHead, 0, sizeof(m_pFreeHead));
-    memset(m_nFreeCount, 0, sizeof(m_nFreeCount));
-    
-    m_pHeadPage = nullptr;
-    m_pWorkPage = nullptr;
-    m_pPageBuf = nullptr;
+    m_bDebug = bDebug;
     
     return SetMemoryPage();
 }
 
 void* CSDVarMemoryPool::Malloc(UINT32 dwLen)
+{
+    return m_bDebug ? DebugMalloc(dwLen, nullptr) : GetPoolMemory(dwLen);
+}
+
+void* CSDVarMemoryPool::Malloc(UINT32 dwLen, const CHAR* pszTag)
+{
+    return m_bDebug ? DebugMalloc(dwLen, pszTag) : GetPoolMemory(dwLen);
+}
+
+void CSDVarMemoryPool::Free(void* p)
+{
+    if (!p) return;
+
+    if (m_bDebug)
+        DebugFree(p);
+    else
+        FreePoolMemory(p);
+}
+
+void* CSDVarMemoryPool::GetPoolMemory(UINT32 dwLen)
 {
     if (dwLen == 0)
         return nullptr;
@@ -63,6 +155,11 @@ void* CSDVarMemoryPool::Malloc(UINT32 dwLen)
         BYTE* p = (BYTE*)malloc(dwLen + sizeof(UINT32));
         if (!p) return nullptr;
         *(UINT32*)p = dwLen;
+        m_nLargeInUse++;
+        m_qwLargeBytes += dwLen;
+        m_qwInUseBytes += dwLen;
+        if (m_qwInUseBytes > m_qwPeakInUseBytes)
+            m_qwPeakInUseBytes = m_qwInUseBytes;
         return p + sizeof(UINT32);
     }
 
@@ -70,45 +167,39 @@ void* CSDVarMemoryPool::Malloc(UINT32 dwLen)
     INT32 dwIndex = (dwLen - 1) / ALIGNMENT;
     if (dwIndex >= UNIT_TYPE_COUNT) dwIndex = UNIT_TYPE_COUNT - 1;
 
-    // Try fast path from free list
-    if (m_pFreeHead[dwIndex])
-    {
-        BYTE* pBlock = m_pFreeHead[dwIndex]; // block base (header/next area)
-        m_pFreeHead[dwIndex] = *(BYTE**)pBlock;
-        m_nFreeCount[dwIndex]--;
-        // Write size header and return payload pointer
-        *(UINT32*)pBlock = dwLen;
-        return pBlock + sizeof(UINT32);
-    }
-
-    // No free block; replenish and retry
-    if (!AddFreeMemory(dwIndex))
+    // No free block; replenish first
+    if (!m_pFreeHead[dwIndex] && !AddFreeMemory(dwIndex))
         return nullptr;
 
-    if (m_pFreeHead[dwIndex])
-    {
-        BYTE* pBlock = m_pFreeHead[dwIndex];
-        m_pFreeHead[dwIndex] = *(BYTE**)pBlock;
-        m_nFreeCount[dwIndex]--;
-        *(UINT32*)pBlock = dwLen;
-        return pBlock + sizeof(UINT32);
-    }
+    BYTE* pBlock = m_pFreeHead[dwIndex]; // block base (header/next area)
+    m_pFreeHead[dwIndex] = ReadLink(pBlock);
+    m_nFreeCount[dwIndex]--;
 
-    return nullptr;
+    m_qwAllocs[dwIndex]++;
+    if (++m_nInUse[dwIndex] > m_nPeakInUse[dwIndex])
+        m_nPeakInUse[dwIndex] = m_nInUse[dwIndex];
+    m_qwInUseBytes += dwLen;
+    if (m_qwInUseBytes > m_qwPeakInUseBytes)
+        m_qwPeakInUseBytes = m_qwInUseBytes;
+
+    // Write size header and return payload pointer
+    *(UINT32*)pBlock = dwLen;
+    return pBlock + sizeof(UINT32);
 }
 
 
-void CSDVarMemoryPool::Free(void* p)
+void CSDVarMemoryPool::FreePoolMemory(void* p)
 {
-    if (!p) return;
-
     // Recover size header stored just before payload
     BYTE* pBase = (BYTE*)p - sizeof(UINT32);
     UINT32 dwLen = *(UINT32*)pBase;
+    m_qwInUseBytes -= dwLen;
 
     if (dwLen > MAX_UNIT_SIZE)
     {
         // Large blocks were allocated via malloc with header
+        m_nLargeInUse--;
+        m_qwLargeBytes -= dwLen;
         free(pBase);
         return;
     }
@@ -118,9 +209,64 @@ void CSDVarMemoryPool::Free(void* p)
     if (dwIndex >= UNIT_TYPE_COUNT) dwIndex = UNIT_TYPE_COUNT - 1;
 
     // Push block base back to free list head
-    *(BYTE**)pBase = m_pFreeHead[dwIndex];
+    WriteLink(pBase, m_pFreeHead[dwIndex]);
     m_pFreeHead[dwIndex] = pBase;
     m_nFreeCount[dwIndex]++;
+    m_nInUse[dwIndex]--;
+}
+
+void* CSDVarMemoryPool::DebugMalloc(UINT32 dwLen, const CHAR* pszTag)
+{
+    if (dwLen == 0 || dwLen > 0xFFFFFFFF - DEBUG_EXTRA - ALIGNMENT)
+        return nullptr;
+
+    BYTE* pRaw = (BYTE*)GetPoolMemory(dwLen + DEBUG_EXTRA);
+    if (!pRaw)
+        return nullptr;
+
+    DebugBlock block;
+    block.pPrev = nullptr;
+    block.pNext = (BYTE*)m_pDebugHead;
+    block.pszTag = pszTag;
+    block.dwLen = dwLen;
+    WriteBlock(pRaw, block);
+    if (block.pNext)
+        SetPrev(block.pNext, pRaw);
+    m_pDebugHead = pRaw;
+
+    BYTE* p = pRaw + DEBUG_HEAD;
+    WriteWord(p - sizeof(UINT32), GUARD_WORD);
+    memset(p, FILL_NEW, dwLen);
+    WriteWord(p + dwLen, GUARD_WORD);
+    return p;
+}
+
+void CSDVarMemoryPool::DebugFree(void* p)
+{
+    BYTE* pData = (BYTE*)p;
+    BYTE* pRaw = pData - DEBUG_HEAD;
+    DebugBlock block = ReadBlock(pRaw);
+    UINT32 dwHead = ReadWord(pData - sizeof(UINT32));
+
+    // 已释放的块保留释放标记，直到被重新分配
+    if (dwHead == FREED_WORD)
+    {
+        m_nDoubleFrees++;
+        return;
+    }
+    if (dwHead != GUARD_WORD || ReadWord(pData + block.dwLen) != GUARD_WORD)
+        m_nGuardErrors++;
+
+    if (block.pPrev)
+        SetNext(block.pPrev, block.pNext);
+    else
+        m_pDebugHead = block.pNext;
+    if (block.pNext)
+        SetPrev(block.pNext, block.pPrev);
+
+    memset(pData, FILL_FREED, block.dwLen);
+    WriteWord(pData - sizeof(UINT32), FREED_WORD);
+    FreePoolMemory(pRaw);
 }
 
 
@@ -140,6 +286,7 @@ void CSDVarMemoryPool::Clear()
     
     memset(m_pFreeHead, 0, sizeof(m_pFreeHead));
     memset(m_nFreeCount, 0, sizeof(m_nFreeCount));
+    ResetStats();
 }
 
 INT32 CSDVarMemoryPool::GetMemUsed()
@@ -156,6 +303,102 @@ INT32 CSDVarMemoryPool::GetMemUsed()
     return nUsed;
 }
 
+void CSDVarMemoryPool::GetStats(SVarMemPoolStats& stStats)
+{
+    memset(&stStats, 0, sizeof(stStats));
+    stStats.dwPageCount = m_nPageCount;
+    stStats.qwPageBytes = (UINT64)m_nPageCount * m_nPageSize;
+    stStats.qwCarvedBytes = m_qwCarved;
+    stStats.qwWastedBytes = m_qwWasted;
+    stStats.qwInUseBytes = m_qwInUseBytes;
+    stStats.qwPeakInUseBytes = m_qwPeakInUseBytes;
+    stStats.dwLargeInUse = m_nLargeInUse;
+    stStats.qwLargeBytes = m_qwLargeBytes;
+    stStats.dwGuardErrors = m_nGuardErrors;
+    stStats.dwDoubleFrees = m_nDoubleFrees;
+    for (UINT32 i = 0; i < UNIT_TYPE_COUNT; ++i)
+    {
+        SVarMemPoolClassStats& st = stStats.astClass[i];
+        st.dwUnitSize = (i + 1) * ALIGNMENT;
+        st.dwInUse = m_nInUse[i];
+        st.dwFree = m_nFreeCount[i];
+        st.dwPeakInUse = m_nPeakInUse[i];
+        st.qwAllocs = m_qwAllocs[i];
+    }
+}
+
+std::string CSDVarMemoryPool::DumpStats()
+{
+    SVarMemPoolStats st;
+    GetStats(st);
+    std::string out = "pages:" + std::to_string(st.dwPageCount) + " page-bytes:" + std::to_string(st.qwPageBytes) +
+                      " carved:" + std::to_string(st.qwCarvedBytes) + " wasted:" + std::to_string(st.qwWastedBytes) +
+                      " in-use:" + std::to_string(st.qwInUseBytes) + " peak:" + std::to_string(st.qwPeakInUseBytes) +
+                      " large:" + std::to_string(st.dwLargeInUse) + "/" + std::to_string(st.qwLargeBytes);
+    if (m_bDebug)
+        out += " guard-errors:" + std::to_string(st.dwGuardErrors) + " double-frees:" + std::to_string(st.dwDoubleFrees);
+    out += "\n";
+
+    // 只列出用过的尺寸档
+    for (UINT32 i = 0; i < UNIT_TYPE_COUNT; ++i)
+    {
+        const SVarMemPoolClassStats& c = st.astClass[i];
+        if (!c.qwAllocs)
+            continue;
+        out += "  " + std::to_string(c.dwUnitSize) + ": in-use " + std::to_string(c.dwInUse) + " free " +
+               std::to_string(c.dwFree) + " peak " + std::to_string(c.dwPeakInUse) + " allocs " +
+               std::to_string(c.qwAllocs) + "\n";
+    }
+
+    if (m_bDebug)
+    {
+        // 按分配位置汇总未释放的内存，字节数多的在前
+        struct Site
+        {
+            const CHAR* pszTag;
+            UINT64 qwBlocks;
+            UINT64 qwBytes;
+        };
+        std::vector<Site> sites;
+        for (BYTE* pRaw = (BYTE*)m_pDebugHead; pRaw;)
+        {
+            DebugBlock block = ReadBlock(pRaw);
+            pRaw = block.pNext;
+            const CHAR* pszTag = block.pszTag ? block.pszTag : "(untagged)";
+            auto it = std::find_if(sites.begin(), sites.end(),
+                                   [pszTag](const Site& s) { return strcmp(s.pszTag, pszTag) == 0; });
+            if (it == sites.end())
+                it = sites.insert(sites.end(), Site{pszTag, 0, 0});
+            it->qwBlocks++;
+            it->qwBytes += block.dwLen;
+        }
+        std::sort(sites.begin(), sites.end(), [](const Site& a, const Site& b) { return a.qwBytes > b.qwBytes; });
+        for (const Site& site : sites)
+        {
+            out += "  live " + std::string(site.pszTag) + ": " + std::to_string(site.qwBlocks) + " blocks " +
+                   std::to_string(site.qwBytes) + " bytes\n";
+        }
+    }
+    return out;
+}
+
+void CSDVarMemoryPool::ResetStats()
+{
+    memset(m_nInUse, 0, sizeof(m_nInUse));
+    memset(m_nPeakInUse, 0, sizeof(m_nPeakInUse));
+    memset(m_qwAllocs, 0, sizeof(m_qwAllocs));
+    m_nPageCount = 0;
+    m_qwCarved = 0;
+    m_qwWasted = 0;
+    m_qwInUseBytes = 0;
+    m_qwPeakInUseBytes = 0;
+    m_nLargeInUse = 0;
+    m_qwLargeBytes = 0;
+    m_pDebugHead = nullptr;
+    m_nGuardErrors = 0;
+    m_nDoubleFrees = 0;
+}
+
 BOOL CSDVarMemoryPool::AddFreeMemory(INT32 dwIndex)
 {
     // Payload size for this bucket
@@ -166,6 +409,8 @@ BOOL CSDVarMemoryPool::AddFreeMemory(INT32 dwIndex)
     // Ensure current work page has enough contiguous space; otherwise allocate a new page
     if (!m_pWorkPage || m_pPageBuf + (size_t)stride * ALLOC_COUNT > GetPageBufEnd(m_pWorkPage))
     {
+        if (m_pWorkPage)
+            m_qwWasted += GetPageBufEnd(m_pWorkPage) - m_pPageBuf;
         if (!SetMemoryPage())
             return FALSE;
     }
@@ -174,11 +419,12 @@ BOOL CSDVarMemoryPool::AddFreeMemory(INT32 dwIndex)
     for (INT32 i = 0; i < ALLOC_COUNT; ++i)
     {
         // Link into free list; store next pointer in block base
-        *(BYTE**)m_pPageBuf = m_pFreeHead[dwIndex];
+        WriteLink(m_pPageBuf, m_pFreeHead[dwIndex]);
         m_pFreeHead[dwIndex] = m_pPageBuf;
         m_pPageBuf += stride;
         m_nFreeCount[dwIndex]++;
     }
+    m_qwCarved += (UINT64)stride * ALLOC_COUNT;
 
     return TRUE;
 }
@@ -193,6 +439,7 @@ BOOL CSDVarMemoryPool::SetMemoryPage()
     m_pHeadPage = pNewPage;
     m_pWorkPage = pNewPage;
     m_pPageBuf = GetPageBufGegin(pNewPage);
+    m_nPageCount++;
 
     // Adjust start so that payload pointer (base + sizeof(UINT32)) is ALIGNMENT-aligned
     size_t mis = ((size_t)m_pPageBuf + sizeof(UINT32)) % ALIGNMENT;
@@ -0,0 +1,658 @@
+/******************************************************************************
+Copyright (C) 2025 Cui Hairu. All rights reserved.
+
+sdmtmemorypool.cpp - 线程安全的可变内存池实现
+******************************************************************************/
+
+#include "ssengine/sdmemorypool.h"
+#include <atomic>
+#include <cstdlib>
+#include <mutex>
+#include <new>
+#include <unordered_set>
+#include <vector>
+
+#ifndef WINDOWS
+#include <sys/mman.h>
+#endif
+
+namespace SSCP
+{
+
+namespace
+{
+
+// Spans are SPAN_SIZE bytes and SPAN_SIZE-aligned, so the span of any block
+// is found by masking its address. 64 KiB is also the Windows allocation
+// granularity, so VirtualAlloc returns aligned spans directly.
+const size_t SPAN_SIZE = 0x10000;
+const size_t SPAN_HEADER = 128;
+const UINT32 SMALL_CLASSES = 16;            // 8..128 in steps of 8, as CSDVarMemoryPool
+const UINT32 CLASS_COUNT = 40;
+const UINT32 MAX_SMALL_SIZE = 8192;
+const UINT32 LARGE_CLASS = 0xFFFFFFFF;
+
+// Above 128 bytes, four classes per power of two, up to 8 KiB.
+UINT32 ClassSize(UINT32 cls)
+{
+    if (cls < SMALL_CLASSES)
+        return (cls + 1) * 8;
+    UINT32 step = cls - SMALL_CLASSES;
+    UINT32 base = 128u << (step / 4);
+    return base + (base / 4) * (step % 4 + 1);
+}
+
+// Class of every 8-byte step up to MAX_SMALL_SIZE.
+struct SizeClassTable
+{
+    BYTE cls[MAX_SMALL_SIZE / 8 + 1];
+
+    SizeClassTable()
+    {
+        UINT32 c = 0;
+        for (UINT32 i = 1; i <= MAX_SMALL_SIZE / 8; ++i)
+        {
+            while (ClassSize(c) < i * 8)
+                ++c;
+            cls[i] = (BYTE)c;
+        }
+        cls[0] = 0;
+    }
+};
+
+const SizeClassTable g_classes;
+
+inline UINT32 SizeClass(UINT32 dwLen)
+{
+    return g_classes.cls[(dwLen + 7) / 8];
+}
+
+void* MapSpan()
+{
+#ifdef WINDOWS
+    return ::VirtualAlloc(NULL, SPAN_SIZE, MEM_RESERVE | MEM_COMMIT, PAGE_READWRITE);
+#else
+    // Over-map and trim to get the alignment.
+    void* p = mmap(nullptr, SPAN_SIZE * 2, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (p == MAP_FAILED)
+        return nullptr;
+    BYTE* raw = (BYTE*)p;
+    BYTE* aligned = (BYTE*)(((size_t)raw + SPAN_SIZE - 1) & ~(SPAN_SIZE - 1));
+    if (aligned > raw)
+        munmap(raw, aligned - raw);
+    if (aligned + SPAN_SIZE < raw + SPAN_SIZE * 2)
+        munmap(aligned + SPAN_SIZE, raw + SPAN_SIZE * 2 - (aligned + SPAN_SIZE));
+    return aligned;
+#endif
+}
+
+void UnmapSpan(void* p)
+{
+#ifdef WINDOWS
+    ::VirtualFree(p, 0, MEM_RELEASE);
+#else
+    munmap(p, SPAN_SIZE);
+#endif
+}
+
+void* AllocLarge(size_t nLen)
+{
+#ifdef WINDOWS
+    return _aligned_malloc(nLen, SPAN_SIZE);
+#else
+    void* p = nullptr;
+    return posix_memalign(&p, SPAN_SIZE, nLen) == 0 ? p : nullptr;
+#endif
+}
+
+void FreeLarge(void* p)
+{
+#ifdef WINDOWS
+    _aligned_free(p);
+#else
+    free(p);
+#endif
+}
+
+struct Heap;
+
+// Header at the start of every span. Blocks are carved lazily from bump, so
+// a fresh span only touches the pages it hands out. Everything but remote is
+// owned by the heap's thread; remote collects blocks freed by other threads
+// until the owner takes the whole list at once.
+struct Span
+{
+    std::atomic<void*> remote;
+    Heap* heap;
+    void* free;
+    BYTE* bump;
+    BYTE* end;
+    Span* prev;
+    Span* next;
+    UINT32 cls;
+    UINT32 blockSize;
+    UINT32 used;
+    size_t mapped;                          // large blocks: bytes allocated
+};
+
+static_assert(sizeof(Span) <= SPAN_HEADER, "span header too large");
+
+// Spans of one class, those with free blocks first; the head is the one
+// allocated from, and moves to the tail once full.
+struct ClassList
+{
+    Span* head;
+    Span* tail;
+    UINT32 spans;
+    UINT32 idle;                            // spans with no block in use
+    UINT64 live;                            // blocks in use, remote frees not yet collected included
+};
+
+// One thread's cache. Heaps outlive their threads: an exiting thread
+// returns its idle spans and abandons the heap (owner == NULL), which keeps
+// the rest until another thread adopts it, or Trim sweeps it, and collects
+// whatever was freed into it meanwhile.
+struct Heap
+{
+    CSDMTVarMemoryPoolImpl* pool;
+    std::atomic<const void*> owner;
+    ClassList classes[CLASS_COUNT];
+    std::atomic<UINT64> pending;            // classes with remote frees to collect
+};
+
+// Per-thread table of (pool, heap) pairs. Pool ids are never reused, so an
+// entry for a destroyed pool simply never matches again.
+struct ThreadHeaps
+{
+    struct Entry
+    {
+        UINT64 poolId;
+        Heap* heap;
+    };
+    Entry last = {0, nullptr};
+    std::vector<Entry> entries;
+
+    ~ThreadHeaps();
+};
+
+thread_local ThreadHeaps t_heaps;
+
+std::atomic<UINT64> g_nextPoolId(1);
+std::mutex g_poolsMutex;
+std::unordered_set<UINT64> g_livePools;
+
+void ListUnlink(ClassList& list, Span* s)
+{
+    if (s->prev)
+        s->prev->next = s->next;
+    else
+        list.head = s->next;
+    if (s->next)
+        s->next->prev = s->prev;
+    else
+        list.tail = s->prev;
+    s->prev = s->next = nullptr;
+}
+
+void ListPushFront(ClassList& list, Span* s)
+{
+    s->prev = nullptr;
+    s->next = list.head;
+    if (list.head)
+        list.head->prev = s;
+    else
+        list.tail = s;
+    list.head = s;
+}
+
+void ListPushBack(ClassList& list, Span* s)
+{
+    s->next = nullptr;
+    s->prev = list.tail;
+    if (list.tail)
+        list.tail->next = s;
+    else
+        list.head = s;
+    list.tail = s;
+}
+
+// Right behind the head, so the span being allocated from is not displaced.
+void ListPushSecond(ClassList& list, Span* s)
+{
+    if (!list.head)
+    {
+        ListPushFront(list, s);
+        return;
+    }
+    s->prev = list.head;
+    s->next = list.head->next;
+    if (s->next)
+        s->next->prev = s;
+    else
+        list.tail = s;
+    list.head->next = s;
+}
+
+inline bool SpanHasRoom(const Span* s)
+{
+    return s->free || s->bump + s->blockSize <= s->end;
+}
+
+inline Span* SpanOf(void* p)
+{
+    return (Span*)((size_t)p & ~(SPAN_SIZE - 1));
+}
+
+} // namespace
+
+///////////////////////////////////////////////////////////////////////////////
+// CSDMTVarMemoryPool - 线程安全的可变内存池
+///////////////////////////////////////////////////////////////////////////////
+
+class CSDMTVarMemoryPoolImpl
+{
+public:
+    CSDMTVarMemoryPoolImpl()
+        : m_nId(g_nextPoolId.fetch_add(1))
+        , m_nMapped(0)
+    {
+        std::lock_guard<std::mutex> lk(g_poolsMutex);
+        g_livePools.insert(m_nId);
+    }
+
+    ~CSDMTVarMemoryPoolImpl()
+    {
+        {
+            std::lock_guard<std::mutex> lk(g_poolsMutex);
+            g_livePools.erase(m_nId);
+        }
+        for (Heap* heap : m_heaps)
+        {
+            for (ClassList& list : heap->classes)
+            {
+                while (Span* s = list.head)
+                {
+                    ListUnlink(list, s);
+                    UnmapSpan(s);
+                }
+            }
+            delete heap;
+        }
+    }
+
+    void* Malloc(UINT32 dwLen)
+    {
+        if (dwLen == 0)
+            return nullptr;
+        if (dwLen > MAX_SMALL_SIZE)
+            return MallocLarge(dwLen);
+
+        UINT32 cls = SizeClass(dwLen);
+        Heap* heap = LocalHeap();
+        if (!heap)
+            return nullptr;
+        ClassList& list = heap->classes[cls];
+        Span* s = list.head;
+        if (!s || !SpanHasRoom(s))
+        {
+            s = Refill(heap, cls);
+            if (!s)
+                return nullptr;
+        }
+        void* p;
+        if (s->free)
+        {
+            p = s->free;
+            s->free = *(void**)p;
+        }
+        else
+        {
+            p = s->bump;
+            s->bump += s->blockSize;
+        }
+        if (s->used++ == 0)
+            --list.idle;
+        ++list.live;
+        return p;
+    }
+
+    void Free(void* p)
+    {
+        Span* s = SpanOf(p);
+        if (s->cls == LARGE_CLASS)
+        {
+            m_nMapped.fetch_sub(s->mapped, std::memory_order_relaxed);
+            FreeLarge(s);
+            return;
+        }
+        Heap* heap = s->heap;
+        if (heap->owner.load(std::memory_order_relaxed) == &t_heaps)
+        {
+            FreeLocal(heap, s, p);
+            return;
+        }
+        // Remote free: no lock, one CAS on the span's list. The owner takes
+        // the whole list in one exchange when it runs short of blocks.
+        // The push and the pending check pair with Collect's clear and
+        // exchange (store then load on each side), so all four are seq_cst:
+        // either this thread sees the bit cleared and sets it again, or the
+        // owner's exchange sees the block.
+        UINT32 cls = s->cls;
+        void* head = s->remote.load(std::memory_order_relaxed);
+        do
+        {
+            *(void**)p = head;
+        } while (!s->remote.compare_exchange_weak(head, p, std::memory_order_seq_cst, std::memory_order_relaxed));
+        if (!(heap->pending.load(std::memory_order_seq_cst) & (UINT64(1) << cls)))
+            heap->pending.fetch_or(UINT64(1) << cls, std::memory_order_release);
+    }
+
+    // Trims the calling thread's heap and every abandoned one.
+    void Trim()
+    {
+        if (Heap* heap = LocalHeap())
+            TrimHeap(heap);
+        std::lock_guard<std::mutex> lk(m_heapsMutex);
+        for (Heap* heap : m_heaps)
+        {
+            const void* none = nullptr;
+            if (heap->owner.compare_exchange_strong(none, &t_heaps, std::memory_order_acquire))
+            {
+                heap->pending.store(~UINT64(0), std::memory_order_relaxed);
+                TrimHeap(heap);
+                heap->owner.store(nullptr, std::memory_order_release);
+            }
+        }
+    }
+
+    // Collects the remote frees of heap, owned by the calling thread, and
+    // returns all of its idle spans.
+    void TrimHeap(Heap* heap)
+    {
+        for (UINT32 cls = 0; cls < CLASS_COUNT; ++cls)
+        {
+            Collect(heap, cls);
+            ClassList& list = heap->classes[cls];
+            for (Span* s = list.head; s;)
+            {
+                Span* next = s->next;
+                if (s->used == 0)
+                    Release(list, s);
+                s = next;
+            }
+        }
+    }
+
+    INT64 MemUsed() const
+    {
+        return (INT64)m_nMapped.load(std::memory_order_relaxed);
+    }
+
+private:
+    void* MallocLarge(UINT32 dwLen)
+    {
+        size_t total = SPAN_HEADER + dwLen;
+        Span* s = (Span*)AllocLarge(total);
+        if (!s)
+            return nullptr;
+        s->cls = LARGE_CLASS;
+        s->mapped = total;
+        m_nMapped.fetch_add(total, std::memory_order_relaxed);
+        return (BYTE*)s + SPAN_HEADER;
+    }
+
+    Heap* LocalHeap()
+    {
+        ThreadHeaps& th = t_heaps;
+        if (th.last.poolId == m_nId)
+            return th.last.heap;
+        for (const ThreadHeaps::Entry& e : th.entries)
+        {
+            if (e.poolId == m_nId)
+            {
+                th.last = e;
+                return e.heap;
+            }
+        }
+        Heap* heap = AcquireHeap();
+        if (!heap)
+            return nullptr;
+        {
+            // Drop entries of pools destroyed since.
+            std::lock_guard<std::mutex> lk(g_poolsMutex);
+            for (size_t i = 0; i < th.entries.size();)
+            {
+                if (g_livePools.count(th.entries[i].poolId))
+                {
+                    ++i;
+                    continue;
+                }
+                th.entries[i] = th.entries.back();
+                th.entries.pop_back();
+            }
+        }
+        th.last = ThreadHeaps::Entry{m_nId, heap};
+        th.entries.push_back(th.last);
+        return heap;
+    }
+
+    // Adopts an abandoned heap, or makes a new one.
+    Heap* AcquireHeap()
+    {
+        std::lock_guard<std::mutex> lk(m_heapsMutex);
+        for (Heap* heap : m_heaps)
+        {
+            const void* none = nullptr;
+            if (heap->owner.compare_exchange_strong(none, &t_heaps, std::memory_order_acquire))
+            {
+                // Frees made while it had no owner were all remote.
+                heap->pending.store(~UINT64(0), std::memory_order_relaxed);
+                return heap;
+            }
+        }
+        Heap* heap = new Heap();
+        heap->pool = this;
+        heap->owner.store(&t_heaps, std::memory_order_relaxed);
+        heap->pending.store(0, std::memory_order_relaxed);
+        for (ClassList& list : heap->classes)
+        {
+            list.head = nullptr;
+            list.tail = nullptr;
+            list.spans = 0;
+            list.idle = 0;
+            list.live = 0;
+        }
+        m_heaps.push_back(heap);
+        return heap;
+    }
+
+    void FreeLocal(Heap* heap, Span* s, void* p)
+    {
+        bool wasFull = !SpanHasRoom(s);
+        *(void**)p = s->free;
+        s->free = p;
+        --s->used;
+        ClassList& list = heap->classes[s->cls];
+        --list.live;
+        if (s->used == 0 && Emptied(list, s))
+            return;
+        if (wasFull && s != list.head)
+        {
+            ListUnlink(list, s);
+            ListPushSecond(list, s);
+        }
+    }
+
+    // Takes the remote frees of every span of cls; spans that regained
+    // room move to the front.
+    void Collect(Heap* heap, UINT32 cls)
+    {
+        UINT64 bit = UINT64(1) << cls;
+        if (!(heap->pending.load(std::memory_order_relaxed) & bit))
+            return;
+        heap->pending.fetch_and(~bit, std::memory_order_seq_cst);
+        ClassList& list = heap->classes[cls];
+        for (Span* s = list.head; s;)
+        {
+            Span* next = s->next;
+            void* blocks = s->remote.exchange(nullptr, std::memory_order_seq_cst);
+            if (blocks)
+            {
+                void* tail = blocks;
+                UINT32 n = 1;
+                while (*(void**)tail)
+                {
+                    tail = *(void**)tail;
+                    ++n;
+                }
+                *(void**)tail = s->free;
+                s->free = blocks;
+                s->used -= n;
+                list.live -= n;
+                bool released = s->used == 0 && Emptied(list, s);
+                if (list.live == 0)
+                    break;              // the rest are idle, and may be gone
+                if (!released && s != list.head)
+                {
+                    ListUnlink(list, s);
+                    ListPushFront(list, s);
+                }
+            }
+            s = next;
+        }
+    }
+
+    // Called when the head span of cls is out of blocks.
+    Span* Refill(Heap* heap, UINT32 cls)
+    {
+        Collect(heap, cls);
+        ClassList& list = heap->classes[cls];
+        Span* full = list.head;
+        if (full && !SpanHasRoom(full) && full != list.tail)
+        {
+            ListUnlink(list, full);
+            ListPushBack(list, full);
+        }
+        if (list.head && SpanHasRoom(list.head))
+            return list.head;
+        Span* s = (Span*)MapSpan();
+        if (!s)
+            return nullptr;
+        m_nMapped.fetch_add(SPAN_SIZE, std::memory_order_relaxed);
+        new (&s->remote) std::atomic<void*>(nullptr);
+        s->heap = heap;
+        s->free = nullptr;
+        s->bump = (BYTE*)s + SPAN_HEADER;
+        s->end = (BYTE*)s + SPAN_SIZE;
+        s->cls = cls;
+        s->blockSize = ClassSize(cls);
+        s->used = 0;
+        s->mapped = SPAN_SIZE;
+        ListPushFront(list, s);
+        ++list.spans;
+        ++list.idle;
+        return s;
+    }
+
+    // s just lost its last block; returns whether s was released. Idle
+    // spans stay as free capacity while the class is in use, so a class
+    // whose blocks come and go does not map and unmap spans all the time.
+    // They go back to the OS once they outnumber the spans in use, and when
+    // the whole class goes idle, all but one spare do.
+    bool Emptied(ClassList& list, Span* s)
+    {
+        ++list.idle;
+        if (list.live == 0)
+        {
+            for (Span* other = list.head; other;)
+            {
+                Span* next = other->next;
+                if (other != s)
+                    Release(list, other);
+                other = next;
+            }
+            return false;
+        }
+        if (list.idle > 2 && list.idle * 2 > list.spans)
+        {
+            Release(list, s);
+            return true;
+        }
+        return false;
+    }
+
+    // s must be idle.
+    void Release(ClassList& list, Span* s)
+    {
+        ListUnlink(list, s);
+        --list.spans;
+        --list.idle;
+        m_nMapped.fetch_sub(SPAN_SIZE, std::memory_order_relaxed);
+        UnmapSpan(s);
+    }
+
+    const UINT64 m_nId;
+    std::atomic<size_t> m_nMapped;
+    std::mutex m_heapsMutex;
+    std::vector<Heap*> m_heaps;
+};
+
+namespace
+{
+
+ThreadHeaps::~ThreadHeaps()
+{
+    // Pools cannot be destroyed meanwhile: they unregister under this lock.
+    std::lock_guard<std::mutex> lk(g_poolsMutex);
+    for (const Entry& e : entries)
+    {
+        if (!g_livePools.count(e.poolId))
+            continue;
+        e.heap->pool->TrimHeap(e.heap);
+        e.heap->owner.store(nullptr, std::memory_order_release);
+    }
+}
+
+} // namespace
+
+CSDMTVarMemoryPool::CSDMTVarMemoryPool()
+    : m_pImpl(nullptr)
+{
+}
+
+CSDMTVarMemoryPool::~CSDMTVarMemoryPool()
+{
+    delete m_pImpl;
+    m_pImpl = nullptr;
+}
+
+BOOL CSDMTVarMemoryPool::Create()
+{
+    if (!m_pImpl)
+        m_pImpl = new CSDMTVarMemoryPoolImpl();
+    return TRUE;
+}
+
+void* CSDMTVarMemoryPool::Malloc(UINT32 dwLen)
+{
+    return m_pImpl ? m_pImpl->Malloc(dwLen) : nullptr;
+}
+
+void CSDMTVarMemoryPool::Free(void* p)
+{
+    if (p && m_pImpl)
+        m_pImpl->Free(p);
+}
+
+void CSDMTVarMemoryPool::Trim()
+{
+    if (m_pImpl)
+        m_pImpl->Trim();
+}
+
+INT64 CSDMTVarMemoryPool::GetMemUsed()
+{
+    return m_pImpl ? m_pImpl->MemUsed() : 0;
+}
+
+} // namespace SSCP
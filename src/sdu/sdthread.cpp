@@ -1,21 +1,176 @@
 #include "ssengine/sdthread.h"
 #include "ssengine/sdtype.h"
 
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <map>
+#include <mutex>
+
 #ifdef WINDOWS
 #  include <windows.h>
 #  include <process.h>
 #else
 #  include <pthread.h>
+#  include <sched.h>
+#  include <sys/resource.h>
+#  include <sys/syscall.h>
+#  include <unistd.h>
 #  include <functional>
-#  include <map>
-#  include <mutex>
 #  include <atomic>
+#endif
+
+namespace SSCP {
+
 namespace {
-struct ThReg { std::mutex mtx; std::map<int, pthread_t> tbl; std::atomic<int> next{1}; } g_threg;
+
+// Calls fn(cpu) for each entry of a sysfs list such as "0-3,8,10-11".
+template <typename Fn>
+void forEachInList(const char* list, Fn fn) {
+    const char* p = list;
+    while (*p) {
+        char* end = nullptr;
+        unsigned long first = std::strtoul(p, &end, 10);
+        if (end == p) break;
+        unsigned long last = first;
+        p = end;
+        if (*p == '-') {
+            last = std::strtoul(p + 1, &end, 10);
+            p = end;
+        }
+        for (unsigned long i = first; i <= last; ++i) fn(static_cast<UINT32>(i));
+        while (*p == ',' || *p == '\n' || *p == ' ') ++p;
+    }
+}
+
+bool hasCpuMask(const SThreadAttr& a) {
+    for (UINT64 w : a.m_aqwCpuMask) {
+        if (w) return true;
+    }
+    return false;
+}
+
+#ifdef WINDOWS
+
+struct ThReg { std::mutex mtx; std::map<SDHANDLE, SThreadAttr> attrs; } g_threg;
+
+typedef HRESULT (WINAPI *PFSetThreadDescription)(HANDLE, PCWSTR);
+
+// Only processor group 0 (the first 64 CPUs) can be expressed here.
+BOOL applyAttr(HANDLE h, const SThreadAttr& a) {
+    BOOL ok = TRUE;
+    if (hasCpuMask(a) || a.m_nNumaNode >= 0) {
+        ULONGLONG mask = hasCpuMask(a) ? a.m_aqwCpuMask[0] : ~ULONGLONG(0);
+        if (a.m_nNumaNode >= 0) {
+            ULONGLONG nodeMask = 0;
+            if (!::GetNumaNodeProcessorMask(static_cast<UCHAR>(a.m_nNumaNode), &nodeMask)) nodeMask = 0;
+            mask &= nodeMask;
+        }
+        if (mask == 0 || ::SetThreadAffinityMask(h, static_cast<DWORD_PTR>(mask)) == 0) ok = FALSE;
+    }
+    if (a.m_nPriority != SDTHREAD_PRIORITY_NORMAL && !::SetThreadPriority(h, a.m_nPriority)) ok = FALSE;
+    if (a.m_szName[0]) {
+        // SetThreadDescription only exists from Windows 10 1607.
+        static PFSetThreadDescription setDescription = reinterpret_cast<PFSetThreadDescription>(
+            ::GetProcAddress(::GetModuleHandleW(L"kernel32.dll"), "SetThreadDescription"));
+        WCHAR name[SDTHREAD_NAME_LEN];
+        if (!setDescription ||
+            ::MultiByteToWideChar(CP_ACP, 0, a.m_szName, -1, name, SDTHREAD_NAME_LEN) == 0 ||
+            FAILED(setDescription(h, name))) {
+            ok = FALSE;
+        }
+    }
+    return ok;
+}
+
+#else
+
+// Maintain a registry from small int handle to pthread_t. Each thread
+// starts in threadStart, which records its kernel id (for the nice value)
+// and applies the attributes stored for it before running the user proc.
+struct ThEntry {
+    pthread_t tid;
+    pid_t ktid;
+    bool hasAttr;
+    bool joining;
+    SThreadAttr attr;
+};
+struct ThReg { std::mutex mtx; std::map<int, ThEntry> tbl; std::atomic<int> next{1}; } g_threg;
+
+struct ThStart { PFThrdProc proc; void* arg; int handle; };
+
+pid_t currentKernelTid() { return static_cast<pid_t>(::syscall(SYS_gettid)); }
+
+bool nodeCpus(INT32 node, cpu_set_t& set) {
+    char path[64];
+    std::snprintf(path, sizeof(path), "/sys/devices/system/node/node%d/cpulist", node);
+    FILE* f = std::fopen(path, "r");
+    if (!f) return false;
+    char list[1024] = {0};
+    bool read = std::fgets(list, sizeof(list), f) != nullptr;
+    std::fclose(f);
+    if (!read) return false;
+    CPU_ZERO(&set);
+    forEachInList(list, [&set](UINT32 cpu) { if (cpu < CPU_SETSIZE) CPU_SET(cpu, &set); });
+    return true;
+}
+
+// ktid 0: the thread has not started; threadStart sets the nice value.
+BOOL applyAttr(pthread_t th, pid_t ktid, const SThreadAttr& a) {
+    BOOL ok = TRUE;
+    if (hasCpuMask(a) || a.m_nNumaNode >= 0) {
+        cpu_set_t set;
+        CPU_ZERO(&set);
+        if (hasCpuMask(a)) {
+            for (UINT32 cpu = 0; cpu < SDTHREAD_MAX_CPUS && cpu < CPU_SETSIZE; ++cpu) {
+                if (a.m_aqwCpuMask[cpu / 64] & (UINT64(1) << (cpu % 64))) CPU_SET(cpu, &set);
+            }
+        }
+        if (a.m_nNumaNode >= 0) {
+            cpu_set_t node;
+            if (!nodeCpus(a.m_nNumaNode, node)) CPU_ZERO(&node);
+            if (hasCpuMask(a)) CPU_AND(&set, &set, &node);
+            else set = node;
+        }
+        if (CPU_COUNT(&set) == 0 || ::pthread_setaffinity_np(th, sizeof(set), &set) != 0) ok = FALSE;
+    }
+    if (a.m_nPriority != SDTHREAD_PRIORITY_NORMAL && ktid) {
+        static const int nice[] = {10, 5, 0, -5, -10};
+        INT32 level = a.m_nPriority < SDTHREAD_PRIORITY_LOWEST ? SDTHREAD_PRIORITY_LOWEST
+                    : a.m_nPriority > SDTHREAD_PRIORITY_HIGHEST ? SDTHREAD_PRIORITY_HIGHEST : a.m_nPriority;
+        if (::setpriority(PRIO_PROCESS, static_cast<id_t>(ktid), nice[level - SDTHREAD_PRIORITY_LOWEST]) != 0) ok = FALSE;
+    }
+    if (a.m_szName[0]) {
+        char name[SDTHREAD_NAME_LEN];
+        std::strncpy(name, a.m_szName, sizeof(name) - 1);
+        name[sizeof(name) - 1] = 0;
+        if (::pthread_setname_np(th, name) != 0) ok = FALSE;
+    }
+    return ok;
+}
+
+void* threadStart(void* p) {
+    ThStart start = *static_cast<ThStart*>(p);
+    delete static_cast<ThStart*>(p);
+    pid_t ktid = currentKernelTid();
+    bool hasAttr = false;
+    SThreadAttr attr;
+    {
+        std::lock_guard<std::mutex> lk(g_threg.mtx);
+        auto it = g_threg.tbl.find(start.handle);
+        if (it != g_threg.tbl.end()) {
+            it->second.ktid = ktid;
+            hasAttr = it->second.hasAttr;
+            attr = it->second.attr;
+        }
+    }
+    if (hasAttr) applyAttr(::pthread_self(), ktid, attr);
+    return start.proc(start.arg);
 }
+
 #endif
 
-namespace SSCP {
+} // namespace
 
 SDTHREADID SSAPI SDGetThreadId() {
 #ifdef WINDOWS
@@ -27,8 +182,51 @@ SDTHREADID SSAPI SDGetThreadId() {
 #endif
 }
 
+void SSAPI SDThreadAttrInit(SThreadAttr* pAttr) {
+    if (!pAttr) return;
+    std::memset(pAttr, 0, sizeof(*pAttr));
+    pAttr->m_nNumaNode = -1;
+    pAttr->m_nPriority = SDTHREAD_PRIORITY_NORMAL;
+}
+
+void SSAPI SDThreadAttrAddCpu(SThreadAttr* pAttr, UINT32 dwCpu) {
+    if (!pAttr || dwCpu >= SDTHREAD_MAX_CPUS) return;
+    pAttr->m_aqwCpuMask[dwCpu / 64] |= UINT64(1) << (dwCpu % 64);
+}
+
+void SSAPI SDThreadAttrSetName(SThreadAttr* pAttr, const CHAR* pszName) {
+    if (!pAttr) return;
+    std::strncpy(pAttr->m_szName, pszName ? pszName : "", SDTHREAD_NAME_LEN - 1);
+    pAttr->m_szName[SDTHREAD_NAME_LEN - 1] = 0;
+}
+
+UINT32 SSAPI SDGetNumaNodeCount() {
+#ifdef WINDOWS
+    ULONG highest = 0;
+    return ::GetNumaHighestNodeNumber(&highest) ? static_cast<UINT32>(highest) + 1 : 1;
+#else
+    FILE* f = std::fopen("/sys/devices/system/node/online", "r");
+    if (!f) return 1;
+    char list[256] = {0};
+    bool read = std::fgets(list, sizeof(list), f) != nullptr;
+    std::fclose(f);
+    UINT32 count = 0;
+    if (read) forEachInList(list, [&count](UINT32) { ++count; });
+    return count ? count : 1;
+#endif
+}
+
+BOOL SSAPI SDSetCurrentThreadAttr(const SThreadAttr* pAttr) {
+    if (!pAttr) return FALSE;
+#ifdef WINDOWS
+    return applyAttr(::GetCurrentThread(), *pAttr);
+#else
+    return applyAttr(::pthread_self(), currentKernelTid(), *pAttr);
+#endif
+}
+
 SDHANDLE SSAPI SDCreateThread(
-    SThreadAttr* /*pAttr*/,
+    SThreadAttr* pAttr,
     PFThrdProc pThrdProc,
     void* pArg,
     SDTHREADID* pThreadId,
@@ -36,7 +234,8 @@ SDHANDLE SSAPI SDCreateThread(
 {
 #ifdef WINDOWS
     unsigned threadId = 0;
-    unsigned initFlag = bSuspend ? CREATE_SUSPENDED : 0;
+    // With attributes the thread starts suspended until they are applied.
+    unsigned initFlag = (bSuspend || pAttr) ? CREATE_SUSPENDED : 0;
     // Prefer _beginthreadex for C runtime initialization correctness
     uintptr_t h = _beginthreadex(
         nullptr,
@@ -48,17 +247,39 @@ SDHANDLE SSAPI SDCreateThread(
     if (h == 0) {
         return SDINVALID_HANDLE;
     }
+    if (pAttr) {
+        applyAttr(reinterpret_cast<HANDLE>(h), *pAttr);
+        {
+            std::lock_guard<std::mutex> lk(g_threg.mtx);
+            g_threg.attrs[reinterpret_cast<SDHANDLE>(h)] = *pAttr;
+        }
+        if (!bSuspend) ::ResumeThread(reinterpret_cast<HANDLE>(h));
+    }
     if (pThreadId) *pThreadId = static_cast<SDTHREADID>(threadId);
     return reinterpret_cast<SDHANDLE>(h);
 #else
-    // Maintain a registry from small int handle to pthread_t
+    // The entry exists before the thread does, so threadStart finds it.
+    int h;
+    {
+        std::lock_guard<std::mutex> lk(g_threg.mtx);
+        h = g_threg.next++;
+        ThEntry& e = g_threg.tbl[h];
+        e.ktid = 0;
+        e.hasAttr = pAttr != nullptr;
+        if (pAttr) e.attr = *pAttr;
+    }
     pthread_t tid;
     pthread_attr_t attr; pthread_attr_init(&attr);
-    int rc = pthread_create(&tid, &attr, pThrdProc, pArg);
+    ThStart* start = new ThStart{pThrdProc, pArg, h};
+    int rc = pthread_create(&tid, &attr, &threadStart, start);
     pthread_attr_destroy(&attr);
-    if (rc != 0) return SDINVALID_HANDLE;
-    int h;
-    { std::lock_guard<std::mutex> lk(g_threg.mtx); h = g_threg.next++; g_threg.tbl[h] = tid; }
+    if (rc != 0) {
+        delete start;
+        std::lock_guard<std::mutex> lk(g_threg.mtx);
+        g_threg.tbl.erase(h);
+        return SDINVALID_HANDLE;
+    }
+    { std::lock_guard<std::mutex> lk(g_threg.mtx); g_threg.tbl[h].tid = tid; }
     if (pThreadId) *pThreadId = static_cast<SDTHREADID>(h);
     (void)bSuspend; // not supported on POSIX
     return h;
@@ -71,22 +292,28 @@ INT32 SSAPI SDThreadWait(SDHANDLE handle) {
     DWORD rc = ::WaitForSingleObject(reinterpret_cast<HANDLE>(handle), INFINITE);
     return (rc == WAIT_OBJECT_0) ? 0 : -1;
 #else
-    // join and erase from registry
+    // join, then erase from registry: a thread that has not reached
+    // threadStart yet still needs its entry
     pthread_t tid;
     {
         std::lock_guard<std::mutex> lk(g_threg.mtx);
         auto it = g_threg.tbl.find(handle);
-        if (it == g_threg.tbl.end()) return -1;
-        tid = it->second;
-        g_threg.tbl.erase(it);
+        if (it == g_threg.tbl.end() || it->second.joining) return -1;
+        it->second.joining = true;
+        tid = it->second.tid;
     }
-    void* ret=nullptr; return pthread_join(tid, &ret)==0 ? 0 : -1;
+    void* ret=nullptr; int rc = pthread_join(tid, &ret);
+    { std::lock_guard<std::mutex> lk(g_threg.mtx); g_threg.tbl.erase(handle); }
+    return rc==0 ? 0 : -1;
 #endif
 }
 
 void SSAPI SDThreadCloseHandle(SDHANDLE handle) {
 #ifdef WINDOWS
-    if (handle) ::CloseHandle(reinterpret_cast<HANDLE>(handle));
+    if (handle) {
+        { std::lock_guard<std::mutex> lk(g_threg.mtx); g_threg.attrs.erase(handle); }
+        ::CloseHandle(reinterpret_cast<HANDLE>(handle));
+    }
 #else
     // nothing to close for pthreads
     (void)handle;
@@ -118,20 +345,53 @@ void SSAPI SDThreadResume(SDHANDLE handle) {
 #endif
 }
 
-void SSAPI SDSetThreadAttr(SDHANDLE /*h*/, SThreadAttr* /*pAttr*/) {}
+BOOL SSAPI SDSetThreadAttr(SDHANDLE handle, SThreadAttr* pAttr) {
+    if (!pAttr) return FALSE;
+#ifdef WINDOWS
+    if (!handle) return FALSE;
+    { std::lock_guard<std::mutex> lk(g_threg.mtx); g_threg.attrs[handle] = *pAttr; }
+    return applyAttr(reinterpret_cast<HANDLE>(handle), *pAttr);
+#else
+    pthread_t tid;
+    pid_t ktid;
+    {
+        // A thread not yet in threadStart picks the new attributes up there.
+        std::lock_guard<std::mutex> lk(g_threg.mtx);
+        auto it = g_threg.tbl.find(handle);
+        if (it == g_threg.tbl.end()) return FALSE;
+        it->second.hasAttr = true;
+        it->second.attr = *pAttr;
+        tid = it->second.tid;
+        ktid = it->second.ktid;
+    }
+    if (!ktid) return TRUE;
+    return applyAttr(tid, ktid, *pAttr);
+#endif
+}
 
-SThreadAttr* SSAPI SDGetThreadAttr(SDHANDLE /*h*/) { return nullptr; }
+SThreadAttr* SSAPI SDGetThreadAttr(SDHANDLE handle) {
+    std::lock_guard<std::mutex> lk(g_threg.mtx);
+#ifdef WINDOWS
+    auto it = g_threg.attrs.find(handle);
+    return it == g_threg.attrs.end() ? nullptr : &it->second;
+#else
+    auto it = g_threg.tbl.find(handle);
+    return (it == g_threg.tbl.end() || !it->second.hasAttr) ? nullptr : &it->second.attr;
+#endif
+}
 
 // ---------------- CSDThread ----------------
 
 CSDThread::CSDThread()
-  : m_bstart(FALSE), m_tid(0), m_handle(SDINVALID_HANDLE), m_arg(nullptr) {}
+  : m_bstart(FALSE), m_tid(0), m_handle(SDINVALID_HANDLE), m_arg(nullptr), m_bAttr(FALSE) {
+    SDThreadAttrInit(&m_attr);
+}
 
 CSDThread::~CSDThread() {
 #ifdef WINDOWS
     if (m_handle) {
         // Avoid leaking handle; do not force terminate here
-        ::CloseHandle(reinterpret_cast<HANDLE>(m_handle));
+        SDThreadCloseHandle(m_handle);
         m_handle = SDINVALID_HANDLE;
     }
 #endif
@@ -139,7 +399,7 @@ CSDThread::~CSDThread() {
 
 BOOL SSAPI CSDThread::Start(PFThrdProc pfThrdProc, void* pArg, BOOL bSuspend) {
     if (m_bstart) return FALSE;
-    m_handle = SDCreateThread(nullptr, pfThrdProc, pArg, &m_tid, bSuspend);
+    m_handle = SDCreateThread(m_bAttr ? &m_attr : nullptr, pfThrdProc, pArg, &m_tid, bSuspend);
     m_bstart = (m_handle != SDINVALID_HANDLE);
     return m_bstart;
 }
@@ -154,7 +414,7 @@ SDTHREAD_DECLARE(CSDThread::SDThreadFunc) (void* arg) {
 BOOL SSAPI CSDThread::Start(BOOL bSuspend) {
     if (m_bstart) return FALSE;
     m_arg = this;
-    m_handle = SDCreateThread(nullptr, &CSDThread::SDThreadFunc, this, &m_tid, bSuspend);
+    m_handle = SDCreateThread(m_bAttr ? &m_attr : nullptr, &CSDThread::SDThreadFunc, this, &m_tid, bSuspend);
     m_bstart = (m_handle != SDINVALID_HANDLE);
     return m_bstart;
 }
@@ -175,8 +435,16 @@ void SSAPI CSDThread::Resume() {
     SDThreadResume(m_handle);
 }
 
-void SSAPI CSDThread::SetAttribute(SThreadAttr* /*pAttr*/) {}
+BOOL SSAPI CSDThread::SetAttribute(SThreadAttr* pAttr) {
+    if (!pAttr) {
+        m_bAttr = FALSE;
+        return TRUE;
+    }
+    m_attr = *pAttr;
+    m_bAttr = TRUE;
+    return m_bstart ? SDSetThreadAttr(m_handle, &m_attr) : TRUE;
+}
 
-SThreadAttr* SSAPI CSDThread::GetAttribute() { return nullptr; }
+SThreadAttr* SSAPI CSDThread::GetAttribute() { return m_bAttr ? &m_attr : nullptr; }
 
 } // namespace SSCP
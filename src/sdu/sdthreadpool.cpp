@@ -3,9 +3,14 @@
 #include "ssengine/sdcondition.h"
 #include "ssengine/sdmutex.h"
 #include "ssengine/sdthread.h"
+#include "ssengine/sdtime.h"
 
 #include <algorithm>
-#include <chrono>
+#include <atomic>
+#include <cstdio>
+#include <cstring>
+#include <deque>
+#include <memory>
 #include <thread>
 #include <vector>
 
@@ -22,21 +27,582 @@ private:
     CSDMutex& _mutex;
 };
 
+// Chase-Lev work-stealing deque (Le et al., "Correct and Efficient
+// Work-Stealing for Weak Memory Models"). The owning worker pushes and pops
+// at the bottom; other workers steal from the top. Arrays are only replaced
+// by larger copies and kept until the deque goes away, so a thief holding a
+// stale array still reads a valid slot.
+class JobDeque {
+public:
+    JobDeque() : _top(0), _bottom(0) {
+        _arrays.emplace_back(new Array(INITIAL_SIZE));
+        _array.store(_arrays.back().get(), std::memory_order_relaxed);
+    }
+
+    // Owner only.
+    void push(ISSRunable* job) {
+        INT64 b = _bottom.load(std::memory_order_relaxed);
+        INT64 t = _top.load(std::memory_order_acquire);
+        Array* a = _array.load(std::memory_order_relaxed);
+        if (b - t >= a->size) {
+            a = grow(a, t, b);
+        }
+        a->put(b, job);
+        _bottom.store(b + 1, std::memory_order_release);
+    }
+
+    // Owner only; newest job first.
+    ISSRunable* pop() {
+        INT64 b = _bottom.load(std::memory_order_relaxed) - 1;
+        Array* a = _array.load(std::memory_order_relaxed);
+        _bottom.store(b, std::memory_order_seq_cst);
+        INT64 t = _top.load(std::memory_order_seq_cst);
+        if (t > b) {
+            _bottom.store(b + 1, std::memory_order_relaxed);
+            return nullptr;
+        }
+        ISSRunable* job = a->get(b);
+        if (t == b) {
+            // Last job: race the thieves for it.
+            if (!_top.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst, std::memory_order_relaxed)) {
+                job = nullptr;
+            }
+            _bottom.store(b + 1, std::memory_order_relaxed);
+        }
+        return job;
+    }
+
+    // Any thread; oldest job first. nullptr when empty or another thread won.
+    ISSRunable* steal() {
+        INT64 t = _top.load(std::memory_order_seq_cst);
+        INT64 b = _bottom.load(std::memory_order_seq_cst);
+        if (t >= b) {
+            return nullptr;
+        }
+        Array* a = _array.load(std::memory_order_acquire);
+        ISSRunable* job = a->get(t);
+        if (!_top.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst, std::memory_order_relaxed)) {
+            return nullptr;
+        }
+        return job;
+    }
+
+    // Moves the queued jobs into out, oldest first; only while no worker runs.
+    void clear(std::vector<ISSRunable*>& out) {
+        INT64 t = _top.load(std::memory_order_relaxed);
+        INT64 b = _bottom.load(std::memory_order_relaxed);
+        Array* a = _array.load(std::memory_order_relaxed);
+        for (INT64 i = t; i < b; ++i) {
+            out.push_back(a->get(i));
+        }
+        _top.store(b, std::memory_order_relaxed);
+    }
+
+private:
+    static const INT64 INITIAL_SIZE = 256;
+
+    struct Array {
+        explicit Array(INT64 n) : size(n), slots(new std::atomic<ISSRunable*>[n]) {}
+        ISSRunable* get(INT64 i) const { return slots[i & (size - 1)].load(std::memory_order_relaxed); }
+        void put(INT64 i, ISSRunable* job) { slots[i & (size - 1)].store(job, std::memory_order_relaxed); }
+        INT64 size;
+        std::unique_ptr<std::atomic<ISSRunable*>[]> slots;
+    };
+
+    Array* grow(Array* a, INT64 t, INT64 b) {
+        _arrays.emplace_back(new Array(a->size * 2));
+        Array* bigger = _arrays.back().get();
+        for (INT64 i = t; i < b; ++i) {
+            bigger->put(i, a->get(i));
+        }
+        _array.store(bigger, std::memory_order_release);
+        return bigger;
+    }
+
+    alignas(64) std::atomic<INT64> _top;
+    alignas(64) std::atomic<INT64> _bottom;
+    std::atomic<Array*> _array;
+    std::vector<std::unique_ptr<Array>> _arrays;
+};
+
 } // namespace
 
+// Priority lanes, used as the job queue in shared-queue mode and as the
+// injection queue in work-stealing mode. Each lane is FIFO; pop picks a lane
+// by smooth weighted round-robin (as in nginx's upstream balancer) over the
+// lanes holding jobs, so each gets its weight's share and none starves.
+// The pool guards it with m_jobMutex; sizes are mirrored in atomics so
+// workers can look without the lock.
+class CSDJobLanes {
+public:
+    // A dequeued job; lane and lateness are filled in by pop.
+    struct Entry {
+        ISSRunable* job;
+        UINT64 enqueuedUs;
+        UINT32 deadlineMs;                  // after enqueuedUs, 0 for none
+        UINT32 lane;
+        UINT32 lateMs;
+        bool late;
+    };
+
+    CSDJobLanes() {
+        static const UINT32 weights[SDJOB_PRIORITY_COUNT] = {8, 4, 1};
+        for (UINT32 i = 0; i < SDJOB_PRIORITY_COUNT; ++i) {
+            _weights[i] = weights[i];
+            _current[i] = 0;
+            _sizes[i].store(0, std::memory_order_relaxed);
+        }
+        _total.store(0, std::memory_order_relaxed);
+        resetStats();
+    }
+
+    void push(ISSRunable* pJob, UINT32 dwLane, UINT32 dwDeadlineMs, UINT64 qwNowUs) {
+        Queued q = {pJob, qwNowUs, dwDeadlineMs};
+        _lanes[dwLane].push_back(q);
+        ++_stats[dwLane].m_qwScheduled;
+        resized(dwLane);
+    }
+
+    // Weighted pick over the non-empty lanes.
+    bool pop(Entry& out, UINT64 qwNowUs) {
+        UINT32 total = 0;
+        INT32 best = -1;
+        for (UINT32 i = 0; i < SDJOB_PRIORITY_COUNT; ++i) {
+            if (_lanes[i].empty()) {
+                continue;
+            }
+            _current[i] += _weights[i];
+            total += _weights[i];
+            if (best < 0 || _current[i] > _current[best]) {
+                best = static_cast<INT32>(i);
+            }
+        }
+        if (best < 0) {
+            return false;
+        }
+        _current[best] -= static_cast<INT32>(total);
+        return pop(static_cast<UINT32>(best), out, qwNowUs);
+    }
+
+    bool pop(UINT32 dwLane, Entry& out, UINT64 qwNowUs) {
+        if (_lanes[dwLane].empty()) {
+            return false;
+        }
+        const Queued& q = _lanes[dwLane].front();
+        out.job = q.job;
+        out.enqueuedUs = q.enqueuedUs;
+        out.deadlineMs = q.deadlineMs;
+        out.lane = dwLane;
+        out.lateMs = 0;
+        _lanes[dwLane].pop_front();
+        SDJobLaneStats& s = _stats[dwLane];
+        ++s.m_qwDequeued;
+        UINT64 wait = qwNowUs > out.enqueuedUs ? qwNowUs - out.enqueuedUs : 0;
+        UINT32 bucket = 0;
+        for (UINT64 v = wait; v && bucket < SDJOB_WAIT_BUCKETS - 1; v >>= 1) ++bucket;
+        ++s.m_aqwWaitBuckets[bucket];
+        s.m_qwWaitTotalUs += wait;
+        s.m_qwWaitMaxUs = std::max(s.m_qwWaitMaxUs, wait);
+        UINT64 deadline = UINT64(out.deadlineMs) * 1000;
+        out.late = out.deadlineMs && wait > deadline;
+        if (out.late) {
+            ++s.m_qwLate;
+            out.lateMs = static_cast<UINT32>((wait - deadline) / 1000);
+        }
+        resized(dwLane);
+        return true;
+    }
+
+    // Pops the front of dwLane only when it has no deadline.
+    bool popPlain(UINT32 dwLane, Entry& out, UINT64 qwNowUs) {
+        if (_lanes[dwLane].empty() || _lanes[dwLane].front().deadlineMs) {
+            return false;
+        }
+        return pop(dwLane, out, qwNowUs);
+    }
+
+    size_t size() const { return _total.load(std::memory_order_relaxed); }
+    size_t size(UINT32 dwLane) const { return _sizes[dwLane].load(std::memory_order_relaxed); }
+
+    // Moves every queued job into out.
+    void clear(std::vector<ISSRunable*>& out) {
+        for (UINT32 i = 0; i < SDJOB_PRIORITY_COUNT; ++i) {
+            for (const Queued& q : _lanes[i]) {
+                out.push_back(q.job);
+            }
+            _lanes[i].clear();
+            _current[i] = 0;
+            resized(i);
+        }
+    }
+
+    void setWeight(UINT32 dwLane, UINT32 dwWeight) { _weights[dwLane] = dwWeight ? dwWeight : 1; }
+
+    // Called without the lock once OnDeadlineMissed has declined a job.
+    void dropped(UINT32 dwLane) { _dropped[dwLane].fetch_add(1, std::memory_order_relaxed); }
+
+    void stats(UINT32 dwLane, SDJobLaneStats& out) const {
+        out = _stats[dwLane];
+        out.m_dwPending = static_cast<UINT32>(_lanes[dwLane].size());
+        out.m_dwWeight = _weights[dwLane];
+        out.m_qwDropped = _dropped[dwLane].load(std::memory_order_relaxed);
+    }
+
+    void resetStats() {
+        for (UINT32 i = 0; i < SDJOB_PRIORITY_COUNT; ++i) {
+            std::memset(&_stats[i], 0, sizeof(_stats[i]));
+            _dropped[i].store(0, std::memory_order_relaxed);
+        }
+    }
+
+private:
+    void resized(UINT32 dwLane) {
+        _sizes[dwLane].store(_lanes[dwLane].size(), std::memory_order_relaxed);
+        size_t total = 0;
+        for (UINT32 i = 0; i < SDJOB_PRIORITY_COUNT; ++i) total += _lanes[i].size();
+        _total.store(total, std::memory_order_release);
+    }
+
+    struct Queued {
+        ISSRunable* job;
+        UINT64 enqueuedUs;
+        UINT32 deadlineMs;
+    };
+
+    std::deque<Queued> _lanes[SDJOB_PRIORITY_COUNT];
+    UINT32 _weights[SDJOB_PRIORITY_COUNT];
+    INT32 _current[SDJOB_PRIORITY_COUNT];
+    SDJobLaneStats _stats[SDJOB_PRIORITY_COUNT];
+    std::atomic<UINT64> _dropped[SDJOB_PRIORITY_COUNT];
+    std::atomic<size_t> _sizes[SDJOB_PRIORITY_COUNT];
+    std::atomic<size_t> _total;
+};
+
+namespace {
+
+// Jobs a stealing worker runs between busy-time updates.
+const UINT32 BUSY_FLUSH = 64;
+
+UINT64 nowUs() {
+    return SDTimeNanoSec() / 1000;
+}
+
+// The job to run for a dequeued entry: a late one only if its
+// OnDeadlineMissed keeps it, otherwise nullptr.
+ISSRunable* admit(const CSDJobLanes::Entry& e, CSDJobLanes& lanes) {
+    if (e.late && !e.job->OnDeadlineMissed(e.lateMs)) {
+        lanes.dropped(e.lane);
+        return nullptr;
+    }
+    return e.job;
+}
+
+} // namespace
+
+// Work-stealing mode. Each worker owns a JobDeque. Plain jobs (normal
+// priority, no deadline) scheduled by a running job go to its worker's
+// deque; everything else goes to the pool's priority lanes. A worker takes
+// from its own deque, or from the lanes first while high-priority jobs
+// wait there; then from the lanes, moving a batch of plain normal jobs into
+// its deque when no other lane is busy; then it steals from random victims.
+// Idle workers sleep on a condition that producers only signal when
+// someone sleeps.
+class CSDWorkStealing {
+public:
+    CSDWorkStealing(UINT32 dwWorkers, CSDJobLanes& lanes, CSDMutex& lanesMutex)
+        : _lanes(lanes), _lanesMutex(lanesMutex), _pending(0), _sleepers(0), _stopping(false) {
+        for (UINT32 i = 0; i < dwWorkers; ++i) {
+            _workers.emplace_back(new Worker(i));
+        }
+    }
+
+    UINT32 workers() const { return static_cast<UINT32>(_workers.size()); }
+
+    BOOL schedule(ISSRunable* pJob, UINT32 dwLane, UINT32 dwDeadlineMs, UINT32 dwMaxPending) {
+        // Counted before it is visible, so a worker that sees no pending
+        // job may safely sleep.
+        if (_pending.fetch_add(1, std::memory_order_seq_cst) >= dwMaxPending && dwMaxPending > 0) {
+            _pending.fetch_sub(1, std::memory_order_relaxed);
+            return FALSE;
+        }
+        if (s_current == this && dwLane == SDJOB_PRIORITY_NORMAL && dwDeadlineMs == 0) {
+            _workers[s_index]->deque.push(pJob);
+        } else {
+            UINT64 now = nowUs();
+            MutexGuard guard(_lanesMutex);
+            _lanes.push(pJob, dwLane, dwDeadlineMs, now);
+        }
+        if (_sleepers.load(std::memory_order_seq_cst) > 0) {
+            MutexGuard guard(_sleepMutex);
+            _wake.Signal();
+        }
+        return TRUE;
+    }
+
+    // Runs on worker dwIndex for as long as the pool keeps it.
+    void enter(UINT32 dwIndex) {
+        s_current = this;
+        s_index = dwIndex;
+    }
+
+    void leave() { s_current = nullptr; }
+
+    ISSRunable* take(UINT32 dwIndex) {
+        Worker& self = *_workers[dwIndex];
+        for (;;) {
+            CSDJobLanes::Entry e;
+            bool found = false;
+            ISSRunable* job = nullptr;
+            // While high-priority jobs wait, the lanes go before the deque.
+            if (_lanes.size(SDJOB_PRIORITY_HIGH) > 0) {
+                found = takeLane(&self, e);
+            }
+            if (!found) {
+                job = self.deque.pop();
+            }
+            if (!found && !job && _lanes.size() > 0) {
+                found = takeLane(&self, e);
+            }
+            if (!found && !job) {
+                job = steal(self.seed, &self);
+            }
+            if (!found && !job) {
+                return nullptr;
+            }
+            _pending.fetch_sub(1, std::memory_order_relaxed);
+            if (found) {
+                job = admit(e, _lanes);
+            }
+            if (job) {
+                return job;
+            }
+        }
+    }
+
+    // take() for any thread: a thread outside the pool takes from the
+    // lanes or steals, since it has no deque of its own.
+    ISSRunable* help() {
+        if (s_current == this) {
+            return take(s_index);
+        }
+        for (;;) {
+            CSDJobLanes::Entry e;
+            bool found = _lanes.size() > 0 && takeLane(nullptr, e);
+            ISSRunable* job = found ? nullptr : steal(s_helperSeed, nullptr);
+            if (!found && !job) {
+                return nullptr;
+            }
+            _pending.fetch_sub(1, std::memory_order_relaxed);
+            if (found) {
+                job = admit(e, _lanes);
+            }
+            if (job) {
+                return job;
+            }
+        }
+    }
+
+    // Sleeps until a job is scheduled, wake() is called or the wait times out.
+    // Jobs pending but not found (a lost steal, a job not yet published)
+    // only yield, so the worker retries promptly.
+    void idle(UINT32 dwMs) {
+        if (_pending.load(std::memory_order_relaxed) > 0) {
+            std::this_thread::yield();
+            return;
+        }
+        MutexGuard guard(_sleepMutex);
+        _sleepers.fetch_add(1, std::memory_order_seq_cst);
+        if (_pending.load(std::memory_order_seq_cst) == 0 && !_stopping.load(std::memory_order_relaxed)) {
+            _wake.Wait(_sleepMutex, dwMs);
+        }
+        _sleepers.fetch_sub(1, std::memory_order_relaxed);
+    }
+
+    // Wakes every sleeping worker and keeps them from sleeping until clear().
+    void wake() {
+        MutexGuard guard(_sleepMutex);
+        _stopping.store(true, std::memory_order_relaxed);
+        _wake.Broadcast();
+    }
+
+    UINT32 pending() const {
+        INT64 n = _pending.load(std::memory_order_relaxed);
+        return n > 0 ? static_cast<UINT32>(n) : 0;
+    }
+
+    // Moves the jobs in the deques into out; only while no worker runs. The
+    // pool clears the lanes.
+    void clear(std::vector<ISSRunable*>& out) {
+        for (auto& w : _workers) {
+            w->deque.clear(out);
+        }
+        _pending.store(0, std::memory_order_relaxed);
+        _stopping.store(false, std::memory_order_relaxed);
+    }
+
+private:
+    static const UINT32 INJECT_BATCH = 32;
+
+    struct alignas(64) Worker {
+        explicit Worker(UINT32 index) : seed(index * 2654435761u + 1) {}
+        JobDeque deque;
+        UINT32 seed;                        // xorshift state for victims
+    };
+
+    // Takes one entry from the lanes by weight. When only the normal lane
+    // is busy, a worker taking a plain job also moves a fair share of the
+    // plain jobs behind it into its deque, where idle workers can steal
+    // them; with other lanes busy that would defeat the weights.
+    bool takeLane(Worker* self, CSDJobLanes::Entry& out) {
+        MutexGuard guard(_lanesMutex);
+        UINT64 now = nowUs();
+        bool found = _lanes.pop(out, now);
+        if (!found || !self || out.lane != SDJOB_PRIORITY_NORMAL || out.deadlineMs ||
+            _lanes.size() != _lanes.size(SDJOB_PRIORITY_NORMAL)) {
+            return found;
+        }
+        size_t share = std::min<size_t>(_lanes.size(SDJOB_PRIORITY_NORMAL) / _workers.size(), INJECT_BATCH);
+        CSDJobLanes::Entry moved;
+        for (size_t i = 0; i < share && _lanes.popPlain(SDJOB_PRIORITY_NORMAL, moved, now); ++i) {
+            self->deque.push(moved.job);
+        }
+        return true;
+    }
+
+    ISSRunable* steal(UINT32& seed, const Worker* self) {
+        UINT32 n = workers();
+        if (n < (self ? 2u : 1u)) {
+            return nullptr;
+        }
+        // Two passes over random victims; a lost race counts as a miss.
+        for (UINT32 i = 0; i < 2 * n; ++i) {
+            seed ^= seed << 13;
+            seed ^= seed >> 17;
+            seed ^= seed << 5;
+            Worker& victim = *_workers[seed % n];
+            if (&victim == self) {
+                continue;
+            }
+            ISSRunable* job = victim.deque.steal();
+            if (job) {
+                return job;
+            }
+        }
+        return nullptr;
+    }
+
+    static thread_local CSDWorkStealing* s_current;
+    static thread_local UINT32 s_index;
+    static thread_local UINT32 s_helperSeed;
+
+    std::vector<std::unique_ptr<Worker>> _workers;
+    CSDJobLanes& _lanes;
+    CSDMutex& _lanesMutex;
+    std::atomic<INT64> _pending;            // scheduled and not yet taken
+    std::atomic<UINT32> _sleepers;
+    std::atomic<bool> _stopping;
+    CSDMutex _sleepMutex;
+    CSDCondition _wake;
+};
+
+// Counters behind GetStats/GetWorkerStats. One slot per possible worker,
+// written only by that worker; the set lives from one Init to the next so
+// the numbers can still be read after TerminateWaitJobs.
+class CSDThreadPoolMetrics {
+public:
+    explicit CSDThreadPoolMetrics(UINT32 dwWorkers) : _slots(dwWorkers), _started(0), _spawned(0), _helped(0) {}
+
+    void started(UINT32 dwIndex) {
+        Slot& s = _slots[dwIndex];
+        s.startUs.store(nowUs(), std::memory_order_relaxed);
+        UINT32 n = _started.load(std::memory_order_relaxed);
+        while (n <= dwIndex && !_started.compare_exchange_weak(n, dwIndex + 1, std::memory_order_release)) {
+        }
+    }
+
+    void stopped(UINT32 dwIndex) { _slots[dwIndex].stopUs.store(nowUs(), std::memory_order_relaxed); }
+
+    void ran(UINT32 dwIndex, UINT32 dwJobs, UINT64 qwBusyUs) {
+        Slot& s = _slots[dwIndex];
+        s.jobs.store(s.jobs.load(std::memory_order_relaxed) + dwJobs, std::memory_order_relaxed);
+        s.busyUs.store(s.busyUs.load(std::memory_order_relaxed) + qwBusyUs, std::memory_order_relaxed);
+    }
+
+    void helped() { _helped.fetch_add(1, std::memory_order_relaxed); }
+    void spawned() { _spawned.fetch_add(1, std::memory_order_relaxed); }
+
+    void totals(SDThreadPoolStats& out) const {
+        out.m_dwThreadsPeak = _started.load(std::memory_order_acquire);
+        out.m_qwThreadsSpawned = _spawned.load(std::memory_order_relaxed);
+        out.m_qwJobsExecuted = _helped.load(std::memory_order_relaxed);
+        out.m_qwBusyUs = 0;
+        for (UINT32 i = 0; i < out.m_dwThreadsPeak; ++i) {
+            out.m_qwJobsExecuted += _slots[i].jobs.load(std::memory_order_relaxed);
+            out.m_qwBusyUs += _slots[i].busyUs.load(std::memory_order_relaxed);
+        }
+    }
+
+    UINT32 workers(SDThreadPoolWorkerStats* pOut, UINT32 dwCount) const {
+        UINT32 n = std::min(_started.load(std::memory_order_acquire), dwCount);
+        UINT64 now = nowUs();
+        for (UINT32 i = 0; i < n; ++i) {
+            const Slot& s = _slots[i];
+            UINT64 start = s.startUs.load(std::memory_order_relaxed);
+            UINT64 stop = s.stopUs.load(std::memory_order_relaxed);
+            pOut[i].m_dwIndex = i;
+            pOut[i].m_qwJobs = s.jobs.load(std::memory_order_relaxed);
+            pOut[i].m_qwBusyUs = s.busyUs.load(std::memory_order_relaxed);
+            pOut[i].m_qwAliveUs = (stop ? stop : now) - start;
+        }
+        return n;
+    }
+
+private:
+    struct alignas(64) Slot {
+        Slot() : jobs(0), busyUs(0), startUs(0), stopUs(0) {}
+        std::atomic<UINT64> jobs;
+        std::atomic<UINT64> busyUs;
+        std::atomic<UINT64> startUs;
+        std::atomic<UINT64> stopUs;             // 0 while running
+    };
+
+    std::vector<Slot> _slots;
+    std::atomic<UINT32> _started;           // highest started index + 1
+    std::atomic<UINT64> _spawned;
+    std::atomic<UINT64> _helped;
+};
+
+thread_local CSDWorkStealing* CSDWorkStealing::s_current = nullptr;
+thread_local UINT32 CSDWorkStealing::s_index = 0;
+thread_local UINT32 CSDWorkStealing::s_helperSeed = 0x9E3779B9u;
+
+const UINT32 CSDThreadPool::WAITTIME;
+const UINT32 CSDThreadPool::WAITCOUNT;
+
 CSDThreadPool::CSDThreadPool()
-    : m_minThreads(0)
+    : m_pLanes(new CSDJobLanes())
+    , m_pStealing(nullptr)
+    , m_pMetrics(new CSDThreadPoolMetrics(0))
+    , m_minThreads(0)
     , m_maxThreads(0)
     , m_maxPendingJobs(0)
+    , m_bThreadAttr(FALSE)
     , m_waitTerminate(FALSE)
-    , m_quickTerminate(FALSE) {}
+    , m_quickTerminate(FALSE) {
+    SDThreadAttrInit(&m_threadAttr);
+}
 
 CSDThreadPool::~CSDThreadPool() {
     TerminateQuick();
+    delete m_pStealing;
+    delete m_pMetrics;
+    delete m_pLanes;
 }
 
-BOOL CSDThreadPool::Init(UINT32 dwMinThrds, UINT32 dwMaxThrds, UINT32 dwMaxPendJobs) {
+BOOL CSDThreadPool::Init(UINT32 dwMinThrds, UINT32 dwMaxThrds, UINT32 dwMaxPendJobs, ESDThreadPoolMode eMode) {
     TerminateQuick();
+    delete m_pStealing;
+    m_pStealing = nullptr;
 
     if (dwMinThrds == 0) {
         dwMinThrds = 1;
@@ -51,14 +617,28 @@ BOOL CSDThreadPool::Init(UINT32 dwMinThrds, UINT32 dwMaxThrds, UINT32 dwMaxPendJ
     m_maxPendingJobs = dwMaxPendJobs;
     m_waitTerminate = FALSE;
     m_quickTerminate = FALSE;
+    {
+        MutexGuard jobGuard(m_jobMutex);
+        m_pLanes->resetStats();
+    }
+    delete m_pMetrics;
+    m_pMetrics = new CSDThreadPoolMetrics(m_maxThreads);
 
-    for (UINT32 i = 0; i < m_minThreads; ++i) {
+    // Stealing needs a fixed set of deques, so that pool starts at its size.
+    UINT32 threads = m_minThreads;
+    if (eMode == SDTHREADPOOL_WORK_STEALING) {
+        threads = m_minThreads = m_maxThreads;
+        m_pStealing = new CSDWorkStealing(threads, *m_pLanes, m_jobMutex);
+    }
+
+    for (UINT32 i = 0; i < threads; ++i) {
         ThreadArg* arg = new ThreadArg();
         arg->pThreadPool = this;
         arg->pThread = new CSDThread();
+        arg->dwIndex = i;
         arg->keepWorking = TRUE;
 
-        if (!arg->pThread->Start(&CSDThreadPool::WorkThreadFunc, arg)) {
+        if (!StartThread(arg)) {
             delete arg->pThread;
             delete arg;
             TerminateQuick();
@@ -72,82 +652,126 @@ BOOL CSDThreadPool::Init(UINT32 dwMinThrds, UINT32 dwMaxThrds, UINT32 dwMaxPendJ
     return TRUE;
 }
 
+void CSDThreadPool::SetThreadAttr(const SThreadAttr* pAttr) {
+    m_bThreadAttr = pAttr != nullptr;
+    if (pAttr) {
+        m_threadAttr = *pAttr;
+    }
+}
+
+// Starts a worker with the pool's attributes, its name suffixed by the
+// worker index ("name-3"), cutting the name rather than the index.
+BOOL CSDThreadPool::StartThread(ThreadArg* arg) {
+    if (m_bThreadAttr) {
+        SThreadAttr attr = m_threadAttr;
+        if (attr.m_szName[0]) {
+            char suffix[16];
+            int len = std::snprintf(suffix, sizeof(suffix), "-%u", arg->dwIndex);
+            size_t keep = std::min(std::strlen(attr.m_szName), SDTHREAD_NAME_LEN - 1 - static_cast<size_t>(len));
+            std::memcpy(attr.m_szName + keep, suffix, static_cast<size_t>(len) + 1);
+        }
+        arg->pThread->SetAttribute(&attr);
+    }
+    return arg->pThread->Start(&CSDThreadPool::WorkThreadFunc, arg);
+}
+
 BOOL CSDThreadPool::ScheduleJob(ISSRunable* pJob) {
-    if (!pJob) {
+    return ScheduleJob(pJob, SDJOB_PRIORITY_NORMAL, 0);
+}
+
+BOOL CSDThreadPool::ScheduleJob(ISSRunable* pJob, ESDJobPriority ePriority, UINT32 dwDeadlineMs) {
+    if (!pJob || ePriority < 0 || ePriority >= SDJOB_PRIORITY_COUNT) {
         return FALSE;
     }
     if (m_quickTerminate || m_waitTerminate) {
         return FALSE;
     }
+    if (m_pStealing) {
+        return m_pStealing->schedule(pJob, ePriority, dwDeadlineMs, m_maxPendingJobs);
+    }
 
     size_t pendingAfterPush = 0;
+    UINT64 now = nowUs();
     {
         MutexGuard jobGuard(m_jobMutex);
         if (m_quickTerminate || m_waitTerminate) {
             return FALSE;
         }
-        if (m_maxPendingJobs > 0 && m_jobContainer.size() >= m_maxPendingJobs) {
+        if (m_maxPendingJobs > 0 && m_pLanes->size() >= m_maxPendingJobs) {
             return FALSE;
         }
-        m_jobContainer.push_back(pJob);
-        pendingAfterPush = m_jobContainer.size();
+        m_pLanes->push(pJob, ePriority, dwDeadlineMs, now);
+        pendingAfterPush = m_pLanes->size();
         m_jobCondition.Signal();
     }
 
-    // If there are more pending jobs than threads and capacity allows, add a worker.
-    while (true) {
-        size_t threadCount = 0;
-        {
-            MutexGuard threadGuard(m_threadMutex);
-            threadCount = m_threadArgContainer.size();
-        }
-        if (threadCount >= m_maxThreads || pendingAfterPush <= threadCount) {
-            break;
-        }
-
+    // If there are more pending jobs than threads and capacity allows, add
+    // workers. The count is checked and the index taken under the thread
+    // mutex, so concurrent callers cannot overshoot m_maxThreads.
+    MutexGuard threadGuard(m_threadMutex);
+    while (m_threadArgContainer.size() < m_maxThreads && pendingAfterPush > m_threadArgContainer.size()) {
         ThreadArg* arg = new ThreadArg();
         arg->pThreadPool = this;
         arg->pThread = new CSDThread();
+        arg->dwIndex = static_cast<UINT32>(m_threadArgContainer.size());
         arg->keepWorking = TRUE;
-        if (!arg->pThread->Start(&CSDThreadPool::WorkThreadFunc, arg)) {
+        if (!StartThread(arg)) {
             delete arg->pThread;
             delete arg;
             break;
         }
-
-        {
-            MutexGuard threadGuard(m_threadMutex);
-            m_threadArgContainer.push_back(arg);
-            m_threadArgMap.insert(ThreadArgPair(arg, arg));
-            threadCount = m_threadArgContainer.size();
-        }
-
-        if (threadCount >= m_maxThreads || pendingAfterPush <= threadCount) {
-            break;
-        }
+        m_threadArgContainer.push_back(arg);
+        m_threadArgMap.insert(ThreadArgPair(arg, arg));
+        m_pMetrics->spawned();
     }
 
     return TRUE;
 }
 
 void CSDThreadPool::TerminateQuick() {
+    std::vector<ISSRunable*> dropped;
     {
         MutexGuard jobGuard(m_jobMutex);
-        if (m_jobContainer.empty() && m_threadArgContainer.empty()) {
+        if (m_pLanes->size() == 0 && m_threadArgContainer.empty()) {
             m_quickTerminate = FALSE;
             m_waitTerminate = FALSE;
             return;
         }
         m_quickTerminate = TRUE;
-        m_jobContainer.clear();
+        m_pLanes->clear(dropped);
         m_jobCondition.Broadcast();
     }
+    if (m_pStealing) {
+        m_pStealing->wake();
+    }
+
+    JoinThreads(TRUE);
+    if (m_pStealing) {
+        // A job still running may have scheduled more before it saw the flag.
+        {
+            MutexGuard jobGuard(m_jobMutex);
+            m_pLanes->clear(dropped);
+        }
+        m_pStealing->clear(dropped);
+    }
+    // Dropped jobs are never run; OnCancel lets their owners know.
+    for (ISSRunable* job : dropped) {
+        job->OnCancel();
+    }
 
+    m_quickTerminate = FALSE;
+    m_waitTerminate = FALSE;
+}
+
+// With bStop FALSE the workers are left to finish on their own.
+void CSDThreadPool::JoinThreads(BOOL bStop) {
     std::vector<ThreadArg*> threads;
     {
         MutexGuard threadGuard(m_threadMutex);
         for (ThreadArg* arg : m_threadArgContainer) {
-            arg->keepWorking = FALSE;
+            if (bStop) {
+                arg->keepWorking = FALSE;
+            }
             threads.push_back(arg);
         }
     }
@@ -167,53 +791,30 @@ void CSDThreadPool::TerminateQuick() {
         m_threadArgContainer.clear();
         m_threadArgMap.clear();
     }
-
-    m_quickTerminate = FALSE;
-    m_waitTerminate = FALSE;
 }
 
 void CSDThreadPool::TerminateWaitJobs() {
-    m_waitTerminate = TRUE;
-
-    // Wait until all queued jobs are consumed.
-    while (true) {
-        {
-            MutexGuard jobGuard(m_jobMutex);
-            if (m_jobContainer.empty()) {
-                break;
-            }
-        }
-        std::this_thread::sleep_for(std::chrono::milliseconds(WAITTIME));
-    }
-
+    // Workers drain the queue themselves and leave once they find it empty
+    // with m_waitTerminate set; the flag is raised under the job mutex so a
+    // worker about to wait on the condition cannot miss the broadcast.
+    // Stealing workers stop sleeping and spin only while jobs are pending.
     {
         MutexGuard jobGuard(m_jobMutex);
+        m_waitTerminate = TRUE;
         m_jobCondition.Broadcast();
     }
-
-    std::vector<ThreadArg*> threads;
-    {
-        MutexGuard threadGuard(m_threadMutex);
-        for (ThreadArg* arg : m_threadArgContainer) {
-            arg->keepWorking = FALSE;
-            threads.push_back(arg);
-        }
-    }
-
-    for (ThreadArg* arg : threads) {
-        if (arg && arg->pThread) {
-            arg->pThread->Wait();
-        }
+    if (m_pStealing) {
+        m_pStealing->wake();
     }
 
-    {
-        MutexGuard threadGuard(m_threadMutex);
-        for (ThreadArg* arg : m_threadArgContainer) {
-            delete arg->pThread;
-            delete arg;
+    JoinThreads(FALSE);
+    if (m_pStealing) {
+        // Normally empty by now; anything left is cancelled, not lost.
+        std::vector<ISSRunable*> dropped;
+        m_pStealing->clear(dropped);
+        for (ISSRunable* job : dropped) {
+            job->OnCancel();
         }
-        m_threadArgContainer.clear();
-        m_threadArgMap.clear();
     }
 
     m_waitTerminate = FALSE;
@@ -226,8 +827,115 @@ UINT32 CSDThreadPool::GetThreadNum() {
 }
 
 UINT32 CSDThreadPool::GetJobPending() {
+    if (m_pStealing) {
+        return m_pStealing->pending();
+    }
+    MutexGuard guard(m_jobMutex);
+    return static_cast<UINT32>(m_pLanes->size());
+}
+
+UINT32 CSDThreadPool::GetJobPending(ESDJobPriority ePriority) {
+    if (ePriority < 0 || ePriority >= SDJOB_PRIORITY_COUNT) {
+        return 0;
+    }
+    return static_cast<UINT32>(m_pLanes->size(ePriority));
+}
+
+BOOL CSDThreadPool::GetLaneStats(ESDJobPriority ePriority, SDJobLaneStats& stStats) {
+    if (ePriority < 0 || ePriority >= SDJOB_PRIORITY_COUNT) {
+        return FALSE;
+    }
     MutexGuard guard(m_jobMutex);
-    return static_cast<UINT32>(m_jobContainer.size());
+    m_pLanes->stats(ePriority, stStats);
+    return TRUE;
+}
+
+void CSDThreadPool::SetLaneWeight(ESDJobPriority ePriority, UINT32 dwWeight) {
+    if (ePriority < 0 || ePriority >= SDJOB_PRIORITY_COUNT) {
+        return;
+    }
+    MutexGuard guard(m_jobMutex);
+    m_pLanes->setWeight(ePriority, dwWeight);
+}
+
+void CSDThreadPool::GetStats(SDThreadPoolStats& stStats) {
+    std::memset(&stStats, 0, sizeof(stStats));
+    stStats.m_dwThreads = GetThreadNum();
+    m_pMetrics->totals(stStats);
+
+    UINT64 buckets[SDJOB_WAIT_BUCKETS] = {0};
+    UINT64 dequeued = 0;
+    UINT64 waitTotal = 0;
+    UINT64 waitMax = 0;
+    {
+        MutexGuard guard(m_jobMutex);
+        for (UINT32 i = 0; i < SDJOB_PRIORITY_COUNT; ++i) {
+            SDJobLaneStats lane;
+            m_pLanes->stats(i, lane);
+            dequeued += lane.m_qwDequeued;
+            waitTotal += lane.m_qwWaitTotalUs;
+            waitMax = std::max(waitMax, lane.m_qwWaitMaxUs);
+            for (UINT32 b = 0; b < SDJOB_WAIT_BUCKETS; ++b) {
+                buckets[b] += lane.m_aqwWaitBuckets[b];
+            }
+        }
+    }
+    if (dequeued == 0) {
+        return;
+    }
+    stStats.m_qwWaitAvgUs = waitTotal / dequeued;
+    // Bucket b holds waits below 2^b us; the last one is open-ended.
+    UINT64 rank = dequeued - dequeued / 100;
+    UINT64 seen = 0;
+    for (UINT32 b = 0; b < SDJOB_WAIT_BUCKETS; ++b) {
+        seen += buckets[b];
+        if (seen >= rank) {
+            UINT64 bound = b + 1 < SDJOB_WAIT_BUCKETS ? (UINT64(1) << b) : waitMax;
+            stStats.m_qwWaitP99Us = std::min(bound, waitMax);
+            break;
+        }
+    }
+}
+
+UINT32 CSDThreadPool::GetWorkerStats(SDThreadPoolWorkerStats* pStats, UINT32 dwCount) {
+    if (!pStats) {
+        return 0;
+    }
+    return m_pMetrics->workers(pStats, dwCount);
+}
+
+ESDThreadPoolMode CSDThreadPool::GetMode() {
+    return m_pStealing ? SDTHREADPOOL_WORK_STEALING : SDTHREADPOOL_SHARED_QUEUE;
+}
+
+BOOL CSDThreadPool::RunPendingJob() {
+    ISSRunable* job = nullptr;
+    if (m_pStealing) {
+        // A worker helping from inside a job (CSDTaskGroup::Wait) is still
+        // busy with that job, so its help counts only as a job run.
+        job = m_pStealing->help();
+    } else {
+        CSDJobLanes::Entry e;
+        bool found;
+        {
+            MutexGuard jobGuard(m_jobMutex);
+            found = m_pLanes->pop(e, nowUs());
+        }
+        if (!found) {
+            return FALSE;
+        }
+        // A dropped late job still counts as work done.
+        job = admit(e, *m_pLanes);
+        if (!job) {
+            return TRUE;
+        }
+    }
+    if (!job) {
+        return FALSE;
+    }
+    job->Run();
+    m_pMetrics->helped();
+    return TRUE;
 }
 
 SDTHREAD_DECLARE(CSDThreadPool::WorkThreadFunc)(void* pArg) {
@@ -236,13 +944,24 @@ SDTHREAD_DECLARE(CSDThreadPool::WorkThreadFunc)(void* pArg) {
         SDTHREAD_RETURN(0);
     }
     CSDThreadPool* pool = arg->pThreadPool;
+    CSDThreadPoolMetrics* metrics = pool->m_pMetrics;
+    metrics->started(arg->dwIndex);
+    if (pool->m_pStealing) {
+        StealingWork(arg);
+        metrics->stopped(arg->dwIndex);
+        SDTHREAD_RETURN(0);
+    }
 
+    // Read outside the lock so the clock stays out of the critical section:
+    // the end of one job is the pop time of the next, refreshed after sleeping.
+    UINT64 now = nowUs();
     while (arg->keepWorking && !pool->m_quickTerminate) {
-        ISSRunable* job = nullptr;
+        CSDJobLanes::Entry entry;
+        bool found = false;
         {
             MutexGuard jobGuard(pool->m_jobMutex);
             UINT32 waitCount = 0;
-            while (arg->keepWorking && !pool->m_quickTerminate && pool->m_jobContainer.empty()) {
+            while (arg->keepWorking && !pool->m_quickTerminate && pool->m_pLanes->size() == 0) {
                 if (pool->m_waitTerminate) {
                     arg->keepWorking = FALSE;
                     break;
@@ -251,34 +970,73 @@ SDTHREAD_DECLARE(CSDThreadPool::WorkThreadFunc)(void* pArg) {
                     waitCount = 0;
                 }
                 pool->m_jobCondition.Wait(pool->m_jobMutex, WAITTIME);
+                now = nowUs();
             }
             if (!arg->keepWorking || pool->m_quickTerminate) {
                 break;
             }
-            if (!pool->m_jobContainer.empty()) {
-                job = pool->m_jobContainer.front();
-                pool->m_jobContainer.pop_front();
+            if (pool->m_pLanes->pop(entry, now)) {
+                found = true;
             } else if (pool->m_waitTerminate) {
                 arg->keepWorking = FALSE;
             }
         }
 
+        ISSRunable* job = found ? admit(entry, *pool->m_pLanes) : nullptr;
         if (!job) {
+            now = nowUs();
             continue;
         }
 
         job->Run();
+        UINT64 end = nowUs();
+        metrics->ran(arg->dwIndex, 1, end - now);
+        now = end;
+    }
 
-        {
-            MutexGuard jobGuard(pool->m_jobMutex);
-            if (pool->m_jobContainer.empty()) {
-                pool->m_jobCondition.Broadcast();
+    arg->keepWorking = FALSE;
+    metrics->stopped(arg->dwIndex);
+    SDTHREAD_RETURN(0);
+}
+
+void CSDThreadPool::StealingWork(ThreadArg* arg) {
+    CSDThreadPool* pool = arg->pThreadPool;
+    CSDWorkStealing* stealing = pool->m_pStealing;
+    CSDThreadPoolMetrics* metrics = pool->m_pMetrics;
+    stealing->enter(arg->dwIndex);
+    // Jobs here are too cheap to time one by one: busy time is counted per
+    // run of jobs without idling, flushed when the worker runs dry and
+    // every BUSY_FLUSH jobs. It includes taking and stealing.
+    UINT64 start = nowUs();
+    UINT32 run = 0;
+    while (arg->keepWorking && !pool->m_quickTerminate) {
+        ISSRunable* job = stealing->take(arg->dwIndex);
+        if (job) {
+            job->Run();
+            if (++run < BUSY_FLUSH) {
+                continue;
             }
         }
+        if (run) {
+            UINT64 end = nowUs();
+            metrics->ran(arg->dwIndex, run, end - start);
+            start = end;
+            run = 0;
+        }
+        if (job) {
+            continue;
+        }
+        if (pool->m_waitTerminate && stealing->pending() == 0) {
+            break;
+        }
+        stealing->idle(WAITTIME);
+        start = nowUs();
     }
-
+    if (run) {
+        metrics->ran(arg->dwIndex, run, nowUs() - start);
+    }
+    stealing->leave();
     arg->keepWorking = FALSE;
-    SDTHREAD_RETURN(0);
 }
 
 } // namespace SSCP
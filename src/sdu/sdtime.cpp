@@ -1,9 +1,20 @@
 #include "ssengine/sdtime.h"
+#include <algorithm>
+#include <atomic>
 #include <chrono>
 #include <thread>
 #include <iomanip>
 #include <sstream>
 
+#if defined(__x86_64__) || defined(__i386__)
+#include <cpuid.h>
+#include <x86intrin.h>
+#define SD_HAS_TSC 1
+#elif defined(_M_X64) || defined(_M_IX86)
+#include <intrin.h>
+#define SD_HAS_TSC 1
+#endif
+
 namespace SSCP {
 
 using Clock = std::chrono::system_clock;
@@ -260,4 +271,178 @@ UINT64 SSAPI SDTimeSecs() {
     return static_cast<UINT64>(duration_cast<seconds>(steady_clock::now().time_since_epoch()).count());
 }
 
+namespace {
+
+UINT64 steadyNanoSec() {
+    using namespace std::chrono;
+    return static_cast<UINT64>(duration_cast<nanoseconds>(steady_clock::now().time_since_epoch()).count());
+}
+
+#ifdef SD_HAS_TSC
+// Invariant TSC (CPUID 0x80000007, EDX bit 8) ticks at a constant rate in
+// every P- and C-state, so it can stand in for a clock.
+bool tscInvariant() {
+#if defined(_MSC_VER)
+    int regs[4];
+    __cpuid(regs, 0x80000000);
+    if (static_cast<unsigned>(regs[0]) < 0x80000007u) return false;
+    __cpuid(regs, 0x80000007);
+    return (regs[3] & (1 << 8)) != 0;
+#else
+    unsigned a, b, c, d;
+    if (__get_cpuid_max(0x80000000u, nullptr) < 0x80000007u) return false;
+    __get_cpuid(0x80000007u, &a, &b, &c, &d);
+    return (d & (1u << 8)) != 0;
+#endif
+}
+
+// One steady_clock reading and the TSC at the same instant: the steady read
+// is bracketed by two TSC reads and the tightest of a few tries is kept.
+void tscPair(UINT64& tsc, UINT64& ns) {
+    UINT64 best = ~UINT64(0);
+    for (int i = 0; i < 8; ++i) {
+        UINT64 t0 = __rdtsc();
+        UINT64 n = steadyNanoSec();
+        UINT64 t1 = __rdtsc();
+        if (t1 - t0 < best) {
+            best = t1 - t0;
+            tsc = t0 + (t1 - t0) / 2;
+            ns = n;
+        }
+    }
+}
+
+// TSC time is baseNs + (tsc - baseTsc) * nsPerTick. Every ANCHOR_NS the
+// line is re-anchored against steady_clock: the rate is re-measured over
+// the whole run since the origin pair, and the next segment is bent so it
+// meets steady_clock again at its end. Segments join end to end, so the
+// clock never steps back; readers retry while a re-anchor is in progress.
+struct TscClock {
+    std::atomic<UINT32> seq{0};
+    std::atomic<UINT64> baseTsc{0};
+    std::atomic<UINT64> baseNs{0};
+    std::atomic<UINT64> nextTsc{0};
+    std::atomic<double> nsPerTick{0};
+    std::atomic<bool> anchoring{false};
+    UINT64 originTsc = 0;
+    UINT64 originNs = 0;
+};
+
+const UINT64 ANCHOR_NS = 1000000000;    // re-anchor period
+const INT64 STEP_NS = 1000000;          // a lag above this is stepped out at once
+
+TscClock g_tsc;
+std::atomic<bool> g_tscOn(false);
+
+void tscPublish(UINT64 tsc, UINT64 ns, double nsPerTick, UINT64 nextTsc) {
+    g_tsc.seq.fetch_add(1, std::memory_order_acq_rel);
+    g_tsc.baseTsc.store(tsc, std::memory_order_relaxed);
+    g_tsc.baseNs.store(ns, std::memory_order_relaxed);
+    g_tsc.nsPerTick.store(nsPerTick, std::memory_order_relaxed);
+    g_tsc.nextTsc.store(nextTsc, std::memory_order_relaxed);
+    g_tsc.seq.fetch_add(1, std::memory_order_release);
+}
+
+bool calibrateTsc() {
+    if (!tscInvariant()) return false;
+    UINT64 tsc0, ns0, tsc1, ns1;
+    tscPair(tsc0, ns0);
+    std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    tscPair(tsc1, ns1);
+    if (tsc1 <= tsc0 || ns1 <= ns0) return false;
+    double rate = static_cast<double>(ns1 - ns0) / static_cast<double>(tsc1 - tsc0);
+    g_tsc.originTsc = tsc0;
+    g_tsc.originNs = ns0;
+    tscPublish(tsc1, ns1, rate, tsc1 + static_cast<UINT64>(ANCHOR_NS / rate));
+    return true;
+}
+
+// Called by whichever reader first crosses nextTsc; the others keep using
+// the current segment meanwhile.
+void tscAnchor() {
+    if (g_tsc.anchoring.exchange(true, std::memory_order_acquire)) return;
+    UINT64 tsc, ns;
+    tscPair(tsc, ns);
+    UINT64 baseTsc = g_tsc.baseTsc.load(std::memory_order_relaxed);
+    if (tsc > baseTsc && tsc > g_tsc.originTsc) {
+        double rate = static_cast<double>(ns - g_tsc.originNs) / static_cast<double>(tsc - g_tsc.originTsc);
+        UINT64 cur = g_tsc.baseNs.load(std::memory_order_relaxed) +
+                     static_cast<UINT64>(static_cast<double>(tsc - baseTsc) * g_tsc.nsPerTick.load(std::memory_order_relaxed));
+        INT64 lag = static_cast<INT64>(ns - cur);
+        double ticks = ANCHOR_NS / rate;
+        double slewed = rate;
+        if (lag > STEP_NS) {
+            cur = ns;
+        } else {
+            // Absorb the error over the next period, bending the rate by at most 10%.
+            slewed = std::min(std::max(rate + static_cast<double>(lag) / ticks, rate * 0.9), rate * 1.1);
+        }
+        tscPublish(tsc, cur, slewed, tsc + static_cast<UINT64>(ticks));
+    }
+    g_tsc.anchoring.store(false, std::memory_order_release);
+}
+
+UINT64 tscNanoSec() {
+    for (;;) {
+        UINT32 seq = g_tsc.seq.load(std::memory_order_acquire);
+        UINT64 baseTsc = g_tsc.baseTsc.load(std::memory_order_relaxed);
+        UINT64 baseNs = g_tsc.baseNs.load(std::memory_order_relaxed);
+        double nsPerTick = g_tsc.nsPerTick.load(std::memory_order_relaxed);
+        UINT64 nextTsc = g_tsc.nextTsc.load(std::memory_order_relaxed);
+        UINT64 tsc = __rdtsc();
+        std::atomic_thread_fence(std::memory_order_acquire);
+        if ((seq & 1) || g_tsc.seq.load(std::memory_order_relaxed) != seq) continue;
+        if (tsc >= nextTsc) {
+            tscAnchor();
+            continue;
+        }
+        if (tsc <= baseTsc) return baseNs;
+        return baseNs + static_cast<UINT64>(static_cast<double>(tsc - baseTsc) * nsPerTick);
+    }
+}
+#endif
+
+// Refreshed by SDFrameClockUpdate; us == 0 until the first refresh.
+struct FrameClock {
+    UINT64 ms;
+    UINT64 us;
+};
+
+thread_local FrameClock t_frame = {0, 0};
+
+} // namespace
+
+UINT64 SSAPI SDTimeNanoSec() {
+#ifdef SD_HAS_TSC
+    if (g_tscOn.load(std::memory_order_acquire)) return tscNanoSec();
+#endif
+    return steadyNanoSec();
+}
+
+BOOL SSAPI SDTscEnable() {
+#ifdef SD_HAS_TSC
+    static const bool calibrated = calibrateTsc();
+    if (calibrated) g_tscOn.store(true, std::memory_order_release);
+    return calibrated ? TRUE : FALSE;
+#else
+    return FALSE;
+#endif
+}
+
+UINT64 SSAPI SDFrameClockUpdate() {
+    UINT64 ns = SDTimeNanoSec();
+    t_frame.us = ns / 1000;
+    t_frame.ms = ns / 1000000;
+    return t_frame.ms;
+}
+
+UINT64 SSAPI SDFrameMilliSec() {
+    return t_frame.us ? t_frame.ms : SDFrameClockUpdate();
+}
+
+UINT64 SSAPI SDFrameMicroSec() {
+    if (!t_frame.us) SDFrameClockUpdate();
+    return t_frame.us;
+}
+
 } // namespace SSCP
@@ -1,81 +1,285 @@
 #include "ssengine/sdtimer.h"
+#include "ssengine/sdtime.h"
 
-#include <algorithm>
-#include <chrono>
+#include <memory>
 #include <mutex>
-#include <thread>
+#include <string>
+#include <unordered_map>
 #include <vector>
 
 namespace SSCP {
 
 namespace {
-struct TimerEntry {
-    ISSTimer* handler{nullptr};
-    UINT32 id{0};
-    UINT32 elapse{0};
-    UINT32 loop{0};
-    std::chrono::steady_clock::time_point next;
+
+// Hierarchical timing wheel with a 1 ms tick, as in the Linux kernel: the
+// first level has 256 slots of one tick each, and each further level has 64
+// slots, each covering a whole turn of the level below. Together the five
+// levels span 2^32 ms, the full range of dwElapse. When the first level wraps,
+// the due slot of the next level is cascaded down, so every timer is touched
+// at most once per level.
+const UINT32 ROOT_BITS = 8;
+const UINT32 LEVEL_BITS = 6;
+const UINT32 ROOT_SIZE = 1u << ROOT_BITS;
+const UINT32 LEVEL_SIZE = 1u << LEVEL_BITS;
+const UINT32 LEVELS = 4;                    // above the root level
+const UINT32 NODES_PER_CHUNK = 1024;
+
+struct TimerNode {
+    TimerNode* prev;        // slot list; free list through next
+    TimerNode* next;
+    TimerNode* idPrev;      // timers sharing an id
+    TimerNode* idNext;
+    ISSTimer* handler;
+    UINT32 id;
+    UINT32 elapse;
+    UINT32 loop;
+    UINT64 expire;          // tick the timer is due at
 };
+
+void listInit(TimerNode& head) { head.prev = head.next = &head; }
+bool listEmpty(const TimerNode& head) { return head.next == &head; }
+
+void listAppend(TimerNode& head, TimerNode* node) {
+    node->prev = head.prev;
+    node->next = &head;
+    head.prev->next = node;
+    head.prev = node;
+}
+
+void listUnlink(TimerNode* node) {
+    node->prev->next = node->next;
+    node->next->prev = node->prev;
+    node->prev = node->next = nullptr;
 }
 
+// Moves every node of from to the empty list to.
+void listMove(TimerNode& from, TimerNode& to) {
+    if (listEmpty(from)) {
+        listInit(to);
+        return;
+    }
+    to.next = from.next;
+    to.prev = from.prev;
+    to.next->prev = &to;
+    to.prev->next = &to;
+    listInit(from);
+}
+
+} // namespace
+
 class CSDTimerImpl {
 public:
+    CSDTimerImpl() : _start(SDTimeNanoSec() / 1000000), _next(0), _count(0), _fired(0), _cascaded(0) {
+        for (TimerNode& head : _root) listInit(head);
+        for (auto& level : _levels) {
+            for (TimerNode& head : level) listInit(head);
+        }
+        _free = nullptr;
+    }
+
     BOOL SetTimer(ISSTimer* handler, UINT32 timerId, UINT32 elapse, UINT32 loop) {
         if (!handler || elapse == 0) {
             return FALSE;
         }
+        UINT64 now = tick(SDTimeNanoSec() / 1000000);
         std::lock_guard<std::mutex> lk(_mutex);
-        TimerEntry entry;
-        entry.handler = handler;
-        entry.id = timerId;
-        entry.elapse = elapse;
-        entry.loop = loop;
-        entry.next = std::chrono::steady_clock::now() + std::chrono::milliseconds(elapse);
-        _entries.push_back(entry);
+        TimerNode* node = allocNode();
+        node->handler = handler;
+        node->id = timerId;
+        node->elapse = elapse;
+        node->loop = loop;
+        node->expire = now + elapse;
+        // Timers sharing an id are kept and killed together.
+        TimerNode*& first = _ids[timerId];
+        node->idPrev = nullptr;
+        node->idNext = first;
+        if (first) first->idPrev = node;
+        first = node;
+        ++_count;
+        schedule(node);
         return TRUE;
     }
 
     BOOL KillTimer(UINT32 timerId) {
         std::lock_guard<std::mutex> lk(_mutex);
-        auto it = std::remove_if(_entries.begin(), _entries.end(), [timerId](const TimerEntry& e) {
-            return e.id == timerId;
-        });
-        bool removed = it != _entries.end();
-        _entries.erase(it, _entries.end());
-        return removed ? TRUE : FALSE;
+        auto it = _ids.find(timerId);
+        if (it == _ids.end()) {
+            return FALSE;
+        }
+        for (TimerNode* node = it->second; node;) {
+            TimerNode* next = node->idNext;
+            listUnlink(node);
+            freeNode(node);
+            --_count;
+            node = next;
+        }
+        _ids.erase(it);
+        return TRUE;
     }
 
+    // Run is the once-per-loop call, so it refreshes the thread's frame clock
+    // for the rest of the iteration.
     BOOL Run() {
-        std::vector<TimerEntry> callbacks;
-        auto now = std::chrono::steady_clock::now();
-        {
-            std::lock_guard<std::mutex> lk(_mutex);
-            for (auto& entry : _entries) {
-                if (now >= entry.next) {
-                    callbacks.push_back(entry);
-                    if (entry.loop == 1) {
-                        entry.loop = 0;
-                    } else if (entry.loop > 1 && entry.loop != 0xFFFFFFFFu) {
-                        --entry.loop;
+        UINT64 now = tick(SDFrameClockUpdate());
+        bool fired = false;
+        std::unique_lock<std::mutex> lk(_mutex);
+        if (_count == 0) {
+            // Nothing to cascade, so idle ticks need not be walked.
+            _next = now + 1;
+            return FALSE;
+        }
+        while (_next <= now) {
+            TimerNode due;
+            advance(due);
+            // Fire one node at a time without the lock, so OnTimer may set or
+            // kill timers, including ones still in due.
+            while (!listEmpty(due)) {
+                TimerNode* node = due.next;
+                listUnlink(node);
+                ISSTimer* handler = node->handler;
+                UINT32 id = node->id;
+                if (node->loop == 0 || node->loop == 1) {
+                    unlinkId(node);
+                    freeNode(node);
+                    --_count;
+                } else {
+                    if (node->loop != 0xFFFFFFFFu) {
+                        --node->loop;
                     }
-                    entry.next = now + std::chrono::milliseconds(entry.elapse);
+                    // Rescheduled from the current time, like a late Run.
+                    node->expire = now + node->elapse;
+                    schedule(node);
                 }
+                ++_fired;
+                fired = true;
+                lk.unlock();
+                handler->OnTimer(id);
+                lk.lock();
             }
-            _entries.erase(std::remove_if(_entries.begin(), _entries.end(), [](const TimerEntry& e) {
-                return e.loop == 0;
-            }), _entries.end());
         }
-        for (auto& cb : callbacks) {
-            if (cb.handler) {
-                cb.handler->OnTimer(cb.id);
+        return fired ? TRUE : FALSE;
+    }
+
+    std::string Dump() {
+        std::lock_guard<std::mutex> lk(_mutex);
+        std::string out = "timer-count:" + std::to_string(_count) + " ids:" + std::to_string(_ids.size()) +
+                          " tick:" + std::to_string(_next) + " fired:" + std::to_string(_fired) +
+                          " cascaded:" + std::to_string(_cascaded) +
+                          " nodes:" + std::to_string(_chunks.size() * NODES_PER_CHUNK) + " free:" +
+                          std::to_string(_chunks.size() * NODES_PER_CHUNK - _count);
+        // Per level: occupied slots, timers and the longest slot.
+        auto level = [&out](UINT32 n, const TimerNode* heads, UINT32 size) {
+            UINT32 used = 0;
+            UINT64 timers = 0;
+            UINT64 longest = 0;
+            for (UINT32 i = 0; i < size; ++i) {
+                UINT64 len = 0;
+                for (const TimerNode* p = heads[i].next; p != &heads[i]; p = p->next) ++len;
+                if (len) ++used;
+                timers += len;
+                if (len > longest) longest = len;
             }
+            out += " L" + std::to_string(n) + ":" + std::to_string(used) + "/" + std::to_string(size) + " slots," +
+                   std::to_string(timers) + " timers,max " + std::to_string(longest);
+        };
+        level(0, _root, ROOT_SIZE);
+        for (UINT32 i = 0; i < LEVELS; ++i) {
+            level(i + 1, _levels[i], LEVEL_SIZE);
         }
-        return !callbacks.empty() ? TRUE : FALSE;
+        return out;
     }
 
 private:
+    // Clamped, since a clock switched to the TSC may read a hair earlier.
+    UINT64 tick(UINT64 ms) const { return ms > _start ? ms - _start : 0; }
+
+    TimerNode* allocNode() {
+        if (!_free) {
+            _chunks.emplace_back(new TimerNode[NODES_PER_CHUNK]);
+            TimerNode* chunk = _chunks.back().get();
+            for (UINT32 i = 0; i < NODES_PER_CHUNK; ++i) {
+                chunk[i].next = i + 1 < NODES_PER_CHUNK ? &chunk[i + 1] : nullptr;
+            }
+            _free = chunk;
+        }
+        TimerNode* node = _free;
+        _free = node->next;
+        return node;
+    }
+
+    void freeNode(TimerNode* node) {
+        node->handler = nullptr;
+        node->next = _free;
+        _free = node;
+    }
+
+    void unlinkId(TimerNode* node) {
+        if (node->idNext) node->idNext->idPrev = node->idPrev;
+        if (node->idPrev) {
+            node->idPrev->idNext = node->idNext;
+        } else if (node->idNext) {
+            _ids[node->id] = node->idNext;
+        } else {
+            _ids.erase(node->id);
+        }
+    }
+
+    // Puts node in the slot its expiry falls in, relative to _next.
+    void schedule(TimerNode* node) {
+        UINT64 expire = node->expire < _next ? _next : node->expire;
+        UINT64 delta = expire - _next;
+        if (delta < ROOT_SIZE) {
+            listAppend(_root[expire & (ROOT_SIZE - 1)], node);
+            return;
+        }
+        UINT32 i = 0;
+        while (i + 1 < LEVELS && delta >= (UINT64(1) << (ROOT_BITS + (i + 1) * LEVEL_BITS))) {
+            ++i;
+        }
+        UINT32 shift = ROOT_BITS + i * LEVEL_BITS;
+        if (i + 1 == LEVELS && delta > 0xFFFFFFFFull) {
+            expire = _next + 0xFFFFFFFFull;
+        }
+        listAppend(_levels[i][(expire >> shift) & (LEVEL_SIZE - 1)], node);
+    }
+
+    // Re-files the timers of one slot of a higher level; returns the slot.
+    UINT32 cascade(UINT32 level) {
+        UINT32 index = static_cast<UINT32>((_next >> (ROOT_BITS + level * LEVEL_BITS)) & (LEVEL_SIZE - 1));
+        TimerNode moving;
+        listMove(_levels[level][index], moving);
+        while (!listEmpty(moving)) {
+            TimerNode* node = moving.next;
+            listUnlink(node);
+            schedule(node);
+            ++_cascaded;
+        }
+        return index;
+    }
+
+    // Processes tick _next: cascades when the root wraps and moves the
+    // root slot's timers to due.
+    void advance(TimerNode& due) {
+        UINT32 index = static_cast<UINT32>(_next & (ROOT_SIZE - 1));
+        if (index == 0) {
+            for (UINT32 level = 0; level < LEVELS && cascade(level) == 0; ++level) {
+            }
+        }
+        listMove(_root[index], due);
+        ++_next;
+    }
+
     std::mutex _mutex;
-    std::vector<TimerEntry> _entries;
+    UINT64 _start;                          // SDTimeNanoSec ms of tick 0
+    UINT64 _next;                           // next tick to process
+    TimerNode _root[ROOT_SIZE];
+    TimerNode _levels[LEVELS][LEVEL_SIZE];
+    std::unordered_map<UINT32, TimerNode*> _ids;
+    std::vector<std::unique_ptr<TimerNode[]>> _chunks;
+    TimerNode* _free;
+    UINT64 _count;
+    UINT64 _fired;
+    UINT64 _cascaded;
 };
 
 CSDTimer::CSDTimer()
@@ -99,7 +303,7 @@ BOOL SSAPI CSDTimer::Run() {
 }
 
 std::string SSAPI CSDTimer::DumpTimerInfo() {
-    return "timer-count:"; // placeholder summary
+    return m_pTimerImpl->Dump();
 }
 
 } // namespace SSCP
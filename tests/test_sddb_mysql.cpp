@@ -0,0 +1,1079 @@
+#include <gtest/gtest.h>
+#include "ssengine/sddb.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstring>
+#include <functional>
+#include <map>
+#include <mutex>
+#include <set>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+using namespace SSCP;
+
+namespace {
+
+// SHA-1 of its own, so the fake server checks the client's scramble
+// independently.
+std::string sha1(const std::string& msg) {
+    auto rol = [](UINT32 v, int n) { return (v << n) | (v >> (32 - n)); };
+    UINT32 h[5] = {0x67452301, 0xEFCDAB89, 0x98BADCFE, 0x10325476, 0xC3D2E1F0};
+    std::string m = msg;
+    UINT64 bits = static_cast<UINT64>(msg.size()) * 8;
+    m.push_back(static_cast<char>(0x80));
+    while (m.size() % 64 != 56) m.push_back('\0');
+    for (int i = 7; i >= 0; --i) m.push_back(static_cast<char>(bits >> (8 * i)));
+    for (size_t off = 0; off < m.size(); off += 64) {
+        UINT32 w[80];
+        for (int i = 0; i < 16; ++i) {
+            const unsigned char* p = reinterpret_cast<const unsigned char*>(m.data() + off + 4 * i);
+            w[i] = (UINT32(p[0]) << 24) | (UINT32(p[1]) << 16) | (UINT32(p[2]) << 8) | p[3];
+        }
+        for (int i = 16; i < 80; ++i) w[i] = rol(w[i - 3] ^ w[i - 8] ^ w[i - 14] ^ w[i - 16], 1);
+        UINT32 a = h[0], b = h[1], c = h[2], d = h[3], e = h[4];
+        for (int i = 0; i < 80; ++i) {
+            UINT32 f = i < 20 ? ((b & c) | (~b & d)) : i < 40 ? (b ^ c ^ d) : i < 60 ? ((b & c) | (b & d) | (c & d)) : (b ^ c ^ d);
+            UINT32 k = i < 20 ? 0x5A827999 : i < 40 ? 0x6ED9EBA1 : i < 60 ? 0x8F1BBCDC : 0xCA62C1D6;
+            UINT32 t = rol(a, 5) + f + e + k + w[i];
+            e = d; d = c; c = rol(b, 30); b = a; a = t;
+        }
+        h[0] += a; h[1] += b; h[2] += c; h[3] += d; h[4] += e;
+    }
+    std::string out(20, '\0');
+    for (int i = 0; i < 20; ++i) out[i] = static_cast<char>(h[i / 4] >> (24 - 8 * (i % 4)));
+    return out;
+}
+
+struct Reply {
+    enum Kind { OK, ERR, ROWS } kind = OK;
+    UINT64 affected = 0;
+    UINT64 insertId = 0;
+    UINT16 errCode = 0;
+    std::string errMsg;
+    std::vector<std::string> columns;
+    // "\xFB" alone marks a NULL cell.
+    std::vector<std::vector<std::string>> rows;
+    // Column types for binary rows, 0xfd when empty; 0x8000 marks unsigned.
+    std::vector<UINT16> types;
+};
+
+const std::string NULL_CELL = "\xFB";
+
+// In-process server speaking the MySQL wire protocol: native-password
+// handshake, COM_QUERY answered by a handler (split on ';' while
+// multi-statements are on), COM_SET_OPTION, COM_INIT_DB, COM_PING,
+// COM_STMT_PREPARE/EXECUTE/CLOSE and COM_QUIT. An executed statement reaches
+// the handler with its parameters substituted. One thread per connection.
+class FakeMySQL {
+public:
+    std::string user = "game";
+    std::string password = "secret";
+    std::function<Reply(const std::string&)> handler = [](const std::string&) { return Reply(); };
+
+    ~FakeMySQL() { stop(); }
+
+    bool start(int port) {
+        m_listen = ::socket(AF_INET, SOCK_STREAM, 0);
+        int on = 1;
+        ::setsockopt(m_listen, SOL_SOCKET, SO_REUSEADDR, &on, sizeof(on));
+        sockaddr_in addr;
+        std::memset(&addr, 0, sizeof(addr));
+        addr.sin_family = AF_INET;
+        addr.sin_port = htons(static_cast<uint16_t>(port));
+        addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+        if (::bind(m_listen, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) != 0 || ::listen(m_listen, 16) != 0) {
+            return false;
+        }
+        m_acceptor = std::thread([this] { acceptLoop(); });
+        return true;
+    }
+
+    void stop() {
+        if (m_stop.exchange(true)) return;
+        if (m_acceptor.joinable()) m_acceptor.join();
+        {
+            std::lock_guard<std::mutex> lk(m_mutex);
+            for (int fd : m_fds) ::shutdown(fd, SHUT_RDWR);
+        }
+        for (std::thread& t : m_threads) t.join();
+        if (m_listen >= 0) ::close(m_listen);
+    }
+
+    std::vector<std::string> queries() {
+        std::lock_guard<std::mutex> lk(m_mutex);
+        return m_queries;
+    }
+    int logins() const { return m_logins.load(); }
+    int maxBusy() const { return m_maxBusy.load(); }
+    int roundTrips() const { return m_roundTrips.load(); }
+    int prepares() const { return m_prepares.load(); }
+    int closes() const { return m_closes.load(); }
+
+private:
+    void acceptLoop() {
+        while (!m_stop) {
+            pollfd p = {m_listen, POLLIN, 0};
+            if (::poll(&p, 1, 20) <= 0) continue;
+            int fd = ::accept(m_listen, nullptr, nullptr);
+            if (fd < 0) continue;
+            std::lock_guard<std::mutex> lk(m_mutex);
+            m_fds.push_back(fd);
+            m_threads.emplace_back([this, fd] { serve(fd); ::close(fd); });
+        }
+    }
+
+    static bool recvAll(int fd, char* p, size_t n) {
+        while (n) {
+            ssize_t r = ::recv(fd, p, n, 0);
+            if (r <= 0) return false;
+            p += r;
+            n -= static_cast<size_t>(r);
+        }
+        return true;
+    }
+    bool readPacket(int fd, std::string& out, UINT8& seq) {
+        unsigned char h[4];
+        if (!recvAll(fd, reinterpret_cast<char*>(h), 4)) return false;
+        size_t len = h[0] | (h[1] << 8) | (h[2] << 16);
+        seq = static_cast<UINT8>(h[3] + 1);
+        out.assign(len, '\0');
+        return len == 0 || recvAll(fd, &out[0], len);
+    }
+    static void writePacket(int fd, const std::string& body, UINT8& seq) {
+        std::string p;
+        p.push_back(static_cast<char>(body.size() & 0xFF));
+        p.push_back(static_cast<char>((body.size() >> 8) & 0xFF));
+        p.push_back(static_cast<char>((body.size() >> 16) & 0xFF));
+        p.push_back(static_cast<char>(seq++));
+        p += body;
+        ::send(fd, p.data(), p.size(), MSG_NOSIGNAL);
+    }
+    static std::string lenenc(UINT64 v) {
+        std::string s;
+        if (v < 251) { s.push_back(static_cast<char>(v)); return s; }
+        s.push_back(static_cast<char>(0xFE));
+        for (int i = 0; i < 8; ++i) s.push_back(static_cast<char>(v >> (8 * i)));
+        return s;
+    }
+    static std::string lenStr(const std::string& v) { return lenenc(v.size()) + v; }
+    // status 0x0002 is autocommit, 0x0008 more results follow.
+    static std::string ok(UINT64 affected, UINT64 insertId, bool more = false) {
+        return std::string(1, '\0') + lenenc(affected) + lenenc(insertId) +
+               std::string(more ? "\x0a\x00\x00\x00" : "\x02\x00\x00\x00", 4);
+    }
+    static std::string err(UINT16 code, const std::string& msg) {
+        std::string s = "\xFF";
+        s.push_back(static_cast<char>(code & 0xFF));
+        s.push_back(static_cast<char>(code >> 8));
+        return s + "#HY000" + msg;
+    }
+    static std::string eof() { return std::string("\xFE\x00\x00\x02\x00", 5); }
+    static std::string columnDef(const std::string& name, UINT16 type) {
+        std::string def = lenStr("def") + lenStr("world") + lenStr("t") + lenStr("t") + lenStr(name) + lenStr(name);
+        def += std::string("\x0c\x21\x00\xff\x00\x00\x00", 7);
+        def.push_back(static_cast<char>(type & 0xFF));
+        def.push_back(static_cast<char>((type & 0x8000) ? 0x20 : 0));
+        return def + std::string(4, '\0');
+    }
+    static UINT64 getInt(const std::string& s, size_t& pos, int bytes) {
+        UINT64 v = 0;
+        for (int i = 0; i < bytes && pos < s.size(); ++i) v |= UINT64(static_cast<unsigned char>(s[pos++])) << (8 * i);
+        return v;
+    }
+
+    // Substitutes the COM_STMT_EXECUTE parameters into the statement text.
+    static std::string bindParams(const std::string& sql, const std::string& arg) {
+        size_t n = static_cast<size_t>(std::count(sql.begin(), sql.end(), '?'));
+        size_t pos = 9;
+        size_t bitmap = pos;
+        pos += (n + 7) / 8 + 1;
+        size_t types = pos;
+        pos += 2 * n;
+        std::string out;
+        size_t k = 0;
+        for (char c : sql) {
+            if (c != '?') { out.push_back(c); continue; }
+            UINT8 type = static_cast<UINT8>(arg[types + 2 * k]);
+            bool uns = (static_cast<UINT8>(arg[types + 2 * k + 1]) & 0x80) != 0;
+            std::ostringstream v;
+            if (arg[bitmap + k / 8] & (1 << (k % 8))) {
+                v << "NULL";
+            } else if (type == 0x08) {
+                UINT64 x = getInt(arg, pos, 8);
+                if (uns) v << x; else v << static_cast<INT64>(x);
+            } else if (type == 0x05) {
+                UINT64 x = getInt(arg, pos, 8);
+                double d;
+                std::memcpy(&d, &x, sizeof(d));
+                v << d;
+            } else {
+                size_t len = static_cast<unsigned char>(arg[pos++]);
+                if (len == 0xFC) len = getInt(arg, pos, 2);
+                v << '\'' << arg.substr(pos, len) << '\'';
+                pos += len;
+            }
+            out += v.str();
+            ++k;
+        }
+        return out;
+    }
+    static std::string binaryRow(const std::vector<std::string>& row, const std::vector<UINT16>& types) {
+        std::string bitmap((row.size() + 9) / 8, '\0');
+        std::string values;
+        for (size_t i = 0; i < row.size(); ++i) {
+            if (row[i] == NULL_CELL) {
+                bitmap[(i + 2) / 8] |= static_cast<char>(1 << ((i + 2) % 8));
+                continue;
+            }
+            UINT8 type = i < types.size() ? static_cast<UINT8>(types[i]) : 0xfd;
+            if (type == 0x08 || type == 0x05) {
+                UINT64 x;
+                if (type == 0x05) {
+                    double d = std::stod(row[i]);
+                    std::memcpy(&x, &d, sizeof(x));
+                } else {
+                    x = row[i][0] == '-' ? static_cast<UINT64>(std::stoll(row[i])) : std::stoull(row[i]);
+                }
+                for (int b = 0; b < 8; ++b) values.push_back(static_cast<char>(x >> (8 * b)));
+            } else if (type == 0x0c) {
+                unsigned y, mo, d, h, mi, sec;
+                std::sscanf(row[i].c_str(), "%u-%u-%u %u:%u:%u", &y, &mo, &d, &h, &mi, &sec);
+                const char dt[] = {7, static_cast<char>(y & 0xFF), static_cast<char>(y >> 8), static_cast<char>(mo),
+                                   static_cast<char>(d), static_cast<char>(h), static_cast<char>(mi), static_cast<char>(sec)};
+                values.append(dt, sizeof(dt));
+            } else {
+                values += lenStr(row[i]);
+            }
+        }
+        return std::string(1, '\0') + bitmap + values;
+    }
+    void writeReply(int fd, const Reply& r, UINT8& seq, bool binary) {
+        if (r.kind == Reply::OK) {
+            writePacket(fd, ok(r.affected, r.insertId), seq);
+        } else if (r.kind == Reply::ERR) {
+            writePacket(fd, err(r.errCode, r.errMsg), seq);
+        } else {
+            writePacket(fd, lenenc(r.columns.size()), seq);
+            for (size_t i = 0; i < r.columns.size(); ++i) {
+                writePacket(fd, columnDef(r.columns[i], binary && i < r.types.size() ? r.types[i] : 0xfd), seq);
+            }
+            writePacket(fd, eof(), seq);
+            for (const auto& row : r.rows) {
+                std::string body;
+                if (binary) {
+                    body = binaryRow(row, r.types);
+                } else {
+                    for (const std::string& cell : row) body += cell == NULL_CELL ? cell : lenStr(cell);
+                }
+                writePacket(fd, body, seq);
+            }
+            writePacket(fd, eof(), seq);
+        }
+    }
+
+    void serve(int fd) {
+        const std::string scramble = "abcdefghij0123456789";
+        UINT8 seq = 0;
+        std::string hs;
+        hs.push_back(10);
+        hs += std::string("5.7.99-fake") + '\0';
+        hs += std::string("\x01\x00\x00\x00", 4);
+        hs += scramble.substr(0, 8) + '\0';
+        UINT32 caps = 0x00000001 | 0x00000008 | 0x00000200 | 0x00002000 | 0x00008000 | 0x00020000 | 0x00080000;
+        hs.push_back(static_cast<char>(caps & 0xFF));
+        hs.push_back(static_cast<char>((caps >> 8) & 0xFF));
+        hs.push_back(33);
+        hs += std::string("\x02\x00", 2);
+        hs.push_back(static_cast<char>((caps >> 16) & 0xFF));
+        hs.push_back(static_cast<char>((caps >> 24) & 0xFF));
+        hs.push_back(21);
+        hs += std::string(10, '\0');
+        hs += scramble.substr(8) + '\0';
+        hs += std::string("mysql_native_password") + '\0';
+        writePacket(fd, hs, seq);
+
+        std::string rsp;
+        if (!readPacket(fd, rsp, seq) || rsp.size() < 33) return;
+        size_t pos = 32;
+        std::string name(rsp.c_str() + pos);
+        pos += name.size() + 1;
+        size_t authLen = static_cast<unsigned char>(rsp[pos++]);
+        std::string auth = rsp.substr(pos, authLen);
+        std::string stage1 = sha1(password);
+        std::string mix = sha1(scramble + sha1(stage1));
+        std::string expect(20, '\0');
+        for (int i = 0; i < 20; ++i) expect[i] = static_cast<char>(stage1[i] ^ mix[i]);
+        if (name != user || auth != expect) {
+            writePacket(fd, err(1045, "Access denied"), seq);
+            return;
+        }
+        ++m_logins;
+        writePacket(fd, ok(0, 0), seq);
+
+        bool multi = false;
+        std::map<UINT32, std::string> stmts;
+        UINT32 nextStmt = 1;
+        std::string cmd;
+        while (readPacket(fd, cmd, seq) && !cmd.empty()) {
+            std::string arg = cmd.substr(1);
+            switch (cmd[0]) {
+            case 0x01:
+                return;
+            case 0x02:
+                record("USE " + arg);
+                writePacket(fd, ok(0, 0), seq);
+                break;
+            case 0x0e:
+                writePacket(fd, ok(0, 0), seq);
+                break;
+            case 0x1b:
+                multi = arg.size() >= 2 && arg[0] == 0;
+                writePacket(fd, eof(), seq);
+                break;
+            case 0x03: {
+                ++m_roundTrips;
+                int busy = ++m_busy;
+                for (int prev = m_maxBusy; busy > prev && !m_maxBusy.compare_exchange_weak(prev, busy);) {}
+                std::vector<std::string> stmts;
+                for (size_t at = 0; multi;) {
+                    size_t semi = arg.find(';', at);
+                    stmts.push_back(arg.substr(at, semi == std::string::npos ? std::string::npos : semi - at));
+                    if (semi == std::string::npos) break;
+                    at = semi + 1;
+                }
+                if (stmts.empty()) stmts.push_back(arg);
+                Reply r;
+                for (size_t i = 0; i < stmts.size(); ++i) {
+                    record(stmts[i]);
+                    r = handler(stmts[i]);
+                    if (r.kind != Reply::OK || i + 1 == stmts.size()) break;
+                    writePacket(fd, ok(r.affected, r.insertId, true), seq);
+                }
+                --m_busy;
+                writeReply(fd, r, seq, false);
+                break;
+            }
+            case 0x16: {
+                ++m_prepares;
+                UINT32 id = nextStmt++;
+                stmts[id] = arg;
+                UINT16 params = static_cast<UINT16>(std::count(arg.begin(), arg.end(), '?'));
+                std::string rsp(1, '\0');
+                for (int i = 0; i < 4; ++i) rsp.push_back(static_cast<char>(id >> (8 * i)));
+                rsp += std::string("\x00\x00", 2);
+                rsp.push_back(static_cast<char>(params & 0xFF));
+                rsp.push_back(static_cast<char>(params >> 8));
+                rsp += std::string(3, '\0');
+                writePacket(fd, rsp, seq);
+                for (UINT16 i = 0; i < params; ++i) writePacket(fd, columnDef("?", 0xfd), seq);
+                if (params) writePacket(fd, eof(), seq);
+                break;
+            }
+            case 0x17: {
+                size_t pos = 0;
+                auto it = stmts.find(static_cast<UINT32>(getInt(arg, pos, 4)));
+                if (it == stmts.end()) {
+                    writePacket(fd, err(1243, "Unknown prepared statement handler"), seq);
+                    break;
+                }
+                std::string sql = bindParams(it->second, arg);
+                record(sql);
+                writeReply(fd, handler(sql), seq, true);
+                break;
+            }
+            case 0x19: {
+                size_t pos = 0;
+                stmts.erase(static_cast<UINT32>(getInt(arg, pos, 4)));
+                ++m_closes;
+                break;
+            }
+            default:
+                writePacket(fd, err(1047, "Unknown command"), seq);
+                break;
+            }
+        }
+    }
+
+    void record(const std::string& q) {
+        std::lock_guard<std::mutex> lk(m_mutex);
+        m_queries.push_back(q);
+    }
+
+    int m_listen = -1;
+    std::atomic<bool> m_stop{false};
+    std::thread m_acceptor;
+    std::mutex m_mutex;
+    std::vector<int> m_fds;
+    std::vector<std::thread> m_threads;
+    std::vector<std::string> m_queries;
+    std::atomic<int> m_logins{0};
+    std::atomic<int> m_busy{0};
+    std::atomic<int> m_maxBusy{0};
+    std::atomic<int> m_roundTrips{0};
+    std::atomic<int> m_prepares{0};
+    std::atomic<int> m_closes{0};
+};
+
+SDDBAccount account(int port, const char* pwd = "secret") {
+    SDDBAccount a;
+    std::memset(&a, 0, sizeof(a));
+    std::strcpy(a.m_szHostName, "127.0.0.1");
+    std::strcpy(a.m_szDBName, "world");
+    std::strcpy(a.m_szLoginName, "game");
+    std::strcpy(a.m_szLoginPwd, pwd);
+    std::strcpy(a.m_szCharactSet, "utf8");
+    a.m_wConnPort = static_cast<UINT16>(port);
+    a.m_wDBType = SDDB_DBTYPE_MYSQL;
+    return a;
+}
+
+struct Cmd : public ISSDBCommand {
+    std::string sql;
+    const char* name = nullptr;
+    INT32 group = -1;
+    INT32 result = 0;
+    std::thread::id execThread;
+    std::thread::id doneThread;
+    std::vector<Cmd*>* done = nullptr;
+
+    int SSAPI GetGroupId() override { return group; }
+    const CHAR* SSAPI GetCommandName() override { return name; }
+    void SSAPI OnExecuteSql(ISSDBConnection* poConn) override {
+        execThread = std::this_thread::get_id();
+        result = poConn->ExecuteSql(sql.c_str());
+    }
+    void SSAPI OnExecuted(void) override {
+        doneThread = std::this_thread::get_id();
+        done->push_back(this);
+    }
+    void SSAPI Release(void) override {}
+};
+
+bool runUntil(ISSDBSession* s, const std::vector<Cmd*>& done, size_t n) {
+    auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(5);
+    while (done.size() < n && std::chrono::steady_clock::now() < deadline) {
+        s->Run();
+        std::this_thread::sleep_for(std::chrono::milliseconds(2));
+    }
+    return done.size() == n;
+}
+
+} // namespace
+
+TEST(SDDBMySQLTest, SyncQueriesAndRecordSet) {
+    ASSERT_EQ(sha1("abc"), std::string("\xa9\x99\x3e\x36\x47\x06\x81\x6a\xba\x3e\x25\x71\x78\x50\xc2\x6c\x9c\xd0\xd8\x9d", 20));
+    FakeMySQL server;
+    server.handler = [](const std::string& sql) {
+        Reply r;
+        if (sql.rfind("INSERT", 0) == 0) {
+            r.affected = 3;
+            r.insertId = 42;
+        } else if (sql.rfind("SELECT", 0) == 0) {
+            r.kind = Reply::ROWS;
+            r.columns = {"id", "name"};
+            r.rows = {{"1", "alice"}, {"2", NULL_CELL}};
+        } else if (sql == "BROKEN") {
+            r.kind = Reply::ERR;
+            r.errCode = 1064;
+            r.errMsg = "syntax";
+        }
+        return r;
+    };
+    ASSERT_TRUE(server.start(45720));
+
+    ISSDBModule* module = SSDBGetModule(&SDDB_VERSION);
+    SDDBAccount acc = account(45720);
+    ISSDBSession* session = module->GetDBSession(&acc);
+    ASSERT_NE(session, nullptr);
+
+    UINT64 insertId = 0;
+    EXPECT_EQ(session->ExecuteSql("INSERT INTO t VALUES (1)", &insertId), 3);
+    EXPECT_EQ(insertId, 42u);
+    EXPECT_EQ(session->ExecuteSql("BROKEN"), SDDB_ERR_UNKNOWN);
+
+    ISSDBRecordSet* rs = nullptr;
+    ASSERT_EQ(session->ExecuteSqlRs("SELECT id, name FROM t", &rs), SDDB_HAS_RECORDSET);
+    ASSERT_NE(rs, nullptr);
+    EXPECT_EQ(rs->GetRecordCount(), 2u);
+    EXPECT_EQ(rs->GetFieldCount(), 2u);
+    ASSERT_TRUE(rs->GetRecord());
+    EXPECT_STREQ(rs->GetFieldValue(0), "1");
+    EXPECT_STREQ(rs->GetFieldValueByName("name"), "alice");
+    EXPECT_EQ(rs->GetFieldLengthByName("name"), 5);
+    ASSERT_TRUE(rs->GetRecord());
+    EXPECT_STREQ(rs->GetFieldValue(0), "2");
+    EXPECT_EQ(rs->GetFieldValue(1), nullptr);
+    EXPECT_EQ(rs->GetFieldValueByName("missing"), nullptr);
+    EXPECT_FALSE(rs->GetRecord());
+    rs->Release();
+    EXPECT_EQ(session->ExecuteSqlRs("INSERT INTO t VALUES (2)", &rs), SDDB_NO_RECORDSET);
+    EXPECT_TRUE(session->SelectDB("other"));
+
+    const char raw[] = {'a', '\'', '\0', 'b'};
+    char escaped[16];
+    EXPECT_EQ(session->EscapeString(raw, 4, escaped, sizeof(escaped)), 6u);
+    EXPECT_STREQ(escaped, "a\\'\\0b");
+    EXPECT_EQ(session->EscapeString(raw, 4, escaped, 4), 0u);
+
+    module->Close(session);
+    module->Release();
+    std::vector<std::string> q = server.queries();
+    EXPECT_NE(std::find(q.begin(), q.end(), "USE other"), q.end());
+}
+
+TEST(SDDBMySQLTest, BadPasswordAndConfigString) {
+    FakeMySQL server;
+    ASSERT_TRUE(server.start(45721));
+    ISSDBModule* module = SSDBGetModule(&SDDB_VERSION);
+
+    SDDBAccount bad = account(45721, "wrong");
+    EXPECT_EQ(module->GetDBSession(&bad, 2, 2), nullptr);
+    EXPECT_EQ(server.logins(), 0);
+
+    ISSDBSession* session = module->GetDBSession(
+        "HostName=127.0.0.1;LoginName=game;LoginPwd=secret;DBName=world;CharacterSet=utf8;CoreSize=2;MaxSize=3;DBType=0;Port=45721;");
+    ASSERT_NE(session, nullptr);
+    EXPECT_EQ(server.logins(), 2);
+    module->Close(session);
+
+    SDDBAccount mock = account(45721);
+    mock.m_wDBType = SDDB_DBTYPE_MOCK;
+    session = module->GetDBSession(&mock);
+    ASSERT_NE(session, nullptr);
+    module->Close(session);
+    module->Release();
+}
+
+TEST(SDDBMySQLTest, CommandsRunOnWorkersAndCompleteOnRun) {
+    FakeMySQL server;
+    server.handler = [](const std::string&) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(30));
+        Reply r;
+        r.affected = 1;
+        return r;
+    };
+    ASSERT_TRUE(server.start(45722));
+    ISSDBModule* module = SSDBGetModule(&SDDB_VERSION);
+    SDDBAccount acc = account(45722);
+    ISSDBSession* session = module->GetDBSession(&acc, 2, 4);
+    ASSERT_NE(session, nullptr);
+
+    const int N = 12;
+    std::vector<Cmd> cmds(N);
+    std::vector<Cmd*> done;
+    auto begin = std::chrono::steady_clock::now();
+    for (int i = 0; i < N; ++i) {
+        cmds[i].sql = "UPDATE t SET v=" + std::to_string(i);
+        cmds[i].done = &done;
+        ASSERT_TRUE(session->AddDBCommand(&cmds[i]));
+    }
+    // Queuing does not wait for the server.
+    EXPECT_LT(std::chrono::steady_clock::now() - begin, std::chrono::milliseconds(30));
+    EXPECT_TRUE(done.empty());
+
+    ASSERT_TRUE(runUntil(session, done, N));
+    std::set<std::thread::id> workers;
+    for (const Cmd& c : cmds) {
+        EXPECT_EQ(c.result, 1);
+        EXPECT_EQ(c.doneThread, std::this_thread::get_id());
+        EXPECT_NE(c.execThread, std::this_thread::get_id());
+        workers.insert(c.execThread);
+    }
+    EXPECT_GT(workers.size(), 2u);
+    EXPECT_LE(workers.size(), 4u);
+    EXPECT_GT(server.maxBusy(), 1);
+    EXPECT_LE(server.logins(), 4);
+
+    // Run(n) reports whether n completions were handled.
+    EXPECT_FALSE(session->Run(1));
+    module->Close(session);
+    module->Release();
+}
+
+TEST(SDDBMySQLTest, GroupedCommandsKeepOrder) {
+    FakeMySQL server;
+    std::atomic<int> tick{0};
+    server.handler = [&tick](const std::string&) {
+        std::this_thread::sleep_for(std::chrono::milliseconds((tick++ * 7) % 5));
+        return Reply();
+    };
+    ASSERT_TRUE(server.start(45723));
+    ISSDBModule* module = SSDBGetModule(&SDDB_VERSION);
+    SDDBAccount acc = account(45723);
+    ISSDBSession* session = module->GetDBSession(&acc, 4, 4);
+    ASSERT_NE(session, nullptr);
+
+    const int N = 40;
+    std::vector<Cmd> cmds(N);
+    std::vector<Cmd*> done;
+    for (int i = 0; i < N; ++i) {
+        cmds[i].group = i % 2;
+        cmds[i].sql = "G" + std::to_string(i % 2) + " " + std::to_string(i);
+        cmds[i].done = &done;
+        ASSERT_TRUE(session->AddDBCommand(&cmds[i]));
+    }
+    ASSERT_TRUE(runUntil(session, done, N));
+
+    int last[2] = {-1, -1};
+    for (const std::string& q : server.queries()) {
+        int g = q[1] - '0';
+        int n = std::stoi(q.substr(3));
+        EXPECT_GT(n, last[g]) << q;
+        last[g] = n;
+    }
+    EXPECT_EQ(last[0], N - 2);
+    EXPECT_EQ(last[1], N - 1);
+    module->Close(session);
+    module->Release();
+}
+
+TEST(SDDBMySQLTest, GroupsStayOnOneWorkerAndRunInParallel) {
+    FakeMySQL server;
+    server.handler = [](const std::string&) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(3));
+        return Reply();
+    };
+    ASSERT_TRUE(server.start(45724));
+    ISSDBModule* module = SSDBGetModule(&SDDB_VERSION);
+    SDDBAccount acc = account(45724);
+    ISSDBSession* session = module->GetDBSession(&acc, 3, 3);
+    ASSERT_NE(session, nullptr);
+
+    const int GROUPS = 24, PER_GROUP = 4;
+    std::vector<Cmd> cmds(GROUPS * PER_GROUP);
+    std::vector<Cmd*> done;
+    for (size_t i = 0; i < cmds.size(); ++i) {
+        cmds[i].group = 1000 + static_cast<INT32>(i % GROUPS);
+        cmds[i].sql = "UPDATE player SET v=1 WHERE id=" + std::to_string(cmds[i].group);
+        cmds[i].done = &done;
+        ASSERT_TRUE(session->AddDBCommand(&cmds[i]));
+    }
+    ASSERT_TRUE(runUntil(session, done, cmds.size()));
+
+    std::set<std::thread::id> workers;
+    for (size_t i = 0; i < cmds.size(); ++i) {
+        EXPECT_EQ(cmds[i].execThread, cmds[i % GROUPS].execThread) << "group " << cmds[i].group;
+        workers.insert(cmds[i].execThread);
+    }
+    EXPECT_GT(workers.size(), 1u);
+    EXPECT_GT(server.maxBusy(), 1);
+    module->Close(session);
+    module->Release();
+}
+
+namespace {
+
+struct BatchCmd : public ISSDBBatchCommand {
+    std::string head;
+    std::string row;
+    std::string tail;
+    INT32 result = 999;
+    std::vector<BatchCmd*>* done = nullptr;
+
+    const CHAR* SSAPI GetBatchHead() override { return head.c_str(); }
+    const CHAR* SSAPI GetBatchRow() override { return row.c_str(); }
+    const CHAR* SSAPI GetBatchTail() override { return tail.c_str(); }
+    void SSAPI OnBatchResult(INT32 nResult) override { result = nResult; }
+    void SSAPI OnExecuted(void) override { done->push_back(this); }
+    void SSAPI Release(void) override {}
+};
+
+ISSDBSession* batchSession(ISSDBModule* module, int port, const char* extra) {
+    std::string config = "HostName=127.0.0.1;LoginName=game;LoginPwd=secret;DBName=world;CoreSize=1;MaxSize=1;Port=" +
+                         std::to_string(port) + ";" + extra;
+    return module->GetDBSession(config.c_str());
+}
+
+bool runBatchesUntil(ISSDBSession* s, const std::vector<BatchCmd*>& done, size_t n) {
+    auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(5);
+    while (done.size() < n && std::chrono::steady_clock::now() < deadline) {
+        s->Run();
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    return done.size() == n;
+}
+
+} // namespace
+
+TEST(SDDBMySQLTest, BatchCommandsCombineIntoMultiRowStatements) {
+    FakeMySQL server;
+    server.handler = [](const std::string& sql) {
+        Reply r;
+        if (sql.find("(13,") != std::string::npos) {
+            r.kind = Reply::ERR;
+            r.errCode = 1062;
+            r.errMsg = "Duplicate entry";
+        } else {
+            // One affected row per "(id,1)" row.
+            for (size_t at = sql.find(",1)"); at != std::string::npos; at = sql.find(",1)", at + 1)) ++r.affected;
+        }
+        return r;
+    };
+    ASSERT_TRUE(server.start(45725));
+    ISSDBModule* module = SSDBGetModule(&SDDB_VERSION);
+    ISSDBSession* session = batchSession(module, 45725, "BatchInterval=5;BatchMaxRows=20;");
+    ASSERT_NE(session, nullptr);
+
+    const size_t N = 50;
+    std::vector<BatchCmd> cmds(N);
+    std::vector<BatchCmd*> done;
+    for (size_t i = 0; i < N; ++i) {
+        cmds[i].head = "INSERT INTO item(id,cnt) VALUES ";
+        cmds[i].row = "(" + std::to_string(i) + ",1)";
+        cmds[i].tail = " ON DUPLICATE KEY UPDATE cnt=VALUES(cnt)";
+        cmds[i].done = &done;
+        ASSERT_TRUE(session->AddDBCommand(&cmds[i]));
+    }
+    ASSERT_TRUE(runBatchesUntil(session, done, N));
+
+    // Rows 0-19 failed together and were retried alone; 20-39 and 40-49
+    // went out as one statement each.
+    EXPECT_EQ(server.roundTrips(), 1 + 20 + 1 + 1);
+    for (size_t i = 0; i < N; ++i) {
+        if (i == 13) EXPECT_EQ(cmds[i].result, SDDB_ERR_UNKNOWN);
+        else if (i < 20) EXPECT_EQ(cmds[i].result, 1) << i;
+        else if (i < 40) EXPECT_EQ(cmds[i].result, 20) << i;
+        else EXPECT_EQ(cmds[i].result, 10) << i;
+    }
+    std::vector<std::string> q = server.queries();
+    std::string expect = "INSERT INTO item(id,cnt) VALUES (20,1)";
+    for (int i = 21; i < 40; ++i) expect += ",(" + std::to_string(i) + ",1)";
+    expect += " ON DUPLICATE KEY UPDATE cnt=VALUES(cnt)";
+    EXPECT_NE(std::find(q.begin(), q.end(), expect), q.end());
+    module->Close(session);
+    module->Release();
+}
+
+TEST(SDDBMySQLTest, BatchCommandsWithoutHeadShareOneTransaction) {
+    FakeMySQL server;
+    std::atomic<bool> reject{false};
+    server.handler = [&reject](const std::string& sql) {
+        Reply r;
+        if (reject && sql.find("id=7") != std::string::npos) {
+            r.kind = Reply::ERR;
+            r.errCode = 1213;
+            r.errMsg = "Deadlock";
+        } else if (sql.rfind("UPDATE", 0) == 0) {
+            r.affected = 1;
+        }
+        return r;
+    };
+    ASSERT_TRUE(server.start(45726));
+    ISSDBModule* module = SSDBGetModule(&SDDB_VERSION);
+    ISSDBSession* session = batchSession(module, 45726, "BatchInterval=5;");
+    ASSERT_NE(session, nullptr);
+
+    const size_t N = 30;
+    std::vector<BatchCmd> cmds(N);
+    std::vector<BatchCmd*> done;
+    for (size_t i = 0; i < N; ++i) {
+        cmds[i].row = "UPDATE player SET gold=" + std::to_string(i) + " WHERE id=" + std::to_string(i);
+        cmds[i].done = &done;
+        ASSERT_TRUE(session->AddDBCommand(&cmds[i]));
+    }
+    ASSERT_TRUE(runBatchesUntil(session, done, N));
+    EXPECT_EQ(server.roundTrips(), 1);
+    for (const BatchCmd& c : cmds) EXPECT_EQ(c.result, 1);
+    std::vector<std::string> q = server.queries();
+    ASSERT_EQ(q.size(), N + 2);
+    EXPECT_EQ(q.front(), "START TRANSACTION");
+    EXPECT_EQ(q.back(), "COMMIT");
+
+    // A failing statement rolls the transaction back; every command is then
+    // run on its own and gets its own result.
+    reject = true;
+    done.clear();
+    for (size_t i = 0; i < 10; ++i) ASSERT_TRUE(session->AddDBCommand(&cmds[i]));
+    ASSERT_TRUE(runBatchesUntil(session, done, 10));
+    EXPECT_EQ(server.roundTrips(), 1 + 1 + 1 + 10);
+    for (size_t i = 0; i < 10; ++i) EXPECT_EQ(cmds[i].result, i == 7 ? SDDB_ERR_UNKNOWN : 1) << i;
+    q = server.queries();
+    EXPECT_NE(std::find(q.begin(), q.end(), "ROLLBACK"), q.end());
+    module->Close(session);
+    module->Release();
+}
+
+TEST(SDDBMySQLTest, RecordSetTypedAccessors) {
+    const std::string blob("a\0b\xFB\xFF", 5);
+    const std::string wide(300, 'w');
+    FakeMySQL server;
+    server.handler = [&](const std::string&) {
+        Reply r;
+        r.kind = Reply::ROWS;
+        r.columns = {"id", "gold", "rate", "data", "note"};
+        r.rows = {{"18446744073709551615", "-42", "2.5", blob, wide},
+                  {"7", NULL_CELL, "abc", "", NULL_CELL}};
+        for (int i = 0; i < 1000; ++i) r.rows.push_back({std::to_string(i), std::to_string(-i), "0.5", "x", "y"});
+        return r;
+    };
+    ASSERT_TRUE(server.start(45727));
+    ISSDBModule* module = SSDBGetModule(&SDDB_VERSION);
+    SDDBAccount acc = account(45727);
+    ISSDBSession* session = module->GetDBSession(&acc);
+    ASSERT_NE(session, nullptr);
+
+    ISSDBRecordSet* rs = nullptr;
+    ASSERT_EQ(session->ExecuteSqlRs("SELECT * FROM item", &rs), SDDB_HAS_RECORDSET);
+    ASSERT_EQ(rs->GetRecordCount(), 1002u);
+    INT32 id = rs->GetFieldIndex("id");
+    INT32 gold = rs->GetFieldIndex("gold");
+    INT32 rate = rs->GetFieldIndex("rate");
+    INT32 data = rs->GetFieldIndex("data");
+    INT32 note = rs->GetFieldIndex("note");
+    EXPECT_EQ(rs->GetFieldIndex("missing"), -1);
+    ASSERT_EQ(id, 0);
+    ASSERT_EQ(note, 4);
+
+    ASSERT_TRUE(rs->GetRecord());
+    EXPECT_EQ(rs->GetFieldUInt64(id), 18446744073709551615ull);
+    EXPECT_EQ(rs->GetFieldInt64(gold), -42);
+    EXPECT_DOUBLE_EQ(rs->GetFieldDouble(rate), 2.5);
+    UINT32 len = 0;
+    const CHAR* p = rs->GetFieldBlob(data, &len);
+    ASSERT_NE(p, nullptr);
+    EXPECT_EQ(std::string(p, len), blob);
+    EXPECT_EQ(std::string(rs->GetFieldValue(note)), wide);
+    EXPECT_EQ(rs->GetFieldLength(note), 300);
+    EXPECT_FALSE(rs->IsFieldNull(gold));
+
+    ASSERT_TRUE(rs->GetRecord());
+    EXPECT_TRUE(rs->IsFieldNull(gold));
+    EXPECT_EQ(rs->GetFieldInt64(gold, -1), -1);
+    EXPECT_DOUBLE_EQ(rs->GetFieldDouble(rate, 9.0), 9.0);
+    EXPECT_STREQ(rs->GetFieldValue(data), "");
+    EXPECT_NE(rs->GetFieldBlob(data, &len), nullptr);
+    EXPECT_EQ(len, 0u);
+    EXPECT_EQ(rs->GetFieldBlob(note, &len), nullptr);
+
+    INT64 sum = 0;
+    UINT32 rows = 0;
+    while (rs->GetRecord()) {
+        sum += rs->GetFieldInt64(id) + rs->GetFieldInt64(gold);
+        EXPECT_STREQ(rs->GetFieldValueByName("data"), "x");
+        ++rows;
+    }
+    EXPECT_EQ(rows, 1000u);
+    EXPECT_EQ(sum, 0);
+    EXPECT_EQ(rs->GetFieldValue(id), nullptr);
+    rs->Release();
+    module->Close(session);
+    module->Release();
+}
+
+namespace {
+
+struct FnCmd : public ISSDBCommand {
+    std::function<void(ISSDBConnection*)> fn;
+    bool done = false;
+
+    void SSAPI OnExecuteSql(ISSDBConnection* poConn) override { fn(poConn); }
+    void SSAPI OnExecuted(void) override { done = true; }
+    void SSAPI Release(void) override {}
+};
+
+} // namespace
+
+TEST(SDDBMySQLTest, PreparedStatementsBindBinaryAndAreCached) {
+    FakeMySQL server;
+    server.handler = [](const std::string& sql) {
+        Reply r;
+        if (sql.rfind("INSERT", 0) == 0) {
+            r.affected = 1;
+            r.insertId = 9;
+        } else if (sql == "SELECT id, gold, rate, at, name FROM role WHERE id = 7 AND name = 'bob'") {
+            r.kind = Reply::ROWS;
+            r.columns = {"id", "gold", "rate", "at", "name"};
+            r.types = {0x8008, 0x08, 0x05, 0x0c, 0xfd};
+            r.rows = {{"18446744073709551615", "-42", "2.5", "2026-10-19 08:30:05", "bob"},
+                      {"1", NULL_CELL, "0.25", "2000-01-02 03:04:05", NULL_CELL}};
+        }
+        return r;
+    };
+    ASSERT_TRUE(server.start(45728));
+    ISSDBModule* module = SSDBGetModule(&SDDB_VERSION);
+    ISSDBSession* session = module->GetDBSession(
+        "HostName=127.0.0.1;LoginName=game;LoginPwd=secret;DBName=world;Port=45728;StmtCacheSize=2;");
+    ASSERT_NE(session, nullptr);
+
+    const char* insert = "INSERT INTO role (id, name, rate, note) VALUES (?, ?, ?, ?)";
+    const char* select = "SELECT id, gold, rate, at, name FROM role WHERE id = ? AND name = ?";
+    FnCmd cmd;
+    cmd.fn = [&](ISSDBConnection* conn) {
+        for (int i = 0; i < 10; ++i) {
+            ISSDBStatement* st = conn->Prepare(insert);
+            ASSERT_NE(st, nullptr);
+            ASSERT_EQ(st->GetParamCount(), 4u);
+            EXPECT_TRUE(st->BindInt64(0, -i));
+            EXPECT_TRUE(st->BindString(1, "o'n\0x", 5));
+            EXPECT_TRUE(st->BindDouble(2, 0.5));
+            EXPECT_FALSE(st->BindInt64(4, 1));
+            UINT64 id = 0;
+            EXPECT_EQ(st->Execute(&id), 1);
+            EXPECT_EQ(id, 9u);
+            st->Release();
+        }
+
+        ISSDBStatement* st = conn->Prepare(select);
+        ASSERT_NE(st, nullptr);
+        st->BindUInt64(0, 7);
+        st->BindString(1, "bob", 3);
+        ISSDBRecordSet* rs = nullptr;
+        ASSERT_EQ(st->ExecuteRs(&rs), SDDB_HAS_RECORDSET);
+        ASSERT_EQ(rs->GetRecordCount(), 2u);
+        ASSERT_TRUE(rs->GetRecord());
+        EXPECT_EQ(rs->GetFieldUInt64(0), 18446744073709551615ull);
+        EXPECT_STREQ(rs->GetFieldValue(0), "18446744073709551615");
+        EXPECT_EQ(rs->GetFieldInt64(1), -42);
+        EXPECT_STREQ(rs->GetFieldValue(2), "2.5");
+        EXPECT_STREQ(rs->GetFieldValueByName("at"), "2026-10-19 08:30:05");
+        EXPECT_STREQ(rs->GetFieldValue(4), "bob");
+        ASSERT_TRUE(rs->GetRecord());
+        EXPECT_TRUE(rs->IsFieldNull(1));
+        EXPECT_DOUBLE_EQ(rs->GetFieldDouble(2), 0.25);
+        EXPECT_TRUE(rs->IsFieldNull(4));
+        rs->Release();
+
+        // The cached statement is handed out, so a second one is prepared
+        // and closed on release.
+        ISSDBStatement* again = conn->Prepare(select);
+        ASSERT_NE(again, nullptr);
+        EXPECT_NE(again, st);
+        again->Release();
+        st->Release();
+        EXPECT_EQ(conn->Prepare(select), st);
+        st->Release();
+
+        // A third statement evicts the least recently used one.
+        conn->Prepare("DELETE FROM role WHERE id = ?")->Release();
+        conn->Prepare(insert)->Release();
+        EXPECT_EQ(conn->ExecuteSql("SELECT 1"), 0);
+    };
+    ASSERT_TRUE(session->AddDBCommand(&cmd));
+    auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(5);
+    while (!cmd.done && std::chrono::steady_clock::now() < deadline) {
+        session->Run();
+        std::this_thread::sleep_for(std::chrono::milliseconds(2));
+    }
+    ASSERT_TRUE(cmd.done);
+
+    // insert, select, the uncached select, delete, insert again
+    EXPECT_EQ(server.prepares(), 5);
+    // the uncached select, then insert and select evicted
+    EXPECT_EQ(server.closes(), 3);
+    std::vector<std::string> q = server.queries();
+    const char first[] = "INSERT INTO role (id, name, rate, note) VALUES (0, 'o'n\0x', 0.5, NULL)";
+    const char last[] = "INSERT INTO role (id, name, rate, note) VALUES (-9, 'o'n\0x', 0.5, NULL)";
+    EXPECT_EQ(q[0], std::string(first, sizeof(first) - 1));
+    EXPECT_EQ(q[9], std::string(last, sizeof(last) - 1));
+    module->Close(session);
+    module->Release();
+}
+
+namespace {
+
+struct CaptureLogger : public ISSLogger {
+    std::mutex mutex;
+    std::vector<std::string> lines;
+
+    bool SSAPI LogText(const char* pszLog) override {
+        std::lock_guard<std::mutex> lk(mutex);
+        lines.push_back(pszLog);
+        return true;
+    }
+    bool SSAPI LogBinary(const UINT8*, UINT32) override { return false; }
+};
+
+} // namespace
+
+TEST(SDDBMySQLTest, CommandTimingQueueDepthAndSlowQueries) {
+    FakeMySQL server;
+    std::atomic<bool> blocked{true};
+    server.handler = [&blocked](const std::string& sql) {
+        if (sql == "BLOCK") {
+            while (blocked) std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        } else if (sql.rfind("SLOW", 0) == 0) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(40));
+        }
+        return Reply();
+    };
+    ASSERT_TRUE(server.start(45729));
+    CaptureLogger logger;
+    SSDBSetLogger(&logger, LOGLV_WARN);
+    ISSDBModule* module = SSDBGetModule(&SDDB_VERSION);
+    ISSDBSession* session = module->GetDBSession(
+        "HostName=127.0.0.1;LoginName=game;LoginPwd=secret;DBName=world;Port=45729;CoreSize=2;MaxSize=2;SlowQueryTime=25;");
+    ASSERT_NE(session, nullptr);
+
+    std::vector<Cmd> cmds(10);
+    std::vector<Cmd*> done;
+    for (size_t i = 0; i < cmds.size(); ++i) {
+        cmds[i].done = &done;
+        cmds[i].name = i < 2 ? "block" : i < 8 ? "save" : "load";
+        cmds[i].sql = i < 2 ? "BLOCK" : i < 8 ? "UPDATE role SET x = 1" : "SLOW SELECT 1";
+        ASSERT_TRUE(session->AddDBCommand(&cmds[i]));
+    }
+    // Both workers are stuck on BLOCK, so the rest waits in the queue.
+    SDDBSessionStats st;
+    auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(5);
+    do {
+        ASSERT_TRUE(session->GetStats(&st));
+    } while (st.m_dwRunning < 2 && std::chrono::steady_clock::now() < deadline);
+    EXPECT_EQ(st.m_dwRunning, 2u);
+    EXPECT_EQ(st.m_dwQueued, 8u);
+    EXPECT_EQ(st.m_dwConnections, 2u);
+    EXPECT_EQ(st.m_stTotal.m_qwCommands, 0u);
+    std::this_thread::sleep_for(std::chrono::milliseconds(30));
+    blocked = false;
+    ASSERT_TRUE(runUntil(session, done, cmds.size()));
+
+    ASSERT_TRUE(session->GetStats(&st));
+    EXPECT_EQ(st.m_dwQueued + st.m_dwRunning + st.m_dwCompleted, 0u);
+    EXPECT_EQ(st.m_stTotal.m_qwCommands, 10u);
+    // The blocked commands and the slow ones.
+    EXPECT_EQ(st.m_stTotal.m_qwSlow, 4u);
+    EXPECT_EQ(st.m_qwSlowQueries, 4u);
+    UINT64 bucketed = 0;
+    for (UINT64 n : st.m_stTotal.m_stExecute.m_aqwBuckets) bucketed += n;
+    EXPECT_EQ(bucketed, 10u);
+    EXPECT_EQ(st.m_stTotal.m_stQueue.m_qwCount, 10u);
+    EXPECT_GE(st.m_stTotal.m_stExecute.m_qwMaxUs, 30000u);
+    EXPECT_GE(st.m_stTotal.m_stQueue.m_qwMaxUs, 30000u);
+    EXPECT_GE(st.m_stTotal.m_stTotal.m_qwMaxUs, st.m_stTotal.m_stExecute.m_qwMaxUs);
+
+    EXPECT_EQ(session->GetCommandStats(nullptr, 0), 3u);
+    SDDBCommandStats types[4];
+    ASSERT_EQ(session->GetCommandStats(types, 4), 3u);
+    for (const SDDBCommandStats& t : types) {
+        if (std::string(t.m_szName) == "save") {
+            EXPECT_EQ(t.m_qwCommands, 6u);
+            EXPECT_EQ(t.m_qwSlow, 0u);
+        } else if (std::string(t.m_szName) == "load") {
+            EXPECT_EQ(t.m_qwCommands, 2u);
+            EXPECT_EQ(t.m_qwSlow, 2u);
+            EXPECT_GE(t.m_stExecute.m_qwTotalUs, 80000u);
+        }
+    }
+
+    module->Close(session);
+    module->Release();
+    SSDBSetLogger(nullptr, 0);
+    int slowLines = 0;
+    for (const std::string& line : logger.lines) {
+        if (line.find("SSDB slow query") == std::string::npos) continue;
+        ++slowLines;
+        EXPECT_TRUE(line.find("load): SLOW SELECT 1") != std::string::npos ||
+                    line.find("block): BLOCK") != std::string::npos) << line;
+    }
+    EXPECT_EQ(slowLines, 4);
+}
@@ -0,0 +1,494 @@
+#include <gtest/gtest.h>
+#include "ssengine/sdgate.h"
+#include "ssengine/sdnet_ver.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <functional>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+using namespace SSCP;
+
+namespace {
+
+// Client packets: [UINT16 total length, network order][payload].
+struct LenParser : public ISSPacketParser {
+    INT32 SSAPI ParsePacket(const char* pBuf, UINT32 dwLen) override {
+        if (dwLen < 2) return 0;
+        UINT16 len = static_cast<UINT16>((static_cast<unsigned char>(pBuf[0]) << 8) | static_cast<unsigned char>(pBuf[1]));
+        if (len < 2) return -1;
+        return len <= dwLen ? len : 0;
+    }
+};
+
+std::string clientPacket(const std::string& body) {
+    std::string p(2, '\0');
+    p[0] = static_cast<char>(((body.size() + 2) >> 8) & 0xFF);
+    p[1] = static_cast<char>((body.size() + 2) & 0xFF);
+    return p + body;
+}
+
+struct ServerSession : public ISSServerSession {
+    ISSServerConnection* conn = nullptr;
+    int connects = 0;
+    int closes = 0;
+    std::vector<std::string> serverData;
+    std::vector<std::pair<ISSClientConnection*, std::string>> clientData;
+    std::vector<std::pair<INT32, UINT64>> enters;
+    std::vector<std::pair<INT32, UINT64>> leaves;
+    bool forwardToClient = true;
+
+    void SSAPI SetConnection(ISSServerConnection* c) override { conn = c; }
+    bool SSAPI OnError(INT32, INT32) override { return true; }
+    void SSAPI OnConnect(bool bSuccess) override { if (bSuccess) ++connects; }
+    void SSAPI OnClose(void) override { ++closes; }
+    void SSAPI OnRecvServerData(const char* pData, UINT32 nLen) override { serverData.emplace_back(pData, nLen); }
+    void SSAPI OnRecvClientData(ISSClientConnection* poClient, const char* pData, UINT32 nLen) override {
+        clientData.emplace_back(poClient, std::string(pData, nLen));
+        if (forwardToClient) poClient->Send(pData, nLen);
+    }
+    void SSAPI OnEnter(ISSClientConnection*, INT32 nSDError, UINT64 dwTransID) override { enters.emplace_back(nSDError, dwTransID); }
+    void SSAPI OnLeave(ISSClientConnection*, INT32 nSDError, UINT64 dwTransID) override { leaves.emplace_back(nSDError, dwTransID); }
+};
+
+// Forwards every client packet to the server link it is bound to.
+struct ClientSession : public ISSClientSession {
+    ISSClientConnection* conn = nullptr;
+    ISSServerConnection* link = nullptr;
+    std::vector<std::string>* log = nullptr;
+    int* errors = nullptr;
+    int* closes = nullptr;
+    void SSAPI SetConnection(ISSClientConnection* c) override { conn = c; }
+    bool SSAPI OnError(INT32 nSDError, INT32) override { if (errors) *errors = nSDError; return true; }
+    void SSAPI OnConnect(void) override {}
+    void SSAPI OnClose(void) override { if (closes) ++*closes; }
+    void SSAPI OnRecv(const char* pData, UINT32 nLen) override {
+        if (log) log->emplace_back(pData, nLen);
+        if (link) link->SendClientData(conn, pData, nLen);
+    }
+    void SSAPI Release(void) override { delete this; }
+};
+
+struct Factory : public ISSClientSessionFactory {
+    std::vector<ClientSession*> sessions;
+    std::vector<std::string> log;
+    int lastError = 0;
+    int closes = 0;
+    ISSClientSession* SSAPI CreateSession(void) override {
+        auto* s = new ClientSession;
+        s->log = &log;
+        s->errors = &lastError;
+        s->closes = &closes;
+        sessions.push_back(s);
+        return s;
+    }
+};
+
+struct Frame {
+    UINT16 cmd = 0;
+    UINT16 err = 0;
+    UINT32 clientID = 0;
+    std::string body;
+};
+
+class SDGateTest : public ::testing::Test {
+protected:
+    void SetUp() override {
+        gate = SSCreateGate(&SDGATE_VERSION, nullptr);
+        ASSERT_NE(gate, nullptr);
+        gate->SetClientPacketParser(&parser);
+        gate->SetClientSessionFactory(&factory);
+    }
+    void TearDown() override {
+        for (int fd : fds) ::close(fd);
+        if (link) link->Release();
+        if (gate) gate->Release();
+    }
+
+    bool pump(const std::function<bool()>& done, int ms = 2000) {
+        auto until = std::chrono::steady_clock::now() + std::chrono::milliseconds(ms);
+        while (std::chrono::steady_clock::now() < until) {
+            gate->Run(-1);
+            if (done()) return true;
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        }
+        return done();
+    }
+
+    int listenOn(UINT16 port) {
+        int fd = ::socket(AF_INET, SOCK_STREAM, 0);
+        int on = 1;
+        ::setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &on, sizeof(on));
+        sockaddr_in a{};
+        a.sin_family = AF_INET;
+        a.sin_port = htons(port);
+        a.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+        EXPECT_EQ(::bind(fd, reinterpret_cast<sockaddr*>(&a), sizeof(a)), 0);
+        EXPECT_EQ(::listen(fd, 16), 0);
+        fds.push_back(fd);
+        return fd;
+    }
+
+    int connectTo(UINT16 port) {
+        int fd = ::socket(AF_INET, SOCK_STREAM, 0);
+        sockaddr_in a{};
+        a.sin_family = AF_INET;
+        a.sin_port = htons(port);
+        a.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+        EXPECT_EQ(::connect(fd, reinterpret_cast<sockaddr*>(&a), sizeof(a)), 0);
+        fds.push_back(fd);
+        return fd;
+    }
+
+    // Gate listens on gatePort and links to a raw backend on serverPort.
+    void Start(UINT16 gatePort, UINT16 serverPort) {
+        port = gatePort;
+        ASSERT_GT(gate->AddListen("127.0.0.1", gatePort), 0);
+        int lfd = listenOn(serverPort);
+        link = gate->CreateServerConnection(&server);
+        ASSERT_EQ(link->Connect("127.0.0.1", serverPort, false), NET_SUCCESS);
+        ASSERT_TRUE(pump([&] { return server.connects == 1; }));
+        backend = ::accept(lfd, nullptr, nullptr);
+        ASSERT_GE(backend, 0);
+        fds.push_back(backend);
+    }
+
+    ISSClientConnection* AddClient(int& fd) {
+        size_t before = factory.sessions.size();
+        fd = connectTo(port);
+        EXPECT_TRUE(pump([&] { return factory.sessions.size() == before + 1; }));
+        if (factory.sessions.size() != before + 1) return nullptr;
+        factory.sessions.back()->link = link;
+        return factory.sessions.back()->conn;
+    }
+
+    void sendFrame(UINT16 cmd, UINT16 err, UINT32 clientID, const std::string& body) {
+        SGateLinkHead h;
+        h.dwLen = htonl(static_cast<UINT32>(GATE_LINK_HEAD_LEN + body.size()));
+        h.wCmd = htons(cmd);
+        h.wErr = htons(err);
+        h.dwClientID = htonl(clientID);
+        std::string f(reinterpret_cast<const char*>(&h), GATE_LINK_HEAD_LEN);
+        f += body;
+        ASSERT_EQ(::send(backend, f.data(), f.size(), 0), static_cast<ssize_t>(f.size()));
+    }
+
+    bool readFrame(Frame& out) {
+        bool ok = pump([&] {
+            char tmp[4096];
+            ssize_t n = ::recv(backend, tmp, sizeof(tmp), MSG_DONTWAIT);
+            if (n > 0) backendBuf.append(tmp, static_cast<size_t>(n));
+            if (backendBuf.size() < GATE_LINK_HEAD_LEN) return false;
+            SGateLinkHead h;
+            std::memcpy(&h, backendBuf.data(), sizeof(h));
+            return backendBuf.size() >= ntohl(h.dwLen);
+        });
+        if (!ok) return false;
+        SGateLinkHead h;
+        std::memcpy(&h, backendBuf.data(), sizeof(h));
+        UINT32 len = ntohl(h.dwLen);
+        out.cmd = ntohs(h.wCmd);
+        out.err = ntohs(h.wErr);
+        out.clientID = ntohl(h.dwClientID);
+        out.body = backendBuf.substr(GATE_LINK_HEAD_LEN, len - GATE_LINK_HEAD_LEN);
+        backendBuf.erase(0, len);
+        return true;
+    }
+
+    // Reads until want bytes arrived or the gate closed the socket.
+    std::string readClient(int fd, size_t want) {
+        std::string got;
+        pump([&] {
+            char tmp[256];
+            ssize_t n = ::recv(fd, tmp, sizeof(tmp), MSG_DONTWAIT);
+            if (n > 0) got.append(tmp, static_cast<size_t>(n));
+            return n == 0 || got.size() >= want;
+        });
+        return got;
+    }
+
+    // Enters the client into the link and acknowledges it as the backend.
+    UINT32 EnterAndAck(ISSClientConnection* client, UINT64 transID) {
+        Frame f;
+        EXPECT_TRUE(link->Enter(client, transID));
+        EXPECT_TRUE(readFrame(f));
+        EXPECT_EQ(f.cmd, GATE_LINK_ENTER);
+        sendFrame(GATE_LINK_ENTER, SDGATEERR_SUCCESS, f.clientID, trans(transID));
+        return f.clientID;
+    }
+
+    static std::string be32(UINT32 v) {
+        v = htonl(v);
+        return std::string(reinterpret_cast<const char*>(&v), 4);
+    }
+
+    static std::string pending(int fd) {
+        char tmp[256];
+        ssize_t n = ::recv(fd, tmp, sizeof(tmp), MSG_DONTWAIT);
+        return n > 0 ? std::string(tmp, static_cast<size_t>(n)) : std::string();
+    }
+
+    static std::string trans(UINT64 v) {
+        std::string b(8, '\0');
+        for (int i = 7; i >= 0; --i) { b[i] = static_cast<char>(v & 0xFF); v >>= 8; }
+        return b;
+    }
+
+    LenParser parser;
+    Factory factory;
+    ServerSession server;
+    ISSGate* gate = nullptr;
+    ISSServerConnection* link = nullptr;
+    int backend = -1;
+    std::string backendBuf;
+    std::vector<int> fds;
+    UINT16 port = 0;
+};
+
+} // namespace
+
+TEST_F(SDGateTest, RoutesClientsThroughServerLink) {
+    Start(45700, 45701);
+    int cfd = -1;
+    ISSClientConnection* client = AddClient(cfd);
+    ASSERT_NE(client, nullptr);
+
+    // Not entered yet: nothing may reach the server for this client.
+    EXPECT_FALSE(link->SendClientData(client, "x", 1));
+
+    ASSERT_TRUE(link->Enter(client, 42));
+    Frame f;
+    ASSERT_TRUE(readFrame(f));
+    EXPECT_EQ(f.cmd, GATE_LINK_ENTER);
+    EXPECT_EQ(f.body, trans(42));
+    UINT32 id = f.clientID;
+    EXPECT_NE(id, 0u);
+    sendFrame(GATE_LINK_ENTER, SDGATEERR_SUCCESS, id, trans(42));
+    ASSERT_TRUE(pump([&] { return server.enters.size() == 1; }));
+    EXPECT_EQ(server.enters[0].first, SDGATEERR_SUCCESS);
+    EXPECT_EQ(server.enters[0].second, 42u);
+
+    // Two packets in one write are split by the client parser and forwarded.
+    std::string both = clientPacket("hello") + clientPacket("world");
+    ASSERT_EQ(::send(cfd, both.data(), both.size(), 0), static_cast<ssize_t>(both.size()));
+    ASSERT_TRUE(readFrame(f));
+    EXPECT_EQ(f.cmd, GATE_LINK_CLIENT_DATA);
+    EXPECT_EQ(f.clientID, id);
+    EXPECT_EQ(f.body, clientPacket("hello"));
+    ASSERT_TRUE(readFrame(f));
+    EXPECT_EQ(f.body, clientPacket("world"));
+
+    // Server -> client data reaches the session, which sends it on.
+    sendFrame(GATE_LINK_CLIENT_DATA, 0, id, "pong");
+    EXPECT_EQ(readClient(cfd, 4), "pong");
+    ASSERT_EQ(server.clientData.size(), 1u);
+    EXPECT_EQ(server.clientData[0].first, client);
+
+    sendFrame(GATE_LINK_SERVER_DATA, 0, 0, "cfg");
+    ASSERT_TRUE(pump([&] { return server.serverData.size() == 1; }));
+    EXPECT_EQ(server.serverData[0], "cfg");
+    ASSERT_TRUE(link->SendServerData("hi", 2));
+    ASSERT_TRUE(readFrame(f));
+    EXPECT_EQ(f.cmd, GATE_LINK_SERVER_DATA);
+    EXPECT_EQ(f.body, "hi");
+
+    // Kick closes the client and tells its session why.
+    sendFrame(GATE_LINK_KICK, 0, id, "");
+    ASSERT_TRUE(pump([&] { return factory.closes == 1; }));
+    EXPECT_EQ(factory.lastError, SDGATEERR_CLI_KICK);
+    EXPECT_EQ(readClient(cfd, 1), "");
+
+    // Frames for the departed client are dropped.
+    sendFrame(GATE_LINK_CLIENT_DATA, 0, id, "late");
+    sendFrame(GATE_LINK_SERVER_DATA, 0, 0, "after");
+    ASSERT_TRUE(pump([&] { return server.serverData.size() == 2; }));
+    EXPECT_EQ(server.clientData.size(), 1u);
+}
+
+TEST_F(SDGateTest, ClientCloseAndLinkLoss) {
+    Start(45702, 45703);
+    int cfd = -1;
+    ISSClientConnection* client = AddClient(cfd);
+    ASSERT_NE(client, nullptr);
+    ASSERT_TRUE(link->Enter(client, 7));
+    Frame f;
+    ASSERT_TRUE(readFrame(f));
+    UINT32 id = f.clientID;
+
+    // A client that disconnects is reported to every server it entered.
+    ::close(cfd);
+    fds.erase(std::find(fds.begin(), fds.end(), cfd));
+    ASSERT_TRUE(readFrame(f));
+    EXPECT_EQ(f.cmd, GATE_LINK_CLIENT_CLOSE);
+    EXPECT_EQ(f.clientID, id);
+    EXPECT_EQ(factory.closes, 1);
+
+    // A malformed packet closes the offending client only.
+    ISSClientConnection* bad = AddClient(cfd);
+    ASSERT_NE(bad, nullptr);
+    const char junk[2] = {0, 1};
+    ASSERT_EQ(::send(cfd, junk, 2, 0), 2);
+    ASSERT_TRUE(pump([&] { return factory.closes == 2; }));
+    EXPECT_EQ(factory.lastError, SDGATEERR_PACKET_ERROR);
+
+    // Losing the backend closes the link.
+    ::close(backend);
+    fds.erase(std::find(fds.begin(), fds.end(), backend));
+    ASSERT_TRUE(pump([&] { return server.closes == 1; }));
+    EXPECT_FALSE(link->SendServerData("x", 1));
+}
+
+TEST_F(SDGateTest, GroupCastAndMulticastFanOut) {
+    Start(45704, 45705);
+    int fd[3];
+    ISSClientConnection* c[3];
+    UINT32 id[3];
+    for (int i = 0; i < 3; ++i) {
+        c[i] = AddClient(fd[i]);
+        ASSERT_NE(c[i], nullptr);
+        id[i] = EnterAndAck(c[i], 100 + i);
+    }
+    ASSERT_TRUE(pump([&] { return server.enters.size() == 3; }));
+
+    sendFrame(GATE_LINK_GROUP_JOIN, 0, id[0], be32(5));
+    sendFrame(GATE_LINK_GROUP_JOIN, 0, id[1], be32(5));
+
+    // Group 5 minus the skipped client 0.
+    sendFrame(GATE_LINK_GROUP_CAST, 0, id[0], be32(5) + "A");
+    EXPECT_EQ(readClient(fd[1], 1), "A");
+    // Everyone who entered.
+    sendFrame(GATE_LINK_GROUP_CAST, 0, 0, be32(GATE_GROUP_ENTERED) + "B");
+    for (int i = 0; i < 3; ++i) EXPECT_EQ(readClient(fd[i], 1), "B") << i;
+    // Explicit list; unknown IDs are ignored.
+    sendFrame(GATE_LINK_MULTICAST, 0, 0, be32(3) + be32(id[0]) + be32(0xDEAD) + be32(id[2]) + "C");
+    EXPECT_EQ(readClient(fd[0], 1), "C");
+    EXPECT_EQ(readClient(fd[2], 1), "C");
+    EXPECT_EQ(pending(fd[1]), "");
+
+    // Leaving the group, or the server, stops group delivery.
+    sendFrame(GATE_LINK_GROUP_LEAVE, 0, id[1], be32(5));
+    sendFrame(GATE_LINK_GROUP_CAST, 0, 0, be32(5) + "D");
+    EXPECT_EQ(readClient(fd[0], 1), "D");
+    ASSERT_TRUE(link->Leave(c[0], 9));
+    Frame f;
+    ASSERT_TRUE(readFrame(f));
+    EXPECT_EQ(f.cmd, GATE_LINK_LEAVE);
+    sendFrame(GATE_LINK_LEAVE, SDGATEERR_SUCCESS, id[0], trans(9));
+    sendFrame(GATE_LINK_GROUP_CAST, 0, 0, be32(GATE_GROUP_ENTERED) + "E");
+    EXPECT_EQ(readClient(fd[1], 1), "E");
+    EXPECT_EQ(readClient(fd[2], 1), "E");
+    EXPECT_EQ(pending(fd[0]), "");
+    ASSERT_EQ(server.leaves.size(), 1u);
+    // Multicast skips clients not entered on this backend.
+    sendFrame(GATE_LINK_MULTICAST, 0, 0, be32(2) + be32(id[0]) + be32(id[1]) + "G");
+    EXPECT_EQ(readClient(fd[1], 1), "G");
+    EXPECT_EQ(pending(fd[0]), "");
+    // So does a kick: client 0 stays connected.
+    sendFrame(GATE_LINK_KICK, 0, id[0], "");
+    sendFrame(GATE_LINK_GROUP_CAST, 0, 0, be32(GATE_GROUP_ENTERED) + "H");
+    EXPECT_EQ(readClient(fd[1], 1), "H");
+    EXPECT_EQ(factory.closes, 0);
+
+    // A closed client drops out of its groups.
+    ::close(fd[2]);
+    fds.erase(std::find(fds.begin(), fds.end(), fd[2]));
+    ASSERT_TRUE(readFrame(f));
+    EXPECT_EQ(f.cmd, GATE_LINK_CLIENT_CLOSE);
+    sendFrame(GATE_LINK_GROUP_CAST, 0, 0, be32(GATE_GROUP_ENTERED) + "F");
+    EXPECT_EQ(readClient(fd[1], 1), "F");
+}
+
+TEST_F(SDGateTest, StaleClientIdsMissReusedSlots) {
+    SGateOptMaxClient opt{1};
+    ASSERT_TRUE(gate->SetOpt(GATE_OPT_MAX_CLIENT, &opt));
+    Start(45706, 45707);
+
+    int fdA = -1;
+    ISSClientConnection* a = AddClient(fdA);
+    ASSERT_NE(a, nullptr);
+    UINT32 idA = EnterAndAck(a, 1);
+    ASSERT_TRUE(pump([&] { return server.enters.size() == 1; }));
+
+    // The table is full: a second client is refused at accept.
+    int extra = connectTo(port);
+    EXPECT_EQ(readClient(extra, 1), "");
+    EXPECT_EQ(factory.sessions.size(), 1u);
+    SGateOptMaxClient grow{2};
+    EXPECT_FALSE(gate->SetOpt(GATE_OPT_MAX_CLIENT, &grow));
+
+    ::close(fdA);
+    fds.erase(std::find(fds.begin(), fds.end(), fdA));
+    Frame f;
+    ASSERT_TRUE(readFrame(f));
+    EXPECT_EQ(f.cmd, GATE_LINK_CLIENT_CLOSE);
+
+    // B takes the only slot, under a new ID.
+    int fdB = -1;
+    ISSClientConnection* b = AddClient(fdB);
+    ASSERT_NE(b, nullptr);
+    UINT32 idB = EnterAndAck(b, 2);
+    EXPECT_NE(idA, idB);
+    EXPECT_EQ(idA & 0xFFFFFu, idB & 0xFFFFFu);
+
+    // Frames still addressed to A must not reach B.
+    sendFrame(GATE_LINK_CLIENT_DATA, 0, idA, "forA");
+    sendFrame(GATE_LINK_MULTICAST, 0, 0, be32(1) + be32(idA) + "castA");
+    sendFrame(GATE_LINK_KICK, 0, idA, "");
+    sendFrame(GATE_LINK_CLIENT_DATA, 0, idB, "forB");
+    EXPECT_EQ(readClient(fdB, 4), "forB");
+    EXPECT_EQ(factory.closes, 1);
+}
+
+TEST_F(SDGateTest, FloodLimitsDropThenKick) {
+    Start(45708, 45709);
+    SGateOptClientLimit lim{};
+    lim.dwPacketsPerSec = 1;
+    lim.dwPacketBurst = 5;
+    lim.dwMaxPacketSize = 64;
+    ASSERT_TRUE(gate->SetOpt(GATE_OPT_CLIENT_LIMIT, &lim));
+
+    // Ten packets in one burst: the bucket lets five through.
+    int fd = -1;
+    ASSERT_NE(AddClient(fd), nullptr);
+    std::string burst;
+    for (int i = 0; i < 10; ++i) burst += clientPacket("p" + std::to_string(i));
+    ASSERT_EQ(::send(fd, burst.data(), burst.size(), 0), static_cast<ssize_t>(burst.size()));
+    SGateStats st{};
+    ASSERT_TRUE(pump([&] { gate->SetOpt(GATE_OPT_STATS, &st); return st.qwDroppedPackets == 5; }));
+    ASSERT_EQ(factory.log.size(), 5u);
+    EXPECT_EQ(factory.log[4], clientPacket("p4"));
+    EXPECT_EQ(st.qwDroppedBytes, 5u * 4);
+    EXPECT_EQ(factory.closes, 0);
+
+    // With a kick threshold the same burst closes the client.
+    lim.dwKickAfterDrops = 3;
+    ASSERT_TRUE(gate->SetOpt(GATE_OPT_CLIENT_LIMIT, &lim));
+    int fd2 = -1;
+    ASSERT_NE(AddClient(fd2), nullptr);
+    ASSERT_EQ(::send(fd2, burst.data(), burst.size(), 0), static_cast<ssize_t>(burst.size()));
+    ASSERT_TRUE(pump([&] { return factory.closes == 1; }));
+    EXPECT_EQ(factory.lastError, SDGATEERR_CLI_FLOOD);
+    EXPECT_EQ(readClient(fd2, 1), "");
+
+    // Oversized packets close the client before it is delivered, even
+    // while the packet is still incomplete.
+    int fd3 = -1;
+    ASSERT_NE(AddClient(fd3), nullptr);
+    std::string big = clientPacket(std::string(200, 'x')).substr(0, 100);
+    ASSERT_EQ(::send(fd3, big.data(), big.size(), 0), static_cast<ssize_t>(big.size()));
+    ASSERT_TRUE(pump([&] { return factory.closes == 2; }));
+    EXPECT_EQ(factory.lastError, SDGATEERR_PACKET_TOO_LARGE);
+
+    gate->SetOpt(GATE_OPT_STATS, &st);
+    EXPECT_EQ(st.qwFloodKicks, 1u);
+    EXPECT_EQ(st.qwOversizeKicks, 1u);
+    EXPECT_EQ(st.dwClients, 1u);
+}
@@ -8,6 +8,8 @@
 #include <string>
 #include <vector>
 #include <set>
+#include <chrono>
+#include <iostream>
 
 using namespace SSCP;
 
@@ -9,6 +9,8 @@
 #include <thread>
 #include <chrono>
 #include <random>
+#include <cstring>
+#include <string>
 
 using namespace SSCP;
 
@@ -367,4 +369,167 @@ TEST_F(SDMemoryPoolTest, PerformanceComparison) {
         std::chrono::duration_cast<std::chrono::microseconds>(stdTime).count() << " μs\n";
     std::cout << "Memory pool: " << 
         std::chrono::duration_cast<std::chrono::microseconds>(poolTime).count() << " μs\n";
-}
\ No newline at end of file
+}
+
+TEST_F(SDMemoryPoolTest, VarMemoryPool_Stats) {
+    CSDVarMemoryPool pool;
+    ASSERT_TRUE(pool.Create());
+    std::vector<void*> ptrs;
+    for (int i = 0; i < 20; ++i) ptrs.push_back(pool.Malloc(20));   // 24-byte class
+    void* big = pool.Malloc(1000);
+
+    SVarMemPoolStats st;
+    pool.GetStats(st);
+    EXPECT_EQ(st.dwPageCount, 1u);
+    EXPECT_EQ(st.astClass[2].dwUnitSize, 24u);
+    EXPECT_EQ(st.astClass[2].dwInUse, 20u);
+    EXPECT_EQ(st.astClass[2].dwFree, 12u);                            // two batches of 16 carved
+    EXPECT_EQ(st.astClass[2].qwAllocs, 20u);
+    EXPECT_EQ(st.qwCarvedBytes, 32u * (24 + 4));
+    EXPECT_EQ(st.dwLargeInUse, 1u);
+    EXPECT_EQ(st.qwLargeBytes, 1000u);
+    EXPECT_EQ(st.qwInUseBytes, 20u * 24 + 1000);
+
+    for (int i = 0; i < 15; ++i) pool.Free(ptrs[i]);
+    pool.Free(big);
+    pool.GetStats(st);
+    EXPECT_EQ(st.astClass[2].dwInUse, 5u);
+    EXPECT_EQ(st.astClass[2].dwPeakInUse, 20u);
+    EXPECT_EQ(st.qwInUseBytes, 5u * 24);
+    EXPECT_EQ(st.qwPeakInUseBytes, 20u * 24 + 1000);
+    EXPECT_EQ(st.dwLargeInUse, 0u);
+    std::string dump = pool.DumpStats();
+    EXPECT_NE(dump.find("  24: in-use 5 free 27 peak 20 allocs 20"), std::string::npos) << dump;
+    EXPECT_EQ(dump.find("guard-errors"), std::string::npos) << dump;
+
+    pool.Clear();
+    pool.GetStats(st);
+    EXPECT_EQ(st.dwPageCount, 0u);
+    EXPECT_EQ(st.qwInUseBytes, 0u);
+}
+
+TEST_F(SDMemoryPoolTest, VarMemoryPool_DebugGuardsAndTags) {
+    CSDVarMemoryPool pool;
+    ASSERT_TRUE(pool.Create(0x40000, TRUE));
+    char* a = static_cast<char*>(SD_POOL_MALLOC(pool, 10));
+    char* b = static_cast<char*>(pool.Malloc(300, "packets"));
+    char* c = static_cast<char*>(pool.Malloc(300, "packets"));
+    char* d = static_cast<char*>(pool.Malloc(16));
+    ASSERT_TRUE(a && b && c && d);
+    EXPECT_EQ(static_cast<unsigned char>(a[0]), 0xCDu);
+
+    std::string dump = pool.DumpStats();
+    EXPECT_NE(dump.find("live packets: 2 blocks 600 bytes"), std::string::npos) << dump;
+    EXPECT_NE(dump.find("live (untagged): 1 blocks 16 bytes"), std::string::npos) << dump;
+    EXPECT_NE(dump.find("test_sdmemorypool.cpp:"), std::string::npos) << dump;
+    EXPECT_NE(dump.find("guard-errors:0 double-frees:0"), std::string::npos) << dump;
+
+    a[10] = 'x';                // one past the end
+    pool.Free(a);
+    c[-1] = 'x';                // one before the start
+    pool.Free(c);
+    pool.Free(d);
+    pool.Free(d);               // twice
+
+    SVarMemPoolStats st;
+    pool.GetStats(st);
+    EXPECT_EQ(st.dwGuardErrors, 2u);
+    EXPECT_EQ(st.dwDoubleFrees, 1u);
+    dump = pool.DumpStats();
+    EXPECT_NE(dump.find("live packets: 1 blocks 300 bytes"), std::string::npos) << dump;
+    EXPECT_EQ(dump.find("untagged"), std::string::npos) << dump;
+    pool.Free(b);
+    EXPECT_EQ(pool.DumpStats().find("live"), std::string::npos);
+}
+
+// CSDMTVarMemoryPool Tests
+TEST_F(SDMemoryPoolTest, MTVarMemoryPool_SizesAndReuse) {
+    CSDMTVarMemoryPool pool;
+    EXPECT_EQ(pool.Malloc(16), nullptr);   // not created
+    ASSERT_TRUE(pool.Create());
+    EXPECT_EQ(pool.Malloc(0), nullptr);
+
+    std::vector<std::pair<char*, UINT32>> blocks;
+    for (UINT32 len : {1u, 8u, 9u, 128u, 129u, 200u, 1000u, 4096u, 8192u, 8193u, 100000u}) {
+        char* p = static_cast<char*>(pool.Malloc(len));
+        ASSERT_NE(p, nullptr) << len;
+        EXPECT_EQ(reinterpret_cast<size_t>(p) % 8, 0u) << len;
+        memset(p, static_cast<int>(len & 0xFF), len);
+        blocks.emplace_back(p, len);
+    }
+    for (auto& b : blocks) {
+        EXPECT_EQ(static_cast<unsigned char>(b.first[0]), b.second & 0xFF);
+        EXPECT_EQ(static_cast<unsigned char>(b.first[b.second - 1]), b.second & 0xFF);
+        pool.Free(b.first);
+    }
+
+    // A freed block of the same class comes straight back.
+    void* p = pool.Malloc(40);
+    pool.Free(p);
+    EXPECT_EQ(pool.Malloc(33), p);
+    pool.Free(p);
+}
+
+TEST_F(SDMemoryPoolTest, MTVarMemoryPool_CrossThreadFree) {
+    CSDMTVarMemoryPool pool;
+    ASSERT_TRUE(pool.Create());
+    const int producers = 4;
+    const int perThread = 20000;
+    std::vector<std::vector<UINT32*>> made(producers);
+    std::vector<std::thread> threads;
+    for (int t = 0; t < producers; ++t) {
+        threads.emplace_back([&, t] {
+            for (int i = 0; i < perThread; ++i) {
+                UINT32 len = 8 + (i * 37) % 2000;
+                UINT32* p = static_cast<UINT32*>(pool.Malloc(len));
+                p[0] = t;
+                p[1] = i;
+                made[t].push_back(p);
+            }
+        });
+    }
+    for (auto& th : threads) th.join();
+    threads.clear();
+    // Freed on other threads than the ones that allocated, while those
+    // allocate again from the same pool.
+    for (int t = 0; t < producers; ++t) {
+        threads.emplace_back([&, t] {
+            std::vector<UINT32*>& mine = made[(t + 1) % producers];
+            for (size_t i = 0; i < mine.size(); ++i) {
+                EXPECT_EQ(mine[i][0], static_cast<UINT32>((t + 1) % producers));
+                EXPECT_EQ(mine[i][1], i);
+                pool.Free(mine[i]);
+                pool.Free(pool.Malloc(64));
+            }
+        });
+    }
+    for (auto& th : threads) th.join();
+
+    // The producers' heaps now belong to nobody; a new thread adopts one and
+    // collects what was freed into it.
+    std::thread([&] {
+        for (int i = 0; i < 1000; ++i) pool.Free(pool.Malloc(8 + (i * 37) % 2000));
+        pool.Trim();
+    }).join();
+}
+
+TEST_F(SDMemoryPoolTest, MTVarMemoryPool_ReturnsIdleSpans) {
+    CSDMTVarMemoryPool pool;
+    ASSERT_TRUE(pool.Create());
+    std::vector<void*> ptrs;
+    for (int i = 0; i < 50000; ++i) ptrs.push_back(pool.Malloc(256));
+    EXPECT_GE(pool.GetMemUsed(), 50000 * 256);
+    // Freed locally: every emptied span but the last goes straight back.
+    for (void* p : ptrs) pool.Free(p);
+    EXPECT_EQ(pool.GetMemUsed(), 0x10000);
+
+    ptrs.clear();
+    for (int i = 0; i < 50000; ++i) ptrs.push_back(pool.Malloc(256));
+    std::thread([&] {
+        for (void* p : ptrs) pool.Free(p);
+    }).join();
+    // Freed remotely: held until the owner collects them.
+    EXPECT_GE(pool.GetMemUsed(), 50000 * 256);
+    pool.Trim();
+    EXPECT_EQ(pool.GetMemUsed(), 0);
+}
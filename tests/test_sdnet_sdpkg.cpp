@@ -3,6 +3,7 @@
 #include "ssengine/sdnet_ver.h"
 #include "ssengine/sdpkg.h"
 #include <atomic>
+#include <cstring>
 #include <thread>
 
 using namespace SSCP;
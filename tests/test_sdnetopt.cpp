@@ -51,6 +51,7 @@ TEST_F(SDNetOptTest, LinuxNetworkOptionConstants) {
     EXPECT_EQ(NETLIN_OPT_MAX_CONNECTION, 201u);
     EXPECT_EQ(NETLIN_OPT_QUEUE_SIZE, 202u);
     EXPECT_EQ(NETLIN_OPT_ADVANCE_PARAM, 203u);
+    EXPECT_EQ(NETLIN_OPT_THREAD_ATTR, 204u);
     
     // Constants should be compile-time constants
     static_assert(NETLIN_OPT_MAX_CONNECTION == 201, "NETLIN_OPT_MAX_CONNECTION should be 201");
@@ -64,6 +65,7 @@ TEST_F(SDNetOptTest, WindowsNetworkOptionConstants) {
     EXPECT_EQ(NETWIN_OPT_QUEUE_SIZE, 302u);
     EXPECT_EQ(NETWIN_OPT_ADVANCE_PARAM, 303u);
     EXPECT_EQ(NETWIN_OPT_WORKTHREAD_PARAM, 304u);
+    EXPECT_EQ(NETWIN_OPT_THREAD_ATTR, 305u);
     
     // Constants should be compile-time constants
     static_assert(NETWIN_OPT_MAX_CONNECTION == 301, "NETWIN_OPT_MAX_CONNECTION should be 301");
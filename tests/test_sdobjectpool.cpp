@@ -10,6 +10,10 @@
 #include <thread>
 #include <atomic>
 #include <chrono>
+#include <memory>
+#include <set>
+#include <stdexcept>
+#include <string>
 
 using namespace SSCP;
 
@@ -434,4 +438,197 @@ TEST_F(SDObjectPoolTest, CompareWithStandardNew) {
     
     // Object pool should be competitive or faster
     // Note: Results may vary depending on system and compiler optimizations
-}
\ No newline at end of file
+}
+
+// Own type for the slab tests: test_sdidpool.cpp defines another TestObject
+// in the same binary.
+struct SlabObject {
+    int value;
+    explicit SlabObject(int v) : value(v) {}
+    ~SlabObject() { destroyed++; }
+    static std::atomic<int> destroyed;
+};
+
+std::atomic<int> SlabObject::destroyed{0};
+
+TEST_F(SDObjectPoolTest, SlabAllocatorReuse) {
+    typedef ObjectSlabAllocator<SlabObject> Alloc;
+    CSDObjectPool<SlabObject, CSDNonMutex, Alloc> pool(100, 1);
+    EXPECT_EQ(pool.GetAllocator().capacity(), 100u);
+
+    std::vector<SlabObject*> objects;
+    for (int i = 0; i < 1000; ++i) {
+        objects.push_back(pool.Alloc(i));
+    }
+    size_t carved = pool.GetAllocator().capacity();
+    EXPECT_GE(carved, 1000u);
+    // Objects are laid out back to back within a slab.
+    EXPECT_EQ(reinterpret_cast<char*>(objects[1]) - reinterpret_cast<char*>(objects[0]),
+              -static_cast<std::ptrdiff_t>(sizeof(SlabObject)));
+
+    int before = SlabObject::destroyed;
+    for (SlabObject* obj : objects) {
+        pool.Free(obj);
+    }
+    EXPECT_EQ(SlabObject::destroyed - before, 1000);
+
+    objects.clear();
+    for (int i = 0; i < 1000; ++i) {
+        objects.push_back(pool.Alloc(i));
+        EXPECT_EQ(objects.back()->value, i);
+    }
+    EXPECT_EQ(pool.GetAllocator().capacity(), carved);
+    for (SlabObject* obj : objects) {
+        pool.Free(obj);
+    }
+}
+
+TEST_F(SDObjectPoolTest, SlabAllocatorCrossThread) {
+    typedef ObjectSlabAllocator<SlabObject> Alloc;
+    CSDObjectPool<SlabObject, CSDNonMutex, Alloc> pool;
+
+    const int numThreads = 4;
+    const int objectsPerThread = 5000;
+    std::vector<std::vector<SlabObject*>> allocated(numThreads);
+    std::vector<std::thread> threads;
+    for (int t = 0; t < numThreads; ++t) {
+        threads.emplace_back([&, t]() {
+            for (int i = 0; i < objectsPerThread; ++i) {
+                allocated[t].push_back(pool.Alloc(t * objectsPerThread + i));
+            }
+        });
+    }
+    for (auto& thread : threads) {
+        thread.join();
+    }
+
+    // Every live object is distinct and intact.
+    std::set<SlabObject*> seen;
+    for (int t = 0; t < numThreads; ++t) {
+        for (int i = 0; i < objectsPerThread; ++i) {
+            EXPECT_TRUE(seen.insert(allocated[t][i]).second);
+            EXPECT_EQ(allocated[t][i]->value, t * objectsPerThread + i);
+        }
+    }
+    size_t carved = pool.GetAllocator().capacity();
+
+    // Objects freed on other threads, and the magazines of exited threads,
+    // go back through the depot instead of growing the pool.
+    for (int round = 0; round < 3; ++round) {
+        threads.clear();
+        for (int t = 0; t < numThreads; ++t) {
+            threads.emplace_back([&, t]() {
+                std::vector<SlabObject*>& mine = allocated[(t + 1) % numThreads];
+                for (SlabObject* obj : mine) {
+                    pool.Free(obj);
+                }
+                mine.clear();
+            });
+        }
+        for (auto& thread : threads) {
+            thread.join();
+        }
+        threads.clear();
+        for (int t = 0; t < numThreads; ++t) {
+            threads.emplace_back([&, t]() {
+                for (int i = 0; i < objectsPerThread; ++i) {
+                    allocated[(t + 1) % numThreads].push_back(pool.Alloc(i));
+                }
+            });
+        }
+        for (auto& thread : threads) {
+            thread.join();
+        }
+    }
+    // A thread may still carve while another holds the last free objects in
+    // its two magazines, so allow that much per round plus one slab.
+    EXPECT_LE(pool.GetAllocator().capacity(), carved + 3 * numThreads * 2 * 64 + 256);
+    for (auto& objects : allocated) {
+        for (SlabObject* obj : objects) {
+            pool.Free(obj);
+        }
+    }
+}
+
+// Counts copies of its payload, to check Alloc moves rvalues in.
+struct Payload {
+    std::vector<int> data;
+    static int copies;
+    explicit Payload(size_t n) : data(n, 7) {}
+    Payload(const Payload& o) : data(o.data) { ++copies; }
+    Payload(Payload&&) = default;
+};
+
+int Payload::copies = 0;
+
+struct Message {
+    std::string text;
+    Payload payload;
+    std::unique_ptr<int> extra;
+    Message(std::string t, Payload p, std::unique_ptr<int> e)
+        : text(std::move(t)), payload(std::move(p)), extra(std::move(e)) {}
+    Message(int a, int b, int c, int d, int e, int f, int g) : payload(a + b + c + d + e + f + g) {}
+    explicit Message(bool fail) : payload(0) {
+        if (fail) throw std::runtime_error("ctor");
+    }
+};
+
+TEST_F(SDObjectPoolTest, AllocForwardsArguments) {
+    CSDObjectPool<Message> pool(4, 4);
+    Payload::copies = 0;
+    std::string text(100, 'x');
+    const char* buffer = text.data();
+    Message* msg = pool.Alloc(std::move(text), Payload(1000), std::make_unique<int>(5));
+    EXPECT_EQ(Payload::copies, 0);
+    EXPECT_EQ(msg->text.data(), buffer);
+    EXPECT_EQ(msg->payload.data.size(), 1000u);
+    EXPECT_EQ(*msg->extra, 5);
+
+    // Lvalues are still copied, and any number of arguments is accepted.
+    Payload kept(10);
+    Message* copy = pool.Alloc(std::string("copy"), kept, nullptr);
+    EXPECT_EQ(Payload::copies, 1);
+    EXPECT_EQ(kept.data.size(), 10u);
+    Message* many = pool.Alloc(1, 2, 3, 4, 5, 6, 7);
+    EXPECT_EQ(many->payload.data.size(), 28u);
+
+    pool.Free(msg);
+    pool.Free(copy);
+    pool.Free(many);
+}
+
+TEST_F(SDObjectPoolTest, AllocReturnsMemoryWhenConstructorThrows) {
+    CSDObjectPool<Message> pool(1, 1);
+    EXPECT_THROW(pool.Alloc(true), std::runtime_error);
+    EXPECT_EQ(pool.GetAllocator().read_size(), 1u);
+    Message* msg = pool.Alloc(false);
+    EXPECT_EQ(pool.GetAllocator().read_size(), 0u);
+    pool.Free(msg);
+}
+
+TEST_F(SDObjectPoolTest, AllocUniqueReturnsToPool) {
+    typedef CSDObjectPool<SlabObject> Pool;
+    Pool pool(2, 1);
+    int before = SlabObject::destroyed;
+    auto findFirst = [&pool](int stop) -> int {
+        for (int i = 0;; ++i) {
+            Pool::UniquePtr obj = pool.AllocUnique(i);
+            if (obj->value == stop) {
+                return i;
+            }
+        }
+    };
+    EXPECT_EQ(findFirst(3), 3);
+    EXPECT_EQ(SlabObject::destroyed - before, 4);
+    EXPECT_EQ(pool.GetAllocator().read_size(), 2u);
+
+    // Handles move like unique_ptr and can be released back to raw use.
+    Pool::UniquePtr a = pool.AllocUnique(1);
+    Pool::UniquePtr b = std::move(a);
+    EXPECT_EQ(a, nullptr);
+    EXPECT_EQ(b->value, 1);
+    SlabObject* raw = b.release();
+    EXPECT_EQ(pool.GetAllocator().read_size(), 1u);
+    pool.Free(raw);
+    EXPECT_EQ(pool.GetAllocator().read_size(), 2u);
+}
@@ -86,3 +86,40 @@ TEST(sdpipe, reporter_remoteid_error_code) {
     GTEST_SKIP() << "Windows/Linux/macOS only";
 #endif
 }
+
+TEST(sdpipe, reporter_peer_graceful_close) {
+#if defined(_WIN32) || defined(__linux__) || defined(__APPLE__)
+    auto* net = SSNetGetModule(&SDNET_MODULE_VERSION);
+    ASSERT_NE(net, nullptr);
+    auto* pipe = SSPipeGetModule(&SDNET_MODULE_VERSION);
+    ASSERT_NE(pipe, nullptr);
+    CapturingReporter rep; ASSERT_TRUE(pipe->Init(nullptr, nullptr, &rep, net));
+    ASSERT_TRUE(pipe->AddListen("127.0.0.1", 45686));
+    UINT32 id = 0x21436587; ASSERT_TRUE(pipe->AddConn(id, "127.0.0.1", 45686));
+    for (int i=0;i<100 && rep.success.load() < 2; ++i) { pipe->Run(10); std::this_thread::sleep_for(std::chrono::milliseconds(10)); }
+    ASSERT_GE(rep.success.load(), 2);
+    UINT32 serverId = 0;
+    {
+        std::lock_guard<std::mutex> lk(rep.guard);
+        for (UINT32 sid : rep.ids) if (sid != id) serverId = sid;
+    }
+    ISSPipe* server = pipe->GetPipe(serverId);
+    ASSERT_NE(server, nullptr);
+    // The accepted end closes; the connecting pipe sees a clean shutdown and
+    // tears down its connector while its own terminate callback is running.
+    server->Close();
+    for (int i=0;i<100 && rep.disconnect.load() < 2; ++i) { pipe->Run(10); std::this_thread::sleep_for(std::chrono::milliseconds(10)); }
+    EXPECT_GE(rep.disconnect.load(), 2);
+    ISSPipe* client = pipe->GetPipe(id);
+    ASSERT_NE(client, nullptr);
+    EXPECT_FALSE(client->Send(1, "x", 1));
+    // The pipe can connect again afterwards.
+    int before = rep.success.load();
+    EXPECT_TRUE(pipe->AddConn(id, "127.0.0.1", 45686));
+    for (int i=0;i<100 && rep.success.load() < before + 2; ++i) { pipe->Run(10); std::this_thread::sleep_for(std::chrono::milliseconds(10)); }
+    EXPECT_GE(rep.success.load(), before + 2);
+    net->Release(); pipe->Release();
+#else
+    GTEST_SKIP() << "Windows/Linux/macOS only";
+#endif
+}
@@ -0,0 +1,178 @@
+#include <gtest/gtest.h>
+#include "ssengine/sdpipe.h"
+#include "ssengine/sdnet.h"
+#include "ssengine/sdnet_ver.h"
+#include <chrono>
+#include <string>
+#include <thread>
+#include <vector>
+
+using namespace SSCP;
+
+namespace {
+
+struct IdReporter : public ISSPipeReporter {
+    std::vector<UINT32> ids;
+    void SSAPI OnReport(INT32 nErrCode, UINT32 dwID) override {
+        if (nErrCode == PIPE_SUCCESS) ids.push_back(dwID);
+    }
+};
+
+struct Result {
+    UINT32 callId;
+    INT32 code;
+    std::string data;
+};
+
+struct Collector : public ISSPipeRpcCallback {
+    std::vector<Result> results;
+    void SSAPI OnResponse(UINT32 dwCallID, INT32 nResult, const char* pData, UINT32 dwLen) override {
+        results.push_back(Result{dwCallID, nResult, pData ? std::string(pData, dwLen) : std::string()});
+    }
+};
+
+// Holds requests and answers them later, in reverse order.
+struct DeferredServer : public ISSPipeRpcSink {
+    struct Req { ISSPipe* pipe; UINT16 bid; UINT32 callId; std::string data; };
+    std::vector<Req> reqs;
+    void SSAPI OnRequest(ISSPipe* poPipe, UINT16 wBusinessID, UINT32 dwCallID, const char* pData, UINT32 dwLen) override {
+        reqs.push_back(Req{poPipe, wBusinessID, dwCallID, std::string(pData, dwLen)});
+    }
+    void replyAllReversed() {
+        for (auto it = reqs.rbegin(); it != reqs.rend(); ++it) {
+            std::string rsp = "re:" + it->data;
+            it->pipe->Reply(it->bid, it->callId, rsp.data(), static_cast<UINT32>(rsp.size()));
+        }
+        reqs.clear();
+    }
+};
+
+class SDPipeRpcTest : public ::testing::Test {
+protected:
+    // Each test listens on its own port, like the other sdpipe tests.
+    void Connect(UINT16 port) {
+        net = SSNetGetModule(&SDNET_MODULE_VERSION);
+        ASSERT_NE(net, nullptr);
+        pipe = SSPipeGetModule(&SDNET_MODULE_VERSION);
+        ASSERT_NE(pipe, nullptr);
+        ASSERT_TRUE(pipe->Init(nullptr, nullptr, &rep, net));
+        ASSERT_TRUE(pipe->AddListen("127.0.0.1", port));
+        ASSERT_TRUE(pipe->AddConn(clientId, "127.0.0.1", port));
+        for (int i = 0; i < 200 && serverId == 0; ++i) {
+            for (auto id : rep.ids) if (id != clientId) { serverId = id; break; }
+            pump(1);
+        }
+        ASSERT_NE(serverId, 0u);
+        cp = pipe->GetPipe(clientId);
+        sp = pipe->GetPipe(serverId);
+        ASSERT_NE(cp, nullptr);
+        ASSERT_NE(sp, nullptr);
+        ASSERT_TRUE(sp->SetRpcSink(12, &server));
+    }
+    void TearDown() override {
+        if (net) net->Release();
+        if (pipe) pipe->Release();
+    }
+    void pump(int rounds) {
+        for (int i = 0; i < rounds; ++i) {
+            pipe->Run(10);
+            std::this_thread::sleep_for(std::chrono::milliseconds(5));
+        }
+    }
+
+    ISSNet* net = nullptr;
+    ISSPipeModule* pipe = nullptr;
+    IdReporter rep;
+    UINT32 clientId = 0x0103C0D0;
+    UINT32 serverId = 0;
+    ISSPipe* cp = nullptr;
+    ISSPipe* sp = nullptr;
+    DeferredServer server;
+};
+
+} // namespace
+
+TEST_F(SDPipeRpcTest, ResponsesMatchCallsOutOfOrder) {
+    ASSERT_NO_FATAL_FAILURE(Connect(45691));
+    Collector col;
+    std::vector<UINT32> ids;
+    for (int i = 0; i < 5; ++i) {
+        std::string req = "q" + std::to_string(i);
+        UINT32 cid = 0;
+        ASSERT_TRUE(cp->Call(12, req.data(), static_cast<UINT32>(req.size()), 5000, &col, &cid));
+        EXPECT_NE(cid, 0u);
+        ids.push_back(cid);
+    }
+    EXPECT_EQ(pipe->GetPendingCallCount(), 5u);
+    for (int i = 0; i < 200 && server.reqs.size() < 5; ++i) pump(1);
+    ASSERT_EQ(server.reqs.size(), 5u);
+    EXPECT_EQ(server.reqs[0].bid, 12);
+    EXPECT_EQ(server.reqs[0].data, "q0");
+
+    server.replyAllReversed();
+    for (int i = 0; i < 200 && col.results.size() < 5; ++i) pump(1);
+    ASSERT_EQ(col.results.size(), 5u);
+    for (int i = 0; i < 5; ++i) {
+        const Result& r = col.results[i];
+        EXPECT_EQ(r.code, PIPE_RPC_SUCCESS);
+        EXPECT_EQ(r.callId, ids[4 - i]);
+        EXPECT_EQ(r.data, "re:q" + std::to_string(4 - i));
+    }
+    EXPECT_EQ(pipe->GetPendingCallCount(), 0u);
+}
+
+TEST_F(SDPipeRpcTest, TimeoutAndCancel) {
+    ASSERT_NO_FATAL_FAILURE(Connect(45692));
+    Collector col;
+    UINT32 timedOut = 0, cancelled = 0;
+    ASSERT_TRUE(cp->Call(12, "t", 1, 50, &col, &timedOut));
+    ASSERT_TRUE(cp->Call(12, "c", 1, 50, &col, &cancelled));
+    EXPECT_TRUE(pipe->CancelCall(cancelled));
+    EXPECT_FALSE(pipe->CancelCall(cancelled));
+
+    for (int i = 0; i < 200 && col.results.empty(); ++i) pump(1);
+    ASSERT_EQ(col.results.size(), 1u);
+    EXPECT_EQ(col.results[0].callId, timedOut);
+    EXPECT_EQ(col.results[0].code, PIPE_RPC_TIMEOUT);
+    EXPECT_EQ(pipe->GetPendingCallCount(), 0u);
+
+    // Late replies to expired or cancelled calls are dropped.
+    for (int i = 0; i < 200 && server.reqs.size() < 2; ++i) pump(1);
+    server.replyAllReversed();
+    pump(20);
+    EXPECT_EQ(col.results.size(), 1u);
+}
+
+TEST_F(SDPipeRpcTest, RemoveConnFailsPendingCalls) {
+    ASSERT_NO_FATAL_FAILURE(Connect(45693));
+    Collector col;
+    UINT32 cid = 0;
+    ASSERT_TRUE(cp->Call(12, "x", 1, 60000, &col, &cid));
+    EXPECT_TRUE(pipe->RemoveConn(clientId));
+    EXPECT_TRUE(col.results.empty());
+    pump(1);
+    ASSERT_EQ(col.results.size(), 1u);
+    EXPECT_EQ(col.results[0].callId, cid);
+    EXPECT_EQ(col.results[0].code, PIPE_RPC_DISCONNECT);
+    EXPECT_EQ(pipe->GetPendingCallCount(), 0u);
+}
+
+TEST_F(SDPipeRpcTest, ReconnectKeepsCallsOfTheNewConnection) {
+    ASSERT_NO_FATAL_FAILURE(Connect(45694));
+    Collector col;
+    UINT32 oldCid = 0, newCid = 0;
+    ASSERT_TRUE(cp->Call(12, "old", 3, 60000, &col, &oldCid));
+    // Drop the pipe and connect it again; the new call goes out before Run
+    // gets to fail the calls of the dropped connection.
+    EXPECT_TRUE(pipe->RemoveConn(clientId));
+    ASSERT_TRUE(pipe->AddConn(clientId, "127.0.0.1", 45694));
+    cp = pipe->GetPipe(clientId);
+    ASSERT_NE(cp, nullptr);
+    ASSERT_TRUE(cp->Call(12, "new", 3, 60000, &col, &newCid));
+    pump(1);
+    ASSERT_EQ(col.results.size(), 1u);
+    EXPECT_EQ(col.results[0].callId, oldCid);
+    EXPECT_EQ(col.results[0].code, PIPE_RPC_DISCONNECT);
+    EXPECT_EQ(pipe->GetPendingCallCount(), 1u);
+    EXPECT_TRUE(pipe->CancelCall(newCid));
+}
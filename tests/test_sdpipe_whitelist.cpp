@@ -2,6 +2,7 @@
 #include "ssengine/sdpipe.h"
 #include "ssengine/sdnet.h"
 #include "ssengine/sdnet_ver.h"
+#include <cstdio>
 #include <fstream>
 
 using namespace SSCP;
@@ -39,3 +40,63 @@ TEST(sdpipe, whitelist_addconn_blocks_disallowed) {
 #endif
 }
 
+
+TEST(sdpipe, whitelist_cidr_ranges_and_comments) {
+    auto* net = SSNetGetModule(&SDNET_MODULE_VERSION);
+    ASSERT_NE(net, nullptr);
+    auto* pipe = SSPipeGetModule(&SDNET_MODULE_VERSION);
+    ASSERT_NE(pipe, nullptr);
+    ASSERT_TRUE(pipe->Init(nullptr, nullptr, nullptr, net));
+
+    // Empty list: everything allowed
+    EXPECT_TRUE(pipe->CheckIpValid("203.0.113.7"));
+
+    const char* f = "iplist_cidr.tmp";
+    {
+        std::ofstream ofs(f);
+        ofs << "# gate hosts\n"
+            << "10.12.0.0/16\n"
+            << "  192.168.1.5   # single host\n"
+            << "172.16.0.0/12\n"
+            << "172.20.0.0/16\n"      // contained in the /12 above, merged
+            << "not-an-ip\n"          // ignored
+            << "10.0.0.0/33\n";       // ignored
+    }
+    ASSERT_TRUE(pipe->ReloadIPList(f));
+    EXPECT_TRUE(pipe->CheckIpValid("10.12.0.0"));
+    EXPECT_TRUE(pipe->CheckIpValid("10.12.255.255"));
+    EXPECT_FALSE(pipe->CheckIpValid("10.13.0.1"));
+    EXPECT_FALSE(pipe->CheckIpValid("10.11.255.255"));
+    EXPECT_TRUE(pipe->CheckIpValid("192.168.1.5"));
+    EXPECT_FALSE(pipe->CheckIpValid("192.168.1.6"));
+    EXPECT_TRUE(pipe->CheckIpValid("172.31.1.1"));
+    EXPECT_FALSE(pipe->CheckIpValid("172.32.0.0"));
+    EXPECT_FALSE(pipe->CheckIpValid("bogus"));
+    EXPECT_FALSE(pipe->CheckIpValid(nullptr));
+
+    // /0 admits everything
+    {
+        std::ofstream ofs(f); ofs << "0.0.0.0/0\n";
+    }
+    ASSERT_TRUE(pipe->ReloadIPList(f));
+    EXPECT_TRUE(pipe->CheckIpValid("255.255.255.255"));
+    EXPECT_TRUE(pipe->CheckIpValid("0.0.0.0"));
+
+    // Reload with only comments disables the whitelist
+    {
+        std::ofstream ofs(f); ofs << "# nothing\n";
+    }
+    ASSERT_TRUE(pipe->ReloadIPList(f));
+    EXPECT_TRUE(pipe->CheckIpValid("198.51.100.1"));
+
+    // Entries that all fail to parse deny everything instead of disabling the list
+    {
+        std::ofstream ofs(f); ofs << "gate-host\n::1\n10.0.0.300\n";
+    }
+    ASSERT_TRUE(pipe->ReloadIPList(f));
+    EXPECT_FALSE(pipe->CheckIpValid("198.51.100.1"));
+    EXPECT_FALSE(pipe->CheckIpValid("127.0.0.1"));
+
+    std::remove(f);
+    net->Release(); pipe->Release();
+}
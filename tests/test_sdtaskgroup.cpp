@@ -0,0 +1,163 @@
+/**
+ * @file test_sdtaskgroup.cpp
+ * @brief Task group and parallel-for tests
+ */
+
+#include <gtest/gtest.h>
+#include "ssengine/sdtaskgroup.h"
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <numeric>
+#include <thread>
+#include <vector>
+
+using namespace SSCP;
+
+class SDTaskGroupTest : public ::testing::TestWithParam<ESDThreadPoolMode> {
+protected:
+    void SetUp() override {
+        ASSERT_TRUE(pool.Init(4, 4, 0, GetParam()));
+    }
+
+    void TearDown() override {
+        pool.TerminateWaitJobs();
+    }
+
+    CSDThreadPool pool;
+};
+
+TEST_P(SDTaskGroupTest, RunAndWait) {
+    CSDTaskGroup group(pool);
+    std::vector<int> out(1000, 0);
+    for (int round = 1; round <= 3; ++round) {
+        // Enough tasks to outgrow the inline nodes; later rounds reuse them.
+        for (int i = 0; i < 1000; ++i) {
+            group.Run([&out, i, round] { out[i] = i * round; });
+        }
+        group.Wait();
+        for (int i = 0; i < 1000; ++i) {
+            ASSERT_EQ(out[i], i * round);
+        }
+    }
+}
+
+TEST_P(SDTaskGroupTest, LargeCapturesAndDestruction) {
+    std::atomic<long> sum{0};
+    std::shared_ptr<int> tracked = std::make_shared<int>(7);
+    {
+        CSDTaskGroup group(pool);
+        std::array<long, 32> big;
+        std::iota(big.begin(), big.end(), 1);
+        for (int i = 0; i < 10; ++i) {
+            // Too big for a task node, so it goes to the heap.
+            group.Run([big, &sum] { sum += std::accumulate(big.begin(), big.end(), 0L); });
+            group.Run([tracked, &sum] { sum += *tracked; });
+        }
+        // The destructor waits.
+    }
+    EXPECT_EQ(sum.load(), 10 * (32 * 33 / 2) + 10 * 7);
+    // Every copy of the capture was destroyed.
+    EXPECT_EQ(tracked.use_count(), 1);
+}
+
+TEST_P(SDTaskGroupTest, WaitHelpsWhenWorkersAreBusy) {
+    // Block every worker, so only the waiting thread can run the tasks.
+    std::atomic<bool> release{false};
+    std::atomic<int> blocked{0};
+    CSDTaskGroup blockers(pool);
+    for (int i = 0; i < 4; ++i) {
+        blockers.Run([&] {
+            blocked++;
+            while (!release.load()) std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        });
+    }
+    while (blocked.load() < 4) std::this_thread::sleep_for(std::chrono::milliseconds(1));
+
+    std::thread::id caller = std::this_thread::get_id();
+    std::atomic<int> onCaller{0};
+    CSDTaskGroup group(pool);
+    for (int i = 0; i < 100; ++i) {
+        group.Run([&] {
+            if (std::this_thread::get_id() == caller) onCaller++;
+        });
+    }
+    group.Wait();
+    EXPECT_EQ(onCaller.load(), 100);
+    release = true;
+    blockers.Wait();
+}
+
+TEST_P(SDTaskGroupTest, ParallelForCoversRange) {
+    std::vector<std::atomic<int>> hits(10007);
+    SDParallelFor(pool, 0, 10007, 64, [&hits](INT64 i) { hits[i]++; });
+    for (auto& h : hits) {
+        ASSERT_EQ(h.load(), 1);
+    }
+
+    // The chunk form gets each [first, last) once.
+    std::atomic<INT64> covered{0};
+    std::atomic<int> calls{0};
+    SDParallelFor(pool, 5, 1005, 100, [&](INT64 first, INT64 last) {
+        EXPECT_EQ((first - 5) % 100, 0);
+        covered += last - first;
+        calls++;
+    });
+    EXPECT_EQ(covered.load(), 1000);
+    EXPECT_EQ(calls.load(), 10);
+
+    // Empty ranges and a zero grain are handled.
+    int none = 0;
+    SDParallelFor(pool, 10, 10, 1, [&none](INT64) { none++; });
+    SDParallelFor(pool, 10, 3, 1, [&none](INT64) { none++; });
+    EXPECT_EQ(none, 0);
+    std::atomic<int> one{0};
+    SDParallelFor(pool, 0, 3, 0, [&one](INT64) { one++; });
+    EXPECT_EQ(one.load(), 3);
+}
+
+TEST_P(SDTaskGroupTest, NestedParallelFor) {
+    // Inner loops run on workers and wait there, helping instead of blocking.
+    std::vector<std::atomic<int>> cells(64 * 64);
+    SDParallelFor(pool, 0, 64, 1, [&](INT64 row) {
+        SDParallelFor(pool, 0, 64, 8, [&, row](INT64 col) { cells[row * 64 + col]++; });
+    });
+    for (auto& c : cells) {
+        ASSERT_EQ(c.load(), 1);
+    }
+}
+
+INSTANTIATE_TEST_SUITE_P(Modes, SDTaskGroupTest,
+                         ::testing::Values(SDTHREADPOOL_SHARED_QUEUE, SDTHREADPOOL_WORK_STEALING));
+
+TEST_P(SDTaskGroupTest, TerminateQuickCancelsQueuedTasks) {
+    // Keep every worker busy so the group's tasks stay queued.
+    std::atomic<bool> release{false};
+    std::atomic<int> blocked{0};
+    CSDTaskGroup blockers(pool);
+    for (int i = 0; i < 4; ++i) {
+        blockers.Run([&] {
+            blocked++;
+            while (!release.load()) std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        });
+    }
+    while (blocked.load() < 4) std::this_thread::sleep_for(std::chrono::milliseconds(1));
+
+    std::atomic<int> ran{0};
+    std::shared_ptr<int> tracked = std::make_shared<int>(1);
+    CSDTaskGroup group(pool);
+    for (int i = 0; i < 20; ++i) {
+        group.Run([tracked, &ran] { ran++; });
+    }
+    // TerminateQuick drops the queued tasks before it joins the workers.
+    std::thread terminator([this] { pool.TerminateQuick(); });
+    std::this_thread::sleep_for(std::chrono::milliseconds(50));
+    release = true;
+    terminator.join();
+
+    group.Wait();
+    EXPECT_EQ(ran.load(), 0);
+    // The cancelled tasks destroyed their captures without running.
+    EXPECT_EQ(tracked.use_count(), 1);
+    blockers.Wait();
+}
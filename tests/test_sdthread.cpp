@@ -2,6 +2,18 @@
 #include "ssengine/sdthread.h"
 #include "ssengine/sdtype.h"
 
+#include <atomic>
+#include <cstring>
+#include <string>
+
+#if !defined(_WIN32)
+#include <pthread.h>
+#include <sched.h>
+#include <sys/resource.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
 using namespace SSCP;
 
 TEST(sdthread, get_thread_id_returns_something) {
@@ -46,3 +58,141 @@ TEST(sdthread, function_thread_start_and_wait) {
     EXPECT_TRUE(ran);
 }
 #endif
+
+TEST(sdthread, attr_helpers) {
+    SThreadAttr attr;
+    SDThreadAttrInit(&attr);
+    EXPECT_EQ(attr.m_nNumaNode, -1);
+    EXPECT_EQ(attr.m_nPriority, SDTHREAD_PRIORITY_NORMAL);
+    EXPECT_EQ(attr.m_szName[0], 0);
+    for (UINT64 w : attr.m_aqwCpuMask) EXPECT_EQ(w, 0u);
+
+    SDThreadAttrAddCpu(&attr, 1);
+    SDThreadAttrAddCpu(&attr, 65);
+    SDThreadAttrAddCpu(&attr, SDTHREAD_MAX_CPUS);
+    EXPECT_EQ(attr.m_aqwCpuMask[0], 2u);
+    EXPECT_EQ(attr.m_aqwCpuMask[1], 2u);
+
+    SDThreadAttrSetName(&attr, "a-name-longer-than-fifteen");
+    EXPECT_EQ(std::strlen(attr.m_szName), SDTHREAD_NAME_LEN - 1u);
+    EXPECT_EQ(std::string(attr.m_szName), "a-name-longer-t");
+    EXPECT_GE(SDGetNumaNodeCount(), 1u);
+}
+
+#if !defined(_WIN32)
+namespace {
+// What a thread saw of itself.
+struct Observed {
+    std::atomic<bool> ran{false};
+    std::string name;
+    int cpus = 0;
+    int firstCpu = -1;
+    int nice = 0;
+};
+
+void observe(Observed& o) {
+    char name[SDTHREAD_NAME_LEN] = {0};
+    pthread_getname_np(pthread_self(), name, sizeof(name));
+    o.name = name;
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    pthread_getaffinity_np(pthread_self(), sizeof(set), &set);
+    o.cpus = CPU_COUNT(&set);
+    for (int i = 0; i < CPU_SETSIZE; ++i) {
+        if (CPU_ISSET(i, &set)) {
+            o.firstCpu = i;
+            break;
+        }
+    }
+    o.nice = getpriority(PRIO_PROCESS, static_cast<id_t>(syscall(SYS_gettid)));
+    o.ran = true;
+}
+
+SDTHREAD_DECLARE(observe_proc)(void* arg) {
+    observe(*static_cast<Observed*>(arg));
+    SDTHREAD_RETURN(0);
+}
+
+// The first CPU this process may run on.
+int first_allowed_cpu() {
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    sched_getaffinity(0, sizeof(set), &set);
+    for (int i = 0; i < CPU_SETSIZE; ++i) {
+        if (CPU_ISSET(i, &set)) return i;
+    }
+    return 0;
+}
+
+class ObserveThread : public CSDThread {
+public:
+    Observed seen;
+
+protected:
+    void SSAPI ThrdProc() override { observe(seen); }
+};
+}
+
+TEST(sdthread, create_thread_applies_attr_before_running) {
+    SThreadAttr attr;
+    SDThreadAttrInit(&attr);
+    SDThreadAttrSetName(&attr, "sd-io");
+    int cpu = first_allowed_cpu();
+    SDThreadAttrAddCpu(&attr, static_cast<UINT32>(cpu));
+    // Lowering the priority needs no privileges.
+    attr.m_nPriority = SDTHREAD_PRIORITY_LOWEST;
+
+    Observed seen;
+    SDHANDLE h = SDCreateThread(&attr, &observe_proc, &seen);
+    ASSERT_NE(h, SDINVALID_HANDLE);
+    ASSERT_NE(SDGetThreadAttr(h), nullptr);
+    EXPECT_STREQ(SDGetThreadAttr(h)->m_szName, "sd-io");
+    EXPECT_EQ(SDThreadWait(h), 0);
+    ASSERT_TRUE(seen.ran);
+    EXPECT_EQ(seen.name, "sd-io");
+    EXPECT_EQ(seen.cpus, 1);
+    EXPECT_EQ(seen.firstCpu, cpu);
+    EXPECT_EQ(seen.nice, 10);
+
+    // Without attributes nothing is set.
+    Observed plain;
+    h = SDCreateThread(nullptr, &observe_proc, &plain);
+    ASSERT_NE(h, SDINVALID_HANDLE);
+    EXPECT_EQ(SDGetThreadAttr(h), nullptr);
+    EXPECT_EQ(SDThreadWait(h), 0);
+    EXPECT_NE(plain.name, "sd-io");
+}
+
+TEST(sdthread, numa_node_binding) {
+    SThreadAttr attr;
+    SDThreadAttrInit(&attr);
+    attr.m_nNumaNode = 0;
+    Observed seen;
+    SDHANDLE h = SDCreateThread(&attr, &observe_proc, &seen);
+    ASSERT_NE(h, SDINVALID_HANDLE);
+    EXPECT_EQ(SDThreadWait(h), 0);
+    ASSERT_TRUE(seen.ran);
+    EXPECT_GE(seen.cpus, 1);
+
+    // A node that does not exist leaves no CPU to run on.
+    attr.m_nNumaNode = 4095;
+    EXPECT_FALSE(SDSetCurrentThreadAttr(&attr));
+    EXPECT_FALSE(SDSetCurrentThreadAttr(nullptr));
+}
+
+TEST(sdthread, class_thread_attribute) {
+    ObserveThread thread;
+    EXPECT_EQ(thread.GetAttribute(), nullptr);
+    SThreadAttr attr;
+    SDThreadAttrInit(&attr);
+    SDThreadAttrSetName(&attr, "sd-logic");
+    EXPECT_TRUE(thread.SetAttribute(&attr));
+    ASSERT_NE(thread.GetAttribute(), nullptr);
+    ASSERT_TRUE(thread.Start());
+    thread.Wait();
+    ASSERT_TRUE(thread.seen.ran);
+    EXPECT_EQ(thread.seen.name, "sd-logic");
+    EXPECT_TRUE(thread.SetAttribute(nullptr));
+    EXPECT_EQ(thread.GetAttribute(), nullptr);
+}
+#endif
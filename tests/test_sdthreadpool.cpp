@@ -7,9 +7,17 @@
 #include "ssengine/sdthreadpool.h"
 #include <atomic>
 #include <chrono>
+#include <memory>
+#include <mutex>
+#include <set>
+#include <string>
 #include <vector>
 #include <thread>
 
+#ifndef _WIN32
+#include <pthread.h>
+#endif
+
 using namespace SSCP;
 
 class SDThreadPoolTest : public ::testing::Test {
@@ -485,4 +493,447 @@ TEST_F(SDThreadPoolTest, PerformanceComparison) {
     for (auto* job : jobs) {
         delete job;
     }
-}
\ No newline at end of file
+}
+
+// Splits itself until depth reaches zero, scheduling the halves from inside
+// the pool, like a divide-and-conquer batch.
+class FanOutJob : public ISSRunable {
+public:
+    FanOutJob(CSDThreadPool& pool, int depth, std::atomic<int>& leaves, std::atomic<int>& done)
+        : pool_(pool), depth_(depth), leaves_(leaves), done_(done) {}
+
+    void Run() override {
+        if (depth_ == 0) {
+            leaves_++;
+        } else {
+            for (int i = 0; i < 2; ++i) {
+                FanOutJob* child = new FanOutJob(pool_, depth_ - 1, leaves_, done_);
+                while (!pool_.ScheduleJob(child)) {
+                    std::this_thread::yield();
+                }
+            }
+        }
+        done_++;
+        delete this;
+    }
+
+private:
+    CSDThreadPool& pool_;
+    int depth_;
+    std::atomic<int>& leaves_;
+    std::atomic<int>& done_;
+};
+
+class ThreadIdJob : public ISSRunable {
+public:
+    ThreadIdJob(std::mutex& mutex, std::set<std::thread::id>& ids, std::atomic<int>& counter)
+        : mutex_(mutex), ids_(ids), counter_(counter) {}
+
+    void Run() override {
+        std::this_thread::sleep_for(std::chrono::milliseconds(2));
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            ids_.insert(std::this_thread::get_id());
+        }
+        counter_++;
+    }
+
+private:
+    std::mutex& mutex_;
+    std::set<std::thread::id>& ids_;
+    std::atomic<int>& counter_;
+};
+
+TEST_F(SDThreadPoolTest, WorkStealingRunsExternalJobs) {
+    CSDThreadPool pool;
+    ASSERT_TRUE(pool.Init(1, 4, 0, SDTHREADPOOL_WORK_STEALING));
+    EXPECT_EQ(pool.GetMode(), SDTHREADPOOL_WORK_STEALING);
+    EXPECT_EQ(pool.GetThreadNum(), 4u);
+
+    std::atomic<int> counter{0};
+    std::vector<CounterJob*> jobs;
+    for (int i = 0; i < 10000; ++i) {
+        jobs.push_back(new CounterJob(counter));
+        ASSERT_TRUE(pool.ScheduleJob(jobs.back()));
+    }
+    pool.TerminateWaitJobs();
+    EXPECT_EQ(counter.load(), 10000);
+    EXPECT_EQ(pool.GetJobPending(), 0u);
+    EXPECT_EQ(pool.GetThreadNum(), 0u);
+    for (auto* job : jobs) {
+        delete job;
+    }
+}
+
+TEST_F(SDThreadPoolTest, WorkStealingSpreadsNestedJobs) {
+    CSDThreadPool pool;
+    ASSERT_TRUE(pool.Init(4, 4, 0, SDTHREADPOOL_WORK_STEALING));
+
+    // Every job below is scheduled by a worker onto its own deque; the
+    // other workers only get them by stealing.
+    std::atomic<int> leaves{0};
+    std::atomic<int> done{0};
+    ASSERT_TRUE(pool.ScheduleJob(new FanOutJob(pool, 12, leaves, done)));
+    auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(10);
+    while (done.load() < (1 << 13) - 1 && std::chrono::steady_clock::now() < deadline) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    EXPECT_EQ(leaves.load(), 1 << 12);
+    EXPECT_EQ(done.load(), (1 << 13) - 1);
+
+    std::mutex mutex;
+    std::set<std::thread::id> ids;
+    std::atomic<int> counter{0};
+    std::vector<ThreadIdJob*> jobs;
+    for (int i = 0; i < 64; ++i) {
+        jobs.push_back(new ThreadIdJob(mutex, ids, counter));
+        ASSERT_TRUE(pool.ScheduleJob(jobs.back()));
+    }
+    pool.TerminateWaitJobs();
+    EXPECT_EQ(counter.load(), 64);
+    EXPECT_GT(ids.size(), 1u);
+    for (auto* job : jobs) {
+        delete job;
+    }
+}
+
+TEST_F(SDThreadPoolTest, WorkStealingPendingLimitAndQuickTerminate) {
+    CSDThreadPool pool;
+    ASSERT_TRUE(pool.Init(1, 1, 3, SDTHREADPOOL_WORK_STEALING));
+
+    std::atomic<int> counter{0};
+    std::vector<SleepJob*> jobs;
+    for (int i = 0; i < 8; ++i) {
+        jobs.push_back(new SleepJob(50, counter));
+    }
+    ASSERT_TRUE(pool.ScheduleJob(jobs[0]));
+    // Let the worker take the first job, so three more fit.
+    while (pool.GetJobPending() > 0) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    EXPECT_TRUE(pool.ScheduleJob(jobs[1]));
+    EXPECT_TRUE(pool.ScheduleJob(jobs[2]));
+    EXPECT_TRUE(pool.ScheduleJob(jobs[3]));
+    EXPECT_FALSE(pool.ScheduleJob(jobs[4]));
+    EXPECT_EQ(pool.GetJobPending(), 3u);
+
+    pool.TerminateQuick();
+    EXPECT_LT(counter.load(), 4);
+    EXPECT_EQ(pool.GetJobPending(), 0u);
+
+    // The pool can be started again in either mode.
+    ASSERT_TRUE(pool.Init(2, 2, 0, SDTHREADPOOL_WORK_STEALING));
+    EXPECT_TRUE(pool.ScheduleJob(jobs[5]));
+    pool.TerminateWaitJobs();
+    ASSERT_TRUE(pool.Init(1, 2, 0));
+    EXPECT_EQ(pool.GetMode(), SDTHREADPOOL_SHARED_QUEUE);
+    EXPECT_TRUE(pool.ScheduleJob(jobs[6]));
+    pool.TerminateWaitJobs();
+    EXPECT_GE(counter.load(), 2);
+    for (auto* job : jobs) {
+        delete job;
+    }
+}
+
+// Holds the pool's only worker until released.
+class GateJob : public ISSRunable {
+public:
+    void Run() override {
+        started = true;
+        while (!open.load()) std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+
+    void waitStarted() {
+        while (!started.load()) std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+
+    std::atomic<bool> started{false};
+    std::atomic<bool> open{false};
+};
+
+class OrderJob : public ISSRunable {
+public:
+    OrderJob(int lane, std::mutex& mutex, std::vector<int>& order) : lane_(lane), mutex_(mutex), order_(order) {}
+
+    void Run() override {
+        std::lock_guard<std::mutex> lock(mutex_);
+        order_.push_back(lane_);
+    }
+
+private:
+    int lane_;
+    std::mutex& mutex_;
+    std::vector<int>& order_;
+};
+
+class LateJob : public ISSRunable {
+public:
+    explicit LateJob(BOOL keep) : keep_(keep) {}
+
+    void Run() override { ran = true; }
+
+    BOOL OnDeadlineMissed(UINT32 dwLateMs) override {
+        lateMs = dwLateMs;
+        missed = true;
+        return keep_;
+    }
+
+    std::atomic<bool> ran{false};
+    std::atomic<bool> missed{false};
+    std::atomic<UINT32> lateMs{0};
+
+private:
+    BOOL keep_;
+};
+
+TEST_F(SDThreadPoolTest, PriorityLanesWeightedOrder) {
+    const ESDThreadPoolMode modes[] = {SDTHREADPOOL_SHARED_QUEUE, SDTHREADPOOL_WORK_STEALING};
+    for (ESDThreadPoolMode mode : modes) {
+        CSDThreadPool pool;
+        ASSERT_TRUE(pool.Init(1, 1, 0, mode));
+        GateJob gate;
+        ASSERT_TRUE(pool.ScheduleJob(&gate, SDJOB_PRIORITY_HIGH));
+        gate.waitStarted();
+
+        // A backlog of background jobs queued ahead of the urgent ones.
+        std::mutex mutex;
+        std::vector<int> order;
+        std::vector<std::unique_ptr<OrderJob>> jobs;
+        const ESDJobPriority lanes[] = {SDJOB_PRIORITY_LOW, SDJOB_PRIORITY_NORMAL, SDJOB_PRIORITY_HIGH};
+        for (ESDJobPriority lane : lanes) {
+            for (int i = 0; i < 26; ++i) {
+                jobs.emplace_back(new OrderJob(lane, mutex, order));
+                ASSERT_TRUE(pool.ScheduleJob(jobs.back().get(), lane));
+            }
+        }
+        EXPECT_EQ(pool.GetJobPending(), 78u);
+        EXPECT_EQ(pool.GetJobPending(SDJOB_PRIORITY_LOW), 26u);
+        EXPECT_EQ(pool.GetJobPending(SDJOB_PRIORITY_HIGH), 26u);
+        gate.open = true;
+        pool.TerminateWaitJobs();
+
+        // Weights 8:4:1: every window of 13 while all lanes are busy holds
+        // 8 high, 4 normal and 1 low job, so low is served but not first.
+        ASSERT_EQ(order.size(), 78u);
+        for (int window = 0; window < 2; ++window) {
+            int count[SDJOB_PRIORITY_COUNT] = {0, 0, 0};
+            for (int i = window * 13; i < window * 13 + 13; ++i) count[order[i]]++;
+            EXPECT_EQ(count[SDJOB_PRIORITY_HIGH], 8) << "mode " << mode;
+            EXPECT_EQ(count[SDJOB_PRIORITY_NORMAL], 4) << "mode " << mode;
+            EXPECT_EQ(count[SDJOB_PRIORITY_LOW], 1) << "mode " << mode;
+        }
+        EXPECT_EQ(order[0], SDJOB_PRIORITY_HIGH);
+    }
+}
+
+TEST_F(SDThreadPoolTest, LaneWeightCanBeChanged) {
+    CSDThreadPool pool;
+    ASSERT_TRUE(pool.Init(1, 1, 0));
+    pool.SetLaneWeight(SDJOB_PRIORITY_HIGH, 1);
+    pool.SetLaneWeight(SDJOB_PRIORITY_LOW, 1);
+    GateJob gate;
+    ASSERT_TRUE(pool.ScheduleJob(&gate));
+    gate.waitStarted();
+
+    std::mutex mutex;
+    std::vector<int> order;
+    std::vector<std::unique_ptr<OrderJob>> jobs;
+    for (int i = 0; i < 10; ++i) {
+        jobs.emplace_back(new OrderJob(SDJOB_PRIORITY_LOW, mutex, order));
+        ASSERT_TRUE(pool.ScheduleJob(jobs.back().get(), SDJOB_PRIORITY_LOW));
+        jobs.emplace_back(new OrderJob(SDJOB_PRIORITY_HIGH, mutex, order));
+        ASSERT_TRUE(pool.ScheduleJob(jobs.back().get(), SDJOB_PRIORITY_HIGH));
+    }
+    gate.open = true;
+    pool.TerminateWaitJobs();
+    // Equal weights alternate.
+    ASSERT_EQ(order.size(), 20u);
+    for (size_t i = 1; i < order.size(); ++i) {
+        EXPECT_NE(order[i], order[i - 1]);
+    }
+    SDJobLaneStats stats;
+    ASSERT_TRUE(pool.GetLaneStats(SDJOB_PRIORITY_HIGH, stats));
+    EXPECT_EQ(stats.m_dwWeight, 1u);
+}
+
+TEST_F(SDThreadPoolTest, DeadlinesDropOrReportLateJobs) {
+    const ESDThreadPoolMode modes[] = {SDTHREADPOOL_SHARED_QUEUE, SDTHREADPOOL_WORK_STEALING};
+    for (ESDThreadPoolMode mode : modes) {
+        CSDThreadPool pool;
+        ASSERT_TRUE(pool.Init(1, 1, 0, mode));
+        GateJob gate;
+        ASSERT_TRUE(pool.ScheduleJob(&gate));
+        gate.waitStarted();
+
+        LateJob dropped(FALSE);
+        LateJob kept(TRUE);
+        LateJob onTime(FALSE);
+        ASSERT_TRUE(pool.ScheduleJob(&dropped, SDJOB_PRIORITY_HIGH, 10));
+        ASSERT_TRUE(pool.ScheduleJob(&kept, SDJOB_PRIORITY_HIGH, 10));
+        ASSERT_TRUE(pool.ScheduleJob(&onTime, SDJOB_PRIORITY_NORMAL, 60000));
+        std::this_thread::sleep_for(std::chrono::milliseconds(50));
+        gate.open = true;
+        pool.TerminateWaitJobs();
+
+        EXPECT_TRUE(dropped.missed);
+        EXPECT_FALSE(dropped.ran);
+        EXPECT_TRUE(kept.missed);
+        EXPECT_TRUE(kept.ran);
+        EXPECT_GE(kept.lateMs.load(), 30u);
+        EXPECT_FALSE(onTime.missed);
+        EXPECT_TRUE(onTime.ran);
+
+        SDJobLaneStats high;
+        ASSERT_TRUE(pool.GetLaneStats(SDJOB_PRIORITY_HIGH, high));
+        EXPECT_EQ(high.m_qwScheduled, 2u);
+        EXPECT_EQ(high.m_qwDequeued, 2u);
+        EXPECT_EQ(high.m_qwLate, 2u);
+        EXPECT_EQ(high.m_qwDropped, 1u);
+        EXPECT_EQ(high.m_dwPending, 0u);
+        EXPECT_GE(high.m_qwWaitMaxUs, 40000u);
+
+        // The wait histogram accounts for every dequeued job.
+        SDJobLaneStats normal;
+        ASSERT_TRUE(pool.GetLaneStats(SDJOB_PRIORITY_NORMAL, normal));
+        UINT64 inBuckets = 0;
+        for (UINT64 n : normal.m_aqwWaitBuckets) inBuckets += n;
+        EXPECT_EQ(inBuckets, normal.m_qwDequeued);
+        EXPECT_EQ(normal.m_qwLate, 0u);
+        EXPECT_FALSE(pool.GetLaneStats(SDJOB_PRIORITY_COUNT, normal));
+        EXPECT_FALSE(pool.ScheduleJob(&onTime, SDJOB_PRIORITY_COUNT));
+    }
+}
+
+TEST_F(SDThreadPoolTest, TerminateWaitJobsReturnsOnceDrained) {
+    const ESDThreadPoolMode modes[] = {SDTHREADPOOL_SHARED_QUEUE, SDTHREADPOOL_WORK_STEALING};
+    for (ESDThreadPoolMode mode : modes) {
+        // Best of a few runs, so a descheduled test thread does not fail it.
+        auto best = std::chrono::milliseconds(1000);
+        for (int run = 0; run < 3; ++run) {
+            CSDThreadPool pool;
+            ASSERT_TRUE(pool.Init(2, 2, 0, mode));
+            GateJob gate;
+            ASSERT_TRUE(pool.ScheduleJob(&gate));
+            gate.waitStarted();
+            std::atomic<int> counter{0};
+            std::vector<std::unique_ptr<CounterJob>> jobs;
+            for (int i = 0; i < 4; ++i) {
+                jobs.emplace_back(new CounterJob(counter));
+                ASSERT_TRUE(pool.ScheduleJob(jobs.back().get()));
+            }
+
+            std::thread opener([&gate] {
+                std::this_thread::sleep_for(std::chrono::milliseconds(5));
+                gate.open = true;
+            });
+            auto start = std::chrono::steady_clock::now();
+            pool.TerminateWaitJobs();
+            auto elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - start);
+            opener.join();
+            EXPECT_EQ(counter.load(), 4) << "mode " << mode;
+            EXPECT_EQ(pool.GetThreadNum(), 0u);
+            best = std::min(best, elapsed);
+        }
+        // The old loop polled every 32 ms.
+        EXPECT_LT(best.count(), 25) << "mode " << mode;
+    }
+}
+
+TEST_F(SDThreadPoolTest, StatsCountJobsWaitsAndGrowth) {
+    CSDThreadPool pool;
+    ASSERT_TRUE(pool.Init(1, 3, 0));
+    GateJob gate;
+    ASSERT_TRUE(pool.ScheduleJob(&gate));
+    gate.waitStarted();
+
+    // A backlog grows the pool to its maximum.
+    std::atomic<int> counter{0};
+    std::vector<std::unique_ptr<SleepJob>> jobs;
+    for (int i = 0; i < 9; ++i) {
+        jobs.emplace_back(new SleepJob(5, counter));
+        ASSERT_TRUE(pool.ScheduleJob(jobs.back().get()));
+    }
+    EXPECT_EQ(pool.GetThreadNum(), 3u);
+    std::this_thread::sleep_for(std::chrono::milliseconds(20));
+    gate.open = true;
+    pool.TerminateWaitJobs();
+
+    SDThreadPoolStats stats;
+    pool.GetStats(stats);
+    EXPECT_EQ(stats.m_dwThreads, 0u);
+    EXPECT_EQ(stats.m_dwThreadsPeak, 3u);
+    EXPECT_EQ(stats.m_qwThreadsSpawned, 2u);
+    EXPECT_EQ(stats.m_qwJobsExecuted, 10u);
+    EXPECT_GT(stats.m_qwWaitAvgUs, 0u);
+    EXPECT_GE(stats.m_qwWaitP99Us, stats.m_qwWaitAvgUs);
+    EXPECT_GE(stats.m_qwBusyUs, 9u * 5000u);
+
+    SDThreadPoolWorkerStats workers[4];
+    ASSERT_EQ(pool.GetWorkerStats(workers, 4), 3u);
+    UINT64 jobsRun = 0;
+    UINT64 busy = 0;
+    for (UINT32 i = 0; i < 3; ++i) {
+        EXPECT_EQ(workers[i].m_dwIndex, i);
+        EXPECT_LE(workers[i].m_qwBusyUs, workers[i].m_qwAliveUs);
+        jobsRun += workers[i].m_qwJobs;
+        busy += workers[i].m_qwBusyUs;
+    }
+    EXPECT_EQ(jobsRun, 10u);
+    EXPECT_EQ(busy, stats.m_qwBusyUs);
+    EXPECT_EQ(pool.GetWorkerStats(workers, 1), 1u);
+
+    // Init starts the counters afresh.
+    ASSERT_TRUE(pool.Init(1, 1, 0, SDTHREADPOOL_WORK_STEALING));
+    pool.GetStats(stats);
+    EXPECT_EQ(stats.m_qwJobsExecuted, 0u);
+    EXPECT_EQ(stats.m_qwThreadsSpawned, 0u);
+    EXPECT_EQ(stats.m_dwThreads, 1u);
+    for (int i = 0; i < 5; ++i) {
+        ASSERT_TRUE(pool.ScheduleJob(jobs[i].get()));
+    }
+    pool.TerminateWaitJobs();
+    pool.GetStats(stats);
+    EXPECT_EQ(stats.m_qwJobsExecuted, 5u);
+    EXPECT_EQ(stats.m_qwThreadsSpawned, 0u);
+}
+
+#ifndef _WIN32
+class ThreadNameJob : public ISSRunable {
+public:
+    ThreadNameJob(std::mutex& mutex, std::set<std::string>& names) : mutex_(mutex), names_(names) {}
+
+    void Run() override {
+        char name[SDTHREAD_NAME_LEN] = {0};
+        pthread_getname_np(pthread_self(), name, sizeof(name));
+        std::lock_guard<std::mutex> lock(mutex_);
+        names_.insert(name);
+    }
+
+private:
+    std::mutex& mutex_;
+    std::set<std::string>& names_;
+};
+
+TEST_F(SDThreadPoolTest, WorkersTakeThreadAttr) {
+    CSDThreadPool pool;
+    SThreadAttr attr;
+    SDThreadAttrInit(&attr);
+    // Cut to leave room for the index suffix.
+    SDThreadAttrSetName(&attr, "logic-workers-x");
+    pool.SetThreadAttr(&attr);
+    ASSERT_TRUE(pool.Init(2, 2, 0));
+
+    std::mutex mutex;
+    std::set<std::string> names;
+    std::vector<std::unique_ptr<ThreadNameJob>> jobs;
+    for (int i = 0; i < 200; ++i) {
+        jobs.emplace_back(new ThreadNameJob(mutex, names));
+        ASSERT_TRUE(pool.ScheduleJob(jobs.back().get()));
+    }
+    pool.TerminateWaitJobs();
+    ASSERT_FALSE(names.empty());
+    for (const std::string& name : names) {
+        EXPECT_TRUE(name == "logic-workers-0" || name == "logic-workers-1") << name;
+    }
+}
+#endif
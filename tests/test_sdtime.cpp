@@ -1,5 +1,8 @@
 #include <gtest/gtest.h>
 #include "ssengine/sdtime.h"
+#include <algorithm>
+#include <cstdint>
+#include <thread>
 
 using namespace SSCP;
 
@@ -16,3 +19,53 @@ TEST(sdtime, now_and_diff) {
     later.IncSecond(2);
     EXPECT_GE(later.DiffSecond(now), 2);
 }
+
+TEST(sdtime, frame_clock_is_cached_per_thread) {
+    UINT64 ms = SDFrameClockUpdate();
+    UINT64 us = SDFrameMicroSec();
+    EXPECT_EQ(SDFrameMilliSec(), ms);
+    EXPECT_EQ(us / 1000, ms);
+    SDSleep(5);
+    // Unchanged until the next refresh.
+    EXPECT_EQ(SDFrameMilliSec(), ms);
+    EXPECT_EQ(SDFrameMicroSec(), us);
+    UINT64 other = 0;
+    std::thread([&other] { other = SDFrameMilliSec(); }).join();
+    EXPECT_GE(other, ms + 4);
+    EXPECT_GE(SDFrameClockUpdate(), ms + 4);
+    EXPECT_LE(SDFrameMilliSec(), SDTimeMilliSec());
+}
+
+TEST(sdtime, nano_clock_matches_steady_clock) {
+    // Whether or not this CPU has a usable TSC, SDTimeNanoSec keeps the
+    // SDTimeMicroSec epoch and never runs backwards on one thread.
+    SDTscEnable();
+    EXPECT_EQ(SDTscEnable(), SDTscEnable());
+    UINT64 last = SDTimeNanoSec();
+    for (int i = 0; i < 100000; ++i) {
+        UINT64 ns = SDTimeNanoSec();
+        ASSERT_GE(ns, last);
+        last = ns;
+    }
+    INT64 diffUs = static_cast<INT64>(SDTimeNanoSec() / 1000) - static_cast<INT64>(SDTimeMicroSec());
+    EXPECT_LT(diffUs < 0 ? -diffUs : diffUs, 1000);
+}
+
+TEST(sdtime, nano_clock_stays_anchored_to_steady_clock) {
+    // Run across a re-anchor period: the TSC line must stay monotonic and
+    // keep tracking steady_clock instead of drifting away from it.
+    if (!SDTscEnable()) GTEST_SKIP() << "no invariant TSC";
+    UINT64 start = SDTimeMicroSec();
+    UINT64 last = SDTimeNanoSec();
+    while (SDTimeMicroSec() - start < 1200000) {
+        UINT64 ns = SDTimeNanoSec();
+        ASSERT_GE(ns, last);
+        last = ns;
+    }
+    INT64 best = INT64_MAX;
+    for (int i = 0; i < 16; ++i) {
+        INT64 diff = static_cast<INT64>(SDTimeNanoSec() / 1000) - static_cast<INT64>(SDTimeMicroSec());
+        best = std::min(best, diff < 0 ? -diff : diff);
+    }
+    EXPECT_LT(best, 100);
+}
@@ -1,8 +1,11 @@
 #include <gtest/gtest.h>
 
 #include "ssengine/sdtimer.h"
+#include <algorithm>
 #include <chrono>
+#include <functional>
 #include <thread>
+#include <vector>
 
 using namespace SSCP;
 
@@ -30,3 +33,99 @@ TEST(sdtimer, basic_timeout) {
     EXPECT_EQ(handler.count, 1u);
     EXPECT_EQ(handler.lastId, 42u);
 }
+
+namespace {
+class RecordTimer : public ISSTimer {
+public:
+    void SSAPI OnTimer(UINT32 dwTimerID) override {
+        fired.push_back(dwTimerID);
+        if (onFire) onFire(dwTimerID);
+    }
+    std::vector<UINT32> fired;
+    std::function<void(UINT32)> onFire;
+};
+
+template <typename Pred>
+void runUntil(CSDTimer& timer, Pred done, int maxMs) {
+    auto deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(maxMs);
+    while (!done() && std::chrono::steady_clock::now() < deadline) {
+        timer.Run();
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+}
+}
+
+TEST(sdtimer, many_timers_fire_once_and_not_early) {
+    CSDTimer timer;
+    RecordTimer handler;
+    const UINT32 n = 20000;
+    std::vector<std::chrono::steady_clock::time_point> setAt(n), firedAt(n);
+    handler.onFire = [&](UINT32 id) { firedAt[id] = std::chrono::steady_clock::now(); };
+    for (UINT32 i = 0; i < n; ++i) {
+        setAt[i] = std::chrono::steady_clock::now();
+        ASSERT_TRUE(timer.SetTimer(&handler, i, 1 + (i * 7) % 60, 1));
+    }
+    runUntil(timer, [&] { return handler.fired.size() >= n; }, 2000);
+    ASSERT_EQ(handler.fired.size(), n);
+    std::vector<bool> seen(n, false);
+    for (UINT32 id : handler.fired) {
+        ASSERT_FALSE(seen[id]);
+        seen[id] = true;
+        // Ticks are whole milliseconds, so allow for the one being truncated.
+        EXPECT_GE(firedAt[id] - setAt[id], std::chrono::milliseconds((id * 7) % 60));
+    }
+    timer.Run();
+    EXPECT_EQ(handler.fired.size(), n);
+    EXPECT_NE(timer.DumpTimerInfo().find("timer-count:0 "), std::string::npos);
+}
+
+TEST(sdtimer, loops_kill_and_reentrancy) {
+    CSDTimer timer;
+    RecordTimer handler;
+    ASSERT_FALSE(timer.SetTimer(nullptr, 1, 5));
+    ASSERT_FALSE(timer.SetTimer(&handler, 1, 0));
+    ASSERT_TRUE(timer.SetTimer(&handler, 1, 2, 3));             // fires three times
+    ASSERT_TRUE(timer.SetTimer(&handler, 2, 2));                // forever
+    ASSERT_TRUE(timer.SetTimer(&handler, 3, 5, 1));
+    ASSERT_TRUE(timer.SetTimer(&handler, 4, 5, 1));
+    // 3 and 4 are due on the same tick; 3 kills 4 and 2, and sets 5.
+    handler.onFire = [&](UINT32 id) {
+        if (id == 3) {
+            EXPECT_TRUE(timer.KillTimer(4));
+            EXPECT_TRUE(timer.KillTimer(2));
+            EXPECT_TRUE(timer.SetTimer(&handler, 5, 1, 1));
+        }
+    };
+    auto fired = [&](UINT32 id) { return std::count(handler.fired.begin(), handler.fired.end(), id); };
+    runUntil(timer, [&] { return fired(5) == 1 && fired(1) == 3; }, 1000);
+    std::this_thread::sleep_for(std::chrono::milliseconds(20));
+    timer.Run();
+    EXPECT_EQ(std::count(handler.fired.begin(), handler.fired.end(), 1u), 3);
+    EXPECT_EQ(std::count(handler.fired.begin(), handler.fired.end(), 3u), 1);
+    EXPECT_EQ(std::count(handler.fired.begin(), handler.fired.end(), 4u), 0);
+    EXPECT_EQ(std::count(handler.fired.begin(), handler.fired.end(), 5u), 1);
+    EXPECT_GE(std::count(handler.fired.begin(), handler.fired.end(), 2u), 1);
+    EXPECT_FALSE(timer.KillTimer(2));
+    EXPECT_FALSE(timer.KillTimer(77));
+    EXPECT_NE(timer.DumpTimerInfo().find("timer-count:0 "), std::string::npos);
+}
+
+TEST(sdtimer, long_timers_cascade_down) {
+    CSDTimer timer;
+    RecordTimer handler;
+    auto start = std::chrono::steady_clock::now();
+    // Beyond the first level (256 ms), so filed one level up first.
+    ASSERT_TRUE(timer.SetTimer(&handler, 1, 300, 1));
+    ASSERT_TRUE(timer.SetTimer(&handler, 2, 3600 * 1000, 1));
+    std::string info = timer.DumpTimerInfo();
+    EXPECT_NE(info.find("timer-count:2 "), std::string::npos) << info;
+    EXPECT_NE(info.find("L1:1/64 slots,1 timers"), std::string::npos) << info;
+    EXPECT_NE(info.find("L3:1/64 slots,1 timers"), std::string::npos) << info;
+    runUntil(timer, [&] { return !handler.fired.empty(); }, 2000);
+    auto waited = std::chrono::steady_clock::now() - start;
+    ASSERT_EQ(handler.fired.size(), 1u);
+    EXPECT_EQ(handler.fired[0], 1u);
+    EXPECT_GE(waited, std::chrono::milliseconds(300));
+    EXPECT_LT(waited, std::chrono::milliseconds(1000));
+    EXPECT_TRUE(timer.KillTimer(2));
+}